@@ -23,17 +23,14 @@
 #include "RegisteredBeaconFilter.hpp"
 
 namespace loc{
-    RegisteredBeaconFilter::RegisteredBeaconFilter(const BLEBeacons& bleBeacons){
-        for(const auto& ble: bleBeacons){
-            registeredIDs.insert(ble.id());
-        }
-    }
+    RegisteredBeaconFilter::RegisteredBeaconFilter(const BLEBeacons& bleBeacons)
+    : registry(BeaconRegistry::fromBeacons(bleBeacons)){}
     
     Beacons RegisteredBeaconFilter::filter(const Beacons& beacons) const{
         Beacons filteredBeacons;
         filteredBeacons.timestamp(beacons.timestamp());
         for(const auto& b: beacons){
-            if(0<registeredIDs.count(b.id())){
+            if(registry.find(b.id())!=BeaconRegistry::noIndex){
                 filteredBeacons.push_back(b);
             }
         }
@@ -27,12 +27,13 @@
 #include <set>
 #include "BeaconFilter.hpp"
 #include "BLEBeacon.hpp"
+#include "BeaconRegistry.hpp"
 
 namespace loc{
     
     class RegisteredBeaconFilter : public BeaconFilter{
     private:
-        std::set<BeaconId> registeredIDs;
+        BeaconRegistry registry;
     public:
         RegisteredBeaconFilter() = delete;
         RegisteredBeaconFilter(const BLEBeacons& bleBeacons);
@@ -110,4 +110,6 @@ namespace loc{
     
     template void BLEBeacon::serialize<cereal::JSONOutputArchive> (cereal::JSONOutputArchive& archive);
     template void BLEBeacon::serialize<cereal::JSONInputArchive> (cereal::JSONInputArchive& archive);
+    template void BLEBeacon::serialize<cereal::PortableBinaryOutputArchive> (cereal::PortableBinaryOutputArchive& archive);
+    template void BLEBeacon::serialize<cereal::PortableBinaryInputArchive> (cereal::PortableBinaryInputArchive& archive);
 }
@@ -0,0 +1,82 @@
+/*******************************************************************************
+ * Copyright (c) 2014, 2016  IBM Corporation and others
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *******************************************************************************/
+
+#include "BeaconRegistry.hpp"
+
+#include <algorithm>
+#include <boost/functional/hash.hpp>
+
+namespace loc{
+    
+    const uint32_t BeaconRegistry::noIndex;
+    
+    size_t BeaconIdHash::operator()(const BeaconId& id) const{
+        size_t seed = boost::uuids::hash_value(id.buuid());
+        boost::hash_combine(seed, id.major());
+        boost::hash_combine(seed, id.minor());
+        return seed;
+    }
+    
+    uint64_t BeaconRegistry::majorMinorKey(const BeaconId& id){
+        return (static_cast<uint64_t>(static_cast<uint32_t>(id.major()))<<32) | static_cast<uint32_t>(id.minor());
+    }
+    
+    BeaconRegistry::BeaconRegistry(const std::vector<BeaconId>& ids) : ids_(ids){
+        for(uint32_t i=0; i<ids_.size(); i++){
+            const BeaconId& id = ids_[i];
+            uint64_t key = majorMinorKey(id);
+            majorMinorIndexMap_.insert(std::make_pair(key, i));
+            if(id.buuid().is_nil()){
+                nilMajorMinorIndexMap_.insert(std::make_pair(key, i));
+            }else{
+                idIndexMap_.insert(std::make_pair(id, i));
+            }
+        }
+    }
+    
+    uint32_t BeaconRegistry::find(const BeaconId& id) const{
+        uint64_t key = majorMinorKey(id);
+        if(id.buuid().is_nil()){
+            auto iter = majorMinorIndexMap_.find(key);
+            return iter==majorMinorIndexMap_.end() ? noIndex : iter->second;
+        }
+        // The first registered id that compares equal: either the same full id or an id without uuid.
+        uint32_t index = noIndex;
+        auto iter = idIndexMap_.find(id);
+        if(iter!=idIndexMap_.end()){
+            index = iter->second;
+        }
+        auto iterNil = nilMajorMinorIndexMap_.find(key);
+        if(iterNil!=nilMajorMinorIndexMap_.end()){
+            index = std::min(index, iterNil->second);
+        }
+        return index;
+    }
+    
+    const BeaconId& BeaconRegistry::id(uint32_t index) const{
+        return ids_.at(index);
+    }
+    
+    size_t BeaconRegistry::size() const{
+        return ids_.size();
+    }
+}
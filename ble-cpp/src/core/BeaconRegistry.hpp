@@ -0,0 +1,79 @@
+/*******************************************************************************
+ * Copyright (c) 2014, 2016  IBM Corporation and others
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *******************************************************************************/
+
+#ifndef BeaconRegistry_hpp
+#define BeaconRegistry_hpp
+
+#include <stdio.h>
+#include <unordered_map>
+#include <vector>
+
+#include "Beacon.hpp"
+
+namespace loc{
+    
+    // Hash of uuid, major and minor. Consistent with BeaconId::operator== only for ids with uuid.
+    struct BeaconIdHash{
+        size_t operator()(const BeaconId& id) const;
+    };
+    
+    // Immutable table of the beacons of one model. The index of an id is its position in the list
+    // the table is built from, so it can index arrays aligned with the model's BLEBeacons.
+    // find() follows BeaconId::operator==: an id without uuid matches any registered uuid with the
+    // same major and minor, and an id with uuid also matches a registered id without uuid.
+    // Scanned ids are only looked up and never added.
+    class BeaconRegistry{
+        std::vector<BeaconId> ids_;
+        std::unordered_map<BeaconId, uint32_t, BeaconIdHash> idIndexMap_; // registered ids with uuid
+        std::unordered_map<uint64_t, uint32_t> majorMinorIndexMap_; // first registered id per major and minor
+        std::unordered_map<uint64_t, uint32_t> nilMajorMinorIndexMap_; // first registered id without uuid
+        
+        static uint64_t majorMinorKey(const BeaconId& id);
+        
+    public:
+        static const uint32_t noIndex = 0xFFFFFFFF;
+        
+        BeaconRegistry() = default;
+        BeaconRegistry(const std::vector<BeaconId>& ids);
+        ~BeaconRegistry() = default;
+        
+        template<class Tbeacon>
+        static BeaconRegistry fromBeacons(const std::vector<Tbeacon>& beacons);
+        
+        // returns noIndex for unregistered ids
+        uint32_t find(const BeaconId& id) const;
+        const BeaconId& id(uint32_t index) const;
+        size_t size() const;
+    };
+    
+    template<class Tbeacon>
+    BeaconRegistry BeaconRegistry::fromBeacons(const std::vector<Tbeacon>& beacons){
+        std::vector<BeaconId> ids;
+        ids.reserve(beacons.size());
+        for(const auto& b: beacons){
+            ids.push_back(b.id());
+        }
+        return BeaconRegistry(ids);
+    }
+}
+
+#endif /* BeaconRegistry_hpp */
@@ -0,0 +1,146 @@
+/*******************************************************************************
+ * Copyright (c) 2014, 2016  IBM Corporation and others
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *******************************************************************************/
+
+
+#include "FixedLagSmoother.hpp"
+#include <cmath>
+#include <algorithm>
+
+namespace loc{
+    
+    std::string FixedLagSmoother::Estimate::header(){
+        return "timestamp,lag,x,y,z,floor,stdev_x,stdev_y,stdev_z,stdev_floor";
+    }
+    
+    std::ostream& operator<<(std::ostream& os, const FixedLagSmoother::Estimate& estimate){
+        os << estimate.timestamp << "," << estimate.lag << "," << estimate.mean << "," << estimate.stdev;
+        return os;
+    }
+    
+    FixedLagSmoother::FixedLagSmoother(size_t lag) : mLag(lag){}
+    
+    size_t FixedLagSmoother::lag() const{
+        return mLag;
+    }
+    
+    FixedLagSmoother& FixedLagSmoother::lag(size_t lag){
+        mLag = lag;
+        return *this;
+    }
+    
+    void FixedLagSmoother::update(const Particles& particles){
+        const ParticleHistory* history = particles.history();
+        if(history==nullptr){
+            return;
+        }
+        long step = history->step(particles);
+        if(step==mHeadStep && history==mHistory.get()){
+            return;
+        }
+        if(!mHeads.empty() && (history!=mHistory.get() || history->parentStep(step)!=mHeadStep)){
+            smooth(0);
+        }
+        
+        size_t n = particles.size();
+        const double* weights = particles.weight();
+        mHeads.resize(n);
+        mWeights.resize(n);
+        for(size_t i=0; i<n; i++){
+            mHeads[i] = history->cursor(particles, i);
+            mWeights[i] = weights[i];
+        }
+        if(history!=mHistory.get()){
+            mHistory = history->shared_from_this();
+            mLastStep = -1;
+        }
+        mHeadStep = step;
+        smooth(mLag);
+    }
+    
+    void FixedLagSmoother::flush(){
+        smooth(0);
+    }
+    
+    void FixedLagSmoother::clear(){
+        mHistory.reset();
+        mHeads.clear();
+        mWeights.clear();
+        mHeadStep = -1;
+        mLastStep = -1;
+        mEstimates.clear();
+    }
+    
+    bool FixedLagSmoother::next(Estimate& estimate){
+        if(mEstimates.empty()){
+            return false;
+        }
+        estimate = mEstimates.front();
+        mEstimates.pop_front();
+        return true;
+    }
+    
+    size_t FixedLagSmoother::size() const{
+        return mEstimates.size();
+    }
+    
+    void FixedLagSmoother::smooth(size_t minLag){
+        // All the heads refer to the same step, so ancestors at the same depth belong to the same step.
+        mMoments.clear();
+        size_t n = mHeads.size();
+        for(size_t i=0; i<n; i++){
+            double w = mWeights[i];
+            if(!(0<w) || std::isinf(w)){
+                continue;
+            }
+            size_t d = 0;
+            for(ParticleHistory::Cursor c = mHeads[i]; c.valid() && mLastStep<c.step(); c.toParent(), d++){
+                if(mMoments.size()<=d){
+                    mMoments.resize(d+1);
+                    mMoments[d].step = c.step();
+                    mMoments[d].timestamp = c.timestamp();
+                }
+                Location loc = c.location();
+                Moments& m = mMoments[d];
+                m.w += w;
+                m.x += w*loc.x(); m.xx += w*loc.x()*loc.x();
+                m.y += w*loc.y(); m.yy += w*loc.y()*loc.y();
+                m.z += w*loc.z(); m.zz += w*loc.z()*loc.z();
+                m.floor += w*loc.floor(); m.ff += w*loc.floor()*loc.floor();
+            }
+        }
+        
+        // Oldest first
+        auto stdev = [](double s, double ss, double w){
+            return std::sqrt(std::max(ss/w - (s/w)*(s/w), 0.0));
+        };
+        for(size_t d=mMoments.size(); minLag<d; d--){
+            const Moments& m = mMoments[d-1];
+            Estimate e;
+            e.timestamp = m.timestamp;
+            e.lag = d-1;
+            e.mean = Location(m.x/m.w, m.y/m.w, m.z/m.w, m.floor/m.w);
+            e.stdev = Location(stdev(m.x, m.xx, m.w), stdev(m.y, m.yy, m.w), stdev(m.z, m.zz, m.w), stdev(m.floor, m.ff, m.w));
+            mEstimates.push_back(e);
+            mLastStep = m.step;
+        }
+    }
+}
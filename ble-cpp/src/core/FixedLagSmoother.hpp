@@ -0,0 +1,100 @@
+/*******************************************************************************
+ * Copyright (c) 2014, 2016  IBM Corporation and others
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *******************************************************************************/
+
+
+#ifndef FixedLagSmoother_hpp
+#define FixedLagSmoother_hpp
+
+#include <stdio.h>
+#include <iostream>
+#include <vector>
+#include <deque>
+#include <memory>
+#include "Location.hpp"
+#include "Particles.hpp"
+#include "ParticleHistory.hpp"
+
+namespace loc{
+    
+    // Fixed-lag smoother on the genealogy of a particle filter.
+    // The location at a past step is estimated from the ancestors of the current particles at the step,
+    // so each estimate also reflects the observations of the following steps.
+    // Estimates are made lag steps behind the newest particles at the cost of O(particles x lag) per update.
+    // flush() estimates the remaining steps from the ancestors of the last particles, so they reflect fewer than lag later steps.
+    // This is not a forward-filtering backward-smoothing (FFBS) smoother: ancestors are not reweighted by a transition density,
+    // which the system models do not provide, and it is not meant for offline smoothing of whole logs.
+    // Resampling makes the ancestral paths coalesce going back in time: a few resamplings back, the particles often
+    // descend from a handful of ancestors, and the estimate at the oldest steps collapses toward those few locations
+    // with an underestimated stdev. Keep lag short (a few seconds of beacon inputs).
+    class FixedLagSmoother{
+    public:
+        using Ptr = std::shared_ptr<FixedLagSmoother>;
+        
+        struct Estimate{
+            long timestamp = 0;
+            size_t lag = 0; // the number of later steps reflected in the estimate
+            Location mean;
+            Location stdev;
+            static std::string header();
+            friend std::ostream& operator<<(std::ostream& os, const Estimate& estimate);
+        };
+        
+        explicit FixedLagSmoother(size_t lag = 10);
+        
+        size_t lag() const;
+        // The particle history must keep lag+1 steps.
+        FixedLagSmoother& lag(size_t lag);
+        
+        // Called after the particles were stored in a ParticleHistory.
+        // The remaining steps of the previous lineage are flushed if the lineage was broken (e.g. by reset).
+        void update(const Particles& particles);
+        // Smooths all the remaining steps with the ancestors of the last particles.
+        void flush();
+        void clear();
+        
+        // Pops the oldest estimate which has not been taken.
+        bool next(Estimate& estimate);
+        size_t size() const;
+        
+    private:
+        size_t mLag;
+        std::shared_ptr<const ParticleHistory> mHistory;
+        std::vector<ParticleHistory::Cursor> mHeads;
+        std::vector<double> mWeights;
+        long mHeadStep = -1;
+        long mLastStep = -1; // newest step which has been smoothed
+        std::deque<Estimate> mEstimates;
+        
+        struct Moments{
+            long step = -1;
+            long timestamp = 0;
+            double w = 0, x = 0, y = 0, z = 0, floor = 0;
+            double xx = 0, yy = 0, zz = 0, ff = 0;
+        };
+        std::vector<Moments> mMoments;
+        
+        // Estimates the steps at least minLag behind the heads which have not been smoothed.
+        void smooth(size_t minLag);
+    };
+}
+
+#endif /* FixedLagSmoother_hpp */
@@ -0,0 +1,138 @@
+/*******************************************************************************
+ * Copyright (c) 2014, 2016  IBM Corporation and others
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *******************************************************************************/
+
+#include "ParticleHistory.hpp"
+#include "Particles.hpp"
+#include <algorithm>
+
+namespace loc{
+    
+    ParticleHistory::Cursor::Cursor(const ParticleHistory* history, long step, int index) : mHistory(history), mStep(step), mIndex(index){
+        if(mHistory==nullptr || mIndex<0 || mHistory->find(mStep)==nullptr){
+            mStep = -1;
+            mIndex = -1;
+        }
+    }
+    
+    bool ParticleHistory::Cursor::valid() const{
+        return 0<=mIndex;
+    }
+    
+    long ParticleHistory::Cursor::step() const{
+        return mStep;
+    }
+    
+    int ParticleHistory::Cursor::index() const{
+        return mIndex;
+    }
+    
+    Location ParticleHistory::Cursor::location() const{
+        const Step* s = mHistory->find(mStep);
+        return Location(s->x[mIndex], s->y[mIndex], s->z[mIndex], s->floor[mIndex]);
+    }
+    
+    long ParticleHistory::Cursor::timestamp() const{
+        return mHistory->find(mStep)->timestamps[mIndex];
+    }
+    
+    ParticleHistory::Cursor& ParticleHistory::Cursor::toParent(){
+        const Step* s = mHistory->find(mStep);
+        *this = Cursor(mHistory, s->parentStep, s->parents[mIndex]);
+        return *this;
+    }
+    
+    ParticleHistory::ParticleHistory(size_t capacity){
+        this->capacity(capacity);
+    }
+    
+    size_t ParticleHistory::capacity() const{
+        return mSteps.size();
+    }
+    
+    ParticleHistory& ParticleHistory::capacity(size_t capacity){
+        if(capacity!=mSteps.size()){
+            mSteps.clear();
+            mSteps.resize(std::max(capacity, (size_t) 1));
+        }
+        return *this;
+    }
+    
+    void ParticleHistory::clear(){
+        // Step ids are not reused so that particles referring to cleared steps find no ancestors.
+        for(auto& s: mSteps){
+            s.id = -1;
+        }
+    }
+    
+    const ParticleHistory::Step* ParticleHistory::find(long step) const{
+        if(step<0){
+            return nullptr;
+        }
+        const Step& s = mSteps[step % mSteps.size()];
+        return s.id==step ? &s : nullptr;
+    }
+    
+    void ParticleHistory::push(Particles& particles){
+        size_t n = particles.size();
+        long id = mNextStep++;
+        Step& s = mSteps[id % mSteps.size()];
+        // Lineages are only followed within this history.
+        bool hasParents = particles.history_.get()==this && find(particles.historyStep_)!=nullptr;
+        s.id = id;
+        s.parentStep = hasParents ? particles.historyStep_ : -1;
+        s.x.assign(particles.x(), particles.x()+n);
+        s.y.assign(particles.y(), particles.y()+n);
+        s.z.assign(particles.z(), particles.z()+n);
+        s.floor.assign(particles.floor(), particles.floor()+n);
+        s.timestamps.assign(particles.timestamp(), particles.timestamp()+n);
+        if(hasParents){
+            s.parents.assign(particles.lineage_.begin(), particles.lineage_.end());
+        }else{
+            s.parents.assign(n, -1);
+        }
+        particles.history_ = shared_from_this();
+        particles.historyStep_ = id;
+        for(size_t i=0; i<n; i++){
+            particles.lineage_[i] = (int) i;
+        }
+    }
+    
+    long ParticleHistory::step(const Particles& particles) const{
+        return particles.history_.get()==this ? particles.historyStep_ : -1;
+    }
+    
+    long ParticleHistory::parentStep(long step) const{
+        const Step* s = find(step);
+        return s==nullptr ? -1 : s->parentStep;
+    }
+    
+    ParticleHistory::Cursor ParticleHistory::cursor(long step, int index) const{
+        return Cursor(this, step, index);
+    }
+    
+    ParticleHistory::Cursor ParticleHistory::cursor(const Particles& particles, size_t i) const{
+        if(particles.history_.get()!=this){
+            return Cursor();
+        }
+        return Cursor(this, particles.historyStep_, particles.lineage_[i]);
+    }
+}
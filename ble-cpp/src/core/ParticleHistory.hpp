@@ -0,0 +1,101 @@
+/*******************************************************************************
+ * Copyright (c) 2014, 2016  IBM Corporation and others
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *******************************************************************************/
+
+#ifndef ParticleHistory_hpp
+#define ParticleHistory_hpp
+
+#include <stdio.h>
+#include <vector>
+#include <memory>
+#include "Location.hpp"
+
+namespace loc{
+    
+    class Particles;
+    
+    // Ring of past particle sets shared by the particles of a filter.
+    // Each step stores the locations and timestamps of the particles and the index of each particle's parent
+    // in the previous step, so the past states of a particle are found by walking its genealogy
+    // instead of being copied into every particle at resampling.
+    class ParticleHistory: public std::enable_shared_from_this<ParticleHistory>{
+    public:
+        using Ptr = std::shared_ptr<ParticleHistory>;
+        
+        // Walks the lineage of a particle from the newest stored step to the oldest.
+        class Cursor{
+        public:
+            Cursor() = default;
+            bool valid() const;
+            long step() const;
+            int index() const;
+            Location location() const;
+            long timestamp() const;
+            Cursor& toParent();
+        private:
+            friend class ParticleHistory;
+            Cursor(const ParticleHistory* history, long step, int index);
+            const ParticleHistory* mHistory = nullptr;
+            long mStep = -1;
+            int mIndex = -1;
+        };
+        
+        // capacity: the number of steps kept
+        explicit ParticleHistory(size_t capacity = 1);
+        
+        size_t capacity() const;
+        // Discards stored steps when the capacity changes.
+        ParticleHistory& capacity(size_t capacity);
+        void clear();
+        
+        // Stores the particles as a new step and makes them refer to the step.
+        // The parents are the entries the particles referred to (e.g. through resampling since the last push).
+        void push(Particles& particles);
+        
+        // Newest step the particles refer to (-1: the particles are not stored in this history)
+        long step(const Particles& particles) const;
+        // Step which the parents of step belong to (-1: no parent or the step has been overwritten)
+        long parentStep(long step) const;
+        
+        // Cursor at entry index of step. It is invalid if the step has been overwritten.
+        Cursor cursor(long step, int index) const;
+        // Cursor at the newest stored ancestor of particle i
+        Cursor cursor(const Particles& particles, size_t i) const;
+        
+    private:
+        struct Step{
+            long id = -1;
+            long parentStep = -1;
+            std::vector<double> x;
+            std::vector<double> y;
+            std::vector<double> z;
+            std::vector<double> floor;
+            std::vector<long> timestamps;
+            std::vector<int> parents; // -1: no parent
+        };
+        std::vector<Step> mSteps; // step id is stored at mSteps[id % capacity]
+        long mNextStep = 0;
+        
+        const Step* find(long step) const;
+    };
+}
+
+#endif /* ParticleHistory_hpp */
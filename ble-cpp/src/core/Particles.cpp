@@ -0,0 +1,388 @@
+/*******************************************************************************
+ * Copyright (c) 2014, 2016  IBM Corporation and others
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *******************************************************************************/
+
+#include "Particles.hpp"
+#include <algorithm>
+#include <limits>
+
+namespace loc{
+    
+    Particles::Particles(size_t n){
+        resize(n);
+    }
+    
+    Particles::Particles(const States& states){
+        assign(states);
+    }
+    
+    Particles::Particles(States&& states){
+        assign(std::move(states));
+    }
+    
+    size_t Particles::size() const{
+        return x_.size();
+    }
+    
+    bool Particles::empty() const{
+        return x_.empty();
+    }
+    
+    void Particles::resize(size_t n){
+        x_.resize(n, 0);
+        y_.resize(n, 0);
+        z_.resize(n, 0);
+        floor_.resize(n, 0);
+        orientation_.resize(n, 0);
+        velocity_.resize(n, 0);
+        normalVelocity_.resize(n, 0);
+        orientationBias_.resize(n, 0);
+        orientationAlignment_.resize(n, 0);
+        rssiBias_.resize(n, 0);
+        weight_.resize(n, 1.0);
+        negativeLogLikelihood_.resize(n, 0);
+        mahalanobisDistance_.resize(n, 0);
+        timestamp_.resize(n, 0);
+        lineage_.resize(n, -1);
+    }
+    
+    void Particles::clear(){
+        resize(0);
+    }
+    
+    Particles::Ref Particles::operator[](size_t i){
+        return Ref(this, i);
+    }
+    
+    Particles::ConstRef Particles::operator[](size_t i) const{
+        return ConstRef(this, i);
+    }
+    
+    double* Particles::x(){ return x_.data(); }
+    double* Particles::y(){ return y_.data(); }
+    double* Particles::z(){ return z_.data(); }
+    double* Particles::floor(){ return floor_.data(); }
+    double* Particles::orientation(){ return orientation_.data(); }
+    double* Particles::velocity(){ return velocity_.data(); }
+    double* Particles::normalVelocity(){ return normalVelocity_.data(); }
+    double* Particles::orientationBias(){ return orientationBias_.data(); }
+    double* Particles::orientationAlignment(){ return orientationAlignment_.data(); }
+    double* Particles::rssiBias(){ return rssiBias_.data(); }
+    double* Particles::weight(){ return weight_.data(); }
+    double* Particles::negativeLogLikelihood(){ return negativeLogLikelihood_.data(); }
+    double* Particles::mahalanobisDistance(){ return mahalanobisDistance_.data(); }
+    long* Particles::timestamp(){ return timestamp_.data(); }
+    const double* Particles::x() const{ return x_.data(); }
+    const double* Particles::y() const{ return y_.data(); }
+    const double* Particles::z() const{ return z_.data(); }
+    const double* Particles::floor() const{ return floor_.data(); }
+    const double* Particles::orientation() const{ return orientation_.data(); }
+    const double* Particles::velocity() const{ return velocity_.data(); }
+    const double* Particles::normalVelocity() const{ return normalVelocity_.data(); }
+    const double* Particles::orientationBias() const{ return orientationBias_.data(); }
+    const double* Particles::orientationAlignment() const{ return orientationAlignment_.data(); }
+    const double* Particles::rssiBias() const{ return rssiBias_.data(); }
+    const double* Particles::weight() const{ return weight_.data(); }
+    const double* Particles::negativeLogLikelihood() const{ return negativeLogLikelihood_.data(); }
+    const double* Particles::mahalanobisDistance() const{ return mahalanobisDistance_.data(); }
+    const long* Particles::timestamp() const{ return timestamp_.data(); }
+    const ParticleHistory* Particles::history() const{ return history_.get(); }
+    
+    Location Particles::location(size_t i) const{
+        return Location(x_[i], y_[i], z_[i], floor_[i]);
+    }
+    
+    void Particles::location(size_t i, const Location& location){
+        x_[i] = location.x();
+        y_[i] = location.y();
+        z_[i] = location.z();
+        floor_[i] = location.floor();
+    }
+    
+    State Particles::state(size_t i) const{
+        State s;
+        s.x(x_[i]).y(y_[i]).z(z_[i]).floor(floor_[i]);
+        s.orientation(orientation_[i]).velocity(velocity_[i]).normalVelocity(normalVelocity_[i]);
+        s.orientationBias(orientationBias_[i]).orientationAlignment(orientationAlignment_[i]).rssiBias(rssiBias_[i]);
+        s.weight(weight_[i]).negativeLogLikelihood(negativeLogLikelihood_[i]).mahalanobisDistance(mahalanobisDistance_[i]);
+        s.timestamp = timestamp_[i];
+        return s;
+    }
+    
+    void Particles::state(size_t i, const State& s){
+        x_[i] = s.x();
+        y_[i] = s.y();
+        z_[i] = s.z();
+        floor_[i] = s.floor();
+        orientation_[i] = s.orientation();
+        velocity_[i] = s.velocity();
+        normalVelocity_[i] = s.normalVelocity();
+        orientationBias_[i] = s.orientationBias();
+        orientationAlignment_[i] = s.orientationAlignment();
+        rssiBias_[i] = s.rssiBias();
+        weight_[i] = s.weight();
+        negativeLogLikelihood_[i] = s.negativeLogLikelihood();
+        mahalanobisDistance_[i] = s.mahalanobisDistance();
+        timestamp_[i] = s.timestamp;
+    }
+    
+    void Particles::assign(const States& states){
+        size_t n = states.size();
+        resize(n);
+        for(size_t i=0; i<n; i++){
+            state(i, states[i]);
+        }
+        lineage_.assign(n, -1);
+    }
+    
+    void Particles::assign(States&& states){
+        size_t n = states.size();
+        resize(n);
+        for(size_t i=0; i<n; i++){
+            state(i, states[i]);
+        }
+        lineage_.assign(n, -1);
+    }
+    
+    States Particles::toStates() const{
+        size_t n = size();
+        States states(n);
+        for(size_t i=0; i<n; i++){
+            states[i] = state(i);
+        }
+        return states;
+    }
+    
+    void Particles::append(const Particles& other){
+        size_t n = size();
+        size_t m = other.size();
+        resize(n + m);
+        std::copy(other.x_.begin(), other.x_.end(), x_.begin() + n);
+        std::copy(other.y_.begin(), other.y_.end(), y_.begin() + n);
+        std::copy(other.z_.begin(), other.z_.end(), z_.begin() + n);
+        std::copy(other.floor_.begin(), other.floor_.end(), floor_.begin() + n);
+        std::copy(other.orientation_.begin(), other.orientation_.end(), orientation_.begin() + n);
+        std::copy(other.velocity_.begin(), other.velocity_.end(), velocity_.begin() + n);
+        std::copy(other.normalVelocity_.begin(), other.normalVelocity_.end(), normalVelocity_.begin() + n);
+        std::copy(other.orientationBias_.begin(), other.orientationBias_.end(), orientationBias_.begin() + n);
+        std::copy(other.orientationAlignment_.begin(), other.orientationAlignment_.end(), orientationAlignment_.begin() + n);
+        std::copy(other.rssiBias_.begin(), other.rssiBias_.end(), rssiBias_.begin() + n);
+        std::copy(other.weight_.begin(), other.weight_.end(), weight_.begin() + n);
+        std::copy(other.negativeLogLikelihood_.begin(), other.negativeLogLikelihood_.end(), negativeLogLikelihood_.begin() + n);
+        std::copy(other.mahalanobisDistance_.begin(), other.mahalanobisDistance_.end(), mahalanobisDistance_.begin() + n);
+        std::copy(other.timestamp_.begin(), other.timestamp_.end(), timestamp_.begin() + n);
+        std::fill(lineage_.begin() + n, lineage_.end(), -1);
+    }
+    
+    void Particles::gather(std::vector<double>& field, const std::vector<int>& ancestors){
+        std::vector<double>& buf = spare_.values;
+        size_t m = ancestors.size();
+        buf.resize(m);
+        for(size_t i=0; i<m; i++){
+            buf[i] = field[ancestors[i]];
+        }
+        field.swap(buf);
+    }
+    
+    void Particles::select(const std::vector<int>& ancestors){
+        size_t m = ancestors.size();
+        gather(x_, ancestors);
+        gather(y_, ancestors);
+        gather(z_, ancestors);
+        gather(floor_, ancestors);
+        gather(orientation_, ancestors);
+        gather(velocity_, ancestors);
+        gather(normalVelocity_, ancestors);
+        gather(orientationBias_, ancestors);
+        gather(orientationAlignment_, ancestors);
+        gather(rssiBias_, ancestors);
+        gather(weight_, ancestors);
+        gather(negativeLogLikelihood_, ancestors);
+        gather(mahalanobisDistance_, ancestors);
+        
+        std::vector<long>& timestamps = spare_.timestamps;
+        timestamps.resize(m);
+        for(size_t i=0; i<m; i++){
+            timestamps[i] = timestamp_[ancestors[i]];
+        }
+        timestamp_.swap(timestamps);
+        
+        // Past states are not copied. Each particle inherits the lineage of its ancestor.
+        std::vector<int>& lineage = spare_.indices;
+        lineage.resize(m);
+        for(size_t i=0; i<m; i++){
+            lineage[i] = lineage_[ancestors[i]];
+        }
+        lineage_.swap(lineage);
+    }
+    
+    void Particles::swapFields(Particles& other){
+        x_.swap(other.x_);
+        y_.swap(other.y_);
+        z_.swap(other.z_);
+        floor_.swap(other.floor_);
+        orientation_.swap(other.orientation_);
+        velocity_.swap(other.velocity_);
+        normalVelocity_.swap(other.normalVelocity_);
+        orientationBias_.swap(other.orientationBias_);
+        orientationAlignment_.swap(other.orientationAlignment_);
+        rssiBias_.swap(other.rssiBias_);
+        weight_.swap(other.weight_);
+        negativeLogLikelihood_.swap(other.negativeLogLikelihood_);
+        mahalanobisDistance_.swap(other.mahalanobisDistance_);
+        timestamp_.swap(other.timestamp_);
+        lineage_.resize(x_.size(), -1);
+    }
+    
+    double Particles::sumWeights() const{
+        double sum = 0;
+        for(double w: weight_){
+            sum += w;
+        }
+        return sum;
+    }
+    
+    Location Particles::weightedMeanLocation() const{
+        size_t n = size();
+        double weightSum = sumWeights();
+        double x = 0, y = 0, z = 0, floor = 0;
+        for(size_t i=0; i<n; i++){
+            double w = weight_[i]/weightSum;
+            x += x_[i] * w;
+            y += y_[i] * w;
+            floor += floor_[i] * w;
+            z += z_[i] * w;
+        }
+        return Location(x, y, z, floor);
+    }
+    
+    Pose Particles::weightedMeanPose() const{
+        // Same as Pose::weightedMean
+        size_t n = size();
+        double weightSum = sumWeights();
+        double xm = 0, ym = 0, zm = 0, floorm = 0;
+        double vxm = 0, vym = 0;
+        double vxrepm = 0, vyrepm = 0;
+        for(size_t i=0; i<n; i++){
+            double w = weight_[i]/weightSum;
+            double c = std::cos(orientation_[i]);
+            double s = std::sin(orientation_[i]);
+            xm += w * x_[i];
+            ym += w * y_[i];
+            zm += w * z_[i];
+            floorm += w * floor_[i];
+            vxm += w * velocity_[i]*c;
+            vym += w * velocity_[i]*s;
+            vxrepm += w * normalVelocity_[i]*c;
+            vyrepm += w * normalVelocity_[i]*s;
+        }
+        double vm = std::sqrt(vxm*vxm + vym*vym);
+        double vrepm = std::sqrt(vxrepm*vxrepm + vyrepm*vyrepm);
+        double orientationm = atan2(vyrepm, vxrepm); // orientation must be calculated by representative velocity.
+        
+        Pose poseMean;
+        poseMean.x(xm).y(ym).z(zm).floor(floorm);
+        poseMean.orientation(orientationm).velocity(vm).normalVelocity(vrepm);
+        return poseMean;
+    }
+    
+    State Particles::weightedMeanState() const{
+        size_t n = size();
+        double weightSum = sumWeights();
+        State meanState(weightedMeanPose());
+        double meanRssiBias = 0;
+        double xOri = 0;
+        double yOri = 0;
+        for(size_t i=0; i<n; i++){
+            double w = weight_[i]/weightSum;
+            meanRssiBias += rssiBias_[i]*w;
+            xOri += w*std::cos(orientationBias_[i]);
+            yOri += w*std::sin(orientationBias_[i]);
+        }
+        meanState.rssiBias(meanRssiBias);
+        meanState.orientationBias(std::atan2(yOri, xOri));
+        return meanState;
+    }
+    
+    Location Particles::meanLocation() const{
+        size_t n = size();
+        double x = 0, y = 0, z = 0, floor = 0;
+        for(size_t i=0; i<n; i++){
+            x += x_[i];
+            y += y_[i];
+            z += z_[i];
+            floor += floor_[i];
+        }
+        return Location(x/n, y/n, z/n, floor/n);
+    }
+    
+    Location Particles::standardDeviation() const{
+        Location meanLoc = meanLocation();
+        size_t n = size();
+        double sumSqX = 0, sumSqY = 0, sumSqZ = 0, sumSqFloor = 0;
+        for(size_t i=0; i<n; i++){
+            double dx = x_[i] - meanLoc.x();
+            double dy = y_[i] - meanLoc.y();
+            double dz = z_[i] - meanLoc.z();
+            double df = floor_[i] - meanLoc.floor();
+            sumSqX += dx*dx;
+            sumSqY += dy*dy;
+            sumSqZ += dz*dz;
+            sumSqFloor += df*df;
+        }
+        return Location(std::sqrt(sumSqX/n), std::sqrt(sumSqY/n), std::sqrt(sumSqZ/n), std::sqrt(sumSqFloor/n));
+    }
+    
+    double Particles::compute2DVariance() const{
+        Location meanLoc = meanLocation();
+        size_t n = size();
+        double varx = 0, vary = 0, covxy = 0;
+        for(size_t i=0; i<n; i++){
+            double dx = x_[i] - meanLoc.x();
+            double dy = y_[i] - meanLoc.y();
+            varx += dx*dx;
+            vary += dy*dy;
+            covxy += dx*dy;
+        }
+        varx/=n;
+        vary/=n;
+        covxy/=n;
+        return varx*vary - covxy*covxy;
+    }
+    
+    size_t Particles::findClosestLocationIndex(const Location& location, double floorCoeff) const{
+        size_t n = size();
+        size_t closest = 0;
+        double minDist2 = std::numeric_limits<double>::infinity();
+        for(size_t i=0; i<n; i++){
+            double dx = x_[i] - location.x();
+            double dy = y_[i] - location.y();
+            double dz = z_[i] - location.z();
+            double df = floorCoeff*(floor_[i] - location.floor());
+            double dist2 = dx*dx + dy*dy + dz*dz + df*df;
+            if(dist2 < minDist2){
+                minDist2 = dist2;
+                closest = i;
+            }
+        }
+        return closest;
+    }
+}
@@ -0,0 +1,217 @@
+/*******************************************************************************
+ * Copyright (c) 2014, 2016  IBM Corporation and others
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *******************************************************************************/
+
+#ifndef Particles_hpp
+#define Particles_hpp
+
+#include <stdio.h>
+#include <vector>
+#include <memory>
+#include "Location.hpp"
+#include "Pose.hpp"
+#include "State.hpp"
+#include "ParticleHistory.hpp"
+
+namespace loc{
+    
+    // Particle set stored as one contiguous array per state field (structure of arrays).
+    // Particles::Ref and Particles::ConstRef are State-like views of a particle for code written against State.
+    class Particles{
+    public:
+        using Ptr = std::shared_ptr<Particles>;
+        
+        class ConstRef{
+        protected:
+            const Particles* p_;
+            size_t i_;
+        public:
+            ConstRef(const Particles* particles, size_t index) : p_(particles), i_(index){}
+            size_t index() const{ return i_; }
+            double x() const{ return p_->x_[i_]; }
+            double y() const{ return p_->y_[i_]; }
+            double z() const{ return p_->z_[i_]; }
+            double floor() const{ return p_->floor_[i_]; }
+            double orientation() const{ return p_->orientation_[i_]; }
+            double velocity() const{ return p_->velocity_[i_]; }
+            double normalVelocity() const{ return p_->normalVelocity_[i_]; }
+            double orientationBias() const{ return p_->orientationBias_[i_]; }
+            double orientationAlignment() const{ return p_->orientationAlignment_[i_]; }
+            double rssiBias() const{ return p_->rssiBias_[i_]; }
+            double weight() const{ return p_->weight_[i_]; }
+            double negativeLogLikelihood() const{ return p_->negativeLogLikelihood_[i_]; }
+            double mahalanobisDistance() const{ return p_->mahalanobisDistance_[i_]; }
+            long timestamp() const{ return p_->timestamp_[i_]; }
+            Location location() const{ return p_->location(i_); }
+            State state() const{ return p_->state(i_); }
+        };
+        
+        class Ref: public ConstRef{
+            Particles* mp_;
+        public:
+            Ref(Particles* particles, size_t index) : ConstRef(particles, index), mp_(particles){}
+            using ConstRef::x;
+            using ConstRef::y;
+            using ConstRef::z;
+            using ConstRef::floor;
+            using ConstRef::orientation;
+            using ConstRef::velocity;
+            using ConstRef::normalVelocity;
+            using ConstRef::orientationBias;
+            using ConstRef::orientationAlignment;
+            using ConstRef::rssiBias;
+            using ConstRef::weight;
+            using ConstRef::negativeLogLikelihood;
+            using ConstRef::mahalanobisDistance;
+            using ConstRef::timestamp;
+            using ConstRef::state;
+            Ref& x(double x){ mp_->x_[i_] = x; return *this; }
+            Ref& y(double y){ mp_->y_[i_] = y; return *this; }
+            Ref& z(double z){ mp_->z_[i_] = z; return *this; }
+            Ref& floor(double floor){ mp_->floor_[i_] = floor; return *this; }
+            Ref& orientation(double orientation){ mp_->orientation_[i_] = orientation; return *this; }
+            Ref& velocity(double velocity){ mp_->velocity_[i_] = velocity; return *this; }
+            Ref& normalVelocity(double normalVelocity){ mp_->normalVelocity_[i_] = normalVelocity; return *this; }
+            Ref& orientationBias(double orientationBias){ mp_->orientationBias_[i_] = orientationBias; return *this; }
+            Ref& orientationAlignment(double orientationAlignment){ mp_->orientationAlignment_[i_] = orientationAlignment; return *this; }
+            Ref& rssiBias(double rssiBias){ mp_->rssiBias_[i_] = rssiBias; return *this; }
+            Ref& weight(double weight){ mp_->weight_[i_] = weight; return *this; }
+            Ref& negativeLogLikelihood(double negativeLogLikelihood){ mp_->negativeLogLikelihood_[i_] = negativeLogLikelihood; return *this; }
+            Ref& mahalanobisDistance(double mahalanobisDistance){ mp_->mahalanobisDistance_[i_] = mahalanobisDistance; return *this; }
+            Ref& timestamp(long timestamp){ mp_->timestamp_[i_] = timestamp; return *this; }
+            Ref& copyLocation(const Location& location){ mp_->location(i_, location); return *this; }
+            Ref& state(const State& state){ mp_->state(i_, state); return *this; }
+        };
+        
+    private:
+        std::vector<double> x_;
+        std::vector<double> y_;
+        std::vector<double> z_;
+        std::vector<double> floor_;
+        std::vector<double> orientation_;
+        std::vector<double> velocity_;
+        std::vector<double> normalVelocity_;
+        std::vector<double> orientationBias_;
+        std::vector<double> orientationAlignment_;
+        std::vector<double> rssiBias_;
+        std::vector<double> weight_;
+        std::vector<double> negativeLogLikelihood_;
+        std::vector<double> mahalanobisDistance_;
+        std::vector<long> timestamp_;
+        
+        // Genealogy: particle i descends from entry lineage_[i] of step historyStep_ in history_ (-1: none).
+        ParticleHistory::Ptr history_;
+        long historyStep_ = -1;
+        std::vector<int> lineage_;
+        friend class ParticleHistory;
+        
+        // Spare arrays swapped with field arrays by select. They are not copied with the particles.
+        struct SpareBuffer{
+            std::vector<double> values;
+            std::vector<long> timestamps;
+            std::vector<int> indices;
+            SpareBuffer() = default;
+            SpareBuffer(const SpareBuffer&){}
+            SpareBuffer& operator=(const SpareBuffer&){ return *this; }
+        };
+        SpareBuffer spare_;
+        void gather(std::vector<double>& field, const std::vector<int>& ancestors);
+        
+    public:
+        Particles() = default;
+        ~Particles() = default;
+        explicit Particles(size_t n);
+        explicit Particles(const States& states);
+        explicit Particles(States&& states);
+        
+        size_t size() const;
+        bool empty() const;
+        void resize(size_t n);
+        void clear();
+        
+        Ref operator[](size_t i);
+        ConstRef operator[](size_t i) const;
+        
+        // Field arrays
+        double* x();
+        double* y();
+        double* z();
+        double* floor();
+        double* orientation();
+        double* velocity();
+        double* normalVelocity();
+        double* orientationBias();
+        double* orientationAlignment();
+        double* rssiBias();
+        double* weight();
+        double* negativeLogLikelihood();
+        double* mahalanobisDistance();
+        long* timestamp();
+        const double* x() const;
+        const double* y() const;
+        const double* z() const;
+        const double* floor() const;
+        const double* orientation() const;
+        const double* velocity() const;
+        const double* normalVelocity() const;
+        const double* orientationBias() const;
+        const double* orientationAlignment() const;
+        const double* rssiBias() const;
+        const double* weight() const;
+        const double* negativeLogLikelihood() const;
+        const double* mahalanobisDistance() const;
+        const long* timestamp() const;
+        
+        // History of the ancestors set by ParticleHistory::push (nullptr if the particles have not been stored).
+        // Lineages are kept by select, while assign starts new lineages.
+        const ParticleHistory* history() const;
+        
+        // Conversion from/to State
+        Location location(size_t i) const;
+        void location(size_t i, const Location& location);
+        State state(size_t i) const;
+        void state(size_t i, const State& state);
+        void assign(const States& states);
+        void assign(States&& states);
+        States toStates() const;
+        // Appends the particles of other. Appended particles start new lineages.
+        void append(const Particles& other);
+        
+        // Replaces the particles with the particles at ancestors (e.g. the output of Resampler).
+        // Fields are gathered into spare arrays kept between calls, so no allocation occurs while the size does not grow.
+        void select(const std::vector<int>& ancestors);
+        // Exchanges the field arrays with other (e.g. a buffer of predicted particles). Lineages are kept.
+        void swapFields(Particles& other);
+        
+        // Statistics
+        double sumWeights() const;
+        Location weightedMeanLocation() const;
+        Pose weightedMeanPose() const;
+        State weightedMeanState() const;
+        Location meanLocation() const;
+        Location standardDeviation() const;
+        double compute2DVariance() const;
+        // Index of the particle closest to location. Floor differences are scaled by floorCoeff as in Location::findClosestLocationIndex.
+        size_t findClosestLocationIndex(const Location& location, double floorCoeff = 1000) const;
+    };
+}
+
+#endif /* Particles_hpp */
@@ -27,8 +27,6 @@
 
 namespace  loc {
     
-    size_t State::history_capacity = 1;
-    
     State::State(const Pose& pose): Pose(pose){}
     
     double State::orientationBias() const{
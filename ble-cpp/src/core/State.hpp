@@ -28,7 +28,6 @@
 #include <vector>
 #include "Location.hpp"
 #include "Pose.hpp"
-#include <boost/circular_buffer.hpp>
 
 namespace loc{
     class State;
@@ -73,8 +72,6 @@ namespace loc{
         
         // experimental feature
         long timestamp;
-        boost::circular_buffer<State> history;
-        static size_t history_capacity;
     };
     
     class StateProperty{
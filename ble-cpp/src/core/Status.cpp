@@ -37,15 +37,18 @@ namespace loc{
         mWasFloorUpdated = status.mWasFloorUpdated;
         auto meanLoc = status.meanLocation();
         auto meanPose = status.meanPose();
-        auto states = status.states();
         if(meanLoc){
             meanLocation_ = Location::Ptr(new Location(*meanLoc));
         }
         if(meanPose){
             meanPose_ = Pose::Ptr(new Pose(*meanPose));
         }
-        if(states){
-            states_ = std::shared_ptr<States>(new States(*states));
+        states_.reset();
+        particles_.reset();
+        if(status.particles_){
+            particles_ = std::shared_ptr<Particles>(new Particles(*status.particles_));
+        }else if(status.states_){
+            states_ = std::shared_ptr<States>(new States(*status.states_));
         }
     }
     
@@ -56,15 +59,18 @@ namespace loc{
         mWasFloorUpdated = status.mWasFloorUpdated;
         auto meanLoc = status.meanLocation();
         auto meanPose = status.meanPose();
-        auto states = status.states();
         if(meanLoc){
             meanLocation_ = Location::Ptr(new Location(*meanLoc));
         }
         if(meanPose){
             meanPose_ = Pose::Ptr(new Pose(*meanPose));
         }
-        if(states){
-            states_ = std::shared_ptr<States>(new States(*states));
+        states_.reset();
+        particles_.reset();
+        if(status.particles_){
+            particles_ = std::shared_ptr<Particles>(new Particles(*status.particles_));
+        }else if(status.states_){
+            states_ = std::shared_ptr<States>(new States(*status.states_));
         }
         return *this;
     }
@@ -82,9 +88,27 @@ namespace loc{
     }
     
     std::shared_ptr<std::vector<State>> Status::states() const{
+        if(particles_){
+            return std::shared_ptr<States>(new States(particles_->toStates()));
+        }
         return states_;
     }
     
+    std::shared_ptr<Particles> Status::particles(){
+        if(!particles_ && states_){
+            particles_ = std::shared_ptr<Particles>(new Particles(*states_));
+            states_.reset();
+        }
+        return particles_;
+    }
+    
+    std::shared_ptr<const Particles> Status::particles() const{
+        if(!particles_ && states_){
+            return std::shared_ptr<const Particles>(new Particles(*states_));
+        }
+        return particles_;
+    }
+    
     Status& Status::meanLocation(std::shared_ptr<Location> location){
         meanLocation_ = location;
         return *this;
@@ -110,6 +134,7 @@ namespace loc{
         this->step(Status::OTHER);
         
         states_ = states;
+        particles_.reset();
         size_t n = states->size();
         std::vector<double> weights(n);
         for(int i=0; i<n; i++){
@@ -129,6 +154,22 @@ namespace loc{
         return *this;
     }
     
+    Status& Status::particles(std::shared_ptr<Particles> particles){
+        this->step(Status::OTHER);
+        
+        particles_ = particles;
+        states_.reset();
+        meanLocation(std::shared_ptr<Location>(new Location(particles->weightedMeanLocation())));
+        meanPose(std::shared_ptr<Pose>(new Pose(particles->weightedMeanPose())));
+        return *this;
+    }
+    
+    Status& Status::particles(std::shared_ptr<Particles> particles, Step step){
+        this->particles(particles);
+        this->step(step);
+        return *this;
+    }
+    
     Status::Step Status::step() const{
         return step_;
     }
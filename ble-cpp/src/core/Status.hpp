@@ -30,6 +30,7 @@
 #include "Location.hpp"
 #include "Pose.hpp"
 #include "State.hpp"
+#include "Particles.hpp"
 
 namespace loc{
     
@@ -63,7 +64,12 @@ namespace loc{
         std::shared_ptr<Location> meanLocation() const;
         std::shared_ptr<Pose> meanPose() const;
         long timestamp() const;
+        // Either states or particles hold the particle set. The other representation is
+        // converted on access. states() returns a new vector when particles were set.
         std::shared_ptr<std::vector<State>> states() const;
+        // Adopts the states as particles, so that in-place edits are kept.
+        std::shared_ptr<Particles> particles();
+        std::shared_ptr<const Particles> particles() const;
         Step step() const;
         LocationStatus locationStatus() const;
         
@@ -74,6 +80,8 @@ namespace loc{
         
         Status& states(std::shared_ptr<std::vector<State>> states);
         Status& states(std::shared_ptr<std::vector<State>> states, Step step);
+        Status& particles(std::shared_ptr<Particles> particles);
+        Status& particles(std::shared_ptr<Particles> particles, Step step);
         Status& step(Step step);
         Status& locationStatus(LocationStatus locationStatus);
         
@@ -94,6 +102,7 @@ namespace loc{
         std::shared_ptr<Location> meanLocation_;
         std::shared_ptr<Pose> meanPose_;
         std::shared_ptr<std::vector<State>> states_;
+        std::shared_ptr<Particles> particles_;
         bool mWasFloorUpdated = false;
         
         Status& meanLocation(std::shared_ptr<Location> location);
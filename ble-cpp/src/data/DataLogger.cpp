@@ -37,9 +37,16 @@ namespace loc{
         ofs.close();
     }
     
-    void DataLogger::createInstance(const std::string resultDirectory){
+    TraceWriter::Ptr DataLogger::traceWriter() const{
+        return mTraceWriter;
+    }
+    
+    void DataLogger::createInstance(const std::string resultDirectory, bool writesTrace, const TraceWriterParameters& traceParams){
         instance = std::shared_ptr<DataLogger>(new DataLogger());
         instance->resultDirectory(resultDirectory);
+        if(writesTrace){
+            instance->mTraceWriter = std::make_shared<TraceWriter>(resultDirectory + "/trace.bin", traceParams);
+        }
     }
     
     std::shared_ptr<DataLogger>& DataLogger::getInstance(){
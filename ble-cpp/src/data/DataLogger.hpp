@@ -29,6 +29,7 @@
 #include <string>
 #include <sstream>
 #include <memory>
+#include "TraceWriter.hpp"
 #ifdef ANDROID_STL_EXT
 #include "string_ext.hpp"
 #endif /* ANDROID_STL_EXT */
@@ -37,11 +38,13 @@ namespace loc{
     
     // Singleton class
     // Data are logged only when the instance is created.
+    // Particle snapshots, inputs and statuses go to the binary trace (resultDirectory/trace.bin) when it is enabled.
     class DataLogger{
         
     private:
         static std::shared_ptr<DataLogger> instance;
         std::string mResultDirectory;
+        TraceWriter::Ptr mTraceWriter;
         
         DataLogger() = default;
         
@@ -51,7 +54,8 @@ namespace loc{
         
         void resultDirectory(const std::string& resultDirectory);
         void log(const std::string& fileName, const std::string& loggedString);
-        static void createInstance(const std::string resultDirectory);
+        TraceWriter::Ptr traceWriter() const;
+        static void createInstance(const std::string resultDirectory, bool writesTrace = false, const TraceWriterParameters& traceParams = TraceWriterParameters());
         static std::shared_ptr<DataLogger>& getInstance();
     };
 }
@@ -0,0 +1,140 @@
+/*******************************************************************************
+ * Copyright (c) 2014, 2016  IBM Corporation and others
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *******************************************************************************/
+
+#include "LocationIndex.hpp"
+
+#include <algorithm>
+#include <cmath>
+
+namespace loc{
+    
+    LocationIndex::LocationIndex(const Locations& locations, const BLEBeacons& bleBeacons, double cellSize)
+    : mNLocations(locations.size()), mBLEBeacons(bleBeacons){
+        BLEBeacon::checkNoDuplication(bleBeacons);
+        mBeaconRegistry = BeaconRegistry::fromBeacons(mBLEBeacons);
+        
+        std::map<double, std::vector<Entry>> entriesPerFloor;
+        for(int i=0; i<locations.size(); i++){
+            const auto& loc = locations.at(i);
+            entriesPerFloor[loc.floor()].push_back(Entry{loc.x(), loc.y(), i});
+        }
+        for(auto& pair: entriesPerFloor){
+            buildGrid(mFloorGrids[pair.first], pair.second, cellSize);
+        }
+    }
+    
+    void LocationIndex::buildGrid(FloorGrid& grid, std::vector<Entry>& entries, double cellSize){
+        double minX = entries.front().x, maxX = minX;
+        double minY = entries.front().y, maxY = minY;
+        for(const auto& e: entries){
+            minX = std::min(minX, e.x);
+            maxX = std::max(maxX, e.x);
+            minY = std::min(minY, e.y);
+            maxY = std::max(maxY, e.y);
+        }
+        // Coarsen the grid when the floor is large compared to the number of locations.
+        double area = (maxX-minX)*(maxY-minY);
+        double minCellSize = std::sqrt(area/(4.0*entries.size()));
+        cellSize = std::max(cellSize, minCellSize);
+        
+        grid.minX = minX;
+        grid.minY = minY;
+        grid.cellSize = cellSize;
+        grid.nx = static_cast<int>((maxX-minX)/cellSize) + 1;
+        grid.ny = static_cast<int>((maxY-minY)/cellSize) + 1;
+        
+        auto cellOf = [&](const Entry& e){
+            int ix = std::min(static_cast<int>((e.x-grid.minX)/cellSize), grid.nx-1);
+            int iy = std::min(static_cast<int>((e.y-grid.minY)/cellSize), grid.ny-1);
+            return iy*grid.nx + ix;
+        };
+        
+        grid.cellStart.assign(grid.nx*grid.ny+1, 0);
+        for(const auto& e: entries){
+            grid.cellStart[cellOf(e)+1]++;
+        }
+        for(int c=0; c<grid.nx*grid.ny; c++){
+            grid.cellStart[c+1] += grid.cellStart[c];
+        }
+        grid.entries.resize(entries.size());
+        std::vector<int> fill(grid.cellStart.begin(), grid.cellStart.end()-1);
+        for(const auto& e: entries){
+            grid.entries[fill[cellOf(e)]++] = e;
+        }
+    }
+    
+    size_t LocationIndex::nLocations() const{
+        return mNLocations;
+    }
+    
+    int LocationIndex::beaconIndex(const Beacon& beacon) const{
+        return beaconIndex(beacon.id());
+    }
+    
+    int LocationIndex::beaconIndex(const BeaconId& id) const{
+        uint32_t index = mBeaconRegistry.find(id);
+        return index==BeaconRegistry::noIndex ? -1 : static_cast<int>(index);
+    }
+    
+    void LocationIndex::findLocationIndices(const Location& center, double radius2D, std::vector<int>& indices) const{
+        auto iter = mFloorGrids.find(center.floor());
+        if(iter==mFloorGrids.end() || radius2D < 0){
+            return;
+        }
+        const FloorGrid& grid = iter->second;
+        auto cellRange = [&](double lo, double hi, double origin, int n, int& i0, int& i1){
+            i0 = static_cast<int>(std::min(std::max(std::floor((lo-origin)/grid.cellSize), 0.0), static_cast<double>(n)));
+            i1 = static_cast<int>(std::max(std::min(std::floor((hi-origin)/grid.cellSize), n-1.0), -1.0));
+        };
+        int ix0, ix1, iy0, iy1;
+        cellRange(center.x()-radius2D, center.x()+radius2D, grid.minX, grid.nx, ix0, ix1);
+        cellRange(center.y()-radius2D, center.y()+radius2D, grid.minY, grid.ny, iy0, iy1);
+        if(ix1<ix0 || iy1<iy0){
+            return;
+        }
+        for(int iy=iy0; iy<=iy1; iy++){
+            int begin = grid.cellStart[iy*grid.nx + ix0];
+            int end = grid.cellStart[iy*grid.nx + ix1 + 1];
+            for(int k=begin; k<end; k++){
+                const Entry& e = grid.entries[k];
+                double dx = e.x - center.x();
+                double dy = e.y - center.y();
+                // Same expression as Location::distance2D
+                if(std::sqrt(dx*dx + dy*dy) <= radius2D){
+                    indices.push_back(e.index);
+                }
+            }
+        }
+    }
+    
+    void LocationIndex::findLocationIndicesCloseToBeacons(const std::vector<Beacon>& beacons, double radius2D, std::vector<int>& indices) const{
+        size_t offset = indices.size();
+        for(const auto& b: beacons){
+            int index = beaconIndex(b);
+            if(index<0){
+                continue;
+            }
+            findLocationIndices(mBLEBeacons.at(index), radius2D, indices);
+        }
+        std::sort(indices.begin()+offset, indices.end());
+    }
+}
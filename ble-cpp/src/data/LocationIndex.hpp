@@ -0,0 +1,86 @@
+/*******************************************************************************
+ * Copyright (c) 2014, 2016  IBM Corporation and others
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *******************************************************************************/
+
+#ifndef LocationIndex_hpp
+#define LocationIndex_hpp
+
+#include <stdio.h>
+#include <map>
+#include <memory>
+#include <vector>
+
+#include "Location.hpp"
+#include "BLEBeacon.hpp"
+#include "BeaconRegistry.hpp"
+
+namespace loc{
+    
+    /**
+     Per-floor uniform grid over the unique locations of a data store, built once.
+     A radius query visits only the cells overlapping the query circle.
+     **/
+    class LocationIndex{
+    public:
+        using Ptr = std::shared_ptr<LocationIndex>;
+        
+        LocationIndex(const Locations& locations, const BLEBeacons& bleBeacons, double cellSize = 10.0);
+        
+        size_t nLocations() const;
+        
+        // Index of the beacon in bleBeacons or -1 when it is not registered.
+        int beaconIndex(const Beacon& beacon) const;
+        int beaconIndex(const BeaconId& id) const;
+        
+        // Appends indices of locations on the same floor within radius2D [m] of center.
+        void findLocationIndices(const Location& center, double radius2D, std::vector<int>& indices) const;
+        
+        // Same selection as checking every location against every observed beacon:
+        // location-major order, one entry per beacon in range.
+        void findLocationIndicesCloseToBeacons(const std::vector<Beacon>& beacons, double radius2D, std::vector<int>& indices) const;
+        
+    private:
+        struct Entry{
+            double x;
+            double y;
+            int index;
+        };
+        
+        struct FloorGrid{
+            double minX = 0;
+            double minY = 0;
+            int nx = 0;
+            int ny = 0;
+            double cellSize = 1.0;
+            std::vector<int> cellStart; // size nx*ny+1
+            std::vector<Entry> entries; // sorted by cell
+        };
+        
+        size_t mNLocations;
+        std::vector<BLEBeacon> mBLEBeacons;
+        BeaconRegistry mBeaconRegistry; // indices of mBLEBeacons
+        std::map<double, FloorGrid> mFloorGrids;
+        
+        static void buildGrid(FloorGrid& grid, std::vector<Entry>& entries, double cellSize);
+    };
+}
+
+#endif /* LocationIndex_hpp */
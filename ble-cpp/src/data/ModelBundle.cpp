@@ -0,0 +1,359 @@
+/*******************************************************************************
+ * Copyright (c) 2014, 2016  IBM Corporation and others
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *******************************************************************************/
+
+#include "ModelBundle.hpp"
+#include "LocException.hpp"
+
+#include <cstring>
+#include <fstream>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+namespace loc{
+    
+    const char ModelBundle::magic[8] = {'B','L','E','L','O','C','M','B'};
+    constexpr uint32_t ModelBundle::formatVersion;
+    constexpr uint32_t ModelBundle::endianTag;
+    constexpr uint64_t ModelBundle::alignment;
+    
+    bool ModelBundle::isBundle(const std::string& path){
+        std::ifstream ifs(path, std::ios::in | std::ios::binary);
+        if(!ifs.is_open()){
+            return false;
+        }
+        char buf[sizeof(magic)];
+        ifs.read(buf, sizeof(buf));
+        if(ifs.gcount() != sizeof(buf)){
+            return false;
+        }
+        return std::memcmp(buf, magic, sizeof(magic))==0;
+    }
+    
+    ModelBundle::Ptr ModelBundle::open(const std::string& path){
+        int fd = ::open(path.c_str(), O_RDONLY);
+        if(fd < 0){
+            BOOST_THROW_EXCEPTION(LocException("failed to open model bundle at " + path));
+        }
+        struct stat st;
+        if(fstat(fd, &st)!=0 || st.st_size < static_cast<off_t>(sizeof(Header))){
+            ::close(fd);
+            BOOST_THROW_EXCEPTION(LocException("invalid model bundle at " + path));
+        }
+        size_t size = static_cast<size_t>(st.st_size);
+        void* addr = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+        ::close(fd);
+        if(addr == MAP_FAILED){
+            BOOST_THROW_EXCEPTION(LocException("failed to map model bundle at " + path));
+        }
+        
+        Ptr bundle(new ModelBundle());
+        bundle->mPath = path;
+        bundle->mData = static_cast<const char*>(addr);
+        bundle->mSize = size;
+        
+        Header header;
+        std::memcpy(&header, bundle->mData, sizeof(Header));
+        if(std::memcmp(header.magic, magic, sizeof(magic))!=0){
+            BOOST_THROW_EXCEPTION(LocException("not a model bundle: " + path));
+        }
+        if(header.endianTag != endianTag){
+            BOOST_THROW_EXCEPTION(LocException("model bundle was written on a machine with different byte order: " + path));
+        }
+        if(header.formatVersion != formatVersion){
+            BOOST_THROW_EXCEPTION(LocException("unsupported model bundle version (version=" + std::to_string(header.formatVersion) + ")"));
+        }
+        uint64_t tableEnd = sizeof(Header) + static_cast<uint64_t>(header.nSections)*sizeof(Section);
+        if(size < tableEnd){
+            BOOST_THROW_EXCEPTION(LocException("truncated section table in model bundle: " + path));
+        }
+        bundle->mSections.resize(header.nSections);
+        if(0 < header.nSections){
+            std::memcpy(bundle->mSections.data(), bundle->mData + sizeof(Header), header.nSections*sizeof(Section));
+        }
+        for(const auto& sec: bundle->mSections){
+            if(sec.offset < tableEnd || size < sec.offset || size - sec.offset < sec.size || sec.offset % alignment != 0){
+                BOOST_THROW_EXCEPTION(LocException("invalid section in model bundle: " + path));
+            }
+        }
+        return bundle;
+    }
+    
+    ModelBundle::~ModelBundle(){
+        if(mData){
+            munmap(const_cast<char*>(mData), mSize);
+        }
+    }
+    
+    const std::string& ModelBundle::path() const{
+        return mPath;
+    }
+    
+    const std::vector<ModelBundle::Section>& ModelBundle::sections() const{
+        return mSections;
+    }
+    
+    const char* ModelBundle::data(const Section& section) const{
+        return mData + section.offset;
+    }
+    
+    bool ModelBundle::hasSection(SectionType type) const{
+        for(const auto& sec: mSections){
+            if(sec.type == type){
+                return true;
+            }
+        }
+        return false;
+    }
+    
+    const ModelBundle::Section& ModelBundle::section(SectionType type) const{
+        for(const auto& sec: mSections){
+            if(sec.type == type){
+                return sec;
+            }
+        }
+        BOOST_THROW_EXCEPTION(LocException("section (type=" + std::to_string(type) + ") is not found in model bundle"));
+    }
+    
+    ModelBundle::AnchorRecord ModelBundle::anchor() const{
+        const Section& sec = section(ANCHOR);
+        if(sec.size < sizeof(AnchorRecord)){
+            BOOST_THROW_EXCEPTION(LocException("invalid anchor section"));
+        }
+        AnchorRecord anchor;
+        std::memcpy(&anchor, data(sec), sizeof(AnchorRecord));
+        return anchor;
+    }
+    
+    Building ModelBundle::building() const{
+        BuildingBuilder buildingBuilder;
+        std::shared_ptr<const void> owner = shared_from_this();
+        for(const auto& sec: mSections){
+            if(sec.type != FLOOR){
+                continue;
+            }
+            if(sec.size < sizeof(FloorHeader)){
+                BOOST_THROW_EXCEPTION(LocException("invalid floor section"));
+            }
+            FloorHeader fh;
+            std::memcpy(&fh, data(sec), sizeof(FloorHeader));
+            if(fh.rows < 0 || fh.cols < 0 || sec.size - sizeof(FloorHeader) < static_cast<uint64_t>(fh.rows)*fh.cols){
+                BOOST_THROW_EXCEPTION(LocException("invalid floor section (floor=" + std::to_string(fh.floor) + ")"));
+            }
+            const uint8_t* labels = reinterpret_cast<const uint8_t*>(data(sec) + sizeof(FloorHeader));
+            ImageHolder image(fh.rows, fh.cols, labels, owner, std::to_string(fh.floor));
+            CoordinateSystemParameters coordSysParams(fh.ppmx, fh.ppmy, fh.ppmz, fh.originx, fh.originy, fh.originz);
+            buildingBuilder.addFloorCoordinateSystemParametersAndImage(fh.floor, coordSysParams, image);
+        }
+        return buildingBuilder.build();
+    }
+    
+    Locations ModelBundle::locations() const{
+        Locations locations;
+        if(!hasSection(LOCATIONS)){
+            return locations;
+        }
+        const Section& sec = section(LOCATIONS);
+        size_t n = sec.size / sizeof(LocationRecord);
+        locations.reserve(n);
+        for(size_t i=0; i<n; i++){
+            LocationRecord rec;
+            std::memcpy(&rec, data(sec) + i*sizeof(LocationRecord), sizeof(LocationRecord));
+            locations.push_back(Location(rec.x, rec.y, rec.z, rec.floor));
+        }
+        return locations;
+    }
+    
+    BLEBeacons ModelBundle::bleBeacons() const{
+        BLEBeacons bleBeacons;
+        if(!hasSection(BEACONS)){
+            return bleBeacons;
+        }
+        const Section& sec = section(BEACONS);
+        size_t n = sec.size / sizeof(BeaconRecord);
+        bleBeacons.reserve(n);
+        for(size_t i=0; i<n; i++){
+            BeaconRecord rec;
+            std::memcpy(&rec, data(sec) + i*sizeof(BeaconRecord), sizeof(BeaconRecord));
+            std::string uuid(rec.uuid, strnlen(rec.uuid, sizeof(rec.uuid)));
+            bleBeacons.push_back(BLEBeacon(uuid, rec.major, rec.minor, rec.x, rec.y, rec.z, rec.floor));
+        }
+        return bleBeacons;
+    }
+    
+    Eigen::Map<const Eigen::MatrixXd> ModelBundle::matrix(SectionType type) const{
+        const Section& sec = section(type);
+        if(sec.size < sizeof(MatrixHeader)){
+            BOOST_THROW_EXCEPTION(LocException("invalid matrix section (type=" + std::to_string(type) + ")"));
+        }
+        MatrixHeader mh;
+        std::memcpy(&mh, data(sec), sizeof(MatrixHeader));
+        uint64_t nValues = (sec.size - sizeof(MatrixHeader))/sizeof(double);
+        if(mh.rows < 0 || mh.cols < 0 || (0 < mh.cols && nValues/mh.cols < static_cast<uint64_t>(mh.rows))){
+            BOOST_THROW_EXCEPTION(LocException("invalid matrix section (type=" + std::to_string(type) + ")"));
+        }
+        const double* values = reinterpret_cast<const double*>(data(sec) + sizeof(MatrixHeader));
+        return Eigen::Map<const Eigen::MatrixXd>(values, mh.rows, mh.cols);
+    }
+    
+    
+    ModelBundleWriter& ModelBundleWriter::anchor(const ModelBundle::AnchorRecord& anchor){
+        mAnchor = anchor;
+        return *this;
+    }
+    
+    ModelBundleWriter& ModelBundleWriter::addFloor(int floor_num, const CoordinateSystemParameters& params, const ImageHolder& image){
+        ModelBundle::FloorHeader fh;
+        fh.floor = floor_num;
+        fh.rows = image.rows();
+        fh.cols = image.cols();
+        fh.reserved = 0;
+        fh.ppmx = params.punit_x;
+        fh.ppmy = params.punit_y;
+        fh.ppmz = params.punit_z;
+        fh.originx = params.x_origin;
+        fh.originy = params.y_origin;
+        fh.originz = params.z_origin;
+        std::vector<uint8_t> labels(static_cast<size_t>(fh.rows)*fh.cols);
+        for(int y=0; y<fh.rows; y++){
+            for(int x=0; x<fh.cols; x++){
+                labels[static_cast<size_t>(y)*fh.cols + x] = image.label(y, x);
+            }
+        }
+        mFloors.push_back(std::make_pair(fh, std::move(labels)));
+        return *this;
+    }
+    
+    ModelBundleWriter& ModelBundleWriter::locations(const Locations& locations){
+        mLocations.clear();
+        for(const auto& loc: locations){
+            mLocations.push_back(ModelBundle::LocationRecord{loc.x(), loc.y(), loc.z(), loc.floor()});
+        }
+        return *this;
+    }
+    
+    ModelBundleWriter& ModelBundleWriter::bleBeacons(const BLEBeacons& bleBeacons){
+        mBeacons.clear();
+        for(const auto& b: bleBeacons){
+            ModelBundle::BeaconRecord rec;
+            std::memset(&rec, 0, sizeof(rec));
+            if(sizeof(rec.uuid) <= b.uuid().size()){
+                BOOST_THROW_EXCEPTION(LocException("too long uuid: " + b.uuid()));
+            }
+            std::memcpy(rec.uuid, b.uuid().data(), b.uuid().size());
+            rec.major = b.major();
+            rec.minor = b.minor();
+            rec.x = b.x();
+            rec.y = b.y();
+            rec.z = b.z();
+            rec.floor = b.floor();
+            mBeacons.push_back(rec);
+        }
+        return *this;
+    }
+    
+    ModelBundleWriter& ModelBundleWriter::observationModel(const std::string& bytes){
+        mObservationModel = bytes;
+        return *this;
+    }
+    
+    ModelBundleWriter& ModelBundleWriter::matrix(ModelBundle::SectionType type, const Eigen::MatrixXd& matrix){
+        ModelBundle::MatrixHeader mh;
+        std::memset(&mh, 0, sizeof(mh));
+        mh.rows = matrix.rows();
+        mh.cols = matrix.cols();
+        std::vector<double> values(matrix.data(), matrix.data() + matrix.size());
+        mMatrices.push_back(std::make_pair(type, std::make_pair(mh, std::move(values))));
+        return *this;
+    }
+    
+    void ModelBundleWriter::write(const std::string& path) const{
+        struct Payload{
+            uint32_t type;
+            std::vector<std::pair<const char*, size_t>> chunks;
+        };
+        std::vector<Payload> payloads;
+        payloads.push_back(Payload{ModelBundle::ANCHOR, {{reinterpret_cast<const char*>(&mAnchor), sizeof(mAnchor)}}});
+        for(const auto& floor: mFloors){
+            payloads.push_back(Payload{ModelBundle::FLOOR, {
+                {reinterpret_cast<const char*>(&floor.first), sizeof(floor.first)},
+                {reinterpret_cast<const char*>(floor.second.data()), floor.second.size()}}});
+        }
+        payloads.push_back(Payload{ModelBundle::LOCATIONS, {{reinterpret_cast<const char*>(mLocations.data()), mLocations.size()*sizeof(ModelBundle::LocationRecord)}}});
+        payloads.push_back(Payload{ModelBundle::BEACONS, {{reinterpret_cast<const char*>(mBeacons.data()), mBeacons.size()*sizeof(ModelBundle::BeaconRecord)}}});
+        payloads.push_back(Payload{ModelBundle::OBSERVATION_MODEL, {{mObservationModel.data(), mObservationModel.size()}}});
+        for(const auto& matrix: mMatrices){
+            payloads.push_back(Payload{matrix.first, {
+                {reinterpret_cast<const char*>(&matrix.second.first), sizeof(matrix.second.first)},
+                {reinterpret_cast<const char*>(matrix.second.second.data()), matrix.second.second.size()*sizeof(double)}}});
+        }
+        
+        auto align = [](uint64_t offset){
+            return (offset + ModelBundle::alignment - 1) / ModelBundle::alignment * ModelBundle::alignment;
+        };
+        
+        ModelBundle::Header header;
+        std::memcpy(header.magic, ModelBundle::magic, sizeof(header.magic));
+        header.formatVersion = ModelBundle::formatVersion;
+        header.endianTag = ModelBundle::endianTag;
+        header.nSections = static_cast<uint32_t>(payloads.size());
+        header.reserved = 0;
+        
+        std::vector<ModelBundle::Section> sections;
+        uint64_t offset = align(sizeof(header) + payloads.size()*sizeof(ModelBundle::Section));
+        for(const auto& payload: payloads){
+            ModelBundle::Section sec;
+            sec.type = payload.type;
+            sec.reserved = 0;
+            sec.offset = offset;
+            sec.size = 0;
+            for(const auto& chunk: payload.chunks){
+                sec.size += chunk.second;
+            }
+            sections.push_back(sec);
+            offset = align(offset + sec.size);
+        }
+        
+        std::ofstream ofs(path, std::ios::out | std::ios::binary | std::ios::trunc);
+        if(!ofs.is_open()){
+            BOOST_THROW_EXCEPTION(LocException("failed to open " + path));
+        }
+        const std::vector<char> padding(ModelBundle::alignment, 0);
+        uint64_t written = 0;
+        auto put = [&](const char* p, size_t n){
+            ofs.write(p, n);
+            written += n;
+        };
+        put(reinterpret_cast<const char*>(&header), sizeof(header));
+        put(reinterpret_cast<const char*>(sections.data()), sections.size()*sizeof(ModelBundle::Section));
+        for(size_t i=0; i<payloads.size(); i++){
+            put(padding.data(), sections[i].offset - written);
+            for(const auto& chunk: payloads[i].chunks){
+                put(chunk.first, chunk.second);
+            }
+        }
+        if(!ofs){
+            BOOST_THROW_EXCEPTION(LocException("failed to write model bundle to " + path));
+        }
+    }
+}
@@ -0,0 +1,180 @@
+/*******************************************************************************
+ * Copyright (c) 2014, 2016  IBM Corporation and others
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *******************************************************************************/
+
+#ifndef ModelBundle_hpp
+#define ModelBundle_hpp
+
+#include <stdio.h>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+#include <streambuf>
+
+#include <Eigen/Core>
+
+#include "Location.hpp"
+#include "BLEBeacon.hpp"
+#include "Building.hpp"
+
+namespace loc{
+    
+    /**
+     Binary model bundle which is memory-mapped and used without parsing.
+     
+     Layout: Header, a table of Section entries, then sections aligned to ModelBundle::alignment bytes.
+     Values are stored in the byte order of the machine which wrote the bundle and are checked with endianTag.
+     Floor sections hold a FloorHeader followed by a row-major label raster (see ImageHolder::label)
+     which is used in place by ImageHolder. Matrix sections hold a MatrixHeader followed by column-major
+     doubles, which are viewed with Eigen::Map. The observation model section holds the small part of
+     GaussianProcessLDPLMultiModel::saveBinary output; its GP and ITU parameters are in matrix sections
+     (ITU parameters have a column per beacon) and are used in place as well.
+     **/
+    class ModelBundle : public std::enable_shared_from_this<ModelBundle>{
+    public:
+        using Ptr = std::shared_ptr<ModelBundle>;
+        
+        static constexpr uint32_t formatVersion = 3;
+        static constexpr uint32_t endianTag = 0x01020304;
+        static constexpr uint64_t alignment = 64;
+        
+        enum SectionType : uint32_t{
+            ANCHOR = 1,
+            FLOOR = 2,
+            LOCATIONS = 3,
+            BEACONS = 4,
+            OBSERVATION_MODEL = 5,
+            GP_X = 6,
+            GP_WEIGHTS = 7,
+            ITU_PARAMETERS = 8
+        };
+        
+        struct Header{
+            char magic[8];
+            uint32_t formatVersion;
+            uint32_t endianTag;
+            uint32_t nSections;
+            uint32_t reserved;
+        };
+        
+        struct Section{
+            uint32_t type;
+            uint32_t reserved;
+            uint64_t offset;
+            uint64_t size;
+        };
+        
+        struct AnchorRecord{
+            double latitude;
+            double longitude;
+            double rotate;
+            double declination; // NaN if not set
+        };
+        
+        struct FloorHeader{
+            int32_t floor;
+            int32_t rows;
+            int32_t cols;
+            int32_t reserved;
+            double ppmx, ppmy, ppmz;
+            double originx, originy, originz;
+        };
+        
+        struct LocationRecord{
+            double x, y, z, floor;
+        };
+        
+        // Padded to alignment so that the values are aligned as well.
+        struct MatrixHeader{
+            int64_t rows;
+            int64_t cols;
+            int64_t reserved[6];
+        };
+        
+        struct BeaconRecord{
+            char uuid[40]; // null-terminated
+            int32_t major;
+            int32_t minor;
+            double x, y, z, floor;
+        };
+        
+        // Read-only stream over a section
+        class SectionStreamBuffer : public std::streambuf{
+        public:
+            SectionStreamBuffer(const char* data, size_t size){
+                char* p = const_cast<char*>(data);
+                setg(p, p, p + size);
+            }
+        };
+        
+        static const char magic[8];
+        
+        static bool isBundle(const std::string& path);
+        static Ptr open(const std::string& path);
+        
+        ~ModelBundle();
+        ModelBundle(const ModelBundle&) = delete;
+        ModelBundle& operator=(const ModelBundle&) = delete;
+        
+        const std::string& path() const;
+        const std::vector<Section>& sections() const;
+        const char* data(const Section& section) const;
+        bool hasSection(SectionType type) const;
+        const Section& section(SectionType type) const;
+        
+        AnchorRecord anchor() const;
+        // Floor images view the mapped file and keep this bundle alive.
+        Building building() const;
+        Locations locations() const;
+        BLEBeacons bleBeacons() const;
+        // Views a matrix section of the mapped file. The view is valid while this bundle is alive.
+        Eigen::Map<const Eigen::MatrixXd> matrix(SectionType type) const;
+        
+    private:
+        ModelBundle() = default;
+        
+        std::string mPath;
+        const char* mData = nullptr;
+        size_t mSize = 0;
+        std::vector<Section> mSections;
+    };
+    
+    class ModelBundleWriter{
+        ModelBundle::AnchorRecord mAnchor{0, 0, 0, 0};
+        std::vector<std::pair<ModelBundle::FloorHeader, std::vector<uint8_t>>> mFloors;
+        std::vector<ModelBundle::LocationRecord> mLocations;
+        std::vector<ModelBundle::BeaconRecord> mBeacons;
+        std::string mObservationModel;
+        std::vector<std::pair<ModelBundle::SectionType, std::pair<ModelBundle::MatrixHeader, std::vector<double>>>> mMatrices;
+        
+    public:
+        ModelBundleWriter& anchor(const ModelBundle::AnchorRecord& anchor);
+        ModelBundleWriter& addFloor(int floor_num, const CoordinateSystemParameters& params, const ImageHolder& image);
+        ModelBundleWriter& locations(const Locations& locations);
+        ModelBundleWriter& bleBeacons(const BLEBeacons& bleBeacons);
+        ModelBundleWriter& observationModel(const std::string& bytes);
+        ModelBundleWriter& matrix(ModelBundle::SectionType type, const Eigen::MatrixXd& matrix);
+        void write(const std::string& path) const;
+    };
+}
+
+#endif /* ModelBundle_hpp */
@@ -0,0 +1,216 @@
+/*******************************************************************************
+ * Copyright (c) 2014, 2016  IBM Corporation and others
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *******************************************************************************/
+
+#include "TraceReader.hpp"
+#include "LocException.hpp"
+
+#include <cstring>
+
+namespace loc{
+    
+    namespace{
+        void checkRemaining(const char* p, const char* end, size_t size){
+            if(static_cast<size_t>(end - p) < size){
+                BOOST_THROW_EXCEPTION(LocException("trace record exceeds its payload size"));
+            }
+        }
+        
+        template<class T>
+        const char* get(const char* p, const char* end, T& value){
+            checkRemaining(p, end, sizeof(T));
+            std::memcpy(&value, p, sizeof(T));
+            return p + sizeof(T);
+        }
+        
+        const char* getArray(const char* p, const char* end, void* data, size_t size){
+            checkRemaining(p, end, size);
+            if(size>0){
+                std::memcpy(data, p, size);
+            }
+            return p + size;
+        }
+        
+        // Bytes per particle (13 double fields and an int64 timestamp) and the minimum bytes per beacon.
+        const size_t particleBytes = 13*sizeof(double) + sizeof(int64_t);
+        const size_t beaconBytes = sizeof(uint32_t) + 2*sizeof(int32_t) + sizeof(double);
+    }
+    
+    TraceReader::TraceReader(const std::string& path){
+        mIfs.open(path, std::ios::binary);
+        if(!mIfs){
+            BOOST_THROW_EXCEPTION(LocException("failed to open trace file at " + path));
+        }
+        char magic[sizeof(TraceWriter::magic)];
+        mIfs.read(magic, sizeof(magic));
+        if(!mIfs || std::memcmp(magic, TraceWriter::magic, sizeof(magic))!=0){
+            BOOST_THROW_EXCEPTION(LocException("invalid trace file at " + path));
+        }
+    }
+    
+    bool TraceReader::next(Record& record){
+        while(true){
+            uint32_t header[2];
+            mIfs.read(reinterpret_cast<char*>(header), sizeof(header));
+            if(!mIfs){
+                return false;
+            }
+            mPayload.resize(header[1]);
+            mIfs.read(mPayload.data(), mPayload.size());
+            if(!mIfs){
+                return false;
+            }
+            switch(header[0]){
+                case TraceWriter::PARTICLES:
+                    decodeParticles(record);
+                    return true;
+                case TraceWriter::INPUT:
+                    decodeInput(record);
+                    return true;
+                case TraceWriter::STATUS:
+                    decodeStatus(record);
+                    return true;
+                default:
+                    break;
+            }
+        }
+    }
+    
+    void TraceReader::decodeParticles(Record& record) const{
+        const char* p = mPayload.data();
+        const char* end = p + mPayload.size();
+        int64_t timestamp;
+        uint32_t stage, n;
+        p = get(p, end, timestamp);
+        p = get(p, end, stage);
+        p = get(p, end, n);
+        checkRemaining(p, end, n*particleBytes);
+        record.type = TraceWriter::PARTICLES;
+        record.timestamp = timestamp;
+        record.stage = static_cast<TraceWriter::Stage>(stage);
+        
+        Particles& particles = record.particles;
+        particles.resize(n);
+        double* fields[] = {
+            particles.x(), particles.y(), particles.z(), particles.floor(),
+            particles.orientation(), particles.velocity(), particles.normalVelocity(),
+            particles.orientationBias(), particles.orientationAlignment(), particles.rssiBias(),
+            particles.weight(), particles.negativeLogLikelihood(), particles.mahalanobisDistance()
+        };
+        for(double* field: fields){
+            p = getArray(p, end, field, n*sizeof(double));
+        }
+        long* timestamps = particles.timestamp();
+        for(uint32_t i=0; i<n; i++){
+            int64_t t;
+            p = get(p, end, t);
+            timestamps[i] = t;
+        }
+    }
+    
+    void TraceReader::decodeInput(Record& record) const{
+        const char* p = mPayload.data();
+        const char* end = p + mPayload.size();
+        uint32_t type, nBeacons;
+        int64_t timestamp;
+        p = get(p, end, type);
+        p = get(p, end, timestamp);
+        
+        SensorEvent& event = record.input;
+        event.type = static_cast<SensorEvent::Type>(type);
+        event.timestamp = timestamp;
+        p = getArray(p, end, event.values, 3*sizeof(double));
+        p = get(p, end, nBeacons);
+        checkRemaining(p, end, nBeacons*beaconBytes);
+        event.beacons.clear();
+        event.beacons.timestamp(timestamp);
+        for(uint32_t i=0; i<nBeacons; i++){
+            uint32_t length;
+            int32_t major, minor;
+            double rssi;
+            p = get(p, end, length);
+            checkRemaining(p, end, length);
+            std::string uuid(p, length);
+            p += length;
+            p = get(p, end, major);
+            p = get(p, end, minor);
+            p = get(p, end, rssi);
+            event.beacons.push_back(Beacon(uuid, major, minor, rssi));
+        }
+        record.type = TraceWriter::INPUT;
+        record.timestamp = timestamp;
+    }
+    
+    void TraceReader::decodeStatus(Record& record) const{
+        const char* p = mPayload.data();
+        const char* end = p + mPayload.size();
+        int64_t timestamp;
+        int32_t step, locationStatus;
+        double pose[7];
+        p = get(p, end, timestamp);
+        p = get(p, end, step);
+        p = get(p, end, locationStatus);
+        p = getArray(p, end, pose, sizeof(pose));
+        record.type = TraceWriter::STATUS;
+        record.timestamp = timestamp;
+        record.step = static_cast<Status::Step>(step);
+        record.locationStatus = static_cast<Status::LocationStatus>(locationStatus);
+        record.meanPose.x(pose[0]).y(pose[1]).z(pose[2]).floor(pose[3]);
+        record.meanPose.orientation(pose[4]).velocity(pose[5]).normalVelocity(pose[6]);
+    }
+    
+    void TraceReader::convertToCSV(const std::string& tracePath, const std::string& outputDirectory){
+        TraceReader reader(tracePath);
+        std::ofstream ofsParticles(outputDirectory + "/particles.csv");
+        std::ofstream ofsInputs(outputDirectory + "/inputs.csv");
+        std::ofstream ofsStatus(outputDirectory + "/status.csv");
+        ofsParticles << "stage,timestamp," << State().header() << std::endl;
+        ofsInputs << "timestamp,type,value0,value1,value2,nBeacons,uuid,major,minor,rssi,..." << std::endl;
+        ofsStatus << "timestamp,step,status," << Pose::header() << std::endl;
+        
+        Record record;
+        while(reader.next(record)){
+            switch(record.type){
+                case TraceWriter::PARTICLES:{
+                    auto stage = TraceWriter::stageToString(record.stage);
+                    for(size_t i=0; i<record.particles.size(); i++){
+                        ofsParticles << stage << "," << record.timestamp << "," << record.particles.state(i) << std::endl;
+                    }
+                    break;
+                }
+                case TraceWriter::INPUT:{
+                    const SensorEvent& event = record.input;
+                    ofsInputs << event.timestamp << "," << event.type << ","
+                    << event.values[0] << "," << event.values[1] << "," << event.values[2] << "," << event.beacons.size();
+                    for(const auto& b: event.beacons){
+                        ofsInputs << "," << b.uuid() << "," << b.major() << "," << b.minor() << "," << b.rssi();
+                    }
+                    ofsInputs << std::endl;
+                    break;
+                }
+                case TraceWriter::STATUS:
+                    ofsStatus << record.timestamp << "," << Status::stepToString(record.step) << ","
+                    << Status::locationStatusToString(record.locationStatus) << "," << record.meanPose << std::endl;
+                    break;
+            }
+        }
+    }
+}
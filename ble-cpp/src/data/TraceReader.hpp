@@ -0,0 +1,72 @@
+/*******************************************************************************
+ * Copyright (c) 2014, 2016  IBM Corporation and others
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *******************************************************************************/
+
+#ifndef TraceReader_hpp
+#define TraceReader_hpp
+
+#include <stdio.h>
+#include <fstream>
+#include <string>
+#include <vector>
+
+#include "TraceWriter.hpp"
+
+namespace loc{
+    
+    // Sequential reader of a trace written by TraceWriter.
+    class TraceReader{
+    public:
+        // Decoded record. Only the members of the record type are updated by next.
+        struct Record{
+            TraceWriter::RecordType type = TraceWriter::PARTICLES;
+            long timestamp = 0;
+            // PARTICLES
+            TraceWriter::Stage stage = TraceWriter::BEFORE_LIKELIHOOD;
+            Particles particles;
+            // INPUT
+            SensorEvent input;
+            // STATUS
+            Status::Step step = Status::OTHER;
+            Status::LocationStatus locationStatus = Status::NIL;
+            Pose meanPose;
+        };
+        
+        TraceReader(const std::string& path);
+        
+        // Reads the next record. Returns false at the end of the trace or at a truncated record.
+        // Records of unknown types are skipped. Throws LocException when a record does not fit in its payload.
+        bool next(Record& record);
+        
+        // Writes particles.csv, inputs.csv and status.csv into outputDirectory.
+        static void convertToCSV(const std::string& tracePath, const std::string& outputDirectory);
+        
+    private:
+        std::ifstream mIfs;
+        std::vector<char> mPayload;
+        
+        void decodeParticles(Record& record) const;
+        void decodeInput(Record& record) const;
+        void decodeStatus(Record& record) const;
+    };
+}
+
+#endif /* TraceReader_hpp */
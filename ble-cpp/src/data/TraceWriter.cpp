@@ -0,0 +1,239 @@
+/*******************************************************************************
+ * Copyright (c) 2014, 2016  IBM Corporation and others
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *******************************************************************************/
+
+#include "TraceWriter.hpp"
+#include "LocException.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+
+namespace loc{
+    
+    const char TraceWriter::magic[8] = {'B','L','T','R','A','C','E','1'};
+    
+    namespace{
+        const size_t recordHeaderSize = 2*sizeof(uint32_t);
+        
+        template<class T>
+        char* put(char* p, T value){
+            std::memcpy(p, &value, sizeof(T));
+            return p + sizeof(T);
+        }
+        
+        char* putArray(char* p, const void* data, size_t size){
+            if(size>0){
+                std::memcpy(p, data, size);
+            }
+            return p + size;
+        }
+    }
+    
+    std::string TraceWriter::stageToString(Stage stage){
+        switch(stage){
+            case BEFORE_LIKELIHOOD:
+                return "before_likelihood";
+            case AFTER_LIKELIHOOD:
+                return "after_likelihood";
+            case RESAMPLED:
+                return "resampled";
+            default:
+                return "unknown";
+        }
+    }
+    
+    TraceWriter::TraceWriter(const std::string& path, const TraceWriterParameters& params)
+    : mParams(params){
+        mOfs.open(path, std::ios::binary | std::ios::trunc);
+        if(!mOfs){
+            BOOST_THROW_EXCEPTION(LocException("failed to open trace file at " + path));
+        }
+        mOfs.write(magic, sizeof(magic));
+        mCurrent.reserve(mParams.bufferSize);
+        mThread = std::thread(&TraceWriter::writerLoop, this);
+    }
+    
+    TraceWriter::~TraceWriter(){
+        flush();
+        {
+            std::lock_guard<std::mutex> lock(mMutex);
+            mStop = true;
+        }
+        mCondPending.notify_all();
+        mThread.join();
+    }
+    
+    bool TraceWriter::hasFreeBuffer() const{
+        // mCurrent counts as one of nBuffers.
+        return mPending.size() + (mWriting ? 1 : 0) + 1 < static_cast<size_t>(std::max(mParams.nBuffers, 2));
+    }
+    
+    void TraceWriter::swapCurrent(){
+        mPending.push_back(std::move(mCurrent));
+        if(mFree.empty()){
+            mCurrent = Buffer();
+            mCurrent.reserve(mParams.bufferSize);
+        }else{
+            mCurrent = std::move(mFree.back());
+            mFree.pop_back();
+        }
+        mCondPending.notify_one();
+    }
+    
+    char* TraceWriter::reserve(std::unique_lock<std::mutex>& lock, RecordType type, size_t payloadSize){
+        size_t recordSize = recordHeaderSize + payloadSize;
+        if(!mCurrent.empty() && mParams.bufferSize < mCurrent.size() + recordSize){
+            if(!hasFreeBuffer()){
+                if(!mParams.blocksWhenFull){
+                    mDroppedRecords++;
+                    return nullptr;
+                }
+                mCondWritten.wait(lock, [this]{ return hasFreeBuffer(); });
+            }
+            swapCurrent();
+        }
+        size_t offset = mCurrent.size();
+        mCurrent.resize(offset + recordSize);
+        char* p = mCurrent.data() + offset;
+        p = put<uint32_t>(p, type);
+        p = put<uint32_t>(p, static_cast<uint32_t>(payloadSize));
+        return p;
+    }
+    
+    void TraceWriter::writeParticles(Stage stage, long timestamp, const Particles& particles){
+        const uint32_t n = static_cast<uint32_t>(particles.size());
+        const double* fields[] = {
+            particles.x(), particles.y(), particles.z(), particles.floor(),
+            particles.orientation(), particles.velocity(), particles.normalVelocity(),
+            particles.orientationBias(), particles.orientationAlignment(), particles.rssiBias(),
+            particles.weight(), particles.negativeLogLikelihood(), particles.mahalanobisDistance()
+        };
+        const size_t nFields = sizeof(fields)/sizeof(fields[0]);
+        size_t payloadSize = sizeof(int64_t) + 2*sizeof(uint32_t) + n*(nFields*sizeof(double) + sizeof(int64_t));
+        
+        std::unique_lock<std::mutex> lock(mMutex);
+        char* p = reserve(lock, PARTICLES, payloadSize);
+        if(!p){
+            return;
+        }
+        p = put<int64_t>(p, timestamp);
+        p = put<uint32_t>(p, stage);
+        p = put<uint32_t>(p, n);
+        for(const double* field: fields){
+            p = putArray(p, field, n*sizeof(double));
+        }
+        const long* timestamps = particles.timestamp();
+        for(uint32_t i=0; i<n; i++){
+            p = put<int64_t>(p, timestamps[i]);
+        }
+    }
+    
+    void TraceWriter::writeInput(const SensorEvent& event){
+        size_t payloadSize = sizeof(uint32_t) + sizeof(int64_t) + 3*sizeof(double) + sizeof(uint32_t);
+        for(const auto& b: event.beacons){
+            payloadSize += sizeof(uint32_t) + b.uuid().size() + 2*sizeof(int32_t) + sizeof(double);
+        }
+        
+        std::unique_lock<std::mutex> lock(mMutex);
+        char* p = reserve(lock, INPUT, payloadSize);
+        if(!p){
+            return;
+        }
+        p = put<uint32_t>(p, event.type);
+        p = put<int64_t>(p, event.timestamp);
+        p = putArray(p, event.values, 3*sizeof(double));
+        p = put<uint32_t>(p, static_cast<uint32_t>(event.beacons.size()));
+        for(const auto& b: event.beacons){
+            const std::string& uuid = b.uuid();
+            p = put<uint32_t>(p, static_cast<uint32_t>(uuid.size()));
+            p = putArray(p, uuid.data(), uuid.size());
+            p = put<int32_t>(p, b.major());
+            p = put<int32_t>(p, b.minor());
+            p = put<double>(p, b.rssi());
+        }
+    }
+    
+    void TraceWriter::writeStatus(const Status& status){
+        double pose[7] = {NAN, NAN, NAN, NAN, NAN, NAN, NAN};
+        if(auto meanPose = status.meanPose()){
+            double values[7] = {meanPose->x(), meanPose->y(), meanPose->z(), meanPose->floor(),
+                meanPose->orientation(), meanPose->velocity(), meanPose->normalVelocity()};
+            std::memcpy(pose, values, sizeof(pose));
+        }
+        size_t payloadSize = sizeof(int64_t) + 2*sizeof(int32_t) + sizeof(pose);
+        
+        std::unique_lock<std::mutex> lock(mMutex);
+        char* p = reserve(lock, STATUS, payloadSize);
+        if(!p){
+            return;
+        }
+        p = put<int64_t>(p, status.timestamp());
+        p = put<int32_t>(p, status.step());
+        p = put<int32_t>(p, status.locationStatus());
+        p = putArray(p, pose, sizeof(pose));
+    }
+    
+    void TraceWriter::flush(){
+        std::unique_lock<std::mutex> lock(mMutex);
+        if(!mCurrent.empty()){
+            mCondWritten.wait(lock, [this]{ return hasFreeBuffer(); });
+            swapCurrent();
+        }
+        mCondWritten.wait(lock, [this]{ return mPending.empty() && !mWriting; });
+        mOfs.flush();
+    }
+    
+    size_t TraceWriter::droppedRecords() const{
+        std::lock_guard<std::mutex> lock(mMutex);
+        return mDroppedRecords;
+    }
+    
+    void TraceWriter::writerLoop(){
+        std::unique_lock<std::mutex> lock(mMutex);
+        while(true){
+            bool signaled = mCondPending.wait_for(lock, std::chrono::milliseconds(mParams.flushIntervalMs),
+                                                  [this]{ return mStop || !mPending.empty(); });
+            // The timed flush is bounded by nBuffers like the swaps in reserve; a full set of pending buffers is
+            // written first and the current buffer is flushed on a later round.
+            if(!signaled && !mCurrent.empty() && hasFreeBuffer()){
+                swapCurrent();
+            }
+            if(mPending.empty()){
+                if(mStop){
+                    break;
+                }
+                continue;
+            }
+            Buffer buffer = std::move(mPending.front());
+            mPending.pop_front();
+            mWriting = true;
+            lock.unlock();
+            mOfs.write(buffer.data(), buffer.size());
+            buffer.clear();
+            lock.lock();
+            mWriting = false;
+            mFree.push_back(std::move(buffer));
+            mCondWritten.notify_all();
+        }
+    }
+}
@@ -0,0 +1,128 @@
+/*******************************************************************************
+ * Copyright (c) 2014, 2016  IBM Corporation and others
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *******************************************************************************/
+
+#ifndef TraceWriter_hpp
+#define TraceWriter_hpp
+
+#include <stdio.h>
+#include <cstdint>
+#include <deque>
+#include <fstream>
+#include <memory>
+#include <mutex>
+#include <condition_variable>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "Particles.hpp"
+#include "Status.hpp"
+#include "SensorEvent.hpp"
+
+namespace loc{
+    
+    class TraceWriterParameters{
+    public:
+        size_t bufferSize = 1 << 20; // [bytes]
+        int nBuffers = 8; // records are dropped (or the caller blocks) when all buffers are pending
+        bool blocksWhenFull = false;
+        long flushIntervalMs = 1000; // partially filled buffer is written after this interval
+    };
+    
+    /**
+     Append-only binary trace of particle snapshots, sensor inputs and statuses.
+     Records are encoded into bounded in-memory buffers and written to one file by a background thread.
+     
+     File layout (native byte order):
+       magic "BLTRACE1"
+       records: uint32 type, uint32 payload size, payload
+     PARTICLES: int64 timestamp, uint32 stage, uint32 n, one double array of n per Particles field
+                (x, y, z, floor, orientation, velocity, normalVelocity, orientationBias,
+                orientationAlignment, rssiBias, weight, negativeLogLikelihood, mahalanobisDistance),
+                int64 array of n particle timestamps
+     INPUT:     uint32 sensor type, int64 timestamp, double values[3], uint32 nBeacons,
+                nBeacons x (uint32 uuid length, uuid, int32 major, int32 minor, double rssi)
+     STATUS:    int64 timestamp, int32 step, int32 location status, 7 doubles of the mean pose
+     **/
+    class TraceWriter{
+    public:
+        using Ptr = std::shared_ptr<TraceWriter>;
+        
+        enum RecordType : uint32_t{
+            PARTICLES = 1,
+            INPUT = 2,
+            STATUS = 3
+        };
+        
+        enum Stage : uint32_t{
+            BEFORE_LIKELIHOOD = 0,
+            AFTER_LIKELIHOOD,
+            RESAMPLED
+        };
+        
+        static const char magic[8];
+        static std::string stageToString(Stage stage);
+        
+        TraceWriter(const std::string& path, const TraceWriterParameters& params = TraceWriterParameters());
+        ~TraceWriter();
+        
+        TraceWriter(const TraceWriter&) = delete;
+        TraceWriter& operator=(const TraceWriter&) = delete;
+        
+        // Thread-safe. Returns without waiting for the file unless blocksWhenFull is set and all buffers are pending.
+        void writeParticles(Stage stage, long timestamp, const Particles& particles);
+        void writeInput(const SensorEvent& event);
+        void writeStatus(const Status& status);
+        
+        // Blocks until all records appended so far are written to the file.
+        void flush();
+        
+        size_t droppedRecords() const;
+        
+    private:
+        using Buffer = std::vector<char>;
+        
+        TraceWriterParameters mParams;
+        std::ofstream mOfs;
+        
+        mutable std::mutex mMutex;
+        std::condition_variable mCondPending;
+        std::condition_variable mCondWritten;
+        Buffer mCurrent;
+        std::deque<Buffer> mPending;
+        std::vector<Buffer> mFree;
+        bool mWriting = false;
+        bool mStop = false;
+        size_t mDroppedRecords = 0;
+        std::thread mThread;
+        
+        void writerLoop();
+        bool hasFreeBuffer() const;
+        void swapCurrent();
+        
+        // Reserves space for a record in the current buffer and returns the payload pointer,
+        // or nullptr when the record is dropped. Must be called with mMutex locked.
+        char* reserve(std::unique_lock<std::mutex>& lock, RecordType type, size_t payloadSize);
+    };
+}
+
+#endif /* TraceWriter_hpp */
@@ -21,6 +21,7 @@
  *******************************************************************************/
 
 #include "VirtualDevice.hpp"
+#include "StreamParticleFilter.hpp"
 
 namespace loc{
     
@@ -43,12 +44,55 @@ namespace loc{
     
     void VirtualDevice::streamLocalizer(std::shared_ptr<StreamLocalizer> streamLocalizer){
         this->mStreamLocalizer = streamLocalizer;
+        attachSmoother();
     }
     
     std::shared_ptr<StreamLocalizer> VirtualDevice::streamLocalizer() const{
         return this->mStreamLocalizer;
     }
     
+    void VirtualDevice::smoother(FixedLagSmoother::Ptr smoother){
+        mSmoother = smoother;
+        attachSmoother();
+    }
+    
+    FixedLagSmoother::Ptr VirtualDevice::smoother() const{
+        return mSmoother;
+    }
+    
+    void VirtualDevice::attachSmoother(){
+        if(!mSmoother || !mStreamLocalizer){
+            return;
+        }
+        auto filter = std::dynamic_pointer_cast<StreamParticleFilter>(mStreamLocalizer);
+        if(filter){
+            filter->smoother(mSmoother);
+        }else{
+            std::cout << "Smoother is not supported by the stream localizer." << std::endl;
+        }
+    }
+    
+    void VirtualDevice::writeSmoothedLocations(){
+        if(!mSmoother){
+            return;
+        }
+        FixedLagSmoother::Estimate estimate;
+        while(mSmoother->next(estimate)){
+            auto iter = mTrueLocations.find(estimate.timestamp);
+            if(iter==mTrueLocations.end()){
+                continue;
+            }
+            const Location& locTrue = iter->second;
+            double dist2D = Location::distance2D(locTrue, estimate.mean);
+            std::cout << "Smooth, ts=" << estimate.timestamp << ",lag=" << estimate.lag << ",locSmoothed=" << estimate.mean
+            << ",locTrue=" << locTrue << ",d2D=" << dist2D << std::endl;
+            if(wasReset){
+                smoothedStream << locTrue << "," << estimate << std::endl;
+            }
+            mTrueLocations.erase(mTrueLocations.begin(), ++iter);
+        }
+    }
+    
     void VirtualDevice::resetLocalizer(){
         mStreamLocalizer->resetStatus();
     }
@@ -128,6 +172,9 @@ namespace loc{
                 Location locTrue = smp.location();
                 double dist2D = Location::distance2D(locTrue, *poseEst);
                 this->mCurrentError = dist2D;
+                if(mSmoother){
+                    mTrueLocations[beacons.timestamp()] = locTrue;
+                }
                 std::cout<< "Filt, ts=" << smp.timestamp() << ",poseEst=" << *poseEst
                 <<  ",locTrue=" << locTrue << ",d2D=" << dist2D <<std::endl;
                 if(wasReset){
@@ -147,6 +194,7 @@ namespace loc{
             }catch (std::invalid_argument e){
                 std::cout << "invalid sampleCSV was found." << std::endl;
             }
+            writeSmoothedLocations();
             count_putBeacons ++;
         }else if(DataUtils::csvCheckSensorType(strBuffer, "Reset")){
             Pose poseReset = DataUtils::parseResetPoseCSV(strBuffer);
@@ -184,11 +232,19 @@ namespace loc{
     }
     
     void VirtualDevice::close(){
+        if(mSmoother){
+            mSmoother->flush();
+            writeSmoothedLocations();
+        }
         if(mResultDir.size()>0){
             std::string path = mResultDir + "/result.csv";
             std::ofstream ofs(path);
             ofs << sstream.str();
             ofs.close();
+            if(mSmoother){
+                std::ofstream ofsSmoothed(mResultDir + "/smoothed.csv");
+                ofsSmoothed << smoothedStream.str();
+            }
         }else{
             std::cout << "Results were not saved."  << std::endl;
         }
@@ -30,10 +30,12 @@
 #include <stdexcept>
 #include <fstream>
 #include <time.h>
+#include <map>
 #include "bleloc.h"
 #include "StreamLocalizer.hpp"
 #include "DataUtils.hpp"
 #include "DataLogger.hpp"
+#include "FixedLagSmoother.hpp"
 
 namespace loc{
     
@@ -56,6 +58,12 @@ namespace loc{
         Pose stdevPose_;
         double mCurrentError = 0;
         
+        FixedLagSmoother::Ptr mSmoother;
+        std::map<long, Location> mTrueLocations; // true locations of beacon inputs waiting for smoothing
+        std::stringstream smoothedStream;
+        void attachSmoother();
+        void writeSmoothedLocations();
+        
     public:
         VirtualDevice() = default;
         
@@ -68,6 +76,10 @@ namespace loc{
         void resultDir(std::string resultDir);
         void streamLocalizer(std::shared_ptr<StreamLocalizer> streamLocalizer);
         std::shared_ptr<StreamLocalizer> streamLocalizer() const;
+        // Smoothed locations are compared with the true locations and saved to resultDir/smoothed.csv.
+        // The stream localizer must be a StreamParticleFilter.
+        void smoother(FixedLagSmoother::Ptr smoother);
+        FixedLagSmoother::Ptr smoother() const;
         void resetLocalizer();
         void checkTimestampConsistency(std::string str);
         void checkTimestampConsistency(long timestamp);
@@ -28,39 +28,55 @@ namespace loc{
     class Pose;
     
     template<class Tstate> std::vector<Tstate>* GridResampler<Tstate>::resample(const std::vector<Tstate>& states, const double weights[]){
+        return resample(states, weights, (int) states.size());
+    }
+    
+    template<class Tstate> std::vector<Tstate>* GridResampler<Tstate>::resample(const std::vector<Tstate>& states, const double weights[], int nResampled){
+        size_t n = states.size();
+        double sumWeights = 0;
+        for(size_t i=0; i<n; i++){
+            sumWeights += weights[i];
+        }
+        std::vector<int> ancestors;
+        sampleIndices(weights, n, sumWeights, nResampled, ancestors);
         
-        int n = (int) states.size();
         std::vector<Tstate>* statesResampled = new std::vector<Tstate>();
-        
-        double d = rand.nextDouble();
-        std::vector<double> grid(n);
-        
-        for (int k=0; k<n; k++){
-            if(gtype==STRATIFIED){
-                d = rand.nextDouble();
-            }
-            grid[k] = ((double)k + d)/((double)n);
+        statesResampled->reserve(ancestors.size());
+        for(int a: ancestors){
+            statesResampled->push_back(states[a]);
         }
-        
-        double cumWeight=0;
-        int k=0;
-        for(int i=0; i<n; i++){
-            int numSample = 0;
-            cumWeight += weights[i];
+        return statesResampled;
+    }
+    
+    template<class Tstate> void GridResampler<Tstate>::resample(const Particles& particles, const double weights[], double sumWeights, std::vector<int>& ancestors){
+        sampleIndices(weights, particles.size(), sumWeights, particles.size(), ancestors);
+    }
+    
+    template<class Tstate> void GridResampler<Tstate>::sampleIndices(const double weights[], size_t n, double sumWeights, size_t m, std::vector<int>& ancestors){
+        ancestors.resize(m);
+        if(n==0 || m==0){
+            ancestors.clear();
+            return;
+        }
+        // Grid points (k + d)/m are compared with cumulative weights scaled by m/sumWeights,
+        // so the weights are normalized in the same pass.
+        double scale = m/sumWeights;
+        double d = rand.nextDouble();
+        double cumWeight = 0;
+        size_t k = 0;
+        for(size_t i=0; i<n && k<m; i++){
+            cumWeight += weights[i]*scale;
             if(i==n-1){
-                cumWeight = 1.0;
+                cumWeight = (double) m;
             }
-            for( ; k<n; k++){
-                if(grid[k] < cumWeight){
-                    Tstate stateCopied(states.at(i));
-                    statesResampled->push_back(stateCopied);
-                    numSample++;
-                }else{
-                    break;
+            while(k<m && k + d < cumWeight){
+                ancestors[k] = (int) i;
+                k++;
+                if(gtype==STRATIFIED){
+                    d = rand.nextDouble();
                 }
             }
         }
-        return statesResampled;
     }
     
     // Explicit instantiation
@@ -68,4 +84,4 @@ namespace loc{
     template class GridResampler<Pose>;
     template class GridResampler<State>;
     
-}
\ No newline at end of file
+}
@@ -33,13 +33,21 @@ namespace loc{
     template<class Tstate> class GridResampler : public Resampler<Tstate>{
     
     public:
+        enum GridType{SYSTEMATIC, STRATIFIED};
+        
+        GridResampler(GridType type = SYSTEMATIC) : gtype(type){}
         ~GridResampler(){}
         
         std::vector<Tstate>* resample(const std::vector<Tstate>& states, const double weights[]);
+        // Draws nResampled states instead of states.size().
+        std::vector<Tstate>* resample(const std::vector<Tstate>& states, const double weights[], int nResampled);
+        void resample(const Particles& particles, const double weights[], double sumWeights, std::vector<int>& ancestors);
+        
+        // Draws m ancestor indices from n unnormalized weights in one pass over the weights.
+        virtual void sampleIndices(const double weights[], size_t n, double sumWeights, size_t m, std::vector<int>& ancestors);
     
-    private:
-        enum GridType{SYSTEMATIC, STRATIFIED};
-        GridType gtype = SYSTEMATIC;        
+    protected:
+        GridType gtype = SYSTEMATIC;
         RandomGenerator rand;
     };
 
@@ -0,0 +1,127 @@
+/*******************************************************************************
+ * Copyright (c) 2014, 2016  IBM Corporation and others
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *******************************************************************************/
+
+#include "KLDResampler.hpp"
+#include "MathUtils.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <unordered_set>
+
+namespace loc{
+    
+    template<class Tstate>
+    KLDResampler<Tstate>::KLDResampler(){
+        parameters(KLDResamplerParameters());
+    }
+    
+    template<class Tstate>
+    KLDResampler<Tstate>::KLDResampler(const KLDResamplerParameters& params){
+        parameters(params);
+    }
+    
+    template<class Tstate>
+    KLDResampler<Tstate>& KLDResampler<Tstate>::parameters(const KLDResamplerParameters& params){
+        mParams = params;
+        mQuantile = MathUtils::quantileNormalDistribution(1.0 - mParams.delta);
+        return *this;
+    }
+    
+    template<class Tstate>
+    const KLDResamplerParameters& KLDResampler<Tstate>::parameters() const{
+        return mParams;
+    }
+    
+    template<class Tstate>
+    int KLDResampler<Tstate>::boundNumberOfStates(int k) const{
+        if(k<=1){
+            return mParams.minStates;
+        }
+        // Wilson-Hilferty approximation of the chi-squared quantile
+        double a = 2.0/(9.0*(k-1));
+        double b = 1.0 - a + std::sqrt(a)*mQuantile;
+        double n = (k-1)/(2.0*mParams.epsilon)*b*b*b;
+        return (int) std::ceil(n);
+    }
+    
+    template<class Tstate>
+    int64_t KLDResampler<Tstate>::binKey(double x, double y, double floor) const{
+        int64_t ix = (int64_t) std::floor(x/mParams.binSize);
+        int64_t iy = (int64_t) std::floor(y/mParams.binSize);
+        int64_t ifloor = (int64_t) std::round(floor);
+        // Shift unsigned values; left-shifting a negative value is undefined.
+        uint64_t key = ((uint64_t) ifloor << 48) ^ (((uint64_t) ix & 0xFFFFFF) << 24) ^ ((uint64_t) iy & 0xFFFFFF);
+        return (int64_t) key;
+    }
+    
+    template<class Tstate>
+    template<class TbinOf>
+    int KLDResampler<Tstate>::numberOfStates(const TbinOf& binOf, const double weights[], size_t n){
+        mCumWeights.resize(n);
+        double cumWeight = 0;
+        for(size_t i=0; i<n; i++){
+            cumWeight += weights[i];
+            mCumWeights[i] = cumWeight;
+        }
+        
+        // Only bins of drawn states are counted. States are drawn later by the grid resampler.
+        std::unordered_set<int64_t> bins;
+        int nMax = std::max(mParams.minStates, mParams.maxStates);
+        int nRequired = mParams.minStates;
+        int m = 0;
+        for( ; m<nRequired && m<nMax; m++){
+            double u = this->rand.nextDouble()*cumWeight;
+            size_t i = std::lower_bound(mCumWeights.begin(), mCumWeights.end(), u) - mCumWeights.begin();
+            i = std::min(i, n-1);
+            if(bins.insert(binOf(i)).second){
+                nRequired = std::max(mParams.minStates, boundNumberOfStates((int) bins.size()));
+            }
+        }
+        return m;
+    }
+    
+    template<class Tstate>
+    std::vector<Tstate>* KLDResampler<Tstate>::resample(const std::vector<Tstate>& states, const double weights[]){
+        int m = numberOfStates([&](size_t i){
+            const Tstate& s = states[i];
+            return binKey(s.x(), s.y(), s.floor());
+        }, weights, states.size());
+        return GridResampler<Tstate>::resample(states, weights, m);
+    }
+    
+    template<class Tstate>
+    void KLDResampler<Tstate>::resample(const Particles& particles, const double weights[], double sumWeights, std::vector<int>& ancestors){
+        const double* x = particles.x();
+        const double* y = particles.y();
+        const double* floor = particles.floor();
+        int m = numberOfStates([&](size_t i){
+            return binKey(x[i], y[i], floor[i]);
+        }, weights, particles.size());
+        this->sampleIndices(weights, particles.size(), sumWeights, m, ancestors);
+    }
+    
+    // Explicit instantiation
+    template class KLDResampler<Location>;
+    template class KLDResampler<Pose>;
+    template class KLDResampler<State>;
+    
+}
@@ -0,0 +1,76 @@
+/*******************************************************************************
+ * Copyright (c) 2014, 2016  IBM Corporation and others
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *******************************************************************************/
+
+#ifndef KLDResampler_hpp
+#define KLDResampler_hpp
+
+#include <stdio.h>
+#include "bleloc.h"
+#include "GridResampler.hpp"
+
+namespace loc{
+    
+    class KLDResamplerParameters{
+    public:
+        int minStates = 100;
+        int maxStates = 1000;
+        double binSize = 1.0; // [m] size of spatial bins on each floor
+        double epsilon = 0.05; // bound of the KL divergence between the sample-based and the true posterior
+        double delta = 0.01; // the bound holds with probability 1-delta
+    };
+    
+    /**
+     Adaptive resampler based on KLD-sampling (Fox, 2003).
+     The number of resampled states is chosen from the number of (floor, x, y) bins occupied
+     by draws from the weighted states, then states are drawn with the grid resampler.
+     **/
+    template<class Tstate> class KLDResampler : public GridResampler<Tstate>{
+    public:
+        using Ptr = std::shared_ptr<KLDResampler<Tstate>>;
+        
+        KLDResampler();
+        KLDResampler(const KLDResamplerParameters& params);
+        ~KLDResampler(){}
+        
+        KLDResampler& parameters(const KLDResamplerParameters& params);
+        const KLDResamplerParameters& parameters() const;
+        
+        using GridResampler<Tstate>::resample;
+        std::vector<Tstate>* resample(const std::vector<Tstate>& states, const double weights[]) override;
+        void resample(const Particles& particles, const double weights[], double sumWeights, std::vector<int>& ancestors) override;
+        
+        // The number of states required for k occupied bins
+        int boundNumberOfStates(int k) const;
+        
+    private:
+        KLDResamplerParameters mParams;
+        double mQuantile; // upper 1-delta quantile of the standard normal distribution
+        std::vector<double> mCumWeights;
+        
+        int64_t binKey(double x, double y, double floor) const;
+        template<class TbinOf>
+        int numberOfStates(const TbinOf& binOf, const double weights[], size_t n);
+    };
+    
+}
+
+#endif /* KLDResampler_hpp */
@@ -24,7 +24,9 @@
 #define Resampler_hpp
 
 #include <stdio.h>
+#include <vector>
 #include "bleloc.h"
+#include "Particles.hpp"
 
 namespace loc{
     
@@ -32,6 +34,10 @@ namespace loc{
     public:
         virtual ~Resampler(){}
         virtual std::vector<Tstate>* resample(const std::vector<Tstate> & states, const double weights[]) = 0;
+        // Writes the ancestor index of each resampled particle to ancestors (resized to the number of resampled particles).
+        // weights are not required to be normalized; sumWeights is their sum.
+        // Apply the result with Particles::select.
+        virtual void resample(const Particles& particles, const double weights[], double sumWeights, std::vector<int>& ancestors) = 0;
     };
     
 }
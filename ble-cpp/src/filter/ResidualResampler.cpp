@@ -0,0 +1,54 @@
+/*******************************************************************************
+ * Copyright (c) 2014, 2016  IBM Corporation and others
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *******************************************************************************/
+
+#include "ResidualResampler.hpp"
+#include <cmath>
+
+namespace loc{
+    
+    template<class Tstate> void ResidualResampler<Tstate>::sampleIndices(const double weights[], size_t n, double sumWeights, size_t m, std::vector<int>& ancestors){
+        ancestors.resize(m);
+        mResiduals.resize(n);
+        double scale = m/sumWeights;
+        double sumResiduals = 0;
+        size_t k = 0;
+        for(size_t i=0; i<n; i++){
+            double x = weights[i]*scale;
+            size_t c = (size_t) std::floor(x);
+            for(size_t j=0; j<c && k<m; j++){
+                ancestors[k++] = (int) i;
+            }
+            mResiduals[i] = x - c;
+            sumResiduals += mResiduals[i];
+        }
+        if(k<m){
+            GridResampler<Tstate>::sampleIndices(mResiduals.data(), n, sumResiduals, m-k, mResidualAncestors);
+            std::copy(mResidualAncestors.begin(), mResidualAncestors.end(), ancestors.begin()+k);
+        }
+    }
+    
+    // Explicit instantiation
+    template class ResidualResampler<Location>;
+    template class ResidualResampler<Pose>;
+    template class ResidualResampler<State>;
+    
+}
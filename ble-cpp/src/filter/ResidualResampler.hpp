@@ -0,0 +1,47 @@
+/*******************************************************************************
+ * Copyright (c) 2014, 2016  IBM Corporation and others
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *******************************************************************************/
+
+#ifndef ResidualResampler_hpp
+#define ResidualResampler_hpp
+
+#include <stdio.h>
+#include "bleloc.h"
+#include "GridResampler.hpp"
+
+namespace loc{
+    
+    // Residual resampling: each state is copied floor(m*w) times and the rest are drawn from the residual weights.
+    template<class Tstate> class ResidualResampler : public GridResampler<Tstate>{
+    public:
+        ResidualResampler(typename GridResampler<Tstate>::GridType type = GridResampler<Tstate>::SYSTEMATIC) : GridResampler<Tstate>(type){}
+        ~ResidualResampler(){}
+        
+        void sampleIndices(const double weights[], size_t n, double sumWeights, size_t m, std::vector<int>& ancestors) override;
+        
+    private:
+        std::vector<double> mResiduals;
+        std::vector<int> mResidualAncestors;
+    };
+    
+}
+
+#endif /* ResidualResampler_hpp */
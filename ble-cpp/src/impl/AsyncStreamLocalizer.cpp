@@ -0,0 +1,512 @@
+/*******************************************************************************
+ * Copyright (c) 2014, 2016  IBM Corporation and others
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *******************************************************************************/
+
+#include "AsyncStreamLocalizer.hpp"
+#include "SensorEvent.hpp"
+#include "LocException.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <functional>
+#include <limits>
+#include <map>
+#include <mutex>
+#include <queue>
+#include <thread>
+
+namespace loc {
+    
+    namespace{
+        // Bounded multi-producer multi-consumer queue (Vyukov's algorithm).
+        // Producers pop as well when the oldest event is dropped.
+        class SensorEventQueue{
+            struct Cell{
+                std::atomic<size_t> sequence;
+                SensorEvent event;
+            };
+            std::unique_ptr<Cell[]> mCells;
+            size_t mMask;
+            // Padding keeps the positions on different cache lines without over-aligned allocation.
+            char mPadding0[64];
+            std::atomic<size_t> mEnqueuePos;
+            char mPadding1[64];
+            std::atomic<size_t> mDequeuePos;
+            
+        public:
+            SensorEventQueue(size_t capacity){
+                size_t n = 2;
+                while(n < capacity){
+                    n <<= 1;
+                }
+                mCells.reset(new Cell[n]);
+                mMask = n - 1;
+                for(size_t i=0; i<n; i++){
+                    mCells[i].sequence.store(i, std::memory_order_relaxed);
+                }
+                mEnqueuePos.store(0, std::memory_order_relaxed);
+                mDequeuePos.store(0, std::memory_order_relaxed);
+            }
+            
+            size_t capacity() const{
+                return mMask + 1;
+            }
+            
+            // event is moved only when it is pushed
+            bool tryPush(SensorEvent& event){
+                size_t pos = mEnqueuePos.load(std::memory_order_relaxed);
+                while(true){
+                    Cell& cell = mCells[pos & mMask];
+                    size_t seq = cell.sequence.load(std::memory_order_acquire);
+                    intptr_t dif = static_cast<intptr_t>(seq) - static_cast<intptr_t>(pos);
+                    if(dif == 0){
+                        if(mEnqueuePos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)){
+                            cell.event = std::move(event);
+                            cell.sequence.store(pos + 1, std::memory_order_release);
+                            return true;
+                        }
+                    }else if(dif < 0){
+                        return false;
+                    }else{
+                        pos = mEnqueuePos.load(std::memory_order_relaxed);
+                    }
+                }
+            }
+            
+            bool tryPop(SensorEvent& event){
+                size_t pos = mDequeuePos.load(std::memory_order_relaxed);
+                while(true){
+                    Cell& cell = mCells[pos & mMask];
+                    size_t seq = cell.sequence.load(std::memory_order_acquire);
+                    intptr_t dif = static_cast<intptr_t>(seq) - static_cast<intptr_t>(pos + 1);
+                    if(dif == 0){
+                        if(mDequeuePos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)){
+                            event = std::move(cell.event);
+                            cell.sequence.store(pos + mMask + 1, std::memory_order_release);
+                            return true;
+                        }
+                    }else if(dif < 0){
+                        return false;
+                    }else{
+                        pos = mDequeuePos.load(std::memory_order_relaxed);
+                    }
+                }
+            }
+            
+            bool empty() const{
+                size_t pos = mDequeuePos.load(std::memory_order_relaxed);
+                const Cell& cell = mCells[pos & mMask];
+                return cell.sequence.load(std::memory_order_acquire) != pos + 1;
+            }
+        };
+    }
+    
+    class AsyncStreamLocalizer::Impl{
+        std::shared_ptr<StreamLocalizer> mLocalizer;
+        AsyncStreamLocalizerParameters mParams;
+        SensorEventQueue mQueue;
+        
+        // Events pushed while the queue is full (COALESCE)
+        std::mutex mOverflowMutex;
+        SensorEvent mOverflow[SensorEvent::N_TYPES];
+        bool mHasOverflowOf[SensorEvent::N_TYPES] = {};
+        std::atomic<bool> mHasOverflow{false};
+        
+        std::thread mWorker;
+        std::mutex mWakeMutex;
+        std::condition_variable mWakeCv;  // worker waits for events
+        std::condition_variable mSpaceCv; // producers wait for free slots (BLOCK)
+        std::condition_variable mFlushCv; // flush waits for processed events
+        std::atomic<bool> mSleeping{false};
+        std::atomic<bool> mStop{false};
+        std::atomic<int> mBlockedProducers{0};
+        std::atomic<int> mFlushing{0}; // the number of flush calls waiting for held events
+        
+        // Held while events are fed to the wrapped localizer
+        std::mutex mProcessMutex;
+        
+        std::atomic<uint64_t> mSequence{0}; // the number of pushed events
+        // Events are retired (processed, dropped or coalesced) out of sequence order.
+        // All events with sequence < mRetiredWatermark have been retired. Guarded by mWakeMutex.
+        uint64_t mRetiredWatermark = 0;
+        std::priority_queue<uint64_t, std::vector<uint64_t>, std::greater<uint64_t>> mRetiredAhead;
+        std::vector<uint64_t> mRetiredBatch; // sequences retired by the worker in the current batch
+        
+        // Status copies returned by getStatus, one per calling thread
+        std::mutex mSnapshotMutex;
+        std::map<std::thread::id, std::unique_ptr<Status>> mStatusSnapshots;
+        
+        std::atomic<uint64_t> mProcessed{0};
+        std::atomic<uint64_t> mDropped{0};
+        std::atomic<uint64_t> mCoalesced{0};
+        std::atomic<uint64_t> mFailed{0};
+        
+        void wakeWorker(){
+            std::atomic_thread_fence(std::memory_order_seq_cst);
+            if(mSleeping.load(std::memory_order_relaxed)){
+                std::lock_guard<std::mutex> lock(mWakeMutex);
+                mWakeCv.notify_one();
+            }
+        }
+        
+        bool onWorkerThread() const{
+            return std::this_thread::get_id() == mWorker.get_id();
+        }
+        
+        // Must be called with mWakeMutex held
+        void retireLocked(uint64_t sequence){
+            mRetiredAhead.push(sequence);
+            while(!mRetiredAhead.empty() && mRetiredAhead.top()==mRetiredWatermark){
+                mRetiredAhead.pop();
+                mRetiredWatermark++;
+            }
+        }
+        
+        void retire(uint64_t sequence){
+            std::lock_guard<std::mutex> lock(mWakeMutex);
+            retireLocked(sequence);
+            mFlushCv.notify_all();
+        }
+        
+        void process(const SensorEvent& ev){
+            try{
+                ev.dispatch(*mLocalizer);
+            }catch(const std::exception& e){
+                mFailed++;
+                std::cerr << "AsyncStreamLocalizer: " << e.what() << std::endl;
+            }catch(const std::string& str){
+                mFailed++;
+                std::cerr << "AsyncStreamLocalizer: " << str << std::endl;
+            }catch(const char* ch){
+                mFailed++;
+                std::cerr << "AsyncStreamLocalizer: " << ch << std::endl;
+            }catch(...){
+                mFailed++;
+                std::cerr << "AsyncStreamLocalizer: unknown exception" << std::endl;
+            }
+            mProcessed++;
+            mRetiredBatch.push_back(ev.sequence);
+        }
+        
+        void run(){
+            std::vector<SensorEvent> batch;
+            batch.reserve(mQueue.capacity() + SensorEvent::N_TYPES);
+            // Events held for reordering. A min-heap by timestamp (and order of pushing).
+            std::vector<SensorEvent> held;
+            auto later = [](const SensorEvent& a, const SensorEvent& b){
+                return b < a;
+            };
+            long newestTimestamp = std::numeric_limits<long>::min();
+            bool timedOut = false;
+            SensorEvent ev;
+            while(true){
+                batch.clear();
+                while(batch.size() < mQueue.capacity() && mQueue.tryPop(ev)){
+                    batch.push_back(std::move(ev));
+                }
+                if(mHasOverflow.load(std::memory_order_acquire)){
+                    std::lock_guard<std::mutex> lock(mOverflowMutex);
+                    for(int t=0; t<SensorEvent::N_TYPES; t++){
+                        if(mHasOverflowOf[t]){
+                            batch.push_back(std::move(mOverflow[t]));
+                            mHasOverflowOf[t] = false;
+                        }
+                    }
+                    mHasOverflow.store(false, std::memory_order_release);
+                }
+                if(0 < mBlockedProducers.load()){
+                    std::lock_guard<std::mutex> lock(mWakeMutex);
+                    mSpaceCv.notify_all();
+                }
+                
+                // Events from different sensor threads may be pushed out of order. They are held until an event
+                // reorderWindow newer arrives and are released in timestamp order.
+                for(SensorEvent& e: batch){
+                    newestTimestamp = std::max(newestTimestamp, e.timestamp);
+                    held.push_back(std::move(e));
+                    std::push_heap(held.begin(), held.end(), later);
+                }
+                batch.clear();
+                bool releasesAll = timedOut || mStop.load() || 0 < mFlushing.load();
+                timedOut = false;
+                while(!held.empty() && (releasesAll || held.size() > mQueue.capacity()
+                                        || held.front().timestamp <= newestTimestamp - mParams.reorderWindow)){
+                    std::pop_heap(held.begin(), held.end(), later);
+                    batch.push_back(std::move(held.back()));
+                    held.pop_back();
+                }
+                
+                if(batch.empty()){
+                    if(mStop.load() && held.empty()){
+                        break;
+                    }
+                    std::unique_lock<std::mutex> lock(mWakeMutex);
+                    mSleeping.store(true, std::memory_order_relaxed);
+                    std::atomic_thread_fence(std::memory_order_seq_cst);
+                    if(held.empty()){
+                        mWakeCv.wait(lock, [this]{
+                            return !mQueue.empty() || mHasOverflow.load() || mStop.load();
+                        });
+                    }else{
+                        timedOut = !mWakeCv.wait_for(lock, std::chrono::milliseconds(mParams.reorderWindow), [this]{
+                            return !mQueue.empty() || mHasOverflow.load() || mStop.load() || 0 < mFlushing.load();
+                        });
+                    }
+                    mSleeping.store(false, std::memory_order_relaxed);
+                    continue;
+                }
+                
+                {
+                    std::lock_guard<std::mutex> lock(mProcessMutex);
+                    for(const SensorEvent& e: batch){
+                        process(e);
+                    }
+                }
+                {
+                    std::lock_guard<std::mutex> lock(mWakeMutex);
+                    for(uint64_t sequence: mRetiredBatch){
+                        retireLocked(sequence);
+                    }
+                    mFlushCv.notify_all();
+                }
+                mRetiredBatch.clear();
+            }
+        }
+        
+    public:
+        Impl(std::shared_ptr<StreamLocalizer> localizer, const AsyncStreamLocalizerParameters& params)
+        : mLocalizer(localizer), mParams(params), mQueue(params.queueCapacity){
+            if(!mLocalizer){
+                BOOST_THROW_EXCEPTION(LocException("localizer is null"));
+            }
+            mWorker = std::thread(&Impl::run, this);
+        }
+        
+        ~Impl(){
+            // Remaining events are processed before the worker exits.
+            mStop.store(true);
+            {
+                std::lock_guard<std::mutex> lock(mWakeMutex);
+                mWakeCv.notify_one();
+            }
+            mWorker.join();
+        }
+        
+        void push(SensorEvent& ev){
+            ev.sequence = mSequence.fetch_add(1);
+            if(!mQueue.tryPush(ev)){
+                if(mParams.policy == BLOCK){
+                    mBlockedProducers++;
+                    while(!mQueue.tryPush(ev)){
+                        wakeWorker();
+                        std::unique_lock<std::mutex> lock(mWakeMutex);
+                        mSpaceCv.wait_for(lock, std::chrono::milliseconds(1));
+                    }
+                    mBlockedProducers--;
+                }else if(mParams.policy == DROP_OLDEST){
+                    SensorEvent oldest;
+                    while(!mQueue.tryPush(ev)){
+                        if(mQueue.tryPop(oldest)){
+                            mDropped++;
+                            retire(oldest.sequence);
+                        }
+                    }
+                }else if(mParams.policy == COALESCE){
+                    // ev is moved from below.
+                    const SensorEvent::Type type = ev.type;
+                    std::lock_guard<std::mutex> lock(mOverflowMutex);
+                    if(mHasOverflowOf[type]){
+                        mCoalesced++;
+                        retire(mOverflow[type].sequence);
+                    }
+                    mOverflow[type] = std::move(ev);
+                    mHasOverflowOf[type] = true;
+                    mHasOverflow.store(true, std::memory_order_release);
+                }
+            }
+            wakeWorker();
+        }
+        
+        void flush(){
+            if(onWorkerThread()){
+                return;
+            }
+            uint64_t target = mSequence.load();
+            // Held events are released while flush is waiting.
+            mFlushing++;
+            {
+                std::lock_guard<std::mutex> lock(mWakeMutex);
+                mWakeCv.notify_one();
+            }
+            {
+                std::unique_lock<std::mutex> lock(mWakeMutex);
+                mFlushCv.wait(lock, [this, target]{
+                    return target <= mRetiredWatermark;
+                });
+            }
+            mFlushing--;
+        }
+        
+        // Runs func with the wrapped localizer after queued events are processed.
+        template<class Tfunc>
+        auto synchronized(Tfunc func) -> decltype(func(*mLocalizer)){
+            if(onWorkerThread()){ // called from an update handler
+                return func(*mLocalizer);
+            }
+            flush();
+            std::lock_guard<std::mutex> lock(mProcessMutex);
+            return func(*mLocalizer);
+        }
+        
+        // The status is copied while the worker does not update it.
+        Status* statusSnapshot(){
+            if(onWorkerThread()){ // called from an update handler
+                return mLocalizer->getStatus();
+            }
+            std::unique_ptr<Status> status = synchronized([](StreamLocalizer& localizer){
+                Status* current = localizer.getStatus();
+                return std::unique_ptr<Status>(current ? new Status(*current) : nullptr);
+            });
+            std::lock_guard<std::mutex> lock(mSnapshotMutex);
+            std::unique_ptr<Status>& snapshot = mStatusSnapshots[std::this_thread::get_id()];
+            snapshot = std::move(status);
+            return snapshot.get();
+        }
+        
+        AsyncStreamLocalizerStatistics statistics() const{
+            AsyncStreamLocalizerStatistics stats;
+            stats.pushed = mSequence.load();
+            stats.processed = mProcessed.load();
+            stats.dropped = mDropped.load();
+            stats.coalesced = mCoalesced.load();
+            stats.failed = mFailed.load();
+            return stats;
+        }
+        
+        std::shared_ptr<StreamLocalizer> localizer() const{
+            return mLocalizer;
+        }
+    };
+    
+    AsyncStreamLocalizer::AsyncStreamLocalizer(std::shared_ptr<StreamLocalizer> localizer, const AsyncStreamLocalizerParameters& params){
+        impl.reset(new Impl(localizer, params));
+    }
+    
+    AsyncStreamLocalizer::~AsyncStreamLocalizer(){}
+    
+    AsyncStreamLocalizer& AsyncStreamLocalizer::updateHandler(void (*functionCalledAfterUpdate)(Status*)){
+        impl->synchronized([&](StreamLocalizer& localizer){
+            localizer.updateHandler(functionCalledAfterUpdate);
+        });
+        return *this;
+    }
+    
+    AsyncStreamLocalizer& AsyncStreamLocalizer::updateHandler(void (*functionCalledAfterUpdate)(void*, Status*), void* inUserData){
+        impl->synchronized([&](StreamLocalizer& localizer){
+            localizer.updateHandler(functionCalledAfterUpdate, inUserData);
+        });
+        return *this;
+    }
+    
+    AsyncStreamLocalizer& AsyncStreamLocalizer::putAcceleration(const Acceleration acceleration){
+        SensorEvent ev(acceleration);
+        impl->push(ev);
+        return *this;
+    }
+    
+    AsyncStreamLocalizer& AsyncStreamLocalizer::putAttitude(const Attitude attitude){
+        SensorEvent ev(attitude);
+        impl->push(ev);
+        return *this;
+    }
+    
+    AsyncStreamLocalizer& AsyncStreamLocalizer::putBeacons(const Beacons beacons){
+        SensorEvent ev(beacons);
+        impl->push(ev);
+        return *this;
+    }
+    
+    AsyncStreamLocalizer& AsyncStreamLocalizer::putLocalHeading(const LocalHeading heading){
+        SensorEvent ev(heading);
+        impl->push(ev);
+        return *this;
+    }
+    
+    AsyncStreamLocalizer& AsyncStreamLocalizer::putAltimeter(const Altimeter altimeter){
+        SensorEvent ev(altimeter);
+        impl->push(ev);
+        return *this;
+    }
+    
+    Status* AsyncStreamLocalizer::getStatus(){
+        return impl->statusSnapshot();
+    }
+    
+    bool AsyncStreamLocalizer::resetStatus(){
+        return impl->synchronized([&](StreamLocalizer& localizer){
+            return localizer.resetStatus();
+        });
+    }
+    
+    bool AsyncStreamLocalizer::resetStatus(Pose pose){
+        return impl->synchronized([&](StreamLocalizer& localizer){
+            return localizer.resetStatus(pose);
+        });
+    }
+    
+    bool AsyncStreamLocalizer::resetStatus(Pose meanPose, Pose stdevPose){
+        return impl->synchronized([&](StreamLocalizer& localizer){
+            return localizer.resetStatus(meanPose, stdevPose);
+        });
+    }
+    
+    bool AsyncStreamLocalizer::resetStatus(Pose meanPose, Pose stdevPose, double rateContami){
+        return impl->synchronized([&](StreamLocalizer& localizer){
+            return localizer.resetStatus(meanPose, stdevPose, rateContami);
+        });
+    }
+    
+    bool AsyncStreamLocalizer::resetStatus(const Beacons& beacons){
+        return impl->synchronized([&](StreamLocalizer& localizer){
+            return localizer.resetStatus(beacons);
+        });
+    }
+    
+    bool AsyncStreamLocalizer::resetStatus(const Location& location, const Beacons& beacons){
+        return impl->synchronized([&](StreamLocalizer& localizer){
+            return localizer.resetStatus(location, beacons);
+        });
+    }
+    
+    void AsyncStreamLocalizer::flush(){
+        impl->flush();
+    }
+    
+    AsyncStreamLocalizerStatistics AsyncStreamLocalizer::statistics() const{
+        return impl->statistics();
+    }
+    
+    std::shared_ptr<StreamLocalizer> AsyncStreamLocalizer::localizer() const{
+        return impl->localizer();
+    }
+}
@@ -0,0 +1,107 @@
+/*******************************************************************************
+ * Copyright (c) 2014, 2016  IBM Corporation and others
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *******************************************************************************/
+
+#ifndef AsyncStreamLocalizer_hpp
+#define AsyncStreamLocalizer_hpp
+
+#include <stdio.h>
+#include <cstdint>
+#include <memory>
+#include "bleloc.h"
+#include "StreamLocalizer.hpp"
+
+namespace loc {
+    
+    // Behavior of put* functions when the queue is full
+    enum BackpressurePolicy{
+        BLOCK,       // wait until the worker frees a slot
+        DROP_OLDEST, // discard the oldest queued event
+        COALESCE     // keep only the newest overflowed event of each sensor type
+    };
+    
+    class AsyncStreamLocalizerParameters{
+    public:
+        size_t queueCapacity = 1024; // rounded up to a power of two
+        BackpressurePolicy policy = BLOCK;
+        // [ms] Events are held until an event reorderWindow newer is pushed, so that events pushed out of order
+        // within the window are processed in timestamp order. Held events are also released by flush and after
+        // reorderWindow of wall time without newer events. At most queueCapacity events are held. 0: no holding.
+        long reorderWindow = 50;
+    };
+    
+    class AsyncStreamLocalizerStatistics{
+    public:
+        uint64_t pushed = 0;
+        uint64_t processed = 0;
+        uint64_t dropped = 0;
+        uint64_t coalesced = 0;
+        uint64_t failed = 0; // events which threw exceptions in the wrapped localizer
+    };
+    
+    /**
+     Asynchronous front end of a StreamLocalizer.
+     
+     put* functions push timestamped events into a bounded lock-free queue and return immediately.
+     A worker thread feeds them to the wrapped localizer, so update handlers
+     registered to the wrapped localizer are called on the worker thread.
+     The worker reorders events by timestamp within a bounded window (see AsyncStreamLocalizerParameters::reorderWindow).
+     An event arriving later than the window is processed when it arrives, after newer events.
+     getStatus and resetStatus wait until queued events are processed.
+     getStatus returns a copy of the status owned by this object, which is valid until the next
+     getStatus call on the same thread (update handlers get the status of the wrapped localizer).
+     **/
+    class AsyncStreamLocalizer : public StreamLocalizer{
+    public:
+        using Ptr = std::shared_ptr<AsyncStreamLocalizer>;
+        
+        AsyncStreamLocalizer(std::shared_ptr<StreamLocalizer> localizer, const AsyncStreamLocalizerParameters& params = AsyncStreamLocalizerParameters());
+        ~AsyncStreamLocalizer();
+        
+        AsyncStreamLocalizer& updateHandler(void (*functionCalledAfterUpdate)(Status*)) override;
+        AsyncStreamLocalizer& updateHandler(void (*functionCalledAfterUpdate)(void*, Status*), void* inUserData) override;
+        
+        AsyncStreamLocalizer& putAcceleration(const Acceleration acceleration) override;
+        AsyncStreamLocalizer& putAttitude(const Attitude attitude) override;
+        AsyncStreamLocalizer& putBeacons(const Beacons beacons) override;
+        AsyncStreamLocalizer& putLocalHeading(const LocalHeading heading) override;
+        AsyncStreamLocalizer& putAltimeter(const Altimeter altimeter) override;
+        Status* getStatus() override;
+        
+        bool resetStatus() override;
+        bool resetStatus(Pose pose) override;
+        bool resetStatus(Pose meanPose, Pose stdevPose) override;
+        bool resetStatus(Pose meanPose, Pose stdevPose, double rateContami) override;
+        bool resetStatus(const Beacons& beacons) override;
+        bool resetStatus(const Location& location, const Beacons& beacons) override;
+        
+        // Blocks until all events pushed before this call have been processed.
+        void flush();
+        AsyncStreamLocalizerStatistics statistics() const;
+        std::shared_ptr<StreamLocalizer> localizer() const;
+        
+    private:
+        class Impl;
+        std::shared_ptr<Impl> impl;
+    };
+}
+
+#endif /* AsyncStreamLocalizer_hpp */
@@ -0,0 +1,233 @@
+/*******************************************************************************
+ * Copyright (c) 2014, 2016  IBM Corporation and others
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *******************************************************************************/
+
+
+#include "SegmentedBatchLocalizer.hpp"
+#include "ThreadPool.hpp"
+#include "LocException.hpp"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+
+namespace loc {
+    
+    namespace{
+        struct SplitPoint{
+            long timestamp;
+            long warmUpEnd; // warm-up of the next segment is taken before this (the start of a beacon gap)
+            std::string reason;
+        };
+        
+        struct SegmentRun{
+            const SegmentedBatchLocalizer::Segment* segment;
+            size_t index;
+            std::vector<TrajectoryPoint> points;
+        };
+        
+        void functionCalledAfterUpdate(void* userData, Status* status){
+            SegmentRun* run = (SegmentRun*) userData;
+            long timestamp = status->timestamp();
+            if(status->step()==Status::OTHER || timestamp < run->segment->start || run->segment->end <= timestamp){
+                return;
+            }
+            auto meanPose = status->meanPose();
+            if(!meanPose){
+                return;
+            }
+            TrajectoryPoint point;
+            point.timestamp = timestamp;
+            point.segment = run->index;
+            point.step = status->step();
+            point.locationStatus = status->locationStatus();
+            point.pose = *meanPose;
+            run->points.push_back(point);
+        }
+        
+        // Stationary periods found from the standard deviation of the acceleration norm in windows
+        void findStationarySplitPoints(const std::vector<SensorEvent>& events, const SegmentedBatchLocalizerParameters& params, std::vector<SplitPoint>& points){
+            long periodStart = -1, periodEnd = -1;
+            long windowStart = -1;
+            double sum = 0, sum2 = 0;
+            size_t n = 0;
+            auto closePeriod = [&](){
+                if(0<=periodStart && params.minStationaryDuration <= periodEnd - periodStart){
+                    long timestamp = (periodStart + periodEnd)/2;
+                    points.push_back(SplitPoint{timestamp, timestamp, "stationary"});
+                }
+                periodStart = periodEnd = -1;
+            };
+            auto closeWindow = [&](){
+                if(2<=n){
+                    double mean = sum/n;
+                    double stdev = std::sqrt(std::max(sum2/n - mean*mean, 0.0));
+                    long windowEnd = windowStart + params.stationaryWindow;
+                    if(stdev < params.stationaryAccelerationStdev){
+                        if(periodEnd < windowStart){
+                            closePeriod();
+                            periodStart = windowStart;
+                        }
+                        periodEnd = windowEnd;
+                    }else{
+                        closePeriod();
+                    }
+                }
+                sum = sum2 = 0;
+                n = 0;
+            };
+            for(const auto& e: events){
+                if(e.type!=SensorEvent::ACCELERATION){
+                    continue;
+                }
+                if(windowStart < 0 || windowStart + params.stationaryWindow <= e.timestamp){
+                    if(0<=windowStart){
+                        closeWindow();
+                    }
+                    windowStart = e.timestamp;
+                }
+                double norm = std::sqrt(e.values[0]*e.values[0] + e.values[1]*e.values[1] + e.values[2]*e.values[2]);
+                sum += norm;
+                sum2 += norm*norm;
+                n++;
+            }
+            if(0<=windowStart){
+                closeWindow();
+            }
+            closePeriod();
+        }
+        
+        void findBeaconGapSplitPoints(const std::vector<SensorEvent>& events, const SegmentedBatchLocalizerParameters& params, std::vector<SplitPoint>& points){
+            long previous = -1;
+            for(const auto& e: events){
+                if(e.type!=SensorEvent::BEACONS){
+                    continue;
+                }
+                if(0<=previous && params.maxBeaconGap < e.timestamp - previous){
+                    points.push_back(SplitPoint{e.timestamp, previous, "beacon_gap"});
+                }
+                previous = e.timestamp;
+            }
+        }
+    }
+    
+    SegmentedBatchLocalizer::SegmentedBatchLocalizer(Factory factory, const SegmentedBatchLocalizerParameters& params)
+    : mFactory(factory), mParams(params){
+        if(!mFactory){
+            BOOST_THROW_EXCEPTION(LocException("localizer factory is not set"));
+        }
+    }
+    
+    std::vector<SegmentedBatchLocalizer::Segment> SegmentedBatchLocalizer::split(const std::vector<SensorEvent>& events) const{
+        std::vector<Segment> segments;
+        if(events.empty()){
+            return segments;
+        }
+        long first = events.front().timestamp;
+        long last = events.back().timestamp + 1;
+        
+        std::vector<SplitPoint> points;
+        if(0<mParams.maxBeaconGap){
+            findBeaconGapSplitPoints(events, mParams, points);
+        }
+        if(0<mParams.minStationaryDuration && 0<mParams.stationaryWindow){
+            findStationarySplitPoints(events, mParams, points);
+        }
+        std::stable_sort(points.begin(), points.end(), [](const SplitPoint& a, const SplitPoint& b){
+            return a.timestamp < b.timestamp;
+        });
+        
+        Segment segment;
+        segment.start = first;
+        segment.warmUpStart = first;
+        segment.reason = "begin";
+        for(const auto& p: points){
+            if(p.timestamp - segment.start < mParams.minSegmentDuration || last - p.timestamp < mParams.minSegmentDuration){
+                continue;
+            }
+            segment.end = p.timestamp;
+            segments.push_back(segment);
+            segment = Segment();
+            segment.start = p.timestamp;
+            segment.warmUpStart = std::max(first, p.warmUpEnd - mParams.warmUpDuration);
+            segment.reason = p.reason;
+        }
+        segment.end = last;
+        segments.push_back(segment);
+        return segments;
+    }
+    
+    std::vector<TrajectoryPoint> SegmentedBatchLocalizer::localize(std::vector<SensorEvent> events){
+        for(size_t i=0; i<events.size(); i++){
+            events[i].sequence = i;
+        }
+        std::sort(events.begin(), events.end());
+        mSegments = split(events);
+        
+        std::vector<std::vector<TrajectoryPoint>> results(mSegments.size());
+        ThreadPool pool(mParams.nThreads);
+        pool.parallelFor(mSegments.size(), [&](size_t i){
+            results[i] = localizeSegment(events, i, mSegments[i]);
+        });
+        
+        std::vector<TrajectoryPoint> trajectory;
+        for(auto& points: results){
+            trajectory.insert(trajectory.end(), points.begin(), points.end());
+        }
+        return trajectory;
+    }
+    
+    const std::vector<SegmentedBatchLocalizer::Segment>& SegmentedBatchLocalizer::segments() const{
+        return mSegments;
+    }
+    
+    std::vector<TrajectoryPoint> SegmentedBatchLocalizer::localizeSegment(const std::vector<SensorEvent>& events, size_t index, Segment& segment){
+        auto s = std::chrono::steady_clock::now();
+        std::shared_ptr<StreamLocalizer> localizer;
+        {
+            std::lock_guard<std::mutex> lock(mMutexFactory);
+            localizer = mFactory();
+        }
+        SegmentRun run;
+        run.segment = &segment;
+        run.index = index;
+        localizer->updateHandler(functionCalledAfterUpdate, &run);
+        
+        auto byTimestamp = [](const SensorEvent& e, long timestamp){
+            return e.timestamp < timestamp;
+        };
+        auto begin = std::lower_bound(events.begin(), events.end(), segment.warmUpStart, byTimestamp);
+        auto end = std::lower_bound(events.begin(), events.end(), segment.end, byTimestamp);
+        for(auto iter = begin; iter != end; iter++){
+            try{
+                iter->dispatch(*localizer);
+            }catch(LocException& e){
+                segment.nFailedEvents++;
+            }catch(std::exception& e){
+                segment.nFailedEvents++;
+            }catch(...){
+                segment.nFailedEvents++;
+            }
+        }
+        segment.nEvents = end - begin;
+        segment.elapsedTime = std::chrono::duration<double>(std::chrono::steady_clock::now() - s).count();
+        return run.points;
+    }
+}
@@ -0,0 +1,101 @@
+/*******************************************************************************
+ * Copyright (c) 2014, 2016  IBM Corporation and others
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *******************************************************************************/
+
+
+#ifndef SegmentedBatchLocalizer_hpp
+#define SegmentedBatchLocalizer_hpp
+
+#include <stdio.h>
+#include <vector>
+#include <string>
+#include <memory>
+#include <functional>
+#include <mutex>
+#include "bleloc.h"
+#include "StreamLocalizer.hpp"
+#include "SensorEvent.hpp"
+
+namespace loc {
+    
+    class SegmentedBatchLocalizerParameters{
+    public:
+        long maxBeaconGap = 10000; // [ms] a log is split where beacons are not received for longer than this (0: disabled)
+        long minStationaryDuration = 10000; // [ms] a log is split in the middle of stationary periods longer than this (0: disabled)
+        long stationaryWindow = 1000; // [ms]
+        double stationaryAccelerationStdev = 0.02; // [G] a window is stationary if the stdev of the acceleration norm is below this
+        long minSegmentDuration = 60000; // [ms] split points which make shorter segments are not used
+        long warmUpDuration = 15000; // [ms] inputs before a segment (before the gap at a beacon gap) fed to let the localizer converge. Their results are discarded.
+        int nThreads = 0; // 0: hardware concurrency
+    };
+    
+    // A localization result of an offline log
+    struct TrajectoryPoint{
+        long timestamp = 0;
+        size_t segment = 0;
+        Status::Step step = Status::OTHER;
+        Status::LocationStatus locationStatus = Status::UNKNOWN;
+        Pose pose;
+    };
+    
+    /**
+     Offline localization of a complete sensor log.
+     
+     The log is split at long gaps of beacon inputs and at stationary periods.
+     Each segment is localized by its own localizer on a thread pool, starting warmUpDuration before the segment
+     so that the localizer has converged at the split point. The results are stitched in the order of segments.
+     **/
+    class SegmentedBatchLocalizer{
+    public:
+        using Ptr = std::shared_ptr<SegmentedBatchLocalizer>;
+        // Creates an independent localizer for a segment. It is called under a lock.
+        using Factory = std::function<std::shared_ptr<StreamLocalizer>()>;
+        
+        struct Segment{
+            long start = 0; // [ms] results in [start, end) are used
+            long end = 0;
+            long warmUpStart = 0; // [ms] inputs are fed from warmUpStart
+            std::string reason; // split reason: "begin", "beacon_gap" or "stationary"
+            size_t nEvents = 0;
+            size_t nFailedEvents = 0; // events which threw exceptions in the localizer
+            double elapsedTime = 0; // [s]
+        };
+        
+        SegmentedBatchLocalizer(Factory factory, const SegmentedBatchLocalizerParameters& params = SegmentedBatchLocalizerParameters());
+        
+        // Splits events sorted by timestamp.
+        std::vector<Segment> split(const std::vector<SensorEvent>& events) const;
+        // Localizes a log and returns the stitched trajectory.
+        std::vector<TrajectoryPoint> localize(std::vector<SensorEvent> events);
+        // Segments of the last localize call
+        const std::vector<Segment>& segments() const;
+        
+    private:
+        Factory mFactory;
+        SegmentedBatchLocalizerParameters mParams;
+        std::vector<Segment> mSegments;
+        std::mutex mMutexFactory;
+        
+        std::vector<TrajectoryPoint> localizeSegment(const std::vector<SensorEvent>& events, size_t index, Segment& segment);
+    };
+}
+
+#endif /* SegmentedBatchLocalizer_hpp */
@@ -0,0 +1,76 @@
+/*******************************************************************************
+ * Copyright (c) 2014, 2016  IBM Corporation and others
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *******************************************************************************/
+
+#include "SensorEvent.hpp"
+
+namespace loc {
+    
+    SensorEvent::SensorEvent(const Acceleration& acceleration)
+    : type(ACCELERATION), timestamp(acceleration.timestamp()), values{acceleration.ax(), acceleration.ay(), acceleration.az()}{
+    }
+    
+    SensorEvent::SensorEvent(const Attitude& attitude)
+    : type(ATTITUDE), timestamp(attitude.timestamp()), values{attitude.pitch(), attitude.roll(), attitude.yaw()}{
+    }
+    
+    SensorEvent::SensorEvent(const Beacons& beacons)
+    : type(BEACONS), timestamp(beacons.timestamp()), beacons(beacons){
+    }
+    
+    SensorEvent::SensorEvent(const LocalHeading& heading)
+    : type(LOCAL_HEADING), timestamp(heading.timestamp()), values{heading.orientation(), heading.orientationDeviation(), 0}{
+    }
+    
+    SensorEvent::SensorEvent(const Altimeter& altimeter)
+    : type(ALTIMETER), timestamp(altimeter.timestamp()), values{altimeter.relativeAltitude(), altimeter.pressure(), 0}{
+    }
+    
+    SensorEvent::SensorEvent(long timestamp, const Pose& pose)
+    : type(RESET), timestamp(timestamp), pose(pose){
+    }
+    
+    void SensorEvent::dispatch(StreamLocalizer& localizer) const{
+        const double* v = values;
+        switch(type){
+            case ACCELERATION:
+                localizer.putAcceleration(Acceleration(timestamp, v[0], v[1], v[2]));
+                break;
+            case ATTITUDE:
+                localizer.putAttitude(Attitude(timestamp, v[0], v[1], v[2]));
+                break;
+            case BEACONS:
+                localizer.putBeacons(beacons);
+                break;
+            case LOCAL_HEADING:
+                localizer.putLocalHeading(LocalHeading(timestamp, v[0], v[1]));
+                break;
+            case ALTIMETER:
+                localizer.putAltimeter(Altimeter(timestamp, v[0], v[1]));
+                break;
+            case RESET:
+                localizer.resetStatus(pose);
+                break;
+            default:
+                break;
+        }
+    }
+}
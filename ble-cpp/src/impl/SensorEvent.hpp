@@ -0,0 +1,72 @@
+/*******************************************************************************
+ * Copyright (c) 2014, 2016  IBM Corporation and others
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *******************************************************************************/
+
+#ifndef SensorEvent_hpp
+#define SensorEvent_hpp
+
+#include <stdio.h>
+#include <cstdint>
+#include "bleloc.h"
+#include "StreamLocalizer.hpp"
+#include "Altimeter.hpp"
+
+namespace loc {
+    
+    // A sensor input of StreamLocalizer which is queued and fed later.
+    struct SensorEvent{
+        enum Type{
+            ACCELERATION = 0,
+            ATTITUDE,
+            BEACONS,
+            LOCAL_HEADING,
+            ALTIMETER,
+            RESET,
+            N_TYPES
+        };
+        
+        Type type = ACCELERATION;
+        long timestamp = 0;
+        uint64_t sequence = 0;
+        double values[3] = {0, 0, 0};
+        Beacons beacons;
+        Pose pose; // RESET
+        
+        SensorEvent() = default;
+        SensorEvent(const Acceleration& acceleration);
+        SensorEvent(const Attitude& attitude);
+        SensorEvent(const Beacons& beacons);
+        SensorEvent(const LocalHeading& heading);
+        SensorEvent(const Altimeter& altimeter);
+        // Reset of the localizer to pose. It is ordered with the inputs by timestamp.
+        SensorEvent(long timestamp, const Pose& pose);
+        
+        // Calls the put* (or resetStatus) function of localizer corresponding to type.
+        void dispatch(StreamLocalizer& localizer) const;
+        
+        // Orders events by timestamp and then by the order of pushing.
+        bool operator<(const SensorEvent& other) const{
+            return timestamp < other.timestamp || (timestamp == other.timestamp && sequence < other.sequence);
+        }
+    };
+}
+
+#endif /* SensorEvent_hpp */
@@ -25,7 +25,15 @@
 namespace loc{
     
     StatusInitializerImpl& StatusInitializerImpl::dataStore(std::shared_ptr<DataStore> dataStore){
+        return this->dataStore(dataStore, std::make_shared<LocationIndex>(dataStore->getLocations(), dataStore->getBLEBeacons(), mRadius2D));
+    }
+    
+    StatusInitializerImpl& StatusInitializerImpl::dataStore(std::shared_ptr<DataStore> dataStore, LocationIndex::Ptr locationIndex){
+        if(!locationIndex || locationIndex->nLocations()!=dataStore->getLocations().size()){
+            BOOST_THROW_EXCEPTION(LocException("location index does not match the locations of the data store"));
+        }
         mDataStore = dataStore;
+        mLocationIndex = locationIndex;
         return *this;
     }
     
@@ -315,30 +323,15 @@ namespace loc{
     Locations StatusInitializerImpl::extractLocationsCloseToBeacons(const std::vector<Beacon> &beacons, double radius2D) const{
         
         auto& uniqueLocations = mDataStore->getLocations();
-        auto& bleBeacons = mDataStore->getBLEBeacons();
         
-        const auto& idToIndexMap = BLEBeacon::constructBeaconIdToIndexMap(bleBeacons);
-        std::vector<Location> selectedLocations;
+        std::vector<int> indices;
+        mLocationIndex->findLocationIndicesCloseToBeacons(beacons, radius2D, indices);
         
-        std::vector<BLEBeacon> observedBLEBeacons;
-        for(auto& b: beacons){
-            const auto& id = b.id();
-            if(idToIndexMap.count(id)>0){
-                observedBLEBeacons.push_back(bleBeacons.at(idToIndexMap.at(id)));
-            }
-        }
-        
-        for(auto& loc: uniqueLocations){
-            for(auto& bloc: observedBLEBeacons){
-                double dist = Location::distance2D(loc, bloc);
-                double floorDiff = Location::floorDifference(loc, bloc);
-                if(dist <= radius2D && floorDiff==0){
-                    selectedLocations.push_back(loc);
-                    continue;
-                }
-            }
+        std::vector<Location> selectedLocations;
+        selectedLocations.reserve(indices.size());
+        for(int index: indices){
+            selectedLocations.push_back(uniqueLocations.at(index));
         }
-        
         return selectedLocations;
     }
     
@@ -346,15 +339,14 @@ namespace loc{
     Locations StatusInitializerImpl::generateLocationsCloseToBeaconsWithPerturbation(const std::vector<Beacon> &beacons, double radius2D) {
         
         auto& bleBeacons = mDataStore->getBLEBeacons();
-        
-        const auto& idToIndexMap = BLEBeacon::constructBeaconIdToIndexMap(bleBeacons);
+        const auto& index = *mLocationIndex;
         std::vector<Location> selectedLocations;
 
         std::vector<BLEBeacon> observedBLEBeacons;
         for(auto& b: beacons){
-            const auto& id = b.id();
-            if(idToIndexMap.count(id)>0){
-                observedBLEBeacons.push_back(bleBeacons.at(idToIndexMap.at(id)));
+            int beaconIndex = index.beaconIndex(b);
+            if(0<=beaconIndex){
+                observedBLEBeacons.push_back(bleBeacons.at(beaconIndex));
             }
         }
         
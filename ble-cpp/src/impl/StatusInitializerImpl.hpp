@@ -30,6 +30,7 @@
 #include "RandomGenerator.hpp"
 #include "StatusInitializer.hpp"
 #include "DataStore.hpp"
+#include "LocationIndex.hpp"
 
 namespace loc{
     /**
@@ -41,6 +42,7 @@ namespace loc{
     private:
         RandomGenerator rand;
         std::shared_ptr<DataStore> mDataStore;
+        LocationIndex::Ptr mLocationIndex; // over the locations of mDataStore
         
         template<class Tstate>
         Tstate perturbLocation(const Tstate& location, const Building& building);
@@ -57,7 +59,10 @@ namespace loc{
         double mRadius2D = 10; //[m]
 
         void beaconEffectiveRadius2D(double);
+        // Builds the location index. The data store must hold its locations and beacons.
         StatusInitializerImpl& dataStore(std::shared_ptr<DataStore> dataStore);
+        // Shares an index already built over the data store, e.g. by a LocalizationModel.
+        StatusInitializerImpl& dataStore(std::shared_ptr<DataStore> dataStore, LocationIndex::Ptr locationIndex);
         StatusInitializerImpl& poseProperty(PoseProperty::Ptr poseProperty);
         StatusInitializerImpl& stateProperty(StateProperty::Ptr stateProperty);
         
@@ -41,6 +41,8 @@
 #include "DataLogger.hpp"
 #include "BaseBeaconFilter.hpp"
 #include "CleansingBeaconFilter.hpp"
+#include "Particles.hpp"
+#include "SpanTracer.hpp"
 
 #include "LocException.hpp"
 
@@ -101,14 +103,14 @@ namespace loc{
         RandomGenerator::Ptr randomGenerator;
         bool mVerbose = false;
         
-        void floorUpdate(States& states, const Beacons& beacons){
+        void floorUpdate(Particles& particles, const Beacons& beacons){
             const BLEBeacons& bleBeacons = mDataStore->getBLEBeacons();
             auto knownBeacons = BLEBeacon::filter(beacons, bleBeacons);
             
             if(mode==COUNT){
-                floorUpdateSimple(states, knownBeacons);
+                floorUpdateSimple(particles, knownBeacons);
             }else if(mode==WEIGHT){
-                floorUpdateUsingObservationModel(states,knownBeacons);
+                floorUpdateUsingObservationModel(particles, knownBeacons);
             }else{
                 BOOST_THROW_EXCEPTION(LocException("Unknown floor update mode."));
             }
@@ -135,7 +137,7 @@ namespace loc{
             return obsFloors;
         }
         
-        void floorUpdateSimple(States& states, const Beacons& beacons){
+        void floorUpdateSimple(Particles& particles, const Beacons& beacons){
             if(beacons.size()==0){
                 return;
             }
@@ -159,19 +161,20 @@ namespace loc{
                 }
             }
             // Update floor when repFloor is different from state.floor
-            for(auto& s: states){
-                int floor = std::round(s.floor());
+            double* floors = particles.floor();
+            for(size_t i=0; i<particles.size(); i++){
+                int floor = std::round(floors[i]);
                 if(obsFloors.count(floor) == 0){
-                    State sTmp(s);
-                    sTmp.floor(repFloor);
-                    if(building.isMovable(sTmp)){
-                        s.floor(repFloor);
+                    Location locTmp = particles.location(i);
+                    locTmp.floor(repFloor);
+                    if(building.isMovable(locTmp)){
+                        floors[i] = repFloor;
                     }
                 }
             }
         }
         
-        void floorUpdateUsingObservationModel(States& states, const Beacons& beacons){
+        void floorUpdateUsingObservationModel(Particles& particles, const Beacons& beacons){
             if(beacons.size()==0){
                 return;
             }
@@ -185,7 +188,7 @@ namespace loc{
             // Add floors
             std::map<int, int> obsFloors = countFloors(beacons, bleBeacons);
 
-            State meanState = State::weightedMean(states);
+            State meanState = particles.weightedMeanState();
             std::vector<int> floors;
             States statesTmp;
             for(auto iter = obsFloors.begin(); iter!=obsFloors.end(); iter++){
@@ -206,8 +209,9 @@ namespace loc{
             std::vector<double> weights = ArrayUtils::computeWeightsFromLogLikelihood(logLLs);
             
             // generate floors using weights and random numbers
+            size_t n = particles.size();
             std::vector<int> floorsGenerated;
-            for(int i = 0; i<states.size(); i++){
+            for(int i = 0; i<n; i++){
                 double d = randomGenerator->nextDouble();
                 double sumw = 0;
                 int floorGen = std::numeric_limits<int>::max();
@@ -226,17 +230,17 @@ namespace loc{
             }
             
             // update floors
-            std::vector<int> floorsWritten(states.size());
-            for(int i=0; i<states.size(); i++){
-                auto&s = states.at(i);
-                int floor = std::round(s.floor());
+            std::vector<int> floorsWritten(n);
+            double* particleFloors = particles.floor();
+            for(int i=0; i<n; i++){
+                int floor = std::round(particleFloors[i]);
                 int floorGen = floorsGenerated.at(i);
                 floorsWritten.at(i) = floor;
                 if(floor!=floorGen){
-                    State sTmp(s);
-                    sTmp.floor(floorGen);
-                    if(building.isMovable(sTmp)){
-                        s.floor(floorGen);
+                    Location locTmp = particles.location(i);
+                    locTmp.floor(floorGen);
+                    if(building.isMovable(locTmp)){
+                        particleFloors[i] = floorGen;
                         floorsWritten.at(i) = floorGen;
                     }
                 }
@@ -276,6 +280,9 @@ namespace loc{
         Location mLocStdevLB;
         
         bool mEnablesFloorUpdate = true;
+        size_t mStateHistoryCapacity = 0;
+        ParticleHistory::Ptr mHistory;
+        FixedLagSmoother::Ptr mSmoother;
         
         MixtureParameters mMixParams;
         FloorTransitionParameters::Ptr mFloorTransParams = std::make_shared<FloorTransitionParameters>();
@@ -298,6 +305,7 @@ namespace loc{
 
         std::shared_ptr<ObservationModel<State, Beacons>> mObservationModel;
         std::shared_ptr<Resampler<State>> mResampler;
+        std::vector<int> mAncestors;
         std::shared_ptr<StatusInitializer> mStatusInitializer;
         std::shared_ptr<BeaconFilter> mBeaconFilter;
 
@@ -323,6 +331,8 @@ namespace loc{
 
         std::deque<double> heightChangeQueueForForceFloorUpdate;
         
+        PipelineMetrics::Ptr mMetrics = std::make_shared<PipelineMetrics>();
+        
     public:
 
         Impl() : status(new Status()),
@@ -333,12 +343,15 @@ namespace loc{
         ~Impl(){}
 
         void initializeStatusIfZero(){
-            if(status->states()->size()==0) {
+            if(status->particles()->size()==0) {
                 initializeStatus();
             }
         }
 
         void putAcceleration(const Acceleration acceleration){
+            if(auto writer = traceWriter()){
+                writer->writeInput(SensorEvent(acceleration));
+            }
             initializeStatusIfZero();
             status->step(Status::OTHER);
             
@@ -353,6 +366,9 @@ namespace loc{
         }
 
         void putAttitude(const Attitude attitude){
+            if(auto writer = traceWriter()){
+                writer->writeInput(SensorEvent(attitude));
+            }
             initializeStatusIfZero();
             status->step(Status::OTHER);
             
@@ -374,28 +390,24 @@ namespace loc{
             input.timestamp(timestamp);
             input.previousTimestamp(previousTimestampMotion);
 
-            std::shared_ptr<States> states = status->states();
+            std::shared_ptr<Particles> particles = status->particles();
             
             bool timestampIntervalIsValid = (input.timestamp() - input.previousTimestamp()) < timestampIntervalLimit;
             
             if(timestampIntervalIsValid){
-                auto& statesObj = *states.get();
-                // move state history
-                std::vector<boost::circular_buffer<State>> histories(statesObj.size());
-                for(int i=0; i<statesObj.size(); i++){
-                    State& sPre = statesObj.at(i);
-                    histories[i] = std::move(sPre.history);
+                // Particles are predicted in place. Histories are not touched by prediction.
+                {
+                    PipelineMetrics::ScopedTimer timer(mMetrics.get(), PipelineMetrics::MOTION_PREDICTION);
+                    mRandomWalker->predict(*particles, input);
+                }
+                if(mMetrics){
+                    mMetrics->increment(PipelineMetrics::MOTION_UPDATES);
                 }
-                StatesPtr statesPredicted(new States(mRandomWalker->predict(statesObj, input)));
-                // move state history
-                for(int i=0; i<statesObj.size(); i++){
-                    State& sPre = statesObj.at(i);
-                    State& sNow = statesPredicted->at(i);
-                    sPre.timestamp = previousTimestampMotion;
-                    sNow.timestamp = timestamp;
-                    sNow.history = std::move(histories[i]);
+                long* timestamps = particles->timestamp();
+                for(size_t i=0; i<particles->size(); i++){
+                    timestamps[i] = timestamp;
                 }
-                status->states(statesPredicted, Status::PREDICTION);
+                status->particles(particles, Status::PREDICTION);
             }else{
                 std::cout << "Interval between two timestamps is too large. The input at timestamp=" << timestamp << " was not used." << std::endl;
             }
@@ -414,6 +426,9 @@ namespace loc{
         }
         
         void putAltimeter(const Altimeter altimeter){
+            if(auto writer = traceWriter()){
+                writer->writeInput(SensorEvent(altimeter));
+            }
             if(mAltitudeManager){
                 mAltitudeManager->putAltimeter(altimeter);
                 // update height change buffer for force floor updater
@@ -426,41 +441,42 @@ namespace loc{
                 }
                 // Update states with the altimeter manager.
                 long ts = altimeter.timestamp();
-                std::shared_ptr<States> states = status->states();
-                auto statesNew = this->predictFloorTransState(states);
+                std::shared_ptr<Particles> particles = status->particles();
+                this->predictFloorTransState(*particles);
                 status->timestamp(ts);
-                status->states(statesNew);
+                status->particles(particles);
                 callback(status.get());
             }
         }
         
-        StatesPtr predictFloorTransState(const StatesPtr& states){
+        void predictFloorTransState(Particles& particles){
+            SpanTracer::Span span("predictFloorTransState", "filter");
             auto heightChanged = mAltitudeManager->heightChange();
             const auto& building = mDataStore->getBuilding();
             
-            auto statesNew = StatesPtr(new States(*states));
-            
             if(heightChanged > mFloorTransParams->heightChangedCriterion()){
                 // multiply weight by coeff in transition area.
                 size_t nTrans = 0;
-                size_t n = statesNew->size();
+                size_t n = particles.size();
+                double* weights = particles.weight();
                 double coeff = mFloorTransParams->weightTransitionArea();
                 double sumWeights = 0.0;
-                for(auto& s: *statesNew){
-                    if(building.isTransitionArea(s)){
-                        s.weight(s.weight() * coeff);
+                std::vector<bool> inTransitionArea(n);
+                for(size_t i=0; i<n; i++){
+                    inTransitionArea[i] = building.isTransitionArea(particles.location(i));
+                    if(inTransitionArea[i]){
+                        weights[i] *= coeff;
                         nTrans++;
                     }
-                    sumWeights += s.weight();
+                    sumWeights += weights[i];
                 }
                 if(sumWeights<=0){
                     LocException ex("sum(weights) <= 0");
                     BOOST_THROW_EXCEPTION(ex);
                 }
                 // normalize weights
-                for(auto&s: *statesNew){
-                    double w = s.weight()/sumWeights;
-                    s.weight(w);
+                for(size_t i=0; i<n; i++){
+                    weights[i] /= sumWeights;
                 }
                 
                 // mix for floor transition area
@@ -468,22 +484,23 @@ namespace loc{
                 int nMixed = 0;
                 if(ratioTrans < mFloorTransParams->mixtureProbaTransArea()){
                     double ratioResid = mFloorTransParams->mixtureProbaTransArea() - ratioTrans;
-                    for(auto& s: *statesNew){
-                        if(building.isTransitionArea(s)){
+                    for(size_t i=0; i<n; i++){
+                        if(inTransitionArea[i]){
                             continue;
                         }
                         double d = mRand->nextDouble();
                         if( d < ratioResid){
-                            const auto& floorMap = building.getFloorAt(s);
-                            auto locsTA = floorMap.findClosestTransitionAreaLocations(s);
+                            Location loc = particles.location(i);
+                            const auto& floorMap = building.getFloorAt(loc);
+                            auto locsTA = floorMap.findClosestTransitionAreaLocations(loc);
                             if(locsTA.size()==0){
                                 continue;
                             }
                             auto locTA = locsTA.at(0);
-                            if( mFloorTransParams->rejectDistance() <= Location::distance(s, locTA)){
+                            if( mFloorTransParams->rejectDistance() <= Location::distance(loc, locTA)){
                                 continue;
                             }else{
-                                s.copyLocation(locTA);
+                                particles.location(i, locTA);
                                 nMixed++;
                             }
                         }
@@ -499,12 +516,19 @@ namespace loc{
                     std::cout << ss.str() << std::endl;
                 }
             }
-            return statesNew;
         }
 
-        void logStates(const States& states, const std::string& filename){
-            if(DataLogger::getInstance()){
-                DataLogger::getInstance()->log(filename, DataUtils::statesToCSV(states));
+        TraceWriter::Ptr traceWriter() const{
+            const auto& logger = DataLogger::getInstance();
+            return logger ? logger->traceWriter() : nullptr;
+        }
+        
+        void logStates(const Particles& particles, TraceWriter::Stage stage, long timestamp){
+            if(auto writer = traceWriter()){
+                writer->writeParticles(stage, timestamp, particles);
+            }else if(DataLogger::getInstance()){
+                std::string filename = TraceWriter::stageToString(stage)+"_states_"+std::to_string(timestamp)+".csv";
+                DataLogger::getInstance()->log(filename, DataUtils::statesToCSV(particles.toStates()));
             }
         }
         
@@ -531,13 +555,15 @@ namespace loc{
             return statesGen;
         }
         
-        States mixStates(const States& states, const Beacons& beacons, const MixtureParameters& mixParams, bool evaluatesLLs,
+        // Computes locations generated from observations and indices of particles to be replaced by them.
+        void mixStates(const Particles& particles, const Beacons& beacons, const MixtureParameters& mixParams, bool evaluatesLLs,
+                       std::vector<int>& indicesMixed, std::vector<Location>& locationsMixed,
                        std::vector<State>& allGeneratedStates, std::vector<double>& allGeneratedStatesLogLLs
                        ){
             if( beacons.size() < mixParams.nBeaconsMinimum){
-                return states;
+                return;
             }
-            size_t nStates = states.size();
+            size_t nStates = particles.size();
             std::vector<int> indices;
             // Select particles that will be removed randomly.
             for(int i=0; i<nStates; i++){
@@ -550,25 +576,22 @@ namespace loc{
             
             //// do burn-in even if nGen==0 to evaluate likelihood
             if(nGen==0 && !evaluatesLLs){
-                return states;
+                return;
             }
             
             States statesGen = generateStatesForMix(nGen, beacons, mixParams, allGeneratedStates, allGeneratedStatesLogLLs);
             
-            States statesMixed(states);
             //Location locMean = Location::mean(states);
-            // Copy location of generated states to the existing states.
+            // Locations of generated states will be copied to the existing states.
             for(int i=0; i<nGen; i++){
                 auto& st = statesGen.at(i);
                 //double p = computeStateAcceptProbability(locMean, st); //compate mean state and new state.
-                double p = computeStateAcceptProbability(states, st); //compare all states and new state.
+                double p = computeStateAcceptProbability(particles, st); //compare all states and new state.
                 if(mRand->nextDouble() < p ){
-                    int idx = indices.at(i);
-                    statesMixed.at(idx).copyLocation(st);
+                    indicesMixed.push_back(indices.at(i));
+                    locationsMixed.push_back(st);
                 }
             }
-            
-            return statesMixed;
         }
         
         double computeStateAcceptProbability(const Location& locMean, const Location& locNew){
@@ -583,13 +606,18 @@ namespace loc{
             return 0;
         }
         
-        double computeStateAcceptProbability(const States& states, const Location& locNew){
-            size_t n = states.size();
+        double computeStateAcceptProbability(const Particles& particles, const Location& locNew){
+            size_t n = particles.size();
+            const double* xs = particles.x();
+            const double* ys = particles.y();
+            const double* zs = particles.z();
+            const double* floors = particles.floor();
             double sumDist = 0;
             double sumIsFloorDifferent = 0;
-            for(const auto& s: states){
-                sumDist += Location::distance(s, locNew);
-                double isFloorDifferent = Location::floorDifference(s, locNew)>0.5 ? 1 : 0;
+            for(size_t i=0; i<n; i++){
+                Location loc(xs[i], ys[i], zs[i], floors[i]);
+                sumDist += Location::distance(loc, locNew);
+                double isFloorDifferent = Location::floorDifference(loc, locNew)>0.5 ? 1 : 0;
                 sumIsFloorDifferent += isFloorDifferent;
             }
             double meanDist = sumDist/n;
@@ -614,10 +642,12 @@ namespace loc{
                 return;
             }
 
+            SpanTracer::Span span("updateStatusByBeacons", "filter");
             long timestamp = beacons.timestamp();
             
             status->timestamp(timestamp);
-            std::shared_ptr<States> states = status->states();
+            std::shared_ptr<Particles> particles = status->particles();
+            size_t n = particles->size();
             
             bool passedMonitoringInterval = false;
             if(timestamp - previousTimestampMonitoring > mLocStatusMonitorParams->monitorIntervalMS() ){
@@ -628,26 +658,32 @@ namespace loc{
             // Compute states mixed with states generated from observations
             std::vector<State> allMixStates;
             std::vector<double> allMixLogLLs;
-            States statesMixed;
+            std::vector<int> indicesMixed;
+            std::vector<Location> locationsMixed;
             if(passedMonitoringInterval || mMixParams.mixtureProbability>0){
-                statesMixed = mixStates(*states, beacons, mMixParams, passedMonitoringInterval, allMixStates, allMixLogLLs);
-            }else{
-                statesMixed = *states;
+                PipelineMetrics::ScopedTimer timer(mMetrics.get(), PipelineMetrics::MIXING);
+                mixStates(*particles, beacons, mMixParams, passedMonitoringInterval, indicesMixed, locationsMixed, allMixStates, allMixLogLLs);
             }
             if(doesFiltering){
                 // Logging before weights updated
-                logStates(*states, "before_likelihood_states_"+std::to_string(timestamp)+".csv");
-                // Copy mixed states when apply filtering
-                *states = statesMixed;
+                logStates(*particles, TraceWriter::BEFORE_LIKELIHOOD, timestamp);
+                // Copy mixed locations when apply filtering
+                for(size_t k=0; k<indicesMixed.size(); k++){
+                    particles->location(indicesMixed[k], locationsMixed[k]);
+                }
             }
             
             // Compute log likelihood
-            std::vector<std::vector<double>> vLogLLsAndMDists = mObservationModel->computeLogLikelihoodRelatedValues(*states, beacons);
-            std::vector<double> vLogLLs(states->size());
-            std::vector<double> mDists(states->size());
-            for(int i=0; i<states->size(); i++){
-                vLogLLs[i] = vLogLLsAndMDists.at(i).at(0);
-                mDists[i] = vLogLLsAndMDists.at(i).at(1);
+            std::vector<double> vLogLLs(n);
+            std::vector<double> mDists(n);
+            {
+                PipelineMetrics::ScopedTimer timer(mMetrics.get(), PipelineMetrics::LIKELIHOOD);
+                std::vector<std::vector<double>> vLogLLsAndMDists;
+                mObservationModel->computeLogLikelihoodRelatedValues(*particles, beacons, vLogLLsAndMDists);
+                for(int i=0; i<n; i++){
+                    vLogLLs[i] = vLogLLsAndMDists.at(i).at(0);
+                    mDists[i] = vLogLLsAndMDists.at(i).at(1);
+                }
             }
             
             bool heightIsChanging = false;
@@ -710,22 +746,29 @@ namespace loc{
             }
             
             if(doesFiltering){
+                PipelineMetrics::ScopedTimer timerWeakening(mMetrics.get(), PipelineMetrics::WEAKENING);
                 // Apply alpha-weaken
                 vLogLLs = weakenLogLikelihoods(vLogLLs, mAlphaWeaken);
                 
                 // Set negative log-likelihoods
-                for(int i=0; i<vLogLLs.size(); i++){
-                    State& s = states->at(i);
-                    s.negativeLogLikelihood(-vLogLLs.at(i));
-                    s.mahalanobisDistance(mDists.at(i));
+                double* negativeLogLLs = particles->negativeLogLikelihood();
+                double* mahalanobisDists = particles->mahalanobisDistance();
+                for(int i=0; i<n; i++){
+                    negativeLogLLs[i] = -vLogLLs[i];
+                    mahalanobisDists[i] = mDists[i];
                 }
                 
-                std::vector<double> weights = ArrayUtils::computeWeightsFromLogLikelihood(vLogLLs);
+                // Weights, their sum and the sum of squares for ESS are computed in one pass.
+                // Weights are left unnormalized when resampling follows because resamplers normalize while drawing.
+                double maxLogLL = *std::max_element(vLogLLs.begin(), vLogLLs.end());
+                double* particleWeights = particles->weight();
                 double sumWeights = 0;
-                // Multiply loglikelihood-based weights and particle weights.
-                for(int i=0; i<weights.size(); i++){
-                    weights[i] = weights[i] * (states->at(i).weight());
-                    sumWeights += weights[i];
+                double sumSquaredWeights = 0;
+                for(int i=0; i<n; i++){
+                    double w = std::exp(vLogLLs[i]-maxLogLL) * particleWeights[i];
+                    particleWeights[i] = w;
+                    sumWeights += w;
+                    sumSquaredWeights += w*w;
                 }
                 if(sumWeights<=0){
                     LocException ex("sum(weights) <= 0");
@@ -737,47 +780,63 @@ namespace loc{
                     }
                     BOOST_THROW_EXCEPTION(ex);
                 }
-                // Renormalized
-                for(int i=0; i<weights.size(); i++){
-                    weights[i] = weights[i]/sumWeights;
-                    states->at(i).weight(weights[i]);
+                double ess = sumWeights*sumWeights/sumSquaredWeights;
+                if(mOptVerbose){
+                    std::cout << "ESS=" << ess << std::endl;
+                }
+                bool resamples = ess<=mEssThreshold;
+                timerWeakening.stop();
+                if(mMetrics){
+                    mMetrics->effectiveSampleSize(ess);
                 }
                 
                 // Logging after weights updated
-                logStates(*states, "after_likelihood_states_"+std::to_string(timestamp)+".csv");
+                if(!resamples || DataLogger::getInstance()){
+                    for(int i=0; i<n; i++){
+                        particleWeights[i] /= sumWeights;
+                    }
+                    sumWeights = 1.0;
+                }
+                logStates(*particles, TraceWriter::AFTER_LIKELIHOOD, timestamp);
                 
                 // Resampling step
-                double ess = computeESS(weights);
-                if(mOptVerbose){
-                    std::cout << "ESS=" << ess << std::endl;
-                }
-                StatesPtr statesNew;
                 Status::Step step;
-                
-                if(ess<=mEssThreshold){
-                    statesNew.reset(mResampler->resample(*states, &weights[0]));
-                    // Assign equal weights after resampling
-                    for(int i=0; i<weights.size(); i++){
-                        double weight = 1.0/(weights.size());
-                        statesNew->at(i).weight(weight);
+                if(resamples){
+                    PipelineMetrics::ScopedTimer timer(mMetrics.get(), PipelineMetrics::RESAMPLING);
+                    // Particles are permuted in place by ancestor indices.
+                    mResampler->resample(*particles, particleWeights, sumWeights, mAncestors);
+                    particles->select(mAncestors);
+                    // Assign equal weights after resampling. Adaptive resamplers may change the number of particles.
+                    size_t nResampled = particles->size();
+                    particleWeights = particles->weight();
+                    for(size_t i=0; i<nResampled; i++){
+                        double weight = 1.0/nResampled;
+                        particleWeights[i] = weight;
+                    }
+                    if(mOptVerbose && nResampled!=n){
+                        std::cout << "number of particles: " << n << " -> " << nResampled << std::endl;
+                    }
+                    if(mMetrics){
+                        mMetrics->increment(PipelineMetrics::RESAMPLINGS);
+                        mMetrics->increment(PipelineMetrics::PARTICLES_RESAMPLED, nResampled);
                     }
                     step = Status::FILTERING_WITH_RESAMPLING;
                 }else{
-                    statesNew.reset(new States(*states));
                     step = Status::FILTERING_WITHOUT_RESAMPLING;
                 }
                 
                 // Posterior-resampling
                 if(mPostResampler){
-                    *statesNew = mPostResampler->resample(*statesNew);
+                    PipelineMetrics::ScopedTimer timer(mMetrics.get(), PipelineMetrics::POST_RESAMPLING);
+                    mPostResampler->resample(*particles);
                 }
                 
-                status->states(statesNew, step);
+                status->particles(particles, step);
                 if(mOptVerbose){
                     std::cout << "resampling at t=" << beacons.timestamp() << std::endl;
                 }
                 // Logging after resampling
-                logStates(*statesNew, "resampled_states_"+std::to_string(timestamp)+".csv");
+                logStates(*particles, TraceWriter::RESAMPLED, timestamp);
                 
                 // Notify registered instances of the update of particle fiter
                 this->notifyObservationUpdated();
@@ -790,15 +849,6 @@ namespace loc{
             mRandomWalker->notifyObservationUpdated();
         }
         
-        double computeESS(std::vector<double> weights){
-            double val = 0;
-            for(double w : weights){
-                val += w*w;
-            }
-            double ess = 1.0/val;
-            return ess;
-        }
-        
         Beacons filterBeacons(const Beacons& beacons){
             size_t nBefore = beacons.size();
             const Beacons& beaconsCleansed = cleansingBeaconFilter.filter(beacons);
@@ -862,13 +912,23 @@ namespace loc{
         }
         
         void putBeacons(const Beacons& beacons){
+            if(auto writer = traceWriter()){
+                writer->writeInput(SensorEvent(beacons));
+            }
             initializeStatusIfZero();
             status->step(Status::OTHER);
+            if(mMetrics){
+                mMetrics->increment(PipelineMetrics::BEACON_UPDATES);
+            }
             
-            const Beacons& beaconsFiltered = filterBeacons(beacons);
+            Beacons beaconsFiltered;
+            {
+                PipelineMetrics::ScopedTimer timer(mMetrics.get(), PipelineMetrics::BEACON_FILTERING);
+                beaconsFiltered = filterBeacons(beacons);
+            }
             if(beaconsFiltered.size()>0){
                 // Observation dependent floor update
-                std::shared_ptr<States> states = status->states();
+                std::shared_ptr<Particles> particles = status->particles();
                 bool tryFloorUpdate = false;
                 if(mEnablesFloorUpdate){
                     if(!mFloorUpdater){
@@ -879,14 +939,15 @@ namespace loc{
                         mFloorUpdater->mVerbose = mOptVerbose;
                         mFloorUpdater->randomGenerator = mRand;
                     }
+                    PipelineMetrics::ScopedTimer timer(mMetrics.get(), PipelineMetrics::FLOOR_UPDATE);
                     tryFloorUpdate = checkTryFloorUpdate();
                     if(tryFloorUpdate){
-                        mFloorUpdater->floorUpdate(*states, beaconsFiltered);
-                        status->states(states);// update states to compute rep values.
+                        mFloorUpdater->floorUpdate(*particles, beaconsFiltered);
+                        status->particles(particles);// update states to compute rep values.
                     }
                 }
                 // filtering
-                bool doesFiltering = checkIfDoFiltering(*states);
+                bool doesFiltering = checkIfDoFiltering(*particles);
                 bool monitorsStatus = true;
                 
                 if(doesFiltering){
@@ -912,18 +973,27 @@ namespace loc{
             // manage state history
             {
                 auto timestamp = beacons.timestamp();
-                std::shared_ptr<States> states = status->states();
-                auto& statesObj = *states.get();
-                // move state history
-                for(int i=0; i<statesObj.size(); i++){
-                    State& sNow = statesObj.at(i);
-                    sNow.timestamp = timestamp;
-                    if(sNow.history.empty()){
-                        sNow.history.set_capacity(State::history_capacity);
+                std::shared_ptr<Particles> particles = status->particles();
+                long* timestamps = particles->timestamp();
+                for(int i=0; i<particles->size(); i++){
+                    timestamps[i] = timestamp;
+                }
+                size_t capacity = mStateHistoryCapacity;
+                if(mSmoother){
+                    capacity = std::max(capacity, mSmoother->lag()+1);
+                }
+                if(0<capacity){
+                    if(!mHistory){
+                        mHistory = std::make_shared<ParticleHistory>(capacity);
+                    }else{
+                        mHistory->capacity(capacity);
                     }
-                    auto history = std::move(sNow.history);
-                    history.push_back(sNow);
-                    sNow.history = std::move(history);
+                    mHistory->push(*particles);
+                }else{
+                    mHistory.reset();
+                }
+                if(mSmoother){
+                    mSmoother->update(*particles);
                 }
             }
             
@@ -945,16 +1015,17 @@ namespace loc{
         }
 
         void initializeStatus(){
+            SpanTracer::Span span("initializeStatus", "filter");
             this->reset();
             mPedometer->reset();
             mOrientationmeter->reset();
-            StatesPtr states(new States(mStatusInitializer->initializeStates(mNumStates)));
-            updateStatus(states);
+            Particles::Ptr particles(new Particles(mStatusInitializer->initializeStates(mNumStates)));
+            updateStatus(particles);
         }
 
-        void updateStatus(StatesPtr states){
+        void updateStatus(Particles::Ptr particles){
             Status *st = new Status();
-            st->states(states, Status::OTHER);
+            st->particles(particles, Status::OTHER);
             status.reset(st);
         }
 
@@ -981,6 +1052,10 @@ namespace loc{
         }
 
         void callback(Status* status){
+            PipelineMetrics::ScopedTimer timer(mMetrics.get(), PipelineMetrics::STATUS_PUBLICATION);
+            if(auto writer = traceWriter()){
+                writer->writeStatus(*status);
+            }
             if(mFunctionCalledAfterUpdate!=NULL){
                 mFunctionCalledAfterUpdate(status);
             }
@@ -994,8 +1069,8 @@ namespace loc{
             if(orientationWasUpdated){
                 std::cout << "Orientation is updated. Reset succeeded." << std::endl;
                 double orientationMeasured = mOrientationmeter->getYaw();
-                StatesPtr states(new States(mStatusInitializer->resetStates(mNumStates, pose, orientationMeasured)));
-                status->states(states, Status::RESET);
+                Particles::Ptr particles(new Particles(mStatusInitializer->resetStates(mNumStates, pose, orientationMeasured)));
+                status->particles(particles, Status::RESET);
                 callback(status.get());
                 return true;
             }else{
@@ -1013,8 +1088,8 @@ namespace loc{
             if(orientationWasUpdated){
                 std::cout << "Orientation is updated. Reset succeeded." << std::endl;
                 double orientationMeasured = mOrientationmeter->getYaw();
-                StatesPtr states(new States(mStatusInitializer->resetStates(mNumStates, meanPose, stdevPose, orientationMeasured)));
-                status->states(states, Status::RESET);
+                Particles::Ptr particles(new Particles(mStatusInitializer->resetStates(mNumStates, meanPose, stdevPose, orientationMeasured)));
+                status->particles(particles, Status::RESET);
                 callback(status.get());
                 return true;
             }else{
@@ -1042,8 +1117,8 @@ namespace loc{
                         s.orientation(orientation);
                     }
                 }
-                StatesPtr states(new States(statesTmp));
-                status->states(states, Status::RESET);
+                Particles::Ptr particles(new Particles(std::move(statesTmp)));
+                status->particles(particles, Status::RESET);
                 callback(status.get());
                 return true;
             }else{
@@ -1068,9 +1143,8 @@ namespace loc{
             if(beaconsFiltered.size() == 0){
                 BOOST_THROW_EXCEPTION(LocException("beaconsFiltered.size==0 in resetStatus(beacons)."));
             }
-            States statesTmp = sampleStatesByObservation(mNumStates, beaconsFiltered);
-            StatesPtr statesNew(new States(statesTmp));
-            status->states(statesNew, Status::RESET);
+            Particles::Ptr particles(new Particles(sampleStatesByObservation(mNumStates, beaconsFiltered)));
+            status->particles(particles, Status::RESET);
             status->timestamp(beacons.timestamp());
             if(mMetro){
                 ss << "an ObservationDependentInitializer.";
@@ -1104,9 +1178,8 @@ namespace loc{
             const Beacons& beaconsFiltered = filterBeacons(beacons);
             std::stringstream ss;
             ss << "Status was initialized by ";
-            States statesTmp = sampleStatesByLocationAndObservation(mNumStates, location, beaconsFiltered);
-            StatesPtr statesNew(new States(statesTmp));
-            status->states(statesNew, Status::RESET);
+            Particles::Ptr particles(new Particles(sampleStatesByLocationAndObservation(mNumStates, location, beaconsFiltered)));
+            status->particles(particles, Status::RESET);
             status->timestamp(beacons.timestamp());
             if(mMetro){
                 ss << "an ObservationDependentInitializer.";
@@ -1157,6 +1230,7 @@ namespace loc{
 
         void processResetStatus(){
             if(functionsForReset.size()>0){
+                SpanTracer::Span span("processResetStatus", "filter");
                 bool orientationWasUpdated = mOrientationmeter->isUpdated();
                 if(orientationWasUpdated){
                     std::function<void()> func = functionsForReset.back();
@@ -1167,13 +1241,13 @@ namespace loc{
             }
         }
 
-        bool checkIfDoFiltering(const States& states) const{
+        bool checkIfDoFiltering(const Particles& particles) const{
             double variance2DLowerBound = std::pow(mLocStdevLB.x(), 2)*std::pow(mLocStdevLB.y(),2);
             double stdZLB = mLocStdevLB.z();
             double stdFloorLB = mLocStdevLB.floor();
             
-            double variance2D = Location::compute2DVariance(states);
-            Location stdevLoc = Location::standardDeviation(states);
+            double variance2D = particles.compute2DVariance();
+            Location stdevLoc = particles.standardDeviation();
             
             if(mOptVerbose){
                 std::cout<<"var2D="<<variance2D<<","<<"var2DLB="<<variance2DLowerBound
@@ -1217,6 +1291,10 @@ namespace loc{
         void enablesFloorUpdate(bool enablesFloorUpdate){
             mEnablesFloorUpdate = enablesFloorUpdate;
         }
+        
+        void stateHistoryCapacity(size_t capacity){
+            mStateHistoryCapacity = capacity;
+        }
 
         void pedometer(std::shared_ptr<Pedometer> pedometer){
             mPedometer=pedometer;
@@ -1266,6 +1344,22 @@ namespace loc{
             mFloorTransParams = params;
         }
         
+        void metrics(PipelineMetrics::Ptr metrics){
+            mMetrics = metrics;
+        }
+        
+        PipelineMetrics::Ptr metrics() const{
+            return mMetrics;
+        }
+        
+        void smoother(FixedLagSmoother::Ptr smoother){
+            mSmoother = smoother;
+        }
+        
+        FixedLagSmoother::Ptr smoother() const{
+            return mSmoother;
+        }
+        
         void locationStatusMonitorParameters(LocationStatusMonitorParameters::Ptr params){
             mLocStatusMonitorParams = params;
         }
@@ -1288,7 +1382,7 @@ namespace loc{
         return *this;
     }
 
-    StreamParticleFilter& StreamParticleFilter::putBeacons(const Beacons beacons) {
+    StreamParticleFilter& StreamParticleFilter::putBeacons(Beacons beacons) {
         impl->putBeacons(beacons);
         return *this;
     }
@@ -1438,6 +1532,11 @@ namespace loc{
         return * this;
     }
     
+    StreamParticleFilter& StreamParticleFilter::stateHistoryCapacity(size_t capacity){
+        impl->stateHistoryCapacity(capacity);
+        return * this;
+    }
+    
     StreamParticleFilter& StreamParticleFilter::floorUpdateMode(FloorUpdateMode mode){
         impl->floorUpdateMode(mode);
         return * this;
@@ -1452,4 +1551,22 @@ namespace loc{
         impl->locationStatusMonitorParameters(params);
         return * this;
     }
+    
+    StreamParticleFilter& StreamParticleFilter::metrics(PipelineMetrics::Ptr metrics){
+        impl->metrics(metrics);
+        return * this;
+    }
+    
+    PipelineMetrics::Ptr StreamParticleFilter::metrics() const{
+        return impl->metrics();
+    }
+    
+    StreamParticleFilter& StreamParticleFilter::smoother(FixedLagSmoother::Ptr smoother){
+        impl->smoother(smoother);
+        return * this;
+    }
+    
+    FixedLagSmoother::Ptr StreamParticleFilter::smoother() const{
+        return impl->smoother();
+    }
 }
@@ -36,6 +36,8 @@
 
 #include "BeaconFilter.hpp"
 #include "AltitudeManager.hpp"
+#include "PipelineMetrics.hpp"
+#include "FixedLagSmoother.hpp"
 
 namespace loc {
     
@@ -164,6 +166,7 @@ namespace loc {
         StreamParticleFilter& mixtureParameters(MixtureParameters);
         StreamParticleFilter& floorTransitionParameters(FloorTransitionParameters::Ptr);
         StreamParticleFilter& enablesFloorUpdate(bool);
+        StreamParticleFilter& stateHistoryCapacity(size_t); // 0: no history is kept
         StreamParticleFilter& floorUpdateMode(FloorUpdateMode);
         StreamParticleFilter& locationStatusMonitorParameters(LocationStatusMonitorParameters::Ptr);
         
@@ -182,6 +185,12 @@ namespace loc {
         StreamParticleFilter& observationDependentInitializer(std::shared_ptr<ObservationDependentInitializer<State, Beacons>> metro);
         StreamParticleFilter& posteriorResampler(PosteriorResampler<State>::Ptr);
         StreamParticleFilter& dataStore(DataStore::Ptr);
+        // Latencies of the update stages and filter counters. Set nullptr to disable measurement.
+        StreamParticleFilter& metrics(PipelineMetrics::Ptr);
+        PipelineMetrics::Ptr metrics() const;
+        // Smoothed locations lag beacon updates behind. The state history is extended to the lag. Set nullptr to disable smoothing.
+        StreamParticleFilter& smoother(FixedLagSmoother::Ptr);
+        FixedLagSmoother::Ptr smoother() const;
         
         // callback function setter
         StreamParticleFilter& updateHandler(void (*functionCalledAfterUpdate)(Status*)) override;
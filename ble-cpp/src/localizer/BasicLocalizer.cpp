@@ -33,6 +33,7 @@
 #include "TransformedOrientationMeterAverage.hpp"
 #include "BeaconFilterChain.hpp"
 #include "RegisteredBeaconFilter.hpp"
+#include "SpanTracer.hpp"
 
 namespace loc{
     // BasicLocalizer
@@ -85,6 +86,7 @@ namespace loc{
     }
     
     StreamLocalizer& BasicLocalizer::putAttitude(const Attitude attitude) {
+        SpanTracer::Span span("BasicLocalizer::putAttitude", "localizer");
         if (!isReady) {
             return *this;
         }
@@ -114,6 +116,7 @@ namespace loc{
         return *this;
     }
     StreamLocalizer& BasicLocalizer::putAcceleration(const Acceleration acceleration) {
+        SpanTracer::Span span("BasicLocalizer::putAcceleration", "localizer");
         if (!isReady) {
             return *this;
         }
@@ -157,6 +160,7 @@ namespace loc{
     }
     
     StreamLocalizer& BasicLocalizer::putAltimeter(const Altimeter altimeter){
+        SpanTracer::Span span("BasicLocalizer::putAltimeter", "localizer");
         if (mFunctionCalledToLog) {
             mFunctionCalledToLog(mUserDataToLog, LogUtil::toString(altimeter));
         }
@@ -175,38 +179,24 @@ namespace loc{
     }
     
     Beacons smoothBeaconsList(const std::vector<Beacon>* beacons_list , int smooth_count, int nSmooth){
-        std::map<BeaconId, loc::Beacons> allBeacons;
+        // Sum and count of RSSIs per id. Unregistered beacons are averaged too; filters are applied later.
+        std::map<BeaconId, std::pair<double, int>> rssiSums;
         
         for(int i = 0; i < N_SMOOTH_MAX && i < smooth_count+1 && i < nSmooth; i++) {
             for(auto& b: beacons_list[i]) {
                 if (b.rssi() == 0) {
                     continue;
                 }
-                auto iter = allBeacons.find(b.id());
-                if (iter == allBeacons.end()) {
-                    auto bs = loc::Beacons();
-                    bs.insert(bs.end(), b);
-                    allBeacons.insert(std::make_pair(b.id(), bs));
-                }else{
-                    iter->second.insert(iter->second.end(), b);
-                }
+                auto& sum = rssiSums[b.id()];
+                sum.first += b.rssi();
+                sum.second++;
             }
         }
         
         Beacons beaconsAveraged;
-        for(auto itr = allBeacons.begin(); itr != allBeacons.end(); ++itr) {
-            const auto& id = itr->first;
-            const auto& uuid = id.uuid();
-            auto major = id.major();
-            auto minor = id.minor();
-            auto& bs = itr->second;
-            int c = 0;
-            double rssi = 0;
-            for(auto& b:bs) {
-                rssi += b.rssi();
-                c++;
-            }
-            beaconsAveraged.insert(beaconsAveraged.end(), loc::Beacon(uuid, major, minor, rssi/c));
+        beaconsAveraged.reserve(rssiSums.size());
+        for(const auto& pair: rssiSums) {
+            beaconsAveraged.push_back(Beacon(pair.first, pair.second.first/pair.second.second));
         }
         return beaconsAveraged;
     }
@@ -224,7 +214,8 @@ namespace loc{
     }
     */
     
-    StreamLocalizer& BasicLocalizer::putBeacons(const Beacons beacons) {
+    StreamLocalizer& BasicLocalizer::putBeacons(Beacons beacons) {
+        SpanTracer::Span span("BasicLocalizer::putBeacons", "localizer");
         if (!isReady) {
             return *this;
         }
@@ -235,14 +226,14 @@ namespace loc{
             std::cout << "The number of strong beacon is zero." << std::endl;
             return *this;
         }
-        Beacons beaconsTmp = beacons;
         if (smoothType == SMOOTH_RSSI) {
-            beacons_list[(smooth_count)%std::min(N_SMOOTH_MAX,nSmooth)] = beacons;
-            Beacons newBeacons = smoothBeaconsList(beacons_list, smooth_count, nSmooth);
-            newBeacons.timestamp(beacons.timestamp());
-            beaconsTmp = newBeacons;
+            long timestamp = beacons.timestamp();
+            beacons_list[(smooth_count)%std::min(N_SMOOTH_MAX,nSmooth)] = std::move(beacons);
+            beacons = smoothBeaconsList(beacons_list, smooth_count, nSmooth);
+            beacons.timestamp(timestamp);
             smooth_count++;
         }
+        const Beacons& beaconsTmp = beacons;
         /*
             switch(mState) {
                 case UNKNOWN:
@@ -307,11 +298,9 @@ namespace loc{
             double oridev;
             if(mTrackedStatus){
                 auto yaw = orientationMeter->getYaw(); // orientationMeter is always updated in putAttitude.
-                auto trackedStates = mTrackedStatus->states();
-                std::vector<double> orientations;
-                for(const auto& s: *trackedStates){
-                    orientations.push_back(s.orientationBias());
-                }
+                auto trackedParticles = mTrackedStatus->particles();
+                const double* orientationBiases = trackedParticles->orientationBias();
+                std::vector<double> orientations(orientationBiases, orientationBiases + trackedParticles->size());
                 auto wnp = MathUtils::computeWrappedNormalParameters(orientations);
                 ori = yaw - wnp.mean();
                 oridev = wnp.stdev();
@@ -354,17 +343,19 @@ namespace loc{
                 nSmoothTmp = nSmooth;
             }
             
-            status_list[(smooth_count++)%std::min(N_SMOOTH_MAX,nSmoothTmp)] = *statusLatest->states();
+            status_list[(smooth_count++)%std::min(N_SMOOTH_MAX,nSmoothTmp)] = *statusLatest->particles();
             
-            std::shared_ptr<States> states (new std::vector<loc::State>);
-            double meanBias = 0;
+            auto particles = std::make_shared<Particles>();
             for(int i = 0; i < N_SMOOTH_MAX && i < smooth_count && i < nSmoothTmp; i++) {
-                for(auto& s: status_list[i]) {
-                    states->push_back(s);
-                    meanBias += s.rssiBias();
-                }
+                particles->append(status_list[i]);
             }
-            mEstimatedRssiBias = meanBias / states->size();
+            size_t nParticles = particles->size();
+            const double* rssiBiases = particles->rssiBias();
+            double meanBias = 0;
+            for(size_t i=0; i<nParticles; i++){
+                meanBias += rssiBiases[i];
+            }
+            mEstimatedRssiBias = meanBias / nParticles;
             
             // update orientation by heading or tracked orientation
             bool headingConfidenceIsActive = 0.0<headingConfidenceForOrientationInit_ && headingConfidenceForOrientationInit_<=1.0;
@@ -372,16 +363,17 @@ namespace loc{
                 auto wnp = computeNormalParameterForInit();
                 RandomGenerator randGen;
                 double contamiRate =  std::max(1.0-headingConfidenceForOrientationInit_, 0.0);
-                for(auto& s: *states){
+                double* orientations = particles->orientation();
+                for(size_t i=0; i<nParticles; i++){
                     if(randGen.nextDouble() < contamiRate || std::isinf(wnp.stdev())){
-                        s.orientation(Pose::normalizeOrientaion(2.0*M_PI*randGen.nextDouble()));
+                        orientations[i] = Pose::normalizeOrientaion(2.0*M_PI*randGen.nextDouble());
                     }else{
-                        s.orientation(randGen.nextWrappedNormal(wnp.mean(), wnp.stdev()));
+                        orientations[i] = randGen.nextWrappedNormal(wnp.mean(), wnp.stdev());
                     }
                 }
             }
             
-            mResult->states(states, Status::RESET);
+            mResult->particles(particles, Status::RESET);
             mResult->locationStatus(mLocationStatus);
             
             updateLocationStatus(mResult.get());
@@ -408,12 +400,11 @@ namespace loc{
         //if (isTrackingLocalizer() && isStatesConverged && mLocationStatus!=Status::STABLE) {
         if (isTrackingLocalizer() && isStatesConverged) {
             Pose refPose = *mResult->meanPose();
-            std::vector<State> states = *mResult->states();
-            auto idx = Location::findClosestLocationIndex(refPose, states);
-            Location locClosest = states.at(idx);
+            auto particles = mResult->particles();
+            Location locClosest = particles->location(particles->findClosestLocationIndex(refPose));
             refPose.copyLocation(locClosest);
 
-            auto std = loc::Location::standardDeviation(*mResult->states());
+            auto std = particles->standardDeviation();
             refPose.floor(roundf(refPose.floor()));
             loc::Pose stdevPose;
             double largeOridev = 10*M_PI;
@@ -442,14 +433,14 @@ namespace loc{
         return *this;
     }
     
-    Status::LocationStatus transitLocationStatus(const Status::LocationStatus& tempLocStatus, const States& states, const LocationStatusMonitorParameters& params){
+    Status::LocationStatus transitLocationStatus(const Status::LocationStatus& tempLocStatus, const Particles& particles, const LocationStatusMonitorParameters& params){
 
         double std2DExitStable = params.stdev2DExitStable();
         double std2DEnterStable = params.stdev2DEnterStable();
         double std2DEnterLocating = params.stdev2DEnterLocating();
         double std2DExitLocating = params.stdev2DExitLocating();
         
-        double std2D = std::pow(Location::compute2DVariance(states), 1.0/4.0);
+        double std2D = std::pow(particles.compute2DVariance(), 1.0/4.0);
         
         Status::LocationStatus newLocStatus = tempLocStatus;
         switch(tempLocStatus){
@@ -491,12 +482,13 @@ namespace loc{
         if(innerStatusWasUpdated){
             newLocStatus = midLocStatus;
         } else {
+            auto particles = status->particles();
             if(this->isVerboseLocalizer){
-                double std2D = std::pow(Location::compute2DVariance(*status->states()), 1.0/4.0);
-                auto stdLoc = Location::standardDeviation(*status->states());
+                double std2D = std::pow(particles->compute2DVariance(), 1.0/4.0);
+                auto stdLoc = particles->standardDeviation();
                 std::cout << "std2D=" << std2D << ",stdX="<< stdLoc.x() << ",stdY=" << stdLoc.y()  << std::endl;
             }
-            auto tmpLocStatus = transitLocationStatus(midLocStatus, *status->states(), *locationStatusMonitorParameters);
+            auto tmpLocStatus = transitLocationStatus(midLocStatus, *particles, *locationStatusMonitorParameters);
             if(midLocStatus==Status::LOCATING && tmpLocStatus==Status::STABLE){
                 if(smooth_count>=nSmooth){
                     newLocStatus = Status::STABLE;
@@ -552,143 +544,48 @@ namespace loc{
     bool BasicLocalizer::resetStatus(const Location& location, const Beacons& beacons) {
         bool ret = mLocalizer->resetStatus(location, beacons);
         double meanBias = 0;
-        for(loc::State s: *mLocalizer->getStatus()->states()) {
-            meanBias += s.rssiBias();
+        auto particles = mLocalizer->getStatus()->particles();
+        const double* rssiBiases = particles->rssiBias();
+        for(size_t i=0; i<particles->size(); i++) {
+            meanBias += rssiBiases[i];
         }
-        mEstimatedRssiBias = meanBias / mLocalizer->getStatus()->states()->size();
+        mEstimatedRssiBias = meanBias / particles->size();
 
         return ret;
     }
     
-    const picojson::value &get(const picojson::value::object &obj, std::string key){
-        auto itr = obj.find(key);
-        if (itr != obj.end()) {
-            return itr->second;
+    BasicLocalizer& BasicLocalizer::setModel(std::string modelPath, std::string workingDir) {
+        if (isReady) { // TODO support multiple models
+            std::cerr << "Already model was set" << std::endl;
+            return *this;
         }
-        throw "not found";
+        LocalizationModelOptions options;
+        options.forceTraining = forceTraining;
+        options.finalizeMapdata = finalizeMapdata;
+        options.gpType = basicLocalizerOptions.gpType;
+        options.nThreadsTraining = basicLocalizerOptions.nThreadsTraining;
+        options.usesPredictionGrid = basicLocalizerOptions.usesPredictionGrid;
+        options.predictionGridParameters = basicLocalizerOptions.predictionGridParameters;
+        return setModel(LocalizationModel::load(modelPath, workingDir, options));
     }
     
-    const std::string &getString(const picojson::value::object &obj, std::string key) {
-        auto& value = get(obj, key);
-        if (value.is<std::string>()) {
-            return value.get<std::string>();
-        }
-        throw "non string value";
-    }
-    double getDouble(const picojson::value::object &obj, std::string key) {
-        auto& value = get(obj, key);
-        if (value.is<double>()) {
-            return value.get<double>();
-        }
-        throw "non double value";
-    }
-    const picojson::value::object &getObject(const picojson::value::object &obj, std::string key) {
-        auto& value = get(obj, key);
-        if (value.is<picojson::value::object>()) {
-            return value.get<picojson::value::object>();
-        }
-        throw "non object value";
-    }
-    const picojson::value::array &getArray(const picojson::value::object &obj, std::string key) {
-        auto& value = get(obj, key);
-        if (value.is<picojson::value::array>()) {
-            return value.get<picojson::value::array>();
-        }
-        throw "non array value";
-    }
-
-    BasicLocalizer& BasicLocalizer::setModel(std::string modelPath, std::string workingDir) {
+    BasicLocalizer& BasicLocalizer::setModel(LocalizationModel::Ptr model) {
         auto s = std::chrono::system_clock::now();
         std::cerr << "start setModel" << std::endl;
         if (isReady) { // TODO support multiple models
             std::cerr << "Already model was set" << std::endl;
             return *this;
         }
-        
-        std::ifstream file;
-        file.open(modelPath, std::ios::in);
-        if(!file.is_open()){
-            throw "model file not found at "+modelPath;
-        }
-        std::istreambuf_iterator<char> input(file);
-        
-        picojson::value v;
-        std::string err;
-        picojson::parse(v, input, std::istreambuf_iterator<char>(), &err);
-        if (!err.empty()) {
-            throw err+" with reading "+modelPath;
-        }
-        if (!v.is<picojson::object>()) {
-            throw "invalid JSON";
-        }
-        file.close();
-        auto msec = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::system_clock::now()-s).count();
-        std::cerr << "parse JSON: " << msec << "ms" << std::endl;
-        
-        picojson::value::object& json = v.get<picojson::object>();
-        
-        auto& anchor = getObject(json, "anchor");
-        this->anchor.latlng.lat = getDouble(anchor, "latitude");
-        this->anchor.latlng.lng = getDouble(anchor, "longitude");
-        this->anchor.rotate = getDouble(anchor, "rotate");
-        
-        try{
-            this->anchor.magneticDeclination = getDouble(anchor, "declination");
-        }catch(char const* e){
-            std::cerr << "declination is not set because it was not found in the anchor." << std::endl;
-            this->anchor.magneticDeclination = std::numeric_limits<double>::quiet_NaN();
-        }
-        
+        mModel = model;
+        this->anchor = model->anchor();
         latLngConverter_ = std::make_shared<LatLngConverter>(this->anchor);
         
-        deserializedModel = std::shared_ptr<GaussianProcessLDPLMultiModel<State, Beacons>> (new GaussianProcessLDPLMultiModel<State, Beacons>());
-        
-        bool doTraining = true;
-        try{
-            try {
-                auto& str = getString(json, "ObservationModelParameters");
-                if (/* DISABLES CODE */ (false)) {
-                    std::string omppath = DataUtils::stringToFile(str, workingDir, "ObservationModelParameters");
-                    
-                    msec = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::system_clock::now()-s).count();
-                    std::cerr << "save deserialized model: " << msec << "ms" << std::endl;
-                    
-                    std::cerr << omppath << std::endl;
-                    //std::istringstream ompss(str);
-                    std::ifstream ompss(omppath);
-                    //if (ompss) {
-                    std::cout << "loading" << std::endl;
-                    deserializedModel->load(ompss);
-                    std::cout << "loaded" << std::endl;
-                    //}
-                } else {
-                    std::istringstream ompss(str);
-                    if (ompss) {
-                        std::cout << "loading" << std::endl;
-                        deserializedModel->load(ompss);
-                        std::cout << "loaded" << std::endl;
-                    }
-                }
-                msec = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::system_clock::now()-s).count();
-                std::cerr << "load deserialized model: " << msec << "ms" << std::endl;
-                doTraining = false;
-            } catch(LocException& e){
-                throw e;
-            } catch(const std::exception& e) {
-                LocException ex(std::string(e.what()));
-                BOOST_THROW_EXCEPTION(ex);
-            } catch(const char* ch){
-                //LocException ex((std::string(ch)));
-                //BOOST_THROW_EXCEPTION(ex);
-            } catch(...){
-                BOOST_THROW_EXCEPTION(LocException("..."));
-            }
-        }catch(LocException& e){
-            e << boost::error_info<struct err_info, std::string>("exception at loading ObservationModelParameters");
-            throw e;
-        }
+        // The copy shares the trained GP and the prediction grid with the model
+        // and holds per-localizer settings (tDelay, normFunc, coeffDiffFloorStdev).
+        deserializedModel = std::make_shared<GaussianProcessLDPLMultiModel<State, Beacons>>(*model->observationModel());
         
         mLocalizer = std::shared_ptr<StreamParticleFilter>(new StreamParticleFilter());
+        mLocalizer->metrics(mMetrics);
         if (mFunctionCalledAfterUpdate2 && mUserData) {
             //mLocalizer->updateHandler(mFunctionCalledAfterUpdate2, mUserData);
             mLocalizer->updateHandler(bridgeFunctionCalledAfterUpdate2, mUserDataBridge);
@@ -705,173 +602,29 @@ namespace loc{
         mLocalizer->effectiveSampleSizeThreshold(effectiveSampleSizeThreshold);
         mLocalizer->enablesFloorUpdate(enablesFloorUpdate);
         
-        std::cout << "Create data store" << std::endl << std::endl;
-        // Create data store
-        dataStore = std::shared_ptr<DataStoreImpl> (new DataStoreImpl());
+        dataStore = model->dataStore();
         mLocalizer->dataStore(dataStore);
         
-        // Building - change read order to reduce memory usage peak
-        //ImageHolder::setMode(ImageHolderMode(heavy));
-        BuildingBuilder buildingBuilder;
-        
-        auto& buildings = getArray(json, "layers");
-        
-        for(int floor_num = 0; floor_num < buildings.size(); floor_num++) {
-            auto& building = buildings.at(floor_num).get<picojson::value::object>();
-            auto& param = getObject(building, "param");
-            double ppmx = getDouble(param, "ppmx");
-            double ppmy = getDouble(param, "ppmy");
-            double ppmz = getDouble(param, "ppmz");
-            double originx = getDouble(param, "originx");
-            double originy = getDouble(param, "originy");
-            double originz = getDouble(param, "originz");
-            CoordinateSystemParameters coordSysParams(ppmx, ppmy, ppmz, originx, originy, originz);
-
-            auto& data = getString(building, "data");
-            std::ostringstream ostr;
-            ostr << floor_num << "floor.png";
-            
-            std::string path = DataUtils::stringToFile(data, workingDir, ostr.str());
-            
-            int fn = floor_num;
-            if (!get(param, "floor").is<picojson::null>()) {
-                fn = (int)getDouble(param, "floor");
-            }
-            
-            buildingBuilder.addFloorCoordinateSystemParametersAndImagePath(fn, coordSysParams, path);
-            
-            msec = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::system_clock::now()-s).count();
-            std::cerr << "prepare floor model[" << floor_num << "]: " << msec << "ms" << std::endl;
-        }
-        dataStore->building(buildingBuilder.build());
-        
-        msec = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::system_clock::now()-s).count();
-        std::cerr << "build floor model: " << msec << "ms" << std::endl;
-        
-        // Sampling data
-        
-        // Samples samples;
-        try{
-            auto& samples = getArray(json, "samples");
-            for(int i = 0; i < samples.size(); i++) {
-                auto& sample = samples.at(i).get<picojson::value::object>();
-                auto& data = getString(sample, "data");
-                
-                //std::string samplepath = DataUtils::stringToFile(data, workingDir);
-                //std::ifstream is(samplepath);
-                std::istringstream is(data);
-                dataStore->readSamples(is);
-            }
-            {
-                std::cerr << dataStore->getSamples().size() << " samples have been loaded" << std::endl;
-            }
-        }catch(const char* ch){
-            std::cerr << "samples have not been loaded." << std::endl;
-        }
-        msec = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::system_clock::now()-s).count();
-        std::cerr << "load sample data: " << msec << "ms" << std::endl;
-        
-        // set unique locations to data store 
-        if(dataStore->getSamples().size() != 0){
-            const auto& uniLocs = Sample::extractUniqueLocations(dataStore->getSamples());
-            dataStore->locations(uniLocs);
-        }
-        
-        
-        // set sample locations
-        try{
-            auto& locationsJarray = getArray(json, "locations");
-            Locations locations;
-            for(int i = 0; i < locationsJarray.size(); i++) {
-                auto& locationsJobj = locationsJarray.at(i).get<picojson::value::object>();
-                auto& data = getString(locationsJobj, "data");
-                std::istringstream is(data);
-                DataUtils::csvLocationsToLocations(is, locations);
-            }
-            dataStore->locations(locations);
-            {
-                std::cerr << dataStore->getLocations().size() << " locations have been loaded" << std::endl;
-            }
-        }catch(const char* ch){
-            {
-                std::cerr << "locations have not been loaded" << std::endl;
-            }
-        }
-        msec = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::system_clock::now()-s).count();
-        std::cerr << "load location data: " << msec << "ms" << std::endl;
-        
-        if(dataStore->getLocations().size()==0){
-            BOOST_THROW_EXCEPTION(LocException("Neither samples nor locations have been loaded"));
-        }
-        
-        
-        // set BLE beacon locations
-        BLEBeacons bleBeacons;
-        auto& beacons = getArray(json, "beacons");
-        for(int i = 0; i < beacons.size(); i++) {
-            auto& beacon = beacons.at(i).get<picojson::value::object>();
-            auto& data = getString(beacon, "data");
-            
-            std::istringstream is(data);
-            BLEBeacons bleBeaconsTmp = DataUtils::csvBLEBeaconsToBLEBeacons(is);
-            bleBeacons.insert(bleBeacons.end(), bleBeaconsTmp.begin(), bleBeaconsTmp.end());
-        }
-        dataStore->bleBeacons(bleBeacons);
-        msec = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::system_clock::now()-s).count();
-        std::cerr << "load beacon data: " << msec << "ms" << std::endl;
-        
-        if(doTraining || forceTraining){
-            std::cerr << "Training will be processed" << std::endl;
-            // Train observation model
-            std::shared_ptr<GaussianProcessLDPLMultiModelTrainer<State, Beacons>>obsModelTrainer( new GaussianProcessLDPLMultiModelTrainer<State, Beacons>());
-            obsModelTrainer->setGPType(basicLocalizerOptions.gpType);
-            obsModelTrainer->dataStore(dataStore);
-            std::shared_ptr<GaussianProcessLDPLMultiModel<State, Beacons>> obsModel( obsModelTrainer->train());
-            //localizer->observationModel(obsModel);
-            
-            std::ostringstream oss;
-            obsModel->save(oss);
-            
-            json["ObservationModelParameters"] = (picojson::value)oss.str();
-            
-            std::ofstream of;
-            of.open(modelPath);
-            of << v.serialize();
-            of.close();
-        }
+        const BLEBeacons& bleBeacons = dataStore->getBLEBeacons();
+        auto msec = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::system_clock::now()-s).count();
         
         // update additional parameters in the observation model
         deserializedModel->coeffDiffFloorStdev(coeffDiffFloorStdev);
         if(1<=tDelay){
             deserializedModel->tDelay(tDelay);
         }
-
-        // finalize mapdata file
-        if(finalizeMapdata){
-            std::cerr << "Finalizing map data." << std::endl;
-            // convert unique locations to string
-            auto uniLocs = dataStore->getLocations();
-            std::stringstream ss;
-            for(const auto& uloc: uniLocs){
-                ss << "0,L," << uloc << std::endl;
-            }
-            auto uLocLine = ss.str();
-            
-            // modify json object
-            picojson::array locationsArray;
-            picojson::object locationsObj;
-            locationsObj.insert(std::make_pair("data", picojson::value(uLocLine)));
-            locationsArray.push_back(picojson::value(locationsObj));
-            json.insert(std::make_pair("locations", picojson::value(locationsArray)));
-            json.erase("samples");
-            
-            // output mapdata
-            std::ofstream of;
-            of.open(modelPath);
-            of << v.serialize();
-            of.close();
+        // Past particles are kept only for delayed prediction; the filter extends the history for a smoother.
+        int tDelayModel = deserializedModel->tDelay();
+        mLocalizer->stateHistoryCapacity(1<tDelayModel ? tDelayModel : 0);
+        if(0<smoothingLag){
+            mLocalizer->smoother(std::make_shared<FixedLagSmoother>(smoothingLag));
         }
-        
+        if(basicLocalizerOptions.usesPredictionGrid && !deserializedModel->predictionGrid()){
+            deserializedModel->buildPredictionGrid(*model->building(), basicLocalizerOptions.predictionGridParameters);
+            msec = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::system_clock::now()-s).count();
+            std::cerr << "build prediction grid: " << msec << "ms" << std::endl;
+        }
+
         // Instantiate sensor data processors
         // Orientation
         orientationMeterAverageParameters.interval(0.1);
@@ -947,12 +700,13 @@ namespace loc{
         prwBuildingProperty->velocityRateEscalator(velocityRateEscalator);
         prwBuildingProperty->relativeVelocityEscalator(relativeVelocityEscalator);
         
-        Building building = dataStore->getBuilding();
-        Building::Ptr buildingPtr(new Building(building));
+        Building::Ptr buildingPtr = model->building();
         poseRandomWalkerInBuilding = std::shared_ptr<PoseRandomWalkerInBuilding>(new PoseRandomWalkerInBuilding());
         poseRandomWalkerInBuilding->poseRandomWalker(poseRandomWalker);
         poseRandomWalkerInBuilding->building(buildingPtr);
         poseRandomWalkerInBuilding->poseRandomWalkerInBuildingProperty(prwBuildingProperty);
+        poseRandomWalkerInBuilding->numThreads(basicLocalizerOptions.nThreadsPrediction);
+        poseRandomWalkerInBuilding->metrics(mMetrics);
         
         RandomWalkerProperty::Ptr randomWalkerProperty(new RandomWalkerProperty);
         randomWalkerProperty->sigma = 0.25;
@@ -976,6 +730,8 @@ namespace loc{
             randomWalkerMotion->setProperty(randomWalkerMotionProperty);
             // Setup SystemModelInBuilding
             SystemModelInBuilding<State, SystemModelInput>::Ptr rwMotionBldg(new SystemModelInBuilding<State, SystemModelInput>(randomWalkerMotion, buildingPtr, prwBuildingProperty) );
+            rwMotionBldg->numThreads(basicLocalizerOptions.nThreadsPrediction);
+            rwMotionBldg->metrics(mMetrics);
             mLocalizer->systemModel(rwMotionBldg);
         }
         else if (localizeMode == RANDOM_WALK) {
@@ -994,19 +750,35 @@ namespace loc{
             wPRWproperty->randomWalkRate(randomWalkRate);
             wPRW->setWeakPoseRandomWalkerProperty(wPRWproperty);
             SystemModelInBuilding<State, SystemModelInput>::Ptr wPRWBldg(new SystemModelInBuilding<State, SystemModelInput>(wPRW, buildingPtr, prwBuildingProperty) );
+            wPRWBldg->numThreads(basicLocalizerOptions.nThreadsPrediction);
+            wPRWBldg->metrics(mMetrics);
             mLocalizer->systemModel(wPRWBldg);
         }
         
         // set resampler
-        resampler = std::shared_ptr<Resampler<State>>(new GridResampler<State>());
+        if(usesKLDSampling){
+            KLDResamplerParameters kldParams;
+            kldParams.minStates = nStatesMin;
+            kldParams.maxStates = nStates;
+            kldParams.binSize = kldBinSize;
+            kldParams.epsilon = kldEpsilon;
+            kldParams.delta = kldDelta;
+            resampler = std::make_shared<KLDResampler<State>>(kldParams);
+        }else{
+            resampler = std::shared_ptr<Resampler<State>>(new GridResampler<State>());
+        }
         mLocalizer->resampler(resampler);
         // Set status initializer
         ////PoseProperty poseProperty;
         ////StateProperty stateProperty;
         
         statusInitializer = std::shared_ptr<StatusInitializerImpl>(new StatusInitializerImpl());
-        statusInitializer->dataStore(dataStore)
-        .poseProperty(poseProperty).stateProperty(stateProperty);
+        if(mModel && mModel->dataStore()==dataStore){
+            statusInitializer->dataStore(dataStore, mModel->locationIndex());
+        }else{
+            statusInitializer->dataStore(dataStore);
+        }
+        statusInitializer->poseProperty(poseProperty).stateProperty(stateProperty);
         mLocalizer->statusInitializer(statusInitializer);
         
         // Set localizer
@@ -1036,6 +808,9 @@ namespace loc{
         msParams.interval = burnInInterval;
         msParams.withOrdering = true;
         msParams.initType = burnInInitType;
+        msParams.nChains = burnInChains;
+        msParams.nThreads = burnInThreads;
+        msParams.maxRetainedSamples = burnInMaxRetainedSamples;
 
         obsDepInitializer->parameters(msParams);
         obsDepInitializer->isVerbose = isVerboseLocalizer;
@@ -1060,6 +835,17 @@ namespace loc{
         return *this;
     }
     
+    LocalizationModel::Ptr BasicLocalizer::model() const{
+        return mModel;
+    }
+    
+    void BasicLocalizer::writeModelBundle(const std::string& bundlePath) const {
+        if (!isReady) {
+            BOOST_THROW_EXCEPTION(LocException("model has not been set"));
+        }
+        mModel->writeBundle(bundlePath);
+    }
+    
     double BasicLocalizer::estimatedRssiBias() {
         return mEstimatedRssiBias;
     }
@@ -35,6 +35,7 @@
 #include "WeakPoseRandomWalker.hpp"
 
 #include "GridResampler.hpp"
+#include "KLDResampler.hpp"
 #include "StatusInitializerStub.hpp"
 #include "StatusInitializerImpl.hpp"
 
@@ -63,6 +64,7 @@
 
 #include "SerializeUtils.hpp"
 #include "LatLngConverter.hpp"
+#include "LocalizationModel.hpp"
 
 #define N_SMOOTH_MAX 10
 
@@ -134,9 +136,16 @@ namespace loc {
         int nSmooth = 10;
         int nSmoothTracking = 1;
         SmoothType smoothType = SMOOTH_LOCATION;
+        int smoothingLag = 0; // [beacon input] lag of the fixed-lag smoother in tracking (0: no smoothing). Long lags degenerate to few ancestors (see FixedLagSmoother).
         LocalizeMode localizeMode = ONESHOT;
         
         double effectiveSampleSizeThreshold = 1000;
+        // KLD-sampling. The number of particles varies between nStatesMin and nStates.
+        bool usesKLDSampling = false;
+        int nStatesMin = 100;
+        double kldBinSize = 1.0; // [m]
+        double kldEpsilon = 0.05;
+        double kldDelta = 0.01;
         int nStrongest = 10;
         bool enablesFloorUpdate = true;
         
@@ -180,6 +189,9 @@ namespace loc {
         int burnInRadius2D = 10;
         int burnInInterval = 1;
         InitType burnInInitType = INIT_WITH_SAMPLE_LOCATIONS;
+        int burnInChains = 1; // each chain runs nBurnIn steps
+        int burnInThreads = 1; // 0: hardware concurrency
+        int burnInMaxRetainedSamples = 0; // 0: all
         
         double mixProba = 0.000;
         double rejectDistance = 5;
@@ -225,9 +237,15 @@ namespace loc {
             OPTIONAL_NVP(ar,nSmoothTracking);
             
             OPTIONAL_NVP(ar,smoothType);
+            OPTIONAL_NVP(ar,smoothingLag);
             OPTIONAL_NVP(ar,localizeMode);
             
             OPTIONAL_NVP(ar,effectiveSampleSizeThreshold);
+            OPTIONAL_NVP(ar,usesKLDSampling);
+            OPTIONAL_NVP(ar,nStatesMin);
+            OPTIONAL_NVP(ar,kldBinSize);
+            OPTIONAL_NVP(ar,kldEpsilon);
+            OPTIONAL_NVP(ar,kldDelta);
             OPTIONAL_NVP(ar,nStrongest);
             OPTIONAL_NVP(ar,enablesFloorUpdate);
             
@@ -273,6 +291,9 @@ namespace loc {
             OPTIONAL_NVP(ar,burnInRadius2D);
             OPTIONAL_NVP(ar,burnInInterval);
             OPTIONAL_NVP(ar,burnInInitType);
+            OPTIONAL_NVP(ar,burnInChains);
+            OPTIONAL_NVP(ar,burnInThreads);
+            OPTIONAL_NVP(ar,burnInMaxRetainedSamples);
             
             OPTIONAL_NVP(ar,mixProba);
             OPTIONAL_NVP(ar,rejectDistance);
@@ -316,6 +337,10 @@ namespace loc {
     class BasicLocalizerOptions{
     public:
         GPType gpType = GPNORMAL;
+        int nThreadsTraining = 1; // 0: hardware concurrency
+        int nThreadsPrediction = 1; // threads for particle prediction in building (0: hardware concurrency)
+        bool usesPredictionGrid = false;
+        RssiPredictionGridParameters predictionGridParameters;
     };
     
     class BasicLocalizer: public StreamLocalizer, public BasicLocalizerParameters{
@@ -337,8 +362,9 @@ namespace loc {
         
         //std::shared_ptr<loc::Status> mResult;
         std::shared_ptr<Status> mTrackedStatus;
+        PipelineMetrics::Ptr mMetrics = std::make_shared<PipelineMetrics>();
         
-        std::vector<loc::State> status_list[N_SMOOTH_MAX];
+        Particles status_list[N_SMOOTH_MAX];
         std::vector<loc::Beacon> beacons_list[N_SMOOTH_MAX];
         
         int smooth_count = 0;
@@ -359,6 +385,7 @@ namespace loc {
         
         void updateStateProperty();
         
+        LocalizationModel::Ptr mModel;
         Anchor anchor;
         LatLngConverter::Ptr latLngConverter_;
 
@@ -447,7 +474,23 @@ namespace loc {
         bool resetStatus(const Beacons& beacons) override;
         bool resetStatus(const Location& location, const Beacons& beacons) override;
 
+        // modelPath is either a JSON map data file or a model bundle written by writeModelBundle.
         BasicLocalizer& setModel(std::string modelPath, std::string workingDir);
+        // Uses a model loaded elsewhere. The model is shared, not copied, and may be used by other localizers.
+        BasicLocalizer& setModel(LocalizationModel::Ptr model);
+        LocalizationModel::Ptr model() const;
+        // Writes the loaded model as a binary bundle which setModel maps into memory without parsing.
+        void writeModelBundle(const std::string& bundlePath) const;
+        
+        // Stage latencies and counters of the particle filter, kept across setModel calls.
+        PipelineMetrics::Ptr metrics() const{
+            return mMetrics;
+        }
+        
+        // Smoothed locations in tracking (nullptr if smoothingLag is 0). Call flush() at the end of a log.
+        FixedLagSmoother::Ptr smoother() const{
+            return mLocalizer ? mLocalizer->smoother() : nullptr;
+        }
         
         bool tracksOrientation(){
             switch(localizeMode) {
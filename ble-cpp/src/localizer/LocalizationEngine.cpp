@@ -0,0 +1,381 @@
+/*******************************************************************************
+ * Copyright (c) 2014, 2016  IBM Corporation and others
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *******************************************************************************/
+
+#include "LocalizationEngine.hpp"
+#include "SensorEvent.hpp"
+#include "LocException.hpp"
+
+#include <algorithm>
+#include <condition_variable>
+#include <deque>
+#include <iostream>
+#include <map>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace loc{
+    
+    class LocalizationEngine::Session::Impl : public std::enable_shared_from_this<LocalizationEngine::Session::Impl>{
+        std::shared_ptr<LocalizationEngine::Impl> mEngine;
+        std::shared_ptr<BasicLocalizer> mLocalizer;
+        
+        std::mutex mEventMutex;
+        std::condition_variable mFlushCv;
+        std::vector<SensorEvent> mPending;
+        bool mScheduled = false; // in the run queue or being processed
+        uint64_t mSequence = 0;  // the number of pushed events
+        uint64_t mProcessed = 0;
+        
+        // Held while events are fed to the localizer
+        std::mutex mProcessMutex;
+        
+        // Status copies returned by getStatus, one per calling thread
+        std::mutex mSnapshotMutex;
+        std::map<std::thread::id, std::unique_ptr<Status>> mStatusSnapshots;
+        
+        static thread_local const Impl* current; // session processed on this thread
+        
+    public:
+        Impl(std::shared_ptr<LocalizationEngine::Impl> engine, std::shared_ptr<BasicLocalizer> localizer)
+        : mEngine(engine), mLocalizer(localizer){
+        }
+        
+        void push(SensorEvent& ev);
+        
+        // Processes the events queued so far. Returns true if more events arrived meanwhile.
+        bool drain(){
+            std::vector<SensorEvent> batch;
+            {
+                std::lock_guard<std::mutex> lock(mEventMutex);
+                batch.swap(mPending);
+            }
+            std::sort(batch.begin(), batch.end());
+            {
+                std::lock_guard<std::mutex> lock(mProcessMutex);
+                current = this;
+                for(const SensorEvent& ev: batch){
+                    try{
+                        ev.dispatch(*mLocalizer);
+                    }catch(const std::exception& e){
+                        std::cerr << "LocalizationEngine: " << e.what() << std::endl;
+                    }catch(const std::string& str){
+                        std::cerr << "LocalizationEngine: " << str << std::endl;
+                    }catch(const char* ch){
+                        std::cerr << "LocalizationEngine: " << ch << std::endl;
+                    }catch(...){
+                        std::cerr << "LocalizationEngine: unknown exception" << std::endl;
+                    }
+                }
+                current = nullptr;
+            }
+            std::lock_guard<std::mutex> lock(mEventMutex);
+            mProcessed += batch.size();
+            mFlushCv.notify_all();
+            if(mPending.empty()){
+                mScheduled = false;
+                return false;
+            }
+            return true;
+        }
+        
+        void flush(){
+            if(current == this){ // called from an update handler
+                return;
+            }
+            std::unique_lock<std::mutex> lock(mEventMutex);
+            uint64_t target = mSequence;
+            mFlushCv.wait(lock, [this, target]{
+                return target <= mProcessed;
+            });
+        }
+        
+        // Runs func with the localizer after queued events are processed.
+        template<class Tfunc>
+        auto synchronized(Tfunc func) -> decltype(func(*mLocalizer)){
+            if(current == this){
+                return func(*mLocalizer);
+            }
+            flush();
+            std::lock_guard<std::mutex> lock(mProcessMutex);
+            return func(*mLocalizer);
+        }
+        
+        // The status is copied while the worker does not update it.
+        Status* statusSnapshot(){
+            if(current == this){ // called from an update handler
+                return mLocalizer->getStatus();
+            }
+            std::unique_ptr<Status> status = synchronized([](BasicLocalizer& localizer){
+                Status* current = localizer.getStatus();
+                return std::unique_ptr<Status>(current ? new Status(*current) : nullptr);
+            });
+            std::lock_guard<std::mutex> lock(mSnapshotMutex);
+            std::unique_ptr<Status>& snapshot = mStatusSnapshots[std::this_thread::get_id()];
+            snapshot = std::move(status);
+            return snapshot.get();
+        }
+        
+        std::shared_ptr<BasicLocalizer> localizer() const{
+            return mLocalizer;
+        }
+    };
+    
+    thread_local const LocalizationEngine::Session::Impl* LocalizationEngine::Session::Impl::current = nullptr;
+    
+    class LocalizationEngine::Impl : public std::enable_shared_from_this<LocalizationEngine::Impl>{
+        LocalizationModel::Ptr mModel;
+        std::vector<std::thread> mWorkers;
+        std::mutex mMutex;
+        std::condition_variable mCv;
+        std::deque<std::shared_ptr<Session::Impl>> mRunQueue;
+        bool mStop = false;
+        
+        void run(){
+            while(true){
+                std::shared_ptr<Session::Impl> session;
+                {
+                    std::unique_lock<std::mutex> lock(mMutex);
+                    mCv.wait(lock, [this]{
+                        return !mRunQueue.empty() || mStop;
+                    });
+                    if(mRunQueue.empty()){
+                        break;
+                    }
+                    session = std::move(mRunQueue.front());
+                    mRunQueue.pop_front();
+                }
+                // Sessions with more events go back to the end of the queue for fairness.
+                if(session->drain()){
+                    schedule(session);
+                }
+            }
+        }
+        
+    public:
+        Impl(LocalizationModel::Ptr model)
+        : mModel(model){
+            if(!mModel){
+                BOOST_THROW_EXCEPTION(LocException("model is null"));
+            }
+        }
+        
+        // Each worker keeps the engine alive, so that a worker detached by stop can finish its loop.
+        void start(const LocalizationEngineParameters& params){
+            int nThreads = params.nThreads;
+            if(nThreads <= 0){
+                nThreads = std::max(1u, std::thread::hardware_concurrency());
+            }
+            auto self = shared_from_this();
+            for(int i=0; i<nThreads; i++){
+                mWorkers.emplace_back([self](){
+                    self->run();
+                });
+            }
+        }
+        
+        // Queued sessions are processed before workers exit.
+        // When called from an update handler, the calling worker cannot be joined and is detached;
+        // it exits after the handler returns and the remaining queue is drained.
+        void stop(){
+            {
+                std::lock_guard<std::mutex> lock(mMutex);
+                if(mStop){
+                    return;
+                }
+                mStop = true;
+            }
+            mCv.notify_all();
+            for(auto& worker: mWorkers){
+                if(worker.get_id() == std::this_thread::get_id()){
+                    worker.detach();
+                }else{
+                    worker.join();
+                }
+            }
+        }
+        
+        void schedule(std::shared_ptr<Session::Impl> session){
+            {
+                std::lock_guard<std::mutex> lock(mMutex);
+                if(!mStop){
+                    mRunQueue.push_back(std::move(session));
+                    mCv.notify_one();
+                    return;
+                }
+            }
+            // The engine has been stopped; process on the caller thread.
+            while(session->drain()){
+            }
+        }
+        
+        LocalizationModel::Ptr model() const{
+            return mModel;
+        }
+    };
+    
+    void LocalizationEngine::Session::Impl::push(SensorEvent& ev){
+        bool schedules = false;
+        {
+            std::lock_guard<std::mutex> lock(mEventMutex);
+            ev.sequence = mSequence++;
+            mPending.push_back(std::move(ev));
+            if(!mScheduled){
+                mScheduled = true;
+                schedules = true;
+            }
+        }
+        if(schedules){
+            mEngine->schedule(shared_from_this());
+        }
+    }
+    
+    LocalizationEngine::LocalizationEngine(LocalizationModel::Ptr model, const LocalizationEngineParameters& params){
+        impl = std::make_shared<Impl>(model);
+        impl->start(params);
+    }
+    
+    LocalizationEngine::~LocalizationEngine(){
+        impl->stop();
+    }
+    
+    LocalizationModel::Ptr LocalizationEngine::model() const{
+        return impl->model();
+    }
+    
+    BasicLocalizerParameters LocalizationEngine::copyParameters(const BasicLocalizerParameters& params){
+        BasicLocalizerParameters copied(params);
+        copied.poseProperty = std::make_shared<PoseProperty>(*params.poseProperty);
+        copied.stateProperty = std::make_shared<StateProperty>(*params.stateProperty);
+        copied.pfFloorTransParams = std::make_shared<StreamParticleFilter::FloorTransitionParameters>(*params.pfFloorTransParams);
+        copied.locationStatusMonitorParameters = std::make_shared<LocationStatusMonitorParameters>(*params.locationStatusMonitorParameters);
+        copied.prwBuildingProperty = std::make_shared<SystemModelInBuildingProperty>(*params.prwBuildingProperty);
+        return copied;
+    }
+    
+    LocalizationEngine::Session::Ptr LocalizationEngine::createSession(const BasicLocalizerParameters& params, const BasicLocalizerOptions& options){
+        auto localizer = std::make_shared<BasicLocalizer>(copyParameters(params));
+        localizer->basicLocalizerOptions = options;
+        localizer->setModel(impl->model());
+        std::shared_ptr<Session::Impl> sessionImpl = std::make_shared<Session::Impl>(impl, localizer);
+        return Session::Ptr(new Session(sessionImpl));
+    }
+    
+    LocalizationEngine::Session::Session(std::shared_ptr<Impl> impl): impl(impl){
+    }
+    
+    LocalizationEngine::Session::~Session(){
+        impl->flush();
+    }
+    
+    LocalizationEngine::Session& LocalizationEngine::Session::updateHandler(void (*functionCalledAfterUpdate)(Status*)){
+        impl->synchronized([&](BasicLocalizer& localizer){
+            localizer.updateHandler(functionCalledAfterUpdate);
+        });
+        return *this;
+    }
+    
+    LocalizationEngine::Session& LocalizationEngine::Session::updateHandler(void (*functionCalledAfterUpdate)(void*, Status*), void* inUserData){
+        impl->synchronized([&](BasicLocalizer& localizer){
+            localizer.updateHandler(functionCalledAfterUpdate, inUserData);
+        });
+        return *this;
+    }
+    
+    LocalizationEngine::Session& LocalizationEngine::Session::putAcceleration(const Acceleration acceleration){
+        SensorEvent ev(acceleration);
+        impl->push(ev);
+        return *this;
+    }
+    
+    LocalizationEngine::Session& LocalizationEngine::Session::putAttitude(const Attitude attitude){
+        SensorEvent ev(attitude);
+        impl->push(ev);
+        return *this;
+    }
+    
+    LocalizationEngine::Session& LocalizationEngine::Session::putBeacons(const Beacons beacons){
+        SensorEvent ev(beacons);
+        impl->push(ev);
+        return *this;
+    }
+    
+    LocalizationEngine::Session& LocalizationEngine::Session::putLocalHeading(const LocalHeading heading){
+        SensorEvent ev(heading);
+        impl->push(ev);
+        return *this;
+    }
+    
+    LocalizationEngine::Session& LocalizationEngine::Session::putAltimeter(const Altimeter altimeter){
+        SensorEvent ev(altimeter);
+        impl->push(ev);
+        return *this;
+    }
+    
+    Status* LocalizationEngine::Session::getStatus(){
+        return impl->statusSnapshot();
+    }
+    
+    bool LocalizationEngine::Session::resetStatus(){
+        return impl->synchronized([&](BasicLocalizer& localizer){
+            return localizer.resetStatus();
+        });
+    }
+    
+    bool LocalizationEngine::Session::resetStatus(Pose pose){
+        return impl->synchronized([&](BasicLocalizer& localizer){
+            return localizer.resetStatus(pose);
+        });
+    }
+    
+    bool LocalizationEngine::Session::resetStatus(Pose meanPose, Pose stdevPose){
+        return impl->synchronized([&](BasicLocalizer& localizer){
+            return localizer.resetStatus(meanPose, stdevPose);
+        });
+    }
+    
+    bool LocalizationEngine::Session::resetStatus(Pose meanPose, Pose stdevPose, double rateContami){
+        return impl->synchronized([&](BasicLocalizer& localizer){
+            return localizer.resetStatus(meanPose, stdevPose, rateContami);
+        });
+    }
+    
+    bool LocalizationEngine::Session::resetStatus(const Beacons& beacons){
+        return impl->synchronized([&](BasicLocalizer& localizer){
+            return localizer.resetStatus(beacons);
+        });
+    }
+    
+    bool LocalizationEngine::Session::resetStatus(const Location& location, const Beacons& beacons){
+        return impl->synchronized([&](BasicLocalizer& localizer){
+            return localizer.resetStatus(location, beacons);
+        });
+    }
+    
+    void LocalizationEngine::Session::flush(){
+        impl->flush();
+    }
+    
+    std::shared_ptr<BasicLocalizer> LocalizationEngine::Session::localizer() const{
+        return impl->localizer();
+    }
+}
@@ -0,0 +1,111 @@
+/*******************************************************************************
+ * Copyright (c) 2014, 2016  IBM Corporation and others
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *******************************************************************************/
+
+#ifndef LocalizationEngine_hpp
+#define LocalizationEngine_hpp
+
+#include <stdio.h>
+#include <cstdint>
+#include <memory>
+#include "StreamLocalizer.hpp"
+#include "BasicLocalizer.hpp"
+#include "LocalizationModel.hpp"
+
+namespace loc{
+    
+    class LocalizationEngineParameters{
+    public:
+        int nThreads = 0; // 0: hardware concurrency
+    };
+    
+    /**
+     Runs many localization sessions against one shared LocalizationModel.
+     
+     The model (building, beacons, locations and the trained observation model) is loaded once
+     and only read by sessions. Each session owns particles, sensor buffers and parameters.
+     put* functions of a session queue events and return; a fixed pool of worker threads
+     processes each session's events in timestamp order, one session at a time per worker.
+     Update handlers of a session are called on a worker thread.
+     Sessions take their own copies of the parameter objects (see copyParameters).
+     The engine may be destroyed from an update handler; the calling worker is then detached instead of joined.
+     **/
+    class LocalizationEngine{
+    public:
+        using Ptr = std::shared_ptr<LocalizationEngine>;
+        
+        class Session;
+        
+        LocalizationEngine(LocalizationModel::Ptr model, const LocalizationEngineParameters& params = LocalizationEngineParameters());
+        ~LocalizationEngine();
+        
+        LocalizationModel::Ptr model() const;
+        
+        std::shared_ptr<Session> createSession(const BasicLocalizerParameters& params, const BasicLocalizerOptions& options = BasicLocalizerOptions());
+        
+        // Property objects are held by shared_ptr and updated by localizers,
+        // so each localizer built from the same parameters takes its own copies.
+        static BasicLocalizerParameters copyParameters(const BasicLocalizerParameters& params);
+        
+        class Impl;
+    private:
+        std::shared_ptr<Impl> impl;
+    };
+    
+    class LocalizationEngine::Session : public StreamLocalizer{
+    public:
+        using Ptr = std::shared_ptr<Session>;
+        
+        ~Session();
+        
+        Session& updateHandler(void (*functionCalledAfterUpdate)(Status*)) override;
+        Session& updateHandler(void (*functionCalledAfterUpdate)(void*, Status*), void* inUserData) override;
+        
+        Session& putAcceleration(const Acceleration acceleration) override;
+        Session& putAttitude(const Attitude attitude) override;
+        Session& putBeacons(const Beacons beacons) override;
+        Session& putLocalHeading(const LocalHeading heading) override;
+        Session& putAltimeter(const Altimeter altimeter) override;
+        // Returns a copy of the status made after queued events are processed. It is valid until
+        // the next getStatus call on the same thread (update handlers get the live status).
+        Status* getStatus() override;
+        
+        bool resetStatus() override;
+        bool resetStatus(Pose pose) override;
+        bool resetStatus(Pose meanPose, Pose stdevPose) override;
+        bool resetStatus(Pose meanPose, Pose stdevPose, double rateContami) override;
+        bool resetStatus(const Beacons& beacons) override;
+        bool resetStatus(const Location& location, const Beacons& beacons) override;
+        
+        // Blocks until all events pushed before this call have been processed.
+        void flush();
+        // The localizer must not be used directly while events are queued.
+        std::shared_ptr<BasicLocalizer> localizer() const;
+        
+        class Impl;
+    private:
+        friend class LocalizationEngine;
+        Session(std::shared_ptr<Impl> impl);
+        std::shared_ptr<Impl> impl;
+    };
+}
+
+#endif /* LocalizationEngine_hpp */
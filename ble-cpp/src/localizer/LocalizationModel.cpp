@@ -0,0 +1,400 @@
+/*******************************************************************************
+ * Copyright (c) 2014, 2016  IBM Corporation and others
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *******************************************************************************/
+
+#include "LocalizationModel.hpp"
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <chrono>
+#include "DataUtils.hpp"
+#include "ModelBundle.hpp"
+
+namespace loc{
+    
+    namespace{
+        const picojson::value &get(const picojson::value::object &obj, std::string key){
+            auto itr = obj.find(key);
+            if (itr != obj.end()) {
+                return itr->second;
+            }
+            throw "not found";
+        }
+    
+        const std::string &getString(const picojson::value::object &obj, std::string key) {
+            auto& value = get(obj, key);
+            if (value.is<std::string>()) {
+                return value.get<std::string>();
+            }
+            throw "non string value";
+        }
+        double getDouble(const picojson::value::object &obj, std::string key) {
+            auto& value = get(obj, key);
+            if (value.is<double>()) {
+                return value.get<double>();
+            }
+            throw "non double value";
+        }
+        const picojson::value::object &getObject(const picojson::value::object &obj, std::string key) {
+            auto& value = get(obj, key);
+            if (value.is<picojson::value::object>()) {
+                return value.get<picojson::value::object>();
+            }
+            throw "non object value";
+        }
+        const picojson::value::array &getArray(const picojson::value::object &obj, std::string key) {
+            auto& value = get(obj, key);
+            if (value.is<picojson::value::array>()) {
+                return value.get<picojson::value::array>();
+            }
+            throw "non array value";
+        }
+    }
+    
+    LocalizationModel::Ptr LocalizationModel::load(const std::string& modelPath, const std::string& workingDir, const LocalizationModelOptions& options){
+        auto s = std::chrono::system_clock::now();
+        Ptr model(new LocalizationModel());
+        model->mObservationModel = std::make_shared<ObservationModel>();
+        model->mDataStore = std::make_shared<DataStoreImpl>();
+        if(ModelBundle::isBundle(modelPath)){
+            model->loadBundle(modelPath);
+        }else{
+            model->loadJSON(modelPath, workingDir, options);
+        }
+        // Locations are extracted lazily; materialize them before the model is shared.
+        model->mDataStore->getLocations();
+        model->mBuilding = std::make_shared<Building>(model->mDataStore->getBuilding());
+        model->mLocationIndex = std::make_shared<LocationIndex>(model->mDataStore->getLocations(), model->mDataStore->getBLEBeacons());
+        if(options.usesPredictionGrid){
+            model->mObservationModel->buildPredictionGrid(*model->mBuilding, options.predictionGridParameters);
+            auto msec = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::system_clock::now()-s).count();
+            std::cerr << "build prediction grid: " << msec << "ms" << std::endl;
+        }
+        return model;
+    }
+    
+    const Anchor& LocalizationModel::anchor() const{
+        return mAnchor;
+    }
+    
+    DataStoreImpl::Ptr LocalizationModel::dataStore() const{
+        return mDataStore;
+    }
+    
+    Building::Ptr LocalizationModel::building() const{
+        return mBuilding;
+    }
+    
+    std::shared_ptr<const LocalizationModel::ObservationModel> LocalizationModel::observationModel() const{
+        return mObservationModel;
+    }
+    
+    LocationIndex::Ptr LocalizationModel::locationIndex() const{
+        return mLocationIndex;
+    }
+    
+    void LocalizationModel::loadJSON(const std::string& modelPath, const std::string& workingDir, const LocalizationModelOptions& options) {
+        auto s = std::chrono::system_clock::now();
+        std::ifstream file;
+        file.open(modelPath, std::ios::in);
+        if(!file.is_open()){
+            throw "model file not found at "+modelPath;
+        }
+        std::istreambuf_iterator<char> input(file);
+        
+        picojson::value v;
+        std::string err;
+        picojson::parse(v, input, std::istreambuf_iterator<char>(), &err);
+        if (!err.empty()) {
+            throw err+" with reading "+modelPath;
+        }
+        if (!v.is<picojson::object>()) {
+            throw "invalid JSON";
+        }
+        file.close();
+        auto msec = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::system_clock::now()-s).count();
+        std::cerr << "parse JSON: " << msec << "ms" << std::endl;
+        
+        picojson::value::object& json = v.get<picojson::object>();
+        
+        auto& anchor = getObject(json, "anchor");
+        mAnchor.latlng.lat = getDouble(anchor, "latitude");
+        mAnchor.latlng.lng = getDouble(anchor, "longitude");
+        mAnchor.rotate = getDouble(anchor, "rotate");
+        
+        try{
+            mAnchor.magneticDeclination = getDouble(anchor, "declination");
+        }catch(char const* e){
+            std::cerr << "declination is not set because it was not found in the anchor." << std::endl;
+            mAnchor.magneticDeclination = std::numeric_limits<double>::quiet_NaN();
+        }
+        
+        bool doTraining = true;
+        try{
+            try {
+                auto& str = getString(json, "ObservationModelParameters");
+                if (/* DISABLES CODE */ (false)) {
+                    std::string omppath = DataUtils::stringToFile(str, workingDir, "ObservationModelParameters");
+                    
+                    msec = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::system_clock::now()-s).count();
+                    std::cerr << "save deserialized model: " << msec << "ms" << std::endl;
+                    
+                    std::cerr << omppath << std::endl;
+                    //std::istringstream ompss(str);
+                    std::ifstream ompss(omppath);
+                    //if (ompss) {
+                    std::cout << "loading" << std::endl;
+                    mObservationModel->load(ompss);
+                    std::cout << "loaded" << std::endl;
+                    //}
+                } else {
+                    std::istringstream ompss(str);
+                    if (ompss) {
+                        std::cout << "loading" << std::endl;
+                        mObservationModel->load(ompss);
+                        std::cout << "loaded" << std::endl;
+                    }
+                }
+                msec = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::system_clock::now()-s).count();
+                std::cerr << "load deserialized model: " << msec << "ms" << std::endl;
+                doTraining = false;
+            } catch(LocException& e){
+                throw e;
+            } catch(const std::exception& e) {
+                LocException ex(std::string(e.what()));
+                BOOST_THROW_EXCEPTION(ex);
+            } catch(const char* ch){
+                //LocException ex((std::string(ch)));
+                //BOOST_THROW_EXCEPTION(ex);
+            } catch(...){
+                BOOST_THROW_EXCEPTION(LocException("..."));
+            }
+        }catch(LocException& e){
+            e << boost::error_info<struct err_info, std::string>("exception at loading ObservationModelParameters");
+            throw e;
+        }
+        
+        // Building - change read order to reduce memory usage peak
+        //ImageHolder::setMode(ImageHolderMode(heavy));
+        BuildingBuilder buildingBuilder;
+        
+        auto& buildings = getArray(json, "layers");
+        
+        for(int floor_num = 0; floor_num < buildings.size(); floor_num++) {
+            auto& building = buildings.at(floor_num).get<picojson::value::object>();
+            auto& param = getObject(building, "param");
+            double ppmx = getDouble(param, "ppmx");
+            double ppmy = getDouble(param, "ppmy");
+            double ppmz = getDouble(param, "ppmz");
+            double originx = getDouble(param, "originx");
+            double originy = getDouble(param, "originy");
+            double originz = getDouble(param, "originz");
+            CoordinateSystemParameters coordSysParams(ppmx, ppmy, ppmz, originx, originy, originz);
+
+            auto& data = getString(building, "data");
+            std::ostringstream ostr;
+            ostr << floor_num << "floor.png";
+            
+            std::string path = DataUtils::stringToFile(data, workingDir, ostr.str());
+            
+            int fn = floor_num;
+            if (!get(param, "floor").is<picojson::null>()) {
+                fn = (int)getDouble(param, "floor");
+            }
+            
+            buildingBuilder.addFloorCoordinateSystemParametersAndImagePath(fn, coordSysParams, path);
+            
+            msec = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::system_clock::now()-s).count();
+            std::cerr << "prepare floor model[" << floor_num << "]: " << msec << "ms" << std::endl;
+        }
+        mDataStore->building(buildingBuilder.build());
+        
+        msec = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::system_clock::now()-s).count();
+        std::cerr << "build floor model: " << msec << "ms" << std::endl;
+        
+        // Sampling data
+        
+        // Samples samples;
+        try{
+            auto& samples = getArray(json, "samples");
+            for(int i = 0; i < samples.size(); i++) {
+                auto& sample = samples.at(i).get<picojson::value::object>();
+                auto& data = getString(sample, "data");
+                
+                //std::string samplepath = DataUtils::stringToFile(data, workingDir);
+                //std::ifstream is(samplepath);
+                std::istringstream is(data);
+                mDataStore->readSamples(is);
+            }
+            {
+                std::cerr << mDataStore->getSamples().size() << " samples have been loaded" << std::endl;
+            }
+        }catch(const char* ch){
+            std::cerr << "samples have not been loaded." << std::endl;
+        }
+        msec = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::system_clock::now()-s).count();
+        std::cerr << "load sample data: " << msec << "ms" << std::endl;
+        
+        // set unique locations to data store 
+        if(mDataStore->getSamples().size() != 0){
+            const auto& uniLocs = Sample::extractUniqueLocations(mDataStore->getSamples());
+            mDataStore->locations(uniLocs);
+        }
+        
+        
+        // set sample locations
+        try{
+            auto& locationsJarray = getArray(json, "locations");
+            Locations locations;
+            for(int i = 0; i < locationsJarray.size(); i++) {
+                auto& locationsJobj = locationsJarray.at(i).get<picojson::value::object>();
+                auto& data = getString(locationsJobj, "data");
+                std::istringstream is(data);
+                DataUtils::csvLocationsToLocations(is, locations);
+            }
+            mDataStore->locations(locations);
+            {
+                std::cerr << mDataStore->getLocations().size() << " locations have been loaded" << std::endl;
+            }
+        }catch(const char* ch){
+            {
+                std::cerr << "locations have not been loaded" << std::endl;
+            }
+        }
+        msec = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::system_clock::now()-s).count();
+        std::cerr << "load location data: " << msec << "ms" << std::endl;
+        
+        if(mDataStore->getLocations().size()==0){
+            BOOST_THROW_EXCEPTION(LocException("Neither samples nor locations have been loaded"));
+        }
+        
+        
+        // set BLE beacon locations
+        BLEBeacons bleBeacons;
+        auto& beacons = getArray(json, "beacons");
+        for(int i = 0; i < beacons.size(); i++) {
+            auto& beacon = beacons.at(i).get<picojson::value::object>();
+            auto& data = getString(beacon, "data");
+            
+            std::istringstream is(data);
+            BLEBeacons bleBeaconsTmp = DataUtils::csvBLEBeaconsToBLEBeacons(is);
+            bleBeacons.insert(bleBeacons.end(), bleBeaconsTmp.begin(), bleBeaconsTmp.end());
+        }
+        mDataStore->bleBeacons(bleBeacons);
+        msec = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::system_clock::now()-s).count();
+        std::cerr << "load beacon data: " << msec << "ms" << std::endl;
+        
+        if(doTraining || options.forceTraining){
+            std::cerr << "Training will be processed" << std::endl;
+            // Train observation model
+            std::shared_ptr<GaussianProcessLDPLMultiModelTrainer<State, Beacons>>obsModelTrainer( new GaussianProcessLDPLMultiModelTrainer<State, Beacons>());
+            obsModelTrainer->setGPType(options.gpType);
+            obsModelTrainer->setNumThreads(options.nThreadsTraining);
+            obsModelTrainer->dataStore(mDataStore);
+            std::shared_ptr<GaussianProcessLDPLMultiModel<State, Beacons>> obsModel( obsModelTrainer->train());
+            //localizer->observationModel(obsModel);
+            
+            std::ostringstream oss;
+            obsModel->save(oss);
+            
+            json["ObservationModelParameters"] = (picojson::value)oss.str();
+            
+            std::ofstream of;
+            of.open(modelPath);
+            of << v.serialize();
+            of.close();
+        }
+        
+        // finalize mapdata file
+        if(options.finalizeMapdata){
+            std::cerr << "Finalizing map data." << std::endl;
+            // convert unique locations to string
+            auto uniLocs = mDataStore->getLocations();
+            std::stringstream ss;
+            for(const auto& uloc: uniLocs){
+                ss << "0,L," << uloc << std::endl;
+            }
+            auto uLocLine = ss.str();
+            
+            // modify json object
+            picojson::array locationsArray;
+            picojson::object locationsObj;
+            locationsObj.insert(std::make_pair("data", picojson::value(uLocLine)));
+            locationsArray.push_back(picojson::value(locationsObj));
+            json.insert(std::make_pair("locations", picojson::value(locationsArray)));
+            json.erase("samples");
+            
+            // output mapdata
+            std::ofstream of;
+            of.open(modelPath);
+            of << v.serialize();
+            of.close();
+        }
+    }
+    
+    void LocalizationModel::loadBundle(const std::string& bundlePath) {
+        auto s = std::chrono::system_clock::now();
+        ModelBundle::Ptr bundle = ModelBundle::open(bundlePath);
+        
+        ModelBundle::AnchorRecord anchorRecord = bundle->anchor();
+        mAnchor.latlng.lat = anchorRecord.latitude;
+        mAnchor.latlng.lng = anchorRecord.longitude;
+        mAnchor.rotate = anchorRecord.rotate;
+        mAnchor.magneticDeclination = anchorRecord.declination;
+        // Matrices of the observation model view the mapped sections and keep the bundle alive.
+        mObservationModel->loadBinary(*bundle);
+        auto msec = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::system_clock::now()-s).count();
+        std::cerr << "load deserialized model: " << msec << "ms" << std::endl;
+        
+        // Floor images refer to the mapped file.
+        mDataStore->building(bundle->building());
+        msec = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::system_clock::now()-s).count();
+        std::cerr << "build floor model: " << msec << "ms" << std::endl;
+        
+        mDataStore->locations(bundle->locations());
+        if(mDataStore->getLocations().size()==0){
+            BOOST_THROW_EXCEPTION(LocException("No locations have been loaded from " + bundlePath));
+        }
+        mDataStore->bleBeacons(bundle->bleBeacons());
+        msec = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::system_clock::now()-s).count();
+        std::cerr << "load location and beacon data: " << msec << "ms" << std::endl;
+    }
+    
+    void LocalizationModel::writeBundle(const std::string& bundlePath) const {
+        ModelBundle::AnchorRecord anchorRecord;
+        anchorRecord.latitude = mAnchor.latlng.lat;
+        anchorRecord.longitude = mAnchor.latlng.lng;
+        anchorRecord.rotate = mAnchor.rotate;
+        anchorRecord.declination = mAnchor.magneticDeclination;
+        
+        ModelBundleWriter writer;
+        writer.anchor(anchorRecord);
+        for(const auto& floor: mDataStore->getBuilding().floorMaps()){
+            const FloorMap& floorMap = floor.second;
+            writer.addFloor(floor.first, floorMap.coordinateSystem().parameters(), floorMap.image());
+        }
+        writer.locations(mDataStore->getLocations());
+        writer.bleBeacons(mDataStore->getBLEBeacons());
+        
+        mObservationModel->saveBinary(writer);
+        writer.write(bundlePath);
+    }
+}
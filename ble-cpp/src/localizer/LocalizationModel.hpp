@@ -0,0 +1,85 @@
+/*******************************************************************************
+ * Copyright (c) 2014, 2016  IBM Corporation and others
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *******************************************************************************/
+
+#ifndef LocalizationModel_hpp
+#define LocalizationModel_hpp
+
+#include <stdio.h>
+#include <memory>
+#include <string>
+
+#include "DataStoreImpl.hpp"
+#include "Building.hpp"
+#include "LatLngConverter.hpp"
+#include "GaussianProcessLDPLMultiModel.hpp"
+#include "RssiPredictionGrid.hpp"
+#include "LocationIndex.hpp"
+
+namespace loc{
+    
+    class LocalizationModelOptions{
+    public:
+        bool forceTraining = false;
+        bool finalizeMapdata = false;
+        GPType gpType = GPNORMAL;
+        int nThreadsTraining = 1; // 0: hardware concurrency
+        bool usesPredictionGrid = false;
+        RssiPredictionGridParameters predictionGridParameters;
+    };
+    
+    /**
+     Map data and observation model loaded once and shared read-only by localizers.
+     BasicLocalizer::setModel(LocalizationModel::Ptr) copies only per-session settings
+     so that many localizers can run against one loaded model.
+     **/
+    class LocalizationModel{
+    public:
+        using Ptr = std::shared_ptr<LocalizationModel>;
+        using ObservationModel = GaussianProcessLDPLMultiModel<State, Beacons>;
+        
+        // modelPath is either a JSON map data file or a model bundle.
+        static Ptr load(const std::string& modelPath, const std::string& workingDir, const LocalizationModelOptions& options = LocalizationModelOptions());
+        
+        const Anchor& anchor() const;
+        DataStoreImpl::Ptr dataStore() const; // shared, must not be modified
+        Building::Ptr building() const;
+        std::shared_ptr<const ObservationModel> observationModel() const;
+        LocationIndex::Ptr locationIndex() const; // over dataStore()->getLocations()
+        
+        // Writes the model as a binary bundle which load maps into memory without parsing.
+        void writeBundle(const std::string& bundlePath) const;
+        
+    private:
+        LocalizationModel() = default;
+        
+        void loadJSON(const std::string& modelPath, const std::string& workingDir, const LocalizationModelOptions& options);
+        void loadBundle(const std::string& bundlePath);
+        
+        Anchor mAnchor;
+        std::shared_ptr<DataStoreImpl> mDataStore;
+        Building::Ptr mBuilding;
+        LocationIndex::Ptr mLocationIndex;
+        std::shared_ptr<ObservationModel> mObservationModel;
+    };
+}
+
+#endif /* LocalizationModel_hpp */
@@ -53,7 +53,7 @@ namespace loc{
         dataStore->bleBeacons(bleBeacons);
         
         // Building
-        ImageHolder::setMode(ImageHolderMode(light));
+        ImageHolder::setMode(ImageHolderMode(dense));
         BuildingBuilder buildingBuilder;
         
         int floor_max = 1;
@@ -199,6 +199,13 @@ namespace loc{
         return *this;
     }
     
+    BuildingBuilder& BuildingBuilder::addFloorCoordinateSystemParametersAndImage(int floor_num, CoordinateSystemParameters coordinateSystemParameters, ImageHolder image){
+        
+        mFloorCoordinateSystemParametersMap[floor_num] = coordinateSystemParameters;
+        mFloorImageMap[floor_num] = image;
+        return *this;
+    }
+    
     Building BuildingBuilder::build(){
         std::map<int, FloorMap> floorsMap;
         for(auto iter= mFloorCoordinateSystemParametersMap.begin();
@@ -208,9 +215,14 @@ namespace loc{
             int floor_num = iter->first;
             std::string name = std::to_string(floor_num);
             CoordinateSystemParameters coordSysParams = mFloorCoordinateSystemParametersMap[floor_num];
-            std::string path = mFloorImagePathMap[floor_num];
             
-            ImageHolder image(path,name);
+            ImageHolder image;
+            if(mFloorImageMap.count(floor_num)!=0){
+                image = mFloorImageMap.at(floor_num);
+            }else{
+                std::string path = mFloorImagePathMap[floor_num];
+                image = ImageHolder(path,name);
+            }
             CoordinateSystem coordSys(coordSysParams);
             FloorMap floorMap(image, coordSys);
             floorsMap[floor_num] = floorMap;
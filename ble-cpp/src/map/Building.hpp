@@ -48,6 +48,8 @@ namespace loc {
         const FloorMap& getFloorAt(int floor_num) const;
         const FloorMap& getFloorAt(const Location& location) const;
         size_t nFloors() const { return this->floors.size(); }
+        bool hasFloor(int floor_num) const { return this->floors.count(floor_num)==1; }
+        const std::map<int, FloorMap>& floorMaps() const { return this->floors; }
 
         bool isMovable(const Location& location) const;
         bool isValid(const Location& location) const;
@@ -74,8 +76,11 @@ namespace loc {
     private:
         std::map<int, CoordinateSystemParameters> mFloorCoordinateSystemParametersMap;
         std::map<int, std::string> mFloorImagePathMap;
+        std::map<int, ImageHolder> mFloorImageMap;
     public:
         BuildingBuilder& addFloorCoordinateSystemParametersAndImagePath(int floor_num, CoordinateSystemParameters coordinateSystemParameters, std::string imagePath);
+        // Adds a floor with an image which has already been loaded (e.g. a label raster in a model bundle)
+        BuildingBuilder& addFloorCoordinateSystemParametersAndImage(int floor_num, CoordinateSystemParameters coordinateSystemParameters, ImageHolder image);
         Building build();
     };
 }
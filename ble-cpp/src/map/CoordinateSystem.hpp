@@ -53,6 +53,9 @@ namespace loc{
         CoordinateSystem(CoordinateSystemParameters parameters){
             mPara = parameters;
         }
+        const CoordinateSystemParameters& parameters() const{
+            return mPara;
+        }
         template<class Tstate> Tstate worldToLocalState(const Tstate& state) const;
         template<class Tstate> Tstate localToWorldState(const Tstate& state) const;
     };
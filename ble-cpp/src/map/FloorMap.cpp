@@ -38,14 +38,20 @@ namespace loc{
     using namespace color;
     
     const std::vector<Color> colorTransitionArea{colorStairs, colorElevator, colorEscalator};
+    
+    namespace{
+        const uint8_t labelFloor = ImageHolder::labelOf(colorFloor);
+        const uint8_t labelWall = ImageHolder::labelOf(colorWall);
+        const uint8_t labelStairs = ImageHolder::labelOf(colorStairs);
+        const uint8_t labelElevator = ImageHolder::labelOf(colorElevator);
+        const uint8_t labelEscalator = ImageHolder::labelOf(colorEscalator);
+    }
         
     FloorMap::FloorMap(ImageHolder image, CoordinateSystem coordSys){
         mImage = image;
         mCoordSys = coordSys;
         
-        //for(const Color&c : colorTransitionArea){
-        //    mImage.setUpIndexForColor(c);
-        //}
+        mImage.setUpNearestPointField(colorTransitionArea);
     }
 
     Color FloorMap::getColor(const Location& location) const{
@@ -60,6 +66,17 @@ namespace loc{
         }
     }
     
+    uint8_t FloorMap::getLabel(const Location& location) const{
+        Location localCoord = mCoordSys.worldToLocalState(location);
+        int x = getX(localCoord);
+        int y = getY(localCoord);
+        if(mImage.checkValid(y, x)){
+            return mImage.label(y, x);
+        }else{
+            return labelFloor;
+        }
+    }
+    
     int FloorMap::getX(const loc::Location &location) const{
         int x = doubleToImageCoordinate(location.x());
         return x;
@@ -98,6 +115,18 @@ namespace loc{
         return true;
     }
     
+    Location FloorMap::minLocation() const{
+        Location corner0 = mCoordSys.localToWorldState(Location(0, 0, 0, 0));
+        Location corner1 = mCoordSys.localToWorldState(Location(mImage.cols()-1, mImage.rows()-1, 0, 0));
+        return Location(std::min(corner0.x(), corner1.x()), std::min(corner0.y(), corner1.y()), 0, 0);
+    }
+    
+    Location FloorMap::maxLocation() const{
+        Location corner0 = mCoordSys.localToWorldState(Location(0, 0, 0, 0));
+        Location corner1 = mCoordSys.localToWorldState(Location(mImage.cols()-1, mImage.rows()-1, 0, 0));
+        return Location(std::max(corner0.x(), corner1.x()), std::max(corner0.y(), corner1.y()), 0, 0);
+    }
+    
     bool FloorMap::isInsideFloor(const Location& location) const{
         Location localCoord = mCoordSys.worldToLocalState(location);
         int x = getX(localCoord);
@@ -115,24 +144,23 @@ namespace loc{
     
 
     bool FloorMap::checkColor(const Location& location, const Color& color) const{
-        Color pixelColor = getColor(location);
-        return pixelColor.equals(color);
+        return getLabel(location) == ImageHolder::labelOf(color);
     }
 
     bool FloorMap::isWall(const Location& location) const{
-        return checkColor(location, color::colorWall);
+        return getLabel(location) == labelWall;
     }
 
     bool FloorMap::isStairs(const Location& location) const {
-        return checkColor(location, color::colorStairs);
+        return getLabel(location) == labelStairs;
     }
 
     bool FloorMap::isElevator(const Location& location) const{
-        return checkColor(location, color::colorElevator);
+        return getLabel(location) == labelElevator;
     }
 
     bool FloorMap::isEscalator(const Location& location) const{
-        return checkColor(location, color::colorEscalator);
+        return getLabel(location) == labelEscalator;
     }
     
     bool FloorMap::isEscalatorEnd(const Location& location) const{
@@ -164,17 +192,14 @@ namespace loc{
         while(count<=norm_int){
             int yInt = doubleToImageCoordinate(y);
             int xInt = doubleToImageCoordinate(x);
-            Color c = color::colorFloor;
-            bool pixelIsValid = mImage.checkValid(yInt, xInt);
-            if(pixelIsValid){
-                c = mImage.get(yInt, xInt);
-            }else{
-                c = color::colorFloor;
+            uint8_t label = labelFloor;
+            if(mImage.checkValid(yInt, xInt)){
+                label = mImage.label(yInt, xInt);
             }
-            if(c.equals(color::colorWall)){
+            if(label == labelWall){
                 return ((double)count-1)/norm_int;
             }
-            if(startIsEscEnd && c.equals(color::colorEscalator)){
+            if(startIsEscEnd && label == labelEscalator){
                 return ((double)count-1)/norm_int;
             }
             x+=dx;
@@ -229,8 +254,13 @@ namespace loc{
         return mCoordSys;
     }
     
+    const ImageHolder& FloorMap::image() const{
+        return mImage;
+    }
+    
     bool FloorMap::isTransitionArea(const Location& location) const{
-        if(isEscalator(location) || isElevator(location) || isStairs(location)){
+        uint8_t label = getLabel(location);
+        if(label == labelEscalator || label == labelElevator || label == labelStairs){
             return true;
         }else{
             return false;
@@ -240,24 +270,13 @@ namespace loc{
     std::vector<Location> FloorMap::findClosestTransitionAreaLocations(const Location& location) const{
         Location localCoord = mCoordSys.worldToLocalState(location);
         ImageHolder::Point pIm = getPoint(location);
-        ImageHolder::Point pClosest;
-        
-        double dmin = std::numeric_limits<double>::max();
-        for(auto& c: colorTransitionArea){
-            auto psRet = mImage.findClosestPoints(c, pIm);
-            if(psRet.size()==0) continue;
         
-            auto pRet = psRet.at(0);
-            double dist = ImageHolder::Point::distance(pIm, pRet);
-            if(dist < dmin){
-                dmin = dist;
-                pClosest = pRet;
-            }
-        }
         std::vector<Location> locsRet;
-        if(std::numeric_limits<double>::max()<=dmin){
+        auto psRet = mImage.findClosestPoints(colorTransitionArea, pIm);
+        if(psRet.size()==0){
             return locsRet;
         }
+        ImageHolder::Point pClosest = psRet.at(0);
         
         localCoord.x(pClosest.x);
         localCoord.y(pClosest.y);
@@ -36,6 +36,7 @@ namespace loc{
         ImageHolder mImage;
 
         Color getColor(const Location& location) const;
+        uint8_t getLabel(const Location& location) const;
         bool checkColor(const Location& location, const Color& color) const;
         int getX(const Location& location) const;
         int getY(const Location& location) const;
@@ -64,6 +65,11 @@ namespace loc{
         double estimateWallAngle(const Location&start, const Location& end) const;
         
         const CoordinateSystem& coordinateSystem() const;
+        const ImageHolder& image() const;
+        
+        // Bounding box of the floor image in world coordinate
+        Location minLocation() const;
+        Location maxLocation() const;
         
         bool isTransitionArea(const Location& location) const;
         std::vector<Location> findClosestTransitionAreaLocations(const Location& location) const;
@@ -20,11 +20,12 @@
  * THE SOFTWARE.
  *******************************************************************************/
 
+#include <array>
 #include <Eigen/SparseCore>
 #include <boost/bimap.hpp>
 #include "ImageHolder.hpp"
 #include "LocException.hpp"
-#include <opencv2/flann/flann.hpp>
+#include "NearestPointField.hpp"
 #include <opencv2/opencv.hpp>
 
 namespace loc{
@@ -39,16 +40,11 @@ namespace loc{
         return dist;
     }
     
-    ImageHolderMode ImageHolder::mode_ = light;
+    ImageHolderMode ImageHolder::mode_ = dense;
     bool ImageHolder::precomputesIndex = false;
     
-    Color::Color(uint8_t r, uint8_t g, uint8_t b){
-        r_ = r;
-        g_ = g;
-        b_ = b;
-    }
-    
-    static const std::vector<Color> colorList{
+    // Constant-initialized so that labelOf can be used during static initialization of other files.
+    static const std::array<Color, 7> colorList{{
         color::white,
         color::black,
         color::red,
@@ -68,7 +64,7 @@ namespace loc{
         color::teal,
         color::maroon
         */
-    };
+    }};
     
     static const std::vector<Color> colorsToIndices{
         color::red,
@@ -111,24 +107,20 @@ namespace loc{
         }
     }
     
-    class IndexWrapper: public cv::flann::Index{
-    public:
-        IndexWrapper(const IndexWrapper& idx) : Index(idx){};
-        IndexWrapper(): Index(){}
-        IndexWrapper(cv::InputArray data,
-                     const cv::flann::IndexParams& params,
-                     cvflann::flann_distance_t distType):
-                    Index(data, params, distType){}
-        ~IndexWrapper(){};
-    };
-    
     class ImageHolder::Impl{
     protected:
+        // Written only while indices are set up. Queries read them without locks.
         std::map<Color, ImageHolder::Points> mColorPointsMap;
-        
-        std::map<Color, cv::Mat> mColorDataMap;
+        std::map<uint8_t, NearestPointField::Ptr> mNearestPointFields; // keyed by a bit mask of labels
         mutable std::mutex mtx_;
-        mutable std::map<Color, std::shared_ptr<IndexWrapper>> mColorIndexMap;
+        
+        static uint8_t labelMask(const std::vector<Color>& colors){
+            uint8_t mask = 0;
+            for(const Color& c: colors){
+                mask |= static_cast<uint8_t>(1 << ImageHolder::labelOf(c));
+            }
+            return mask;
+        }
         
     public:
         virtual ~Impl() = default;
@@ -136,71 +128,81 @@ namespace loc{
         virtual int cols() const = 0;
         virtual Color get(int y, int x) const = 0;
         virtual std::vector<Point> getPoints(const Color& c) const = 0;
+        virtual const uint8_t* labels() const{
+            return nullptr;
+        }
         
         virtual void setUpIndices(){
             for(const Color& c: colorsToIndices){
                 this->setUpIndexForColor(c);
+                if(ImageHolder::precomputesIndex){
+                    this->setUpNearestPointField({c});
+                }
             }
         }
         
         virtual void setUpIndexForColor(const Color& c){
             std::lock_guard<std::mutex> lock(mtx_);
             if(mColorPointsMap.count(c)==0){
-                auto points = getPoints(c);
-                int n = static_cast<int>(points.size());
-                mColorPointsMap[c] = points;
-                if(n>0){
-                    cv::Mat data = cv::Mat::zeros(n, 2, CV_32FC1);
-                    for(int j=0; j<n; j++){
-                        data.at<float>(j,0) = points.at(j).x;
-                        data.at<float>(j,1) = points.at(j).y;
-                    }
-                    mColorDataMap[c] = data;
-                    if(ImageHolder::precomputesIndex){
-                        mColorIndexMap[c] = std::make_shared<IndexWrapper>(mColorDataMap[c], cv::flann::KDTreeIndexParams(), cvflann::FLANN_DIST_EUCLIDEAN);
-                    }
-                }
+                mColorPointsMap[c] = getPoints(c);
             }
         }
         
-        virtual Points findClosestPoints(const Color& c, const ImageHolder::Point& p, int k = 1) const{
-            
+        virtual void setUpNearestPointField(const std::vector<Color>& colors){
+            for(const Color& c: colors){
+                setUpIndexForColor(c);
+            }
             std::lock_guard<std::mutex> lock(mtx_);
-            
-            if(mColorPointsMap.count(c)==0){
-                LocException ex("Index is not set for the input color");
-                BOOST_THROW_EXCEPTION(ex);
+            uint8_t mask = labelMask(colors);
+            if(mNearestPointFields.count(mask)==0){
+                std::vector<int> xs, ys;
+                for(const Color& c: colors){
+                    for(const Point& p: mColorPointsMap.at(c)){
+                        xs.push_back(p.x);
+                        ys.push_back(p.y);
+                    }
+                }
+                mNearestPointFields[mask] = std::make_shared<NearestPointField>(rows(), cols(), xs, ys);
             }
-            
-            const Points& points = mColorPointsMap.at(c);
-            if(points.size()==0){
+        }
+        
+        virtual Points findClosestPoints(const std::vector<Color>& colors, const ImageHolder::Point& p, int k = 1) const{
+            if(k<=0){
                 return Points(0);
             }
-            
-            cv::Mat query = (cv::Mat_<float>(1,2) << p.x , p.y);
-            std::vector<int> indices;
-            std::vector<float> dists;
-            
-            {
-                if(ImageHolder::precomputesIndex){
-                    if(mColorIndexMap.count(c)==0){
-                        cv::Mat data = mColorDataMap.at(c);
-                        mColorIndexMap[c] = std::make_shared<IndexWrapper>(data, cv::flann::KDTreeIndexParams(), cvflann::FLANN_DIST_EUCLIDEAN);
-                    }else{
-                        mColorIndexMap.at(c)->knnSearch(query, indices, dists, k);
+            // O(1) lookup in a precomputed field
+            if(k==1 && 0<=p.y && p.y<rows() && 0<=p.x && p.x<cols()){
+                auto iter = mNearestPointFields.find(labelMask(colors));
+                if(iter!=mNearestPointFields.end()){
+                    int32_t index = iter->second->nearest(p.y, p.x);
+                    if(index<0){
+                        return Points(0);
                     }
-                }else{
-                    cv::Mat data = mColorDataMap.at(c);
-                    cv::flann::Index idx(data, cv::flann::KDTreeIndexParams(), cvflann::FLANN_DIST_EUCLIDEAN);
-                    idx.knnSearch(query, indices, dists, k);
+                    return Points{Point(index % cols(), index / cols())};
                 }
             }
-            
-            Points psRet(k);
-            for(int i=0; i<k; i++){
-                int index = indices.at(0);
-                Point pret = points.at(index);
-                psRet[i] = pret;
+            // Exhaustive search
+            std::vector<std::pair<double, Point>> candidates;
+            for(const Color& c: colors){
+                auto iter = mColorPointsMap.find(c);
+                if(iter==mColorPointsMap.end()){
+                    LocException ex("Index is not set for the input color");
+                    BOOST_THROW_EXCEPTION(ex);
+                }
+                for(const Point& q: iter->second){
+                    double dx = q.x - p.x;
+                    double dy = q.y - p.y;
+                    candidates.push_back(std::make_pair(dx*dx + dy*dy, q));
+                }
+            }
+            size_t nRet = std::min(static_cast<size_t>(k), candidates.size());
+            std::partial_sort(candidates.begin(), candidates.begin() + nRet, candidates.end(),
+                              [](const std::pair<double, Point>& a, const std::pair<double, Point>& b){
+                                  return a.first < b.first;
+                              });
+            Points psRet(nRet);
+            for(size_t i=0; i<nRet; i++){
+                psRet[i] = candidates[i].second;
             }
             return psRet;
         }
@@ -369,11 +371,112 @@ namespace loc{
         }
     };
     
+    class ImageHolder::ImplDense : public ImageHolder::Impl{
+        std::string name_;
+        int rows_ = 0;
+        int cols_ = 0;
+        std::vector<uint8_t> labels_;
+        const uint8_t* data_ = nullptr; // labels_ or an external raster
+        std::shared_ptr<const void> owner_;
+        
+    public:
+        ImplDense(){}
+        ImplDense(int rows, int cols, const uint8_t* labels, std::shared_ptr<const void> owner, const std::string& name){
+            name_ = name;
+            rows_ = rows;
+            cols_ = cols;
+            data_ = labels;
+            owner_ = owner;
+            for(size_t i=0, n=static_cast<size_t>(rows_)*cols_; i<n; i++){
+                if(colorList.size() <= data_[i]){
+                    BOOST_THROW_EXCEPTION(LocException("Invalid label in the raster of " + name));
+                }
+            }
+            this->setUpIndices();
+        }
+        ImplDense(const std::string& filepath, const std::string& name){
+            name_ = name;
+            cv::Mat image = cv::imread(filepath);
+            if(image.empty()){
+                LocException ex("Failed to read the image file at " + filepath);
+                BOOST_THROW_EXCEPTION(ex);
+            }
+            rows_ = image.rows;
+            cols_ = image.cols;
+            labels_.resize(static_cast<size_t>(rows_)*cols_);
+            
+            // Classify all pixels with table lookups instead of comparing each pixel with colorList.
+            // Each channel value is mapped to the set of colors having the value, and the sets are intersected.
+            cv::Mat channelTable(1, 256, CV_8UC3, cv::Scalar::all(0));
+            for(int i=0; i<colorList.size(); i++){
+                const Color& c = colorList.at(i);
+                uint8_t bit = static_cast<uint8_t>(1 << i);
+                channelTable.at<cv::Vec3b>(0, c.b_)[0] |= bit;
+                channelTable.at<cv::Vec3b>(0, c.g_)[1] |= bit;
+                channelTable.at<cv::Vec3b>(0, c.r_)[2] |= bit;
+            }
+            cv::Mat labelTable(1, 256, CV_8UC1, cv::Scalar::all(0));
+            for(int m=1; m<256; m++){
+                int i = 0;
+                while(((m >> i) & 1)==0){
+                    i++;
+                }
+                labelTable.at<uint8_t>(0, m) = static_cast<uint8_t>(i);
+            }
+            cv::Mat bits;
+            cv::LUT(image, channelTable, bits);
+            image.release();
+            std::vector<cv::Mat> planes;
+            cv::split(bits, planes);
+            cv::Mat matched;
+            cv::bitwise_and(planes[0], planes[1], matched);
+            cv::bitwise_and(matched, planes[2], matched);
+            cv::Mat labelMat(rows_, cols_, CV_8UC1, labels_.data());
+            cv::LUT(matched, labelTable, labelMat);
+            data_ = labels_.data();
+            
+            this->setUpIndices();
+        }
+        ~ImplDense() = default;
+        
+        int rows() const{
+            return rows_;
+        }
+        int cols() const{
+            return cols_;
+        }
+        
+        const uint8_t* labels() const override{
+            return data_;
+        }
+        
+        Color get(int y, int x) const{
+            uint8_t code = data_[static_cast<size_t>(y)*cols_ + x];
+            return colorList.at(code);
+        }
+        
+        std::vector<Point> getPoints(const Color& c) const{
+            Points points;
+            uint8_t code_q = ImageHolder::labelOf(c);
+            for(int y=0; y<rows_; y++){
+                const uint8_t* row = &data_[static_cast<size_t>(y)*cols_];
+                for(int x=0; x<cols_; x++){
+                    if(row[x] == code_q){
+                        points.push_back(Point(x, y));
+                    }
+                }
+            }
+            return points;
+        }
+    };
+    
     ImageHolder::ImageHolder(){
         if(mode_ == light){
             impl.reset(new ImplLight());
         }else if (mode_ == heavy){
             impl.reset(new ImplHeavy());
+        }else if (mode_ == dense){
+            impl.reset(new ImplDense());
         }else{
             BOOST_THROW_EXCEPTION(LocException("Unknown ImageHolderMode."));
         }
@@ -386,9 +489,20 @@ namespace loc{
         }else if (mode_ == heavy){
             std::cout << "ImageHolder::ImplHeavy is instantiated." << std::endl;
             impl.reset(new ImplHeavy(filepath, name));
+        }else if (mode_ == dense){
+            std::cout << "ImageHolder::ImplDense is instantiated." << std::endl;
+            impl.reset(new ImplDense(filepath, name));
         }else{
             BOOST_THROW_EXCEPTION(LocException("Unknown ImageHolderMode."));
         }
+        mLabels = impl->labels();
+        mCols = impl->cols();
+    }
+    
+    ImageHolder::ImageHolder(int rows, int cols, const uint8_t* labels, std::shared_ptr<const void> owner, const std::string& name){
+        impl.reset(new ImplDense(rows, cols, labels, owner, name));
+        mLabels = impl->labels();
+        mCols = impl->cols();
     }
     
     ImageHolder::~ImageHolder(){}
@@ -409,6 +523,15 @@ namespace loc{
         return impl->get(y, x);
     }
     
+    uint8_t ImageHolder::labelOf(const Color& c){
+        for(int i=0; i<colorList.size(); i++){
+            if(c.equals(colorList.at(i))){
+                return i;
+            }
+        }
+        return 0;
+    }
+    
     void ImageHolder::setUpIndexForColor(const loc::Color &c){
         impl->setUpIndexForColor(c);
     }
@@ -418,7 +541,15 @@ namespace loc{
     }
     
     ImageHolder::Points ImageHolder::findClosestPoints(const Color& c, const ImageHolder::Point& p, int k) const{
-        return impl->findClosestPoints(c, p, k);
+        return impl->findClosestPoints(std::vector<Color>{c}, p, k);
+    }
+    
+    void ImageHolder::setUpNearestPointField(const std::vector<Color>& colors){
+        impl->setUpNearestPointField(colors);
+    }
+    
+    ImageHolder::Points ImageHolder::findClosestPoints(const std::vector<Color>& colors, const ImageHolder::Point& p, int k) const{
+        return impl->findClosestPoints(colors, p, k);
     }
     
     void ImageHolder::setPrecomputesIndex(bool precomputesIdx){
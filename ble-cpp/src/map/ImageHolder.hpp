@@ -26,18 +26,20 @@
 #include <stdio.h>
 #include <iostream>
 #include <memory>
+#include <vector>
+#include <cstdint>
 
 namespace loc {
 
     enum ImageHolderMode{
-        light=0,heavy=1
+        light=0,heavy=1,dense=2
     };
     
     //Color struct is defined to keep color in RGB format.
     class Color{
     public:
         uint8_t r_, g_, b_;
-        Color(uint8_t r, uint8_t g, uint8_t b);
+        constexpr Color(uint8_t r, uint8_t g, uint8_t b) : r_(r), g_(g), b_(b){}
         bool equals(const Color& c) const;
         bool operator==(const Color& right) const;
         bool operator<(const Color& right) const;
@@ -69,8 +71,13 @@ namespace loc {
         class Impl;
         class ImplHeavy;
         class ImplLight;
+        class ImplDense;
         std::shared_ptr<Impl> impl;
         
+        // Row-major label raster owned by impl (only in dense mode)
+        const uint8_t* mLabels = nullptr;
+        int mCols = 0;
+        
         static ImageHolderMode mode_;
         static bool precomputesIndex;
         
@@ -88,6 +95,8 @@ namespace loc {
         
         ImageHolder();
         ImageHolder(const std::string& filepath, const std::string& name);
+        // Dense image viewing a row-major label raster which is kept alive by owner (e.g. a memory-mapped file)
+        ImageHolder(int rows, int cols, const uint8_t* labels, std::shared_ptr<const void> owner, const std::string& name);
         ~ImageHolder();
         
         static void setMode(ImageHolderMode mode);
@@ -98,10 +107,26 @@ namespace loc {
         bool checkValid(int y, int x) const;
         Color get(int y, int x) const;
         
+        // Label of a pixel. Colors which are not used in maps are labeled as labelOf(color::white).
+        uint8_t label(int y, int x) const{
+            if(mLabels){
+                return mLabels[static_cast<size_t>(y)*mCols + x];
+            }
+            return labelOf(get(y, x));
+        }
+        static uint8_t labelOf(const Color& c);
+        
+        // Indices must be set up before querying closest points. Queries do not lock and can run concurrently.
         void setUpIndexForColor(const Color& c);
         std::vector<Point> getPoints(const Color& c) const;
         Points findClosestPoints(const Color&c, const Point& p, int k=1) const;
         
+        // Precomputes the closest pixel having any of colors for every pixel.
+        // findClosestPoints for the same colors with k=1 is then answered in constant time.
+        void setUpNearestPointField(const std::vector<Color>& colors);
+        Points findClosestPoints(const std::vector<Color>& colors, const Point& p, int k=1) const;
+        
+        // Precomputes nearest-point fields for each indexed color when images are loaded.
         static void setPrecomputesIndex(bool precomputesIdx);
         
     };
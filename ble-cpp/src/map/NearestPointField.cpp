@@ -0,0 +1,111 @@
+/*******************************************************************************
+ * Copyright (c) 2014, 2016  IBM Corporation and others
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *******************************************************************************/
+
+#include "NearestPointField.hpp"
+#include <limits>
+
+namespace loc{
+    
+    NearestPointField::NearestPointField(int rows, int cols, const std::vector<int>& seedXs, const std::vector<int>& seedYs){
+        const int32_t none = -1;
+        mRows = rows;
+        mCols = cols;
+        size_t n = static_cast<size_t>(rows)*cols;
+        mNearest.assign(n, none);
+        
+        // Column pass: row of the closest seed in the same column
+        std::vector<int32_t> nearestRow(n, none);
+        for(size_t i=0; i<seedXs.size(); i++){
+            int x = seedXs[i];
+            int y = seedYs[i];
+            if(0<=x && x<cols && 0<=y && y<rows){
+                nearestRow[static_cast<size_t>(y)*cols + x] = y;
+                mHasSeeds = true;
+            }
+        }
+        if(!mHasSeeds){
+            return;
+        }
+        for(int x=0; x<cols; x++){
+            int32_t last = none;
+            for(int y=0; y<rows; y++){
+                int32_t& r = nearestRow[static_cast<size_t>(y)*cols + x];
+                if(r==y){
+                    last = y;
+                }else{
+                    r = last;
+                }
+            }
+            last = none;
+            for(int y=rows-1; 0<=y; y--){
+                int32_t& r = nearestRow[static_cast<size_t>(y)*cols + x];
+                if(r==y){
+                    last = y;
+                }else if(last!=none && (r==none || last-y < y-r)){
+                    r = last;
+                }
+            }
+        }
+        
+        // Row pass: lower envelope of parabolas (x-q)^2 + (y-nearestRow(q))^2 over columns q
+        const double inf = std::numeric_limits<double>::infinity();
+        std::vector<int> v(cols);
+        std::vector<double> z(cols+1);
+        std::vector<double> f(cols);
+        for(int y=0; y<rows; y++){
+            const int32_t* rowNearest = &nearestRow[static_cast<size_t>(y)*cols];
+            int k = -1;
+            for(int q=0; q<cols; q++){
+                if(rowNearest[q]==none){
+                    continue;
+                }
+                double dy = y - rowNearest[q];
+                f[q] = dy*dy;
+                if(k<0){
+                    k = 0;
+                    v[0] = q;
+                    z[0] = -inf;
+                    z[1] = inf;
+                    continue;
+                }
+                double s = ((f[q] + q*q) - (f[v[k]] + v[k]*v[k]))/(2.0*(q - v[k]));
+                while(s <= z[k]){
+                    k--;
+                    s = ((f[q] + q*q) - (f[v[k]] + v[k]*v[k]))/(2.0*(q - v[k]));
+                }
+                k++;
+                v[k] = q;
+                z[k] = s;
+                z[k+1] = inf;
+            }
+            int j = 0;
+            int32_t* out = &mNearest[static_cast<size_t>(y)*cols];
+            for(int x=0; x<cols; x++){
+                while(z[j+1] < x){
+                    j++;
+                }
+                int q = v[j];
+                out[x] = rowNearest[q]*cols + q;
+            }
+        }
+    }
+}
@@ -0,0 +1,68 @@
+/*******************************************************************************
+ * Copyright (c) 2014, 2016  IBM Corporation and others
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *******************************************************************************/
+
+#ifndef NearestPointField_hpp
+#define NearestPointField_hpp
+
+#include <stdio.h>
+#include <vector>
+#include <memory>
+#include <cstdint>
+
+namespace loc{
+    
+    // Closest seed pixel for every pixel of an image.
+    // Built by an exact Euclidean distance transform which propagates seed positions instead of distances.
+    class NearestPointField{
+    public:
+        using Ptr = std::shared_ptr<NearestPointField>;
+        
+        NearestPointField() = default;
+        ~NearestPointField() = default;
+        
+        // seedXs and seedYs are pixel coordinates of seeds. Seeds outside the image are ignored.
+        NearestPointField(int rows, int cols, const std::vector<int>& seedXs, const std::vector<int>& seedYs);
+        
+        int rows() const{
+            return mRows;
+        }
+        int cols() const{
+            return mCols;
+        }
+        bool hasSeeds() const{
+            return mHasSeeds;
+        }
+        
+        // Row-major index (y*cols + x) of the closest seed to a pixel inside the image, or -1 if there are no seeds.
+        int32_t nearest(int y, int x) const{
+            return mNearest[static_cast<size_t>(y)*mCols + x];
+        }
+        
+    private:
+        int mRows = 0;
+        int mCols = 0;
+        bool mHasSeeds = false;
+        std::vector<int32_t> mNearest;
+    };
+}
+
+#endif /* NearestPointField_hpp */
@@ -43,7 +43,29 @@ namespace loc{
     }
     
     template <class Tstate, class Tinput>
-    State MetropolisSampler<Tstate, Tinput>::findInitialMaxLikelihoodState(){
+    void MetropolisSampler<Tstate, Tinput>::computeLogLikelihood(const std::vector<Tstate>& states, std::vector<double>& logLLs){
+        size_t n = states.size();
+        int nThreads = mParams.nThreads;
+        if(nThreads==1 || n<2){
+            logLLs = mObsModel->computeLogLikelihood(states, mInput);
+            return;
+        }
+        if(!mThreadPool || (0<nThreads && mThreadPool->numThreads()!=nThreads)){
+            mThreadPool = std::make_shared<ThreadPool>(nThreads);
+        }
+        size_t nPartitions = std::min(n, (size_t) mThreadPool->numThreads());
+        logLLs.resize(n);
+        mThreadPool->parallelFor(nPartitions, [&](size_t p){
+            size_t begin = n*p/nPartitions;
+            size_t end = n*(p+1)/nPartitions;
+            std::vector<Tstate> part(states.begin()+begin, states.begin()+end);
+            std::vector<double> partLogLLs = mObsModel->computeLogLikelihood(part, mInput);
+            std::copy(partLogLLs.begin(), partLogLLs.end(), logLLs.begin()+begin);
+        });
+    }
+    
+    template <class Tstate, class Tinput>
+    void MetropolisSampler<Tstate, Tinput>::findInitialStates(){
         Locations locations;
         
         if (mParams.initType == INIT_WITH_SAMPLE_LOCATIONS) {
@@ -66,24 +88,34 @@ namespace loc{
 
         }
         auto states = mStatusInitializer->initializeStatesFromLocations(locations);
-        std::vector<double> logLLs = mObsModel->computeLogLikelihood(states, mInput);
-        auto iterMax = std::max_element(logLLs.begin(), logLLs.end());
-        size_t index = std::distance(logLLs.begin(), iterMax);
-        Tstate locMaxLL = states.at(index);
+        std::vector<double> logLLs;
+        computeLogLikelihood(states, logLLs);
         
-        if(isVerbose){
-            std::cout << "findInitialMaxLikelihoodState: states.size=" << states.size() << "max state=" << locMaxLL << std::endl;
+        // Chains start from the most likely states.
+        std::vector<int> indices(states.size());
+        std::iota(indices.begin(), indices.end(), 0);
+        size_t nChains = std::max(1, mParams.nChains);
+        size_t nTop = std::min(nChains, indices.size());
+        std::partial_sort(indices.begin(), indices.begin()+nTop, indices.end(), [&](int a, int b){
+            return logLLs.at(a) > logLLs.at(b);
+        });
+        currentStates.resize(nChains);
+        currentLogLLs.resize(nChains);
+        for(size_t c=0; c<nChains; c++){
+            int index = indices.at(c%nTop);
+            currentStates[c] = states.at(index);
+            currentLogLLs[c] = logLLs.at(index);
         }
         
-        return locMaxLL;
+        if(isVerbose){
+            std::cout << "findInitialStates: states.size=" << states.size() << "max state=" << currentStates.at(0) << std::endl;
+        }
     }
     
     template <class Tstate, class Tinput>
     void MetropolisSampler<Tstate, Tinput>::initialize(){
         clear();
-        currentState = findInitialMaxLikelihoodState();
-        std::vector<Tstate> ss = {currentState};
-        currentLogLL = mObsModel->computeLogLikelihood(ss, mInput).at(0);
+        findInitialStates();
     }
     
     template <class Tstate, class Tinput>
@@ -93,8 +125,9 @@ namespace loc{
     
     template <class Tstate, class Tinput>
     void MetropolisSampler<Tstate, Tinput>::startBurnIn(int burnIn){
+        // Every chain is advanced burnIn steps.
         for(int i=0; i<burnIn; i++){
-            sample();
+            step(true, true);
         }
         isBurnInFinished = true;
     }
@@ -114,59 +147,70 @@ namespace loc{
         return allLogLLs;
     }
     
+    template <class Tstate, class Tinput>
+    void MetropolisSampler<Tstate, Tinput>::retain(const Tstate& state, double logLL){
+        int maxRetained = mParams.maxRetainedSamples;
+        if(maxRetained<=0){
+            allStates.push_back(state);
+            allLogLLs.push_back(logLL);
+            return;
+        }
+        auto greater = [this](int a, int b){
+            return allLogLLs[a] > allLogLLs[b];
+        };
+        if(allStates.size() < static_cast<size_t>(maxRetained)){
+            allStates.push_back(state);
+            allLogLLs.push_back(logLL);
+            heapIndices.push_back((int) allStates.size()-1);
+            std::push_heap(heapIndices.begin(), heapIndices.end(), greater);
+        }else if(allLogLLs[heapIndices.front()] < logLL){
+            // Replace the least likely retained sample.
+            std::pop_heap(heapIndices.begin(), heapIndices.end(), greater);
+            int index = heapIndices.back();
+            allStates[index] = state;
+            allLogLLs[index] = logLL;
+            std::push_heap(heapIndices.begin(), heapIndices.end(), greater);
+        }
+    }
+    
     template <class Tstate, class Tinput>
     bool MetropolisSampler<Tstate, Tinput>::sample(){
         return sample(true, true);
     }
     
-    // This function returns the result whether a proposed sample was accepted or not.
+    // This function returns the result whether a proposed sample was accepted or not in any chain.
     template <class Tstate, class Tinput>
     bool MetropolisSampler<Tstate, Tinput>::sample(bool transitLoc, bool transitRssiBias){
-        Tstate stateNew = transitState(currentState, transitLoc, transitRssiBias);
-        
-        std::vector<Tstate> ss = {stateNew};
-        double logLLNew = mObsModel->computeLogLikelihood(ss, mInput).at(0);
-        
-        double r = std::exp(logLLNew-currentLogLL); // p(xnew)/p(x) = exp(log(p(xnew))-log(p(xpre)))
-        
-        bool isAccepted = false;
-        if(randGen.nextDouble() < r){
-            currentState = stateNew;
-            currentLogLL = logLLNew;
-            isAccepted = true;
+        return 0 < step(transitLoc, transitRssiBias);
+    }
+    
+    // Advances all chains by one step and returns the number of accepted proposals.
+    template <class Tstate, class Tinput>
+    int MetropolisSampler<Tstate, Tinput>::step(bool transitLoc, bool transitRssiBias){
+        size_t nChains = currentStates.size();
+        proposedStates.resize(nChains);
+        for(size_t c=0; c<nChains; c++){
+            proposedStates[c] = transitState(currentStates[c], transitLoc, transitRssiBias);
         }
-        // Save current state
-        allStates.push_back(Tstate(currentState));
-        allLogLLs.push_back(currentLogLL);
+        computeLogLikelihood(proposedStates, proposedLogLLs);
         
-        return isAccepted;
+        int nAccepted = 0;
+        for(size_t c=0; c<nChains; c++){
+            double r = std::exp(proposedLogLLs[c]-currentLogLLs[c]); // p(xnew)/p(x) = exp(log(p(xnew))-log(p(xpre)))
+            if(randGen.nextDouble() < r){
+                currentStates[c] = proposedStates[c];
+                currentLogLLs[c] = proposedLogLLs[c];
+                nAccepted++;
+            }
+            // Save current state
+            retain(currentStates[c], currentLogLLs[c]);
+        }
+        return nAccepted;
     }
     
     template <class Tstate, class Tinput>
     std::vector<Tstate> MetropolisSampler<Tstate, Tinput>::sampling(int n){
         return sampling(n, mParams.withOrdering);
-        /*
-        std::vector<Tstate> sampledStates;
-        int count = 0;
-        int countAccepted = 0;
-        for(int i=1; ;i++){
-            bool isAccepted = sample();
-            count++;
-            if(isAccepted){
-                countAccepted++;
-            }
-            if(i%mParams.interval==0){
-                sampledStates.push_back(Tstate(currentState));
-            }
-            if(sampledStates.size()>=n){
-                break;
-            }
-        }
-        
-        std::cout << "M-H acceptance rate = " << (double)countAccepted / (double) count << " (" << countAccepted << "/" << count << ")" << std::endl;
-        
-        return sampledStates;
-        */
     }
     
     template <class Tstate, class Tinput>
@@ -183,13 +227,12 @@ namespace loc{
             if(n==0){
                 break;
             }
-            bool isAccepted = sample();
-            count++;
-            if(isAccepted){
-                countAccepted++;
-            }
+            countAccepted += step(true, true);
+            count += currentStates.size();
             if(i%mParams.interval==0){
-                sampledStates.push_back(Tstate(currentState));
+                for(size_t c=0; c<currentStates.size() && sampledStates.size()<static_cast<size_t>(n); c++){
+                    sampledStates.push_back(Tstate(currentStates[c]));
+                }
             }
             if(sampledStates.size()>=n){
                 break;
@@ -203,29 +246,22 @@ namespace loc{
         if(! withOrderging){
             return sampledStates;
         }else{
-            sampledStates = std::vector<State>();
+            std::vector<Tstate> recentStates;
+            recentStates.swap(sampledStates);
+            size_t nSelected = std::min((size_t) n, allStates.size());
             std::vector<int> indices(allStates.size());
-            // create indices = {1,2,3,...,n};
+            // create indices = {0,1,2,...,n-1};
             std::iota(indices.begin(), indices.end(), 0);
-    
-            std::sort(indices.begin(), indices.end(),[&](int a, int b){
-                return allLogLLs.at(a) < allLogLLs.at(b);
-            });
             
-            double logLLMemo = std::numeric_limits<double>::lowest();
-            for(int i=0; ;i++){
-                //std::cout << "indices.size() = " << indices.size() << std::endl;
-                int index = indices.at(indices.size()-1-i);
-                double logLL = allLogLLs.at(index);
-//                if(logLLMemo!=logLL)
-                {
-                    logLLMemo = logLL;
-                    sampledStates.push_back(allStates.at(index));
-                    //std::cout << "state=" << allStates.at(index) << ", logLL=" << logLLMemo << std::endl;
-                }
-                if(sampledStates.size()>=n){
-                    break;
-                }
+            std::partial_sort(indices.begin(), indices.begin()+nSelected, indices.end(), [&](int a, int b){
+                return allLogLLs.at(a) > allLogLLs.at(b);
+            });
+            for(size_t i=0; i<nSelected; i++){
+                sampledStates.push_back(allStates.at(indices.at(i)));
+            }
+            // Fewer samples than n are retained when maxRetainedSamples < n.
+            for(size_t i=0; sampledStates.size()<static_cast<size_t>(n) && i<recentStates.size(); i++){
+                sampledStates.push_back(recentStates.at(i));
             }
         }
         return sampledStates;
@@ -235,9 +271,11 @@ namespace loc{
     std::vector<Tstate> MetropolisSampler<Tstate, Tinput>::sampling(int n, const Location &location){
         Locations locs = {location};
         auto states = mStatusInitializer->initializeStatesFromLocations(locs);
-        std::vector<Tstate> ss = {states};
-        currentState = ss.at(0);
-        currentLogLL = mObsModel->computeLogLikelihood(ss, mInput).at(0);
+        std::vector<double> logLLs;
+        computeLogLikelihood(states, logLLs);
+        size_t nChains = std::max(1, mParams.nChains);
+        currentStates.assign(nChains, states.at(0));
+        currentLogLLs.assign(nChains, logLLs.at(0));
         
         std::vector<Tstate> sampledStates;
         int count = 0;
@@ -246,13 +284,12 @@ namespace loc{
             if(n==0){
                 break;
             }
-            bool isAccepted = sample(false, true);
-            count++;
-            if(isAccepted){
-                countAccepted++;
-            }
+            countAccepted += step(false, true);
+            count += nChains;
             if(i%mParams.interval==0){
-                sampledStates.push_back(Tstate(currentState));
+                for(size_t c=0; c<nChains && sampledStates.size()<static_cast<size_t>(n); c++){
+                    sampledStates.push_back(Tstate(currentStates[c]));
+                }
             }
             if(sampledStates.size()>=n){
                 break;
@@ -289,6 +326,7 @@ namespace loc{
     void MetropolisSampler<Tstate, Tinput>::clear(){
         allStates.clear();
         allLogLLs.clear();
+        heapIndices.clear();
     }
     
     template <class Tstate, class Tinput>
@@ -30,6 +30,7 @@
 #include "ObservationModel.hpp"
 #include "StatusInitializer.hpp"
 #include "StatusInitializerImpl.hpp"
+#include "ThreadPool.hpp"
 
 namespace loc{
     
@@ -40,6 +41,8 @@ namespace loc{
     
     // This class generates samples following p(state|observation) by using the Metropolis algorithm.
     // When withOrdering is set to true, sampling(int n) function returns n largest log-likelihood states from the all generated samples. When withOrdering is false, the latest n samples with the defined interval are returned.
+    // nChains chains start from the nChains most likely initial locations and are advanced together;
+    // the proposals of all chains are evaluated in one call of the observation model per step.
     template<class Tstate, class Tinput>
     class MetropolisSampler : public ObservationDependentInitializer<Tstate, Tinput>{
     public:
@@ -50,6 +53,9 @@ namespace loc{
             double radius2D = 10;
             bool withOrdering = false;
             InitType initType = INIT_WITH_SAMPLE_LOCATIONS;
+            int nChains = 1; // each chain runs burnIn steps, so nChains x burnIn states are evaluated
+            int nThreads = 1; // threads evaluating proposals (0: hardware concurrency). The observation model must be thread-safe if not 1.
+            int maxRetainedSamples = 0; // the number of the most likely samples kept for withOrdering and getAllStates (0: all)
         };
         bool isVerbose = false;
     private:
@@ -62,15 +68,23 @@ namespace loc{
         
         void initialize();
         
-        Tstate currentState;
-        double currentLogLL;
+        std::vector<Tstate> currentStates;
+        std::vector<double> currentLogLLs;
+        std::vector<Tstate> proposedStates;
+        std::vector<double> proposedLogLLs;
+        ThreadPool::Ptr mThreadPool;
         
         bool isBurnInFinished = false;
         
+        // Retained samples. When maxRetainedSamples is set, heapIndices is a min-heap of their log-likelihoods.
         std::vector<Tstate> allStates;
         std::vector<double> allLogLLs;
+        std::vector<int> heapIndices;
+        void retain(const Tstate& state, double logLL);
         
-        State findInitialMaxLikelihoodState();
+        void findInitialStates();
+        void computeLogLikelihood(const std::vector<Tstate>& states, std::vector<double>& logLLs);
+        int step(bool transitLoc, bool transitRssiBias);
         State transitState(Tstate state);
         State transitState(Tstate state, bool transitLoc, bool transitRssiBias);
         
@@ -23,6 +23,11 @@
 #include "GaussianProcess.hpp"
 #include "ArrayUtils.hpp"
 #include "SerializeUtils.hpp"
+#include "LocException.hpp"
+#include <thread>
+#include <atomic>
+#include <new>
+#include <type_traits>
 
 namespace loc{
 
@@ -31,12 +36,19 @@ namespace loc{
         ar(CEREAL_NVP(sigmaN_));
         // ar(CEREAL_NVP(mKernel));
         ar(CEREAL_NVP(mGaussianKernel));
-        ar(CEREAL_NVP(X_));
-        ar(CEREAL_NVP(Weights_));
+        Eigen::MatrixXd X = X_;
+        Eigen::MatrixXd Weights = Weights_;
+        ar(cereal::make_nvp("X_", X));
+        ar(cereal::make_nvp("Weights_", Weights));
+        if(std::is_base_of<cereal::detail::InputArchiveBase, Archive>::value){
+            trained(X, Weights);
+        }
     }
     // Explicit instanciation
     template void GaussianProcess::serialize<cereal::JSONInputArchive> (cereal::JSONInputArchive& archive);
     template void GaussianProcess::serialize<cereal::JSONOutputArchive> (cereal::JSONOutputArchive& archive);
+    template void GaussianProcess::serialize<cereal::PortableBinaryInputArchive> (cereal::PortableBinaryInputArchive& archive);
+    template void GaussianProcess::serialize<cereal::PortableBinaryOutputArchive> (cereal::PortableBinaryOutputArchive& archive);
     
     GaussianProcess& GaussianProcess::sigmaN(double sigmaN){
         sigmaN_ = sigmaN;
@@ -72,34 +84,124 @@ namespace loc{
         return X_;
     }
     
+    const Eigen::Map<const Eigen::MatrixXd>& GaussianProcess::weights() const{
+        return Weights_;
+    }
+    
+    GaussianProcess& GaussianProcess::trained(const Eigen::MatrixXd& X, const Eigen::MatrixXd& Weights){
+        auto storage = std::make_shared<std::pair<Eigen::MatrixXd, Eigen::MatrixXd>>(X, Weights);
+        const Eigen::MatrixXd& Xs = storage->first;
+        const Eigen::MatrixXd& Ws = storage->second;
+        return trained(Eigen::Map<const Eigen::MatrixXd>(Xs.data(), Xs.rows(), Xs.cols()),
+                       Eigen::Map<const Eigen::MatrixXd>(Ws.data(), Ws.rows(), Ws.cols()),
+                       storage);
+    }
+    
+    GaussianProcess& GaussianProcess::trained(const Eigen::Map<const Eigen::MatrixXd>& X, const Eigen::Map<const Eigen::MatrixXd>& Weights, std::shared_ptr<const void> storage){
+        if(X.rows()!=Weights.rows()){
+            BOOST_THROW_EXCEPTION(LocException("the numbers of rows of X and Weights are different"));
+        }
+        mTrainedStorage = storage;
+        // Rebind the views (Map::operator= would copy the values)
+        new (&X_) Eigen::Map<const Eigen::MatrixXd>(X.data(), X.rows(), X.cols());
+        new (&Weights_) Eigen::Map<const Eigen::MatrixXd>(Weights.data(), Weights.rows(), Weights.cols());
+        return *this;
+    }
+    
     Eigen::MatrixXd GaussianProcess::Y() const{
         return Y_;
     }
     
     GaussianProcess& GaussianProcess::fit(const Eigen::MatrixXd & X, const Eigen::MatrixXd& Y){
-        size_t n = Y_.rows();
-        size_t ny = Y_.cols();
+        size_t n = Y.rows();
+        size_t ny = Y.cols();
         Eigen::MatrixXd Actives = Eigen::MatrixXd::Constant(n, ny, 1.0);
         return fit(X,Y,Actives);
     }
     
     GaussianProcess& GaussianProcess::fit(const Eigen::MatrixXd & X, const Eigen::MatrixXd& Y, const Eigen::MatrixXd& Actives){
+        Eigen::MatrixXd Ky = computeKernelMatrix(X);
+        Ky.diagonal().array() += sigmaN_*sigmaN_;
+        return fit(X, Y, Actives, Ky);
+    }
+    
+    GaussianProcess& GaussianProcess::fit(const Eigen::MatrixXd & X, const Eigen::MatrixXd& Y, const Eigen::MatrixXd& Actives, Eigen::MatrixXd& Ky){
         actives(Actives);
-        X_ = X;
         Y_ = Y;
-        size_t ns = X.rows();
-        
-        K_ = computeKernelMatrix(X);
-        Eigen::MatrixXd sigmaNmat = (sigmaN_*sigmaN_) * Eigen::MatrixXd::Identity(ns,ns);
         
-        Ky_ = K_ + sigmaNmat;
-        invKy_ = Ky_.inverse();
+        factorize(Ky);
         
-        Weights_ = invKy_*Y_;
+        trained(X, solveKy(Y_));
         
         return *this;
     }
     
+    void GaussianProcess::factorize(Eigen::MatrixXd& Ky){
+        diagInvKy_.resize(0);
+        usesLDLT_ = false;
+        lltKy_.compute(Ky);
+        if(lltKy_.info()==Eigen::Success){
+            return;
+        }
+        // Ky is not numerically positive definite. Try LDLT, then LLT with increasing jitter.
+        std::cerr << "LLT decomposition failed. LDLT is used instead." << std::endl;
+        ldltKy_.compute(Ky);
+        if(ldltKy_.info()==Eigen::Success && ldltKy_.isPositive() && 0 < ldltKy_.vectorD().minCoeff()){
+            usesLDLT_ = true;
+            return;
+        }
+        double jitter = 1.0e-10 * Ky.diagonal().mean();
+        for(int i=0; i<8; i++){
+            Ky.diagonal().array() += jitter;
+            lltKy_.compute(Ky);
+            if(lltKy_.info()==Eigen::Success){
+                std::cerr << "LLT decomposition succeeded with jitter=" << jitter << std::endl;
+                return;
+            }
+            jitter *= 10;
+        }
+        BOOST_THROW_EXCEPTION(LocException("Failed to factorize the kernel matrix."));
+    }
+    
+    Eigen::MatrixXd GaussianProcess::solveKy(const Eigen::MatrixXd& B) const{
+        if(usesLDLT_){
+            return ldltKy_.solve(B);
+        }
+        return lltKy_.solve(B);
+    }
+    
+    double GaussianProcess::logDeterminantKy() const{
+        double logdetKy = 0;
+        if(usesLDLT_){
+            logdetKy = ldltKy_.vectorD().array().log().sum();
+        }else{
+            logdetKy = 2.0*lltKy_.matrixLLT().diagonal().array().log().sum();
+        }
+        return logdetKy;
+    }
+    
+    const Eigen::VectorXd& GaussianProcess::diagonalOfInverseKy(){
+        if(diagInvKy_.size()==0){
+            if(usesLDLT_){
+                size_t n = ldltKy_.rows();
+                diagInvKy_ = ldltKy_.solve(Eigen::MatrixXd::Identity(n, n)).diagonal();
+            }else{
+                // diag(Ky^-1) = squared column norms of L^-1, computed by blocks of columns
+                size_t n = lltKy_.rows();
+                static const size_t blockSize = 64;
+                diagInvKy_.resize(n);
+                for(size_t start=0; start<n; start+=blockSize){
+                    size_t nb = std::min(blockSize, n-start);
+                    Eigen::MatrixXd invLBlock = Eigen::MatrixXd::Zero(n, nb);
+                    invLBlock.block(start, 0, nb, nb).setIdentity();
+                    lltKy_.matrixL().solveInPlace(invLBlock);
+                    diagInvKy_.segment(start, nb) = invLBlock.colwise().squaredNorm().transpose();
+                }
+            }
+        }
+        return diagInvKy_;
+    }
+    
     GaussianProcess& GaussianProcess::actives(const Eigen::MatrixXd &Actives){
         Actives_ = Actives;
         return *this;
@@ -150,7 +252,7 @@ namespace loc{
             double k = mGaussianKernel.computeKernel(x, x_i);
             kstar(i) = k;
         }
-        delete x_i;
+        delete[] x_i;
         
         return kstar;
     }
@@ -187,6 +289,52 @@ namespace loc{
         return ypreds;
     }
     
+    void GaussianProcess::predict(const double xs[], size_t n, const std::vector<int>& indices, double ypreds[]) const{
+        using RowMajorMatrixXd = Eigen::Matrix<double, Eigen::Dynamic, Eigen::Dynamic, Eigen::RowMajor>;
+        
+        size_t ns = X_.rows();
+        size_t nx = X_.cols();
+        size_t m = indices.size();
+        if(n==0 || m==0){
+            return;
+        }
+        
+        // Scratch buffers are kept per thread to avoid allocation in repeated calls.
+        static const size_t blockSize = 256;
+        thread_local std::vector<double> xtrain;
+        thread_local std::vector<double> weights;
+        thread_local std::vector<double> kstars;
+        xtrain.resize(ns*nx);
+        weights.resize(ns*m);
+        kstars.resize(std::min(n, blockSize)*ns);
+        
+        // Copy training inputs to row-major order and gather weights of the requested outputs
+        for(size_t i=0; i<ns; i++){
+            for(size_t k=0; k<nx; k++){
+                xtrain[i*nx+k] = X_(i,k);
+            }
+        }
+        Eigen::Map<Eigen::MatrixXd> W(weights.data(), ns, m);
+        for(size_t j=0; j<m; j++){
+            W.col(j) = Weights_.col(indices[j]);
+        }
+        
+        // Ypred = Kstar * W for each block of points
+        for(size_t start=0; start<n; start+=blockSize){
+            size_t nb = std::min(blockSize, n-start);
+            for(size_t i=0; i<nb; i++){
+                const double* x = &xs[(start+i)*nx];
+                double* kstar = &kstars[i*ns];
+                for(size_t l=0; l<ns; l++){
+                    kstar[l] = mGaussianKernel.computeKernel(x, &xtrain[l*nx]);
+                }
+            }
+            Eigen::Map<RowMajorMatrixXd> Kstar(kstars.data(), nb, ns);
+            Eigen::Map<RowMajorMatrixXd> Ypred(&ypreds[start*m], nb, m);
+            Ypred.noalias() = Kstar*W;
+        }
+    }
+    
     Eigen::VectorXd GaussianProcess::predictVarianceF(double x[]) const{
         Eigen::VectorXd kstar = computeKstar(x);
         return predictVarianceF(kstar);
@@ -194,7 +342,13 @@ namespace loc{
     
     Eigen::VectorXd GaussianProcess::predictVarianceF(const Eigen::VectorXd& kstar) const{
         //Eigen::VectorXd varianceF = mKernel->variance() - ((kstar.transpose())*invKy_*(kstar)).array();
-        Eigen::VectorXd varianceF = mGaussianKernel.variance() - ((kstar.transpose())*invKy_*(kstar)).array();
+        double kInvKk;
+        if(usesLDLT_){
+            kInvKk = kstar.dot(ldltKy_.solve(kstar));
+        }else{
+            kInvKk = lltKy_.matrixL().solve(kstar).squaredNorm();
+        }
+        Eigen::VectorXd varianceF = Eigen::VectorXd::Constant(1, mGaussianKernel.variance() - kInvKk);
         return varianceF;
     }
     
@@ -222,18 +376,12 @@ namespace loc{
         size_t m = Y_.cols();
         double sumMarginalLogLL = 0;
         
-        double logdetKy = 0;
-        Eigen::VectorXcd eigs = Ky_.eigenvalues();
-        
-        for(int i=0; i<eigs.size(); i++){
-            std::complex<double> eig = eigs(i);
-            logdetKy += log(eig.real());
-        }
+        double logdetKy = logDeterminantKy();
         
         // compute marginal log-likelihood for each BLE beacon
         for(int i=0; i<m; i++){
-            Eigen::VectorXd y = Y_.col(i);
-            double marginalLogLL = - 0.5*y.transpose()*invKy_*y - 0.5*logdetKy - 0.5*n*log(2*M_PI);
+            double yInvKyy = Y_.col(i).dot(Weights_.col(i));
+            double marginalLogLL = - 0.5*yInvKyy - 0.5*logdetKy - 0.5*n*log(2*M_PI);
             sumMarginalLogLL += marginalLogLL;
         }
         return sumMarginalLogLL;
@@ -243,15 +391,17 @@ namespace loc{
         size_t n = Y_.rows();
         size_t m = Y_.cols();
         
+        const Eigen::VectorXd& diagInvKy = diagonalOfInverseKy();
+        
         double sumPredLogLL = 0;
         for(int j=0; j<m; j++){
             double predLogLL_j = 0;
-            Eigen::VectorXd invKy_y = invKy_*(Y_.col(j));
+            // Weights_ = invKy*Y_
             for(int i=0; i<n; i++){
                 double y = Y_(i,j);
                 if(Actives_(i,j)==1){
-                    double mu = y - invKy_y(i)/invKy_(i,i);
-                    double sigma_p2 = 1.0/invKy_(i,i);
+                    double mu = y - Weights_(i,j)/diagInvKy(i);
+                    double sigma_p2 = 1.0/diagInvKy(i);
                     double sigma_p = sqrt(sigma_p2);
                     double predLogLL_j_i = MathUtils::logProbaNormal(y, mu, sigma_p);
                     predLogLL_j += predLogLL_j_i;
@@ -264,24 +414,21 @@ namespace loc{
     
     /**
      Compute leave-one-out MSE. (Note) LOO-MSE does not depend on the scale.
+     LOO residual is computed as [invKy*y]_i/[invKy]_ii, which is equal to (y_i - ypred_i)/(1-H_ii) with H = K*invKy.
      **/
     double GaussianProcess::leaveOneOutMSE(){
         
         size_t n = Y_.rows();
         size_t m = Y_.cols();
         
-        Eigen::MatrixXd Hmat =K_*invKy_;
-        Eigen::MatrixXd Ypred = Hmat*Y_;
+        const Eigen::VectorXd& diagInvKy = diagonalOfInverseKy();
         
         double sumSquareError = 0;
         int count = 0;
         for(int j=0; j<m; j++){
             for(int i=0; i<n; i++){
                 if(Actives_(i,j)==1){
-                    double y = Y_(i,j);
-                    double ypred = Ypred(i,j);
-                    double ei = y - ypred;
-                    double diff = ei/(1.0-Hmat(i,i));
+                    double diff = Weights_(i,j)/diagInvKy(i);
                     double errorcv = diff*diff;
                     sumSquareError += errorcv;
                     count++;
@@ -319,32 +466,99 @@ namespace loc{
         std::vector<GaussianProcessParameters> gkParamsMatrix
                 = createParameterMatrix(mParameterSet);
         size_t nEval = gkParamsMatrix.size();
-        double minValue = std::numeric_limits<double>::max();
-        std::vector<double> gkParamsRowMin(6);
+        size_t n = X.rows();
         
-        int indexMinError = 0;
+        // Squared distances are shared by all candidates when length scales of x, y and z are equal.
+        bool sharesDistances = X.cols()==4;
+        for(const auto& gpParams: gkParamsMatrix){
+            const auto& l = gpParams.gaussianKernelParameters.lengthes;
+            sharesDistances = sharesDistances && l[0]==l[1] && l[1]==l[2];
+        }
+        Eigen::MatrixXd D2xyz;
+        Eigen::MatrixXd D2floor;
+        if(sharesDistances){
+            D2xyz.resize(n, n);
+            D2floor.resize(n, n);
+            for(int j=0; j<n; j++){
+                for(int i=j; i<n; i++){
+                    double dx = X(i,0) - X(j,0);
+                    double dy = X(i,1) - X(j,1);
+                    double dz = X(i,2) - X(j,2);
+                    double df = X(i,3) - X(j,3);
+                    D2xyz(i,j) = D2xyz(j,i) = dx*dx + dy*dy + dz*dz;
+                    D2floor(i,j) = D2floor(j,i) = df*df;
+                }
+            }
+        }
+        
+        // Evaluate candidates in parallel. Each score only depends on its candidate, so the result does not depend on the number of threads.
+        std::vector<double> scores(nEval, std::numeric_limits<double>::quiet_NaN());
+        std::atomic<size_t> next(0);
+        auto evaluate = [&](){
+            while(true){
+                size_t i = next++;
+                if(nEval<=i){
+                    break;
+                }
+                GaussianKernel::Parameters gkParams = gkParamsMatrix.at(i).gaussianKernelParameters;
+                double sigma_n = gkParamsMatrix.at(i).sigmaN;
+                GaussianProcess gp;
+                gp.sigmaN(sigma_n);
+                gp.gaussianKernel(GaussianKernel(gkParams));
+                try{
+                    if(sharesDistances){
+                        double variance = gkParams.sigma_f*gkParams.sigma_f;
+                        double invL2xyz = 1.0/(gkParams.lengthes[0]*gkParams.lengthes[0]);
+                        double invL2floor = 1.0/(gkParams.lengthes[3]*gkParams.lengthes[3]);
+                        Eigen::MatrixXd Ky = (variance*(-(D2xyz*invL2xyz + D2floor*invL2floor)).array().exp()).matrix();
+                        Ky.diagonal().array() += sigma_n*sigma_n;
+                        gp.fit(X, Y, Actives, Ky);
+                    }else{
+                        gp.fit(X, Y, Actives);
+                    }
+                    scores[i] = gp.leaveOneOutMSE();
+                }catch(LocException& e){
+                    std::cerr << "Failed to evaluate kernel parameters=" << gkParams.toString() << "," << sigma_n << std::endl;
+                }
+            }
+        };
+        int nThreads = mNumThreads;
+        if(nThreads<=0){
+            nThreads = std::max(1, (int) std::thread::hardware_concurrency());
+        }
+        nThreads = std::min(nThreads, (int) nEval);
+        std::vector<std::thread> threads;
+        for(int t=1; t<nThreads; t++){
+            threads.push_back(std::thread(evaluate));
+        }
+        evaluate();
+        for(auto& th: threads){
+            th.join();
+        }
+        
+        // Select the candidate with the minimum score. Ties are broken by the order of candidates.
+        double minValue = std::numeric_limits<double>::max();
+        int indexMinError = -1;
         for(int i=0; i<nEval; i++){
-            GaussianKernel::Parameters gkParams = gkParamsMatrix.at(i).gaussianKernelParameters;
-            double sigma_n = gkParamsMatrix.at(i).sigmaN;
-            this->sigmaN(sigma_n);
-            GaussianKernel gKernel(gkParams);
-            this->gaussianKernel(gKernel);
-            // fit GP
-            this->fit(X,Y,Actives);
-            
-            double looMSE = this->leaveOneOutMSE();
+            double looMSE = scores[i];
             std::cout << "LOOMSE=" << looMSE;
-            std::cout << ", (kernel parameters=" << gkParams.toString() << "," << sigma_n << std::endl;
+            std::cout << ", (kernel parameters=" << gkParamsMatrix.at(i).gaussianKernelParameters.toString() << "," << gkParamsMatrix.at(i).sigmaN << std::endl;
             if(looMSE < minValue){
                 minValue = looMSE;
                 indexMinError = i;
-                std::cout << "Min LOOMSE updated." << std::endl;
             }
         }
+        if(indexMinError<0){
+            BOOST_THROW_EXCEPTION(LocException("No valid kernel parameters were found in fitCV."));
+        }
+        mCVResult.parameters = gkParamsMatrix;
+        mCVResult.scores = scores;
+        mCVResult.indexSelected = indexMinError;
         
         // Fit this model with the selected parameters.
         GaussianKernel::Parameters gkParamsMin = gkParamsMatrix.at(indexMinError).gaussianKernelParameters;
         double sigma_n_min = gkParamsMatrix.at(indexMinError).sigmaN;
+        std::cout << "Selected LOOMSE=" << minValue << ", (kernel parameters=" << gkParamsMin.toString() << "," << sigma_n_min << "), #threads=" << nThreads << std::endl;
         this->sigmaN(sigma_n_min);
         // std::shared_ptr<KernelFunction> kernel(new GaussianKernel(gkParamsMin));
         // mKernel = kernel;
@@ -353,4 +567,17 @@ namespace loc{
         
         this->fit(X,Y,Actives);
     }
+    
+    GaussianProcess& GaussianProcess::numThreads(int numThreads){
+        mNumThreads = numThreads;
+        return *this;
+    }
+    
+    int GaussianProcess::numThreads() const{
+        return mNumThreads;
+    }
+    
+    const GaussianProcessCVResult& GaussianProcess::cvResult() const{
+        return mCVResult;
+    }
 }
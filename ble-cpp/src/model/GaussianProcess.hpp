@@ -32,7 +32,7 @@
 
 #include <Eigen/Core>
 #include <Eigen/LU>
-#include <Eigen/Eigenvalues>
+#include <Eigen/Cholesky>
 
 #include "KernelFunction.hpp"
 #include "MathUtils.hpp"
@@ -53,24 +53,46 @@ namespace loc{
         double sigmaN;
     };
     
+    // Scores of hyperparameter candidates evaluated in fitCV
+    class GaussianProcessCVResult{
+    public:
+        std::vector<GaussianProcessParameters> parameters;
+        std::vector<double> scores; // LOO-MSE
+        int indexSelected = -1;
+    };
+    
     class GaussianProcess{
         
     private:
         // variables to be serialized
         ////std::shared_ptr<KernelFunction> mKernel;
         GaussianKernel mGaussianKernel;
-        Eigen::MatrixXd X_;
-        Eigen::MatrixXd Weights_;
+        // X_ and Weights_ view mTrainedStorage, which owns the values or keeps the memory they are mapped from alive.
+        std::shared_ptr<const void> mTrainedStorage;
+        Eigen::Map<const Eigen::MatrixXd> X_{nullptr, 0, 0};
+        Eigen::Map<const Eigen::MatrixXd> Weights_{nullptr, 0, 0};
         double sigmaN_ = 1.0;
         
         // variables not to be serialized
         Eigen::MatrixXd Y_;
-        Eigen::MatrixXd K_;
-        Eigen::MatrixXd Ky_;
-        Eigen::MatrixXd invKy_;
         Eigen::MatrixXd Actives_;
         GaussianProcessParameterSet mParameterSet;
         
+        // Factorization of Ky = K + sigmaN^2*I. LDLT is used when LLT fails.
+        Eigen::LLT<Eigen::MatrixXd> lltKy_;
+        Eigen::LDLT<Eigen::MatrixXd> ldltKy_;
+        bool usesLDLT_ = false;
+        Eigen::VectorXd diagInvKy_; // computed on demand
+        
+        int mNumThreads = 0; // the number of threads used in fitCV (0: hardware concurrency)
+        GaussianProcessCVResult mCVResult;
+        
+        GaussianProcess& fit(const Eigen::MatrixXd & X, const Eigen::MatrixXd& Y, const Eigen::MatrixXd& Actives, Eigen::MatrixXd& Ky);
+        void factorize(Eigen::MatrixXd& Ky);
+        Eigen::MatrixXd solveKy(const Eigen::MatrixXd& B) const;
+        double logDeterminantKy() const;
+        const Eigen::VectorXd& diagonalOfInverseKy();
+        
     public:
         // A function for serealization
         template<class Archive>
@@ -90,6 +112,11 @@ namespace loc{
         
         virtual Eigen::MatrixXd X() const;
         virtual Eigen::MatrixXd Y() const;
+        const Eigen::Map<const Eigen::MatrixXd>& weights() const;
+        // Sets the trained inputs and weights which are serialized.
+        GaussianProcess& trained(const Eigen::MatrixXd& X, const Eigen::MatrixXd& Weights);
+        // Views the trained inputs and weights without copying. storage keeps the viewed memory alive (e.g. a mapped ModelBundle).
+        GaussianProcess& trained(const Eigen::Map<const Eigen::MatrixXd>& X, const Eigen::Map<const Eigen::MatrixXd>& Weights, std::shared_ptr<const void> storage);
         virtual GaussianProcess& fit(const Eigen::MatrixXd & X, const Eigen::MatrixXd& Y);
         virtual GaussianProcess& fit(const Eigen::MatrixXd & X, const Eigen::MatrixXd& Y, const Eigen::MatrixXd& Actives);
         virtual GaussianProcess& actives(const Eigen::MatrixXd& Actives);
@@ -103,6 +130,8 @@ namespace loc{
         virtual double predict(double x[], int index);
         virtual std::vector<double> predict(double x[], const std::vector<int>& indices) const;
         virtual std::vector<double> predict(const Eigen::VectorXd& kstar, const std::vector<int>& indices) const;
+        // Batch prediction for n points. xs: n x ndim (row-major), ypreds: n x indices.size() (row-major)
+        virtual void predict(const double xs[], size_t n, const std::vector<int>& indices, double ypreds[]) const;
         virtual Eigen::VectorXd predictVarianceF(double x[]) const;
         virtual Eigen::VectorXd predictVarianceF(const Eigen::VectorXd& kstar) const;
         
@@ -113,6 +142,9 @@ namespace loc{
         
         virtual std::vector<GaussianProcessParameters> createParameterMatrix(const GaussianProcessParameterSet&) const;
         virtual void fitCV(const Eigen::MatrixXd & X, const Eigen::MatrixXd& Y, const Eigen::MatrixXd& Actives);
+        virtual GaussianProcess& numThreads(int numThreads);
+        virtual int numThreads() const;
+        virtual const GaussianProcessCVResult& cvResult() const;
     };
 }
 
@@ -24,6 +24,8 @@
 #include "ArrayUtils.hpp"
 #include "SerializeUtils.hpp"
 #include "DataLogger.hpp"
+#include "SpanTracer.hpp"
+#include "ModelBundle.hpp"
 
 #include "GaussianProcessLight.hpp"
 
@@ -38,16 +40,12 @@ namespace loc{
         return *this;
     }
     
-    /*
-    void ITUModelFunction::transformFeature(const Location& stateReceiver, const Location& stateTransmitter, double feats[ndim_]) const{
-        
-        double distOffsetTmp = distanceOffset_;
-        double dist = Location::distance(stateReceiver, stateTransmitter, distOffsetTmp);
+    void ITUModelFunction::transformFeature(const Location& stateReceiver, const Location& stateTransmitter, double feats[]) const{
+        double dist = Location::distance(stateReceiver, stateTransmitter, distanceOffset_);
         double floorDiff = Location::floorDifference(stateReceiver, stateTransmitter);
         
         feats[0] = -10.0*log10(dist);
         feats[1] = 1.0;
-
         if(floorDiff<1){
             feats[2] = 0.0;
             feats[3] = 0.0;
@@ -56,23 +54,10 @@ namespace loc{
             feats[3] = -1.0;
         }
     }
-    */
     
     std::vector<double> ITUModelFunction::transformFeature(const Location& stateReceiver, const Location& stateTransmitter) const{
         std::vector<double> feats(ndim_);
-        double distOffsetTmp = distanceOffset_;
-        double dist = Location::distance(stateReceiver, stateTransmitter, distOffsetTmp);
-        double floorDiff = Location::floorDifference(stateReceiver, stateTransmitter);
-        
-        feats[0] = -10.0*log10(dist);
-        feats[1] = 1.0;
-        if(floorDiff<1){
-            feats[2] = 0.0;
-            feats[3] = 0.0;
-        }else{
-            feats[2] = -floorDiff;
-            feats[3] = -1.0;
-        }
+        transformFeature(stateReceiver, stateTransmitter, feats.data());
         return feats;
     }
     
@@ -97,6 +82,8 @@ namespace loc{
     
     template void ITUModelFunction::serialize<cereal::JSONInputArchive> (cereal::JSONInputArchive& archive);
     template void ITUModelFunction::serialize<cereal::JSONOutputArchive> (cereal::JSONOutputArchive& archive);
+    template void ITUModelFunction::serialize<cereal::PortableBinaryInputArchive> (cereal::PortableBinaryInputArchive& archive);
+    template void ITUModelFunction::serialize<cereal::PortableBinaryOutputArchive> (cereal::PortableBinaryOutputArchive& archive);
     
     
     /**
@@ -114,9 +101,25 @@ namespace loc{
             const auto& id = bleBeacon.id();
             mITUModelMap[id] = ITUModelFunction();
         }
+        updateBeaconIndices();
         return *this;
     }
     
+    template<class Tstate, class Tinput>
+    void GaussianProcessLDPLMultiModel<Tstate, Tinput>::updateBeaconIndices(){
+        mBeaconRegistry = BeaconRegistry::fromBeacons(mBLEBeacons);
+        mITUModels.clear();
+        for(const auto& ble: mBLEBeacons){
+            mITUModels.push_back(mITUModelMap.at(ble.id()));
+        }
+    }
+    
+    template<class Tstate, class Tinput>
+    int GaussianProcessLDPLMultiModel<Tstate, Tinput>::findBeaconIndex(const Beacon& beacon) const{
+        uint32_t index = mBeaconRegistry.find(beacon.id());
+        return index==BeaconRegistry::noIndex ? -1 : static_cast<int>(index);
+    }
+    
     /*
     template<class Tstate, class Tinput>
     GaussianProcessLDPLMultiModel<Tstate, Tinput>& GaussianProcessLDPLMultiModel<Tstate, Tinput>::kernelFunction(std::shared_ptr<KernelFunction> kernel){
@@ -125,6 +128,35 @@ namespace loc{
     }
     */
     
+    template<class Tstate, class Tinput>
+    void GaussianProcessLDPLMultiModel<Tstate, Tinput>::ituParameters(const std::vector<std::vector<double>>& ituParameters){
+        size_t nParams = ituParameters.empty() ? 0 : ituParameters.front().size();
+        auto storage = std::make_shared<Eigen::MatrixXd>(nParams, ituParameters.size());
+        for(size_t i=0; i<ituParameters.size(); i++){
+            if(ituParameters[i].size()!=nParams){
+                BOOST_THROW_EXCEPTION(LocException("ITU parameters of beacons have different sizes"));
+            }
+            storage->col(i) = Eigen::Map<const Eigen::VectorXd>(ituParameters[i].data(), nParams);
+        }
+        this->ituParameters(Eigen::Map<const Eigen::MatrixXd>(storage->data(), storage->rows(), storage->cols()), storage);
+    }
+    
+    template<class Tstate, class Tinput>
+    void GaussianProcessLDPLMultiModel<Tstate, Tinput>::ituParameters(const Eigen::Map<const Eigen::MatrixXd>& ituParameters, std::shared_ptr<const void> storage){
+        mITUParameterStorage = storage;
+        // Rebind the view (Map::operator= would copy the values)
+        new (&mITUParameters) Eigen::Map<const Eigen::MatrixXd>(ituParameters.data(), ituParameters.rows(), ituParameters.cols());
+    }
+    
+    template<class Tstate, class Tinput>
+    std::vector<std::vector<double>> GaussianProcessLDPLMultiModel<Tstate, Tinput>::ituParameters() const{
+        std::vector<std::vector<double>> ituParameters(mITUParameters.cols());
+        for(size_t i=0; i<ituParameters.size(); i++){
+            ituParameters[i].assign(mITUParameters.col(i).data(), mITUParameters.col(i).data() + mITUParameters.rows());
+        }
+        return ituParameters;
+    }
+    
     template<class Tstate, class Tinput>
     std::vector<std::vector<double>> GaussianProcessLDPLMultiModel<Tstate, Tinput>::fitITUModel(Samples samples){
         std::vector<Sample> samplesAveraged = Sample::mean(Sample::splitSamplesToConsecutiveSamples(samples)); // averaging consecutive samples
@@ -330,12 +362,14 @@ namespace loc{
     
     template<class Tstate, class Tinput>
     GaussianProcessLDPLMultiModel<Tstate, Tinput>& GaussianProcessLDPLMultiModel<Tstate, Tinput>::train(Samples samples){
+        SpanTracer::Span spanTrain("GaussianProcessLDPLMultiModel::train", "model");
         
         if(gpType==GPNORMAL){
             mGP = std::make_shared<GaussianProcess>();
         }else{
             mGP = std::make_shared<GaussianProcessLight>();
         }
+        mGP->numThreads(nThreadsTraining);
         
         std::vector<Sample> samplesAveraged = Sample::mean(Sample::splitSamplesToConsecutiveSamples(samples)); // averaging consecutive samples
         std::cout << "#samplesAveraged = " << samplesAveraged.size() << std::endl;
@@ -356,8 +390,12 @@ namespace loc{
         bool usesMinRssiObs = true;
         
         // FIT ITU model parameters
-        mITUParameters = fitITUModel(samples);
+        {
+            SpanTracer::Span span("fitITUModel", "model");
+            ituParameters(fitITUModel(samples));
+        }
         
+        SpanTracer::Span spanMatrices("buildTrainingMatrices", "model");
         for(int i=0; i<n; i++){
             Sample smp = samplesAveraged.at(i);
             Location loc = smp.location();
@@ -396,16 +434,20 @@ namespace loc{
                 BLEBeacon bleBeacon = mBLEBeacons.at(j);
                 const auto& id = bleBeacon.id();
                 auto features = mITUModelMap[id].transformFeature(loc, bleBeacon);
-                std::vector<double> params = mITUParameters.at(j);
-                double ymean = mITUModelMap[id].predict(params, features);
+                double ymean = mITUModelMap[id].predict(mITUParameters.col(j).data(), features.data());
                 dY(i, j)=Y(i,j)-ymean;
             }
         }
+        spanMatrices.end();
         
         // Training with selection of kernel parameters
-        mGP->fitCV(X, dY, Actives);
+        {
+            SpanTracer::Span span("fitGaussianProcess", "model");
+            mGP->fitCV(X, dY, Actives);
+        }
         
         // Estimate variance parameter (sigma_n) by using raw (=not averaged) data
+        SpanTracer::Span spanStdev("computeRssiStandardDeviations", "model");
         mRssiStandardDeviations = computeRssiStandardDeviations(samples);
         for(auto& ble: mBLEBeacons){
             const auto& id = ble.id();
@@ -446,8 +488,7 @@ namespace loc{
                 int index = mBeaconIdIndexMap.at(id);
                 BLEBeacon ble = mBLEBeacons.at(index);
                 std::vector<double> features = mITUModelMap[id].transformFeature(loc, ble);
-                std::vector<double> params = mITUParameters.at(index);
-                double mean = mITUModelMap[id].predict(params, features);
+                double mean = mITUModelMap[id].predict(mITUParameters.col(index).data(), features.data());
                 
                 double dypred = dypreds.at(i);
                 double ypred = mean + dypred;
@@ -496,8 +537,7 @@ namespace loc{
     Tinput GaussianProcessLDPLMultiModel<Tstate, Tinput>::convertInput(const Tinput& input){
         Tinput inputConverted;
         for(auto iter=input.begin(); iter!=input.end(); iter++){
-            const auto& id = iter->id();
-            if(mBeaconIdIndexMap.count(id)==1){
+            if(0<=findBeaconIndex(*iter)){
                 inputConverted.push_back(*iter);
             }
         }
@@ -508,10 +548,8 @@ namespace loc{
     std::vector<int> GaussianProcessLDPLMultiModel<Tstate, Tinput>::extractKnownBeaconIndices(const Tinput& input) const{
         std::vector<int> indices;
         for(auto iter=input.begin(); iter!=input.end(); iter++){
-            Beacon b = *iter;
-            const auto& id = b.id();
-            if(mBeaconIdIndexMap.count(id)==1){
-                int index = mBeaconIdIndexMap.at(id);
+            int index = findBeaconIndex(*iter);
+            if(0<=index){
                 indices.push_back(index);
             }
         }
@@ -525,24 +563,33 @@ namespace loc{
         
         std::vector<double> xvec = MLAdapter::locationToVec(state);
         std::vector<int> indices = extractKnownBeaconIndices(input);
-        std::vector<double> dypreds = mGP->predict(xvec.data(), indices);
+        
+        std::vector<double> gridPreds(indices.size());
+        bool usesGrid = mPredictionGrid && mPredictionGrid->interpolate(state, indices.data(), indices.size(), gridPreds.data());
+        std::vector<double> dypreds;
+        if(!usesGrid){
+            dypreds = mGP->predict(xvec.data(), indices);
+        }
         
         int idx_local=0;
         for(auto iter=input.begin(); iter!=input.end(); iter++){
             auto b = *iter;
             const auto& id = b.id();
             // RSSI of known beacons are predicted by a model.
-            if(mBeaconIdIndexMap.count(id)==1){
-                int idx_global = mBeaconIdIndexMap.at(id);
+            int idx_global = findBeaconIndex(b);
+            if(0<=idx_global){
                 const BLEBeacon& bleBeacon = mBLEBeacons.at(idx_global);
                 
-                const auto& ituModel = mITUModelMap.at(id);
-                const auto& features = ituModel.transformFeature(state, bleBeacon);
-                const auto& params = mITUParameters.at(idx_global);
-                double mean = ituModel.predict(params, features);
-                double dypred = dypreds.at(idx_local);
-                
-                double ypred = mean + dypred;
+                double ypred;
+                if(usesGrid){
+                    ypred = gridPreds.at(idx_local);
+                }else{
+                    const auto& ituModel = mITUModels.at(idx_global);
+                    const auto& features = ituModel.transformFeature(state, bleBeacon);
+                    double mean = ituModel.predict(mITUParameters.col(idx_global).data(), features.data());
+                    double dypred = dypreds.at(idx_local);
+                    ypred = mean + dypred;
+                }
                 double stdev = mRssiStandardDeviations[idx_global];
                 
                 if(mCoeffDiffFloorStdev!=1.0 && Location::checkDifferentFloor(state, bleBeacon)){
@@ -566,135 +613,273 @@ namespace loc{
         return values.at(0);
     }
     
-    template<class Tstate, class Tinput>
-    std::vector<double> GaussianProcessLDPLMultiModel<Tstate, Tinput>::computeLogLikelihoodRelatedValues(const Tstate& state, const Tinput& input){
-        //Assuming Tinput = Beacons
+    namespace{
+        // Scratch buffers reused by the batched likelihood computation (one set per thread)
+        struct LikelihoodBuffers{
+            // per observed beacon
+            std::vector<int> localIndices; // index in known beacons or -1
+            std::vector<double> rssis;
+            // per known beacon
+            std::vector<int> indices;
+            std::vector<const BLEBeacon*> bleBeacons;
+            std::vector<const ITUModelFunction*> ituModels;
+            std::vector<const double*> ituParams;
+            std::vector<double> stdevs;
+            // per location to be predicted
+            std::vector<Location> locations;
+            std::vector<size_t> offsets;
+            std::vector<double> locPreds;
+            std::vector<size_t> gpRows;
+            std::vector<double> xs;
+            std::vector<double> dypreds;
+            // per state
+            std::vector<double> rssiBiases;
+            std::vector<double> ypreds;
+        };
         
-        std::vector<double> returnValues(4); // logLikelihood, mahalanobisDistance, #knownBeacons, #unknownBeacons
+        LikelihoodBuffers& likelihoodBuffers(){
+            thread_local LikelihoodBuffers buf;
+            return buf;
+        }
         
-        std::map<BeaconId, NormalParameter> beaconIdRssiStatsMap;
-        // delayed prdiction
-        int T = mTDelay;
-        double dTmin = mDTDelay - mDTDelayMargin; //ms
-        double dTmax = mDTDelay + mDTDelayMargin; //ms
-        if(T==1){
-            beaconIdRssiStatsMap = this->predict(state, input);
-        }else{
-            long headTS = state.timestamp;
-            std::vector<State> statesConsider;
-            auto hsize = state.history.size();
-            for(int i=0; i<hsize; i++){
-                const State& hState = state.history.at(hsize-i-1);
-                long diffTS = headTS - hState.timestamp;
+        template<class Tstate>
+        double rssiBiasOf(const Tstate& state, std::true_type){
+            return state.rssiBias();
+        }
+        template<class Tstate>
+        double rssiBiasOf(const Tstate& state, std::false_type){
+            return 0.0;
+        }
+        
+        // Appends past locations used in delayed prediction by walking the ancestors of a particle
+        void collectDelayedLocations(long headTS, ParticleHistory::Cursor cursor, int T, double dTmin, double dTmax, std::vector<Location>& locations){
+            int nPast = 0;
+            for(; cursor.valid(); cursor.toParent()){
+                long ts = cursor.timestamp();
+                long diffTS = headTS - ts;
                 if( dTmin <= diffTS && diffTS<dTmax){
-                    headTS = hState.timestamp;
-                    statesConsider.push_back(hState);
-                    if((T-1)<= statesConsider.size()){
+                    headTS = ts;
+                    locations.push_back(cursor.location());
+                    nPast++;
+                    if((T-1)<= nPast){
                         break;
                     }
                 }
             }
-            
-            auto nConsidered = statesConsider.size() + 1;
-            auto cMap = this->predict(state, input);
-            std::map<BeaconId, double> meanPreds;
-            double avgWeight = 1.0/((double) nConsidered);
-            
-            for(auto iter = cMap.begin(); iter!= cMap.end() ; ++iter ) {
-                const auto& id = iter->first;
-                meanPreds[id] = avgWeight * iter->second.mean();
-            }
-            for(int i=0; i<statesConsider.size(); i++){
-                const State& s = statesConsider.at(i);
-                auto tmpBMap = this->predict(s, input);
-                for(auto iter = tmpBMap.begin(); iter!= tmpBMap.end() ; ++iter ) {
-                    const auto& id = iter->first;
-                    meanPreds[id] += avgWeight * iter->second.mean();
-                }
-            }
-            
-            std::map<BeaconId, NormalParameter> meanStatsMap;
-            for(auto iter = cMap.begin(); iter!= cMap.end() ; ++iter ) {
-                const auto& id = iter->first;
-                NormalParameter np(meanPreds[id], iter->second.stdev());
-                meanStatsMap[id] = np;
+        }
+    }
+    
+    template<class Tstate, class Tinput>
+    std::vector<double> GaussianProcessLDPLMultiModel<Tstate, Tinput>::computeLogLikelihoodRelatedValues(const Tstate& state, const Tinput& input){
+        std::vector<std::vector<double>> values(1);
+        this->computeLogLikelihoodRelatedValues(&state, 1, input, values);
+        return values[0];
+    }
+    
+    template<class Tstate, class Tinput>
+    void GaussianProcessLDPLMultiModel<Tstate, Tinput>::computeLogLikelihoodRelatedValues(const Tstate states[], size_t n, const Tinput& input, std::vector<std::vector<double>>& values){
+        LikelihoodBuffers& buf = likelihoodBuffers();
+        
+        // Collect locations to be predicted. Delayed prediction needs the particle history and is done only for Particles.
+        buf.locations.clear();
+        buf.offsets.resize(n+1);
+        buf.rssiBiases.resize(n);
+        for(size_t i=0; i<n; i++){
+            const Tstate& state = states[i];
+            buf.offsets[i] = buf.locations.size();
+            buf.locations.push_back(state);
+            buf.rssiBiases[i] = rssiBiasOf(state, typename std::is_base_of<State, Tstate>::type());
+        }
+        buf.offsets[n] = buf.locations.size();
+        
+        this->evaluateCollectedLocations(n, input, values);
+    }
+    
+    template<class Tstate, class Tinput>
+    void GaussianProcessLDPLMultiModel<Tstate, Tinput>::computeLogLikelihoodRelatedValues(const Particles& particles, const Tinput& input, std::vector<std::vector<double>>& values){
+        LikelihoodBuffers& buf = likelihoodBuffers();
+        size_t n = particles.size();
+        const double* xs = particles.x();
+        const double* ys = particles.y();
+        const double* zs = particles.z();
+        const double* floors = particles.floor();
+        const double* rssiBiases = particles.rssiBias();
+        const long* timestamps = particles.timestamp();
+        const ParticleHistory* history = particles.history();
+        
+        int T = mTDelay;
+        double dTmin = mDTDelay - mDTDelayMargin; //ms
+        double dTmax = mDTDelay + mDTDelayMargin; //ms
+        buf.locations.clear();
+        buf.offsets.resize(n+1);
+        buf.rssiBiases.assign(rssiBiases, rssiBiases+n);
+        for(size_t i=0; i<n; i++){
+            buf.offsets[i] = buf.locations.size();
+            buf.locations.push_back(Location(xs[i], ys[i], zs[i], floors[i]));
+            if(T==1 || history==nullptr){
+                continue;
             }
-            beaconIdRssiStatsMap = meanStatsMap;
+            collectDelayedLocations(timestamps[i], history->cursor(particles, i), T, dTmin, dTmax, buf.locations);
         }
+        buf.offsets[n] = buf.locations.size();
         
-        std::vector<int> indices = extractKnownBeaconIndices(input);
+        this->evaluateCollectedLocations(n, input, values);
+    }
+    
+    template<class Tstate, class Tinput>
+    void GaussianProcessLDPLMultiModel<Tstate, Tinput>::evaluateCollectedLocations(size_t n, const Tinput& input, std::vector<std::vector<double>>& values){
+        //Assuming Tinput = Beacons
+        static const int ndim = ITUModelFunction::ndim_;
+        LikelihoodBuffers& buf = likelihoodBuffers();
+        int T = mTDelay;
         
-        size_t countKnown = indices.size();
-        size_t countUnknown = input.size() - indices.size();
-
-        if(countKnown==0){
+        // Resolve observed beacons to dense indices once per input
+        size_t nObs = input.size();
+        buf.localIndices.resize(nObs);
+        buf.rssis.resize(nObs);
+        buf.indices.clear();
+        buf.bleBeacons.clear();
+        buf.ituModels.clear();
+        buf.ituParams.clear();
+        buf.stdevs.clear();
+        for(size_t k=0; k<nObs; k++){
+            const Beacon& b = input[k];
+            buf.rssis[k] = b.rssi();
+            int idx_global = findBeaconIndex(b);
+            if(idx_global<0){
+                buf.localIndices[k] = -1;
+                continue;
+            }
+            buf.localIndices[k] = (int) buf.indices.size();
+            buf.indices.push_back(idx_global);
+            buf.bleBeacons.push_back(&mBLEBeacons[idx_global]);
+            buf.ituModels.push_back(&mITUModels[idx_global]);
+            buf.ituParams.push_back(mITUParameters.col(idx_global).data());
+            buf.stdevs.push_back(mRssiStandardDeviations[idx_global]);
+        }
+        size_t m = buf.indices.size(); // #knownBeacons
+        size_t countUnknown = nObs - m;
+        
+        if(m==0){
             std::cout << "ObservationModel does not know the input data." << std::endl;
         }
         
-        double jointLogLL = 0;
-        double sumMahaDist = 0;
-        for(auto iter=input.begin(); iter!=input.end(); iter++){
-            const Beacon& b = *iter;
-            double rssi = b.rssi();
-            
-            const State* pState = dynamic_cast<const State*>(&state);
-            if(pState){
-                double rssiBias = pState->rssiBias();
-                rssi = rssi - rssiBias;
+        // Predict RSSI means at all locations. The prediction grid is used if it covers a location.
+        size_t nLoc = buf.locations.size();
+        buf.locPreds.resize(nLoc*m);
+        buf.gpRows.clear();
+        for(size_t r=0; r<nLoc; r++){
+            if(mPredictionGrid && mPredictionGrid->interpolate(buf.locations[r], buf.indices.data(), m, &buf.locPreds[r*m])){
+                continue;
             }
-            const auto& id = b.id();
-            
-            // RSSI of known beacons are predicted by a model.
-            if(mBeaconIdIndexMap.count(id)==1){
-                auto rssiStats = beaconIdRssiStatsMap[id];
-                double ypred = rssiStats.mean();
-                double stdev = rssiStats.stdev();
-                
-                //double logLL = MathUtils::logProbaNormal(rssi, ypred, stdev);
-                double logLL = normFunc(rssi, ypred, stdev);
-                double mahaDist = MathUtils::mahalanobisDistance(rssi, ypred, stdev);
-                
-                if(applyLowestLogLikelihood){
-                    double enlargedStdev = mStdevRssiForUnknownBeacon * mCoeffDiffFloorStdev;
-                    int idx = mBeaconIdIndexMap[b.id()];
-                    auto ble = mBLEBeacons.at(idx);
-                    if(ble.floor()!=state.floor()){
-                        double lowestlogLL = normFunc(0, 0, enlargedStdev);
-                        logLL = lowestlogLL < logLL? logLL : lowestlogLL;
+            buf.gpRows.push_back(r);
+        }
+        size_t nGP = buf.gpRows.size();
+        buf.xs.resize(nGP*ndim);
+        for(size_t g=0; g<nGP; g++){
+            const Location& loc = buf.locations[buf.gpRows[g]];
+            double* x = &buf.xs[g*ndim];
+            x[0] = loc.x(); x[1] = loc.y(); x[2] = loc.z(); x[3] = loc.floor();
+        }
+        buf.dypreds.resize(nGP*m);
+        mGP->predict(buf.xs.data(), nGP, buf.indices, buf.dypreds.data());
+        double feats[ndim];
+        for(size_t g=0; g<nGP; g++){
+            size_t r = buf.gpRows[g];
+            const Location& loc = buf.locations[r];
+            const double* dypred = &buf.dypreds[g*m];
+            double* locPred = &buf.locPreds[r*m];
+            for(size_t j=0; j<m; j++){
+                buf.ituModels[j]->transformFeature(loc, *buf.bleBeacons[j], feats);
+                double mean = buf.ituModels[j]->predict(buf.ituParams[j], feats);
+                locPred[j] = mean + dypred[j];
+            }
+        }
+        
+        // Average predictions over considered locations
+        buf.ypreds.resize(n*m);
+        for(size_t i=0; i<n; i++){
+            size_t rBegin = buf.offsets[i];
+            size_t rEnd = buf.offsets[i+1];
+            double avgWeight = 1.0/((double) (rEnd - rBegin));
+            double* ypred = &buf.ypreds[i*m];
+            for(size_t r=rBegin; r<rEnd; r++){
+                const double* locPred = &buf.locPreds[r*m];
+                for(size_t j=0; j<m; j++){
+                    if(T==1){
+                        ypred[j] = locPred[j];
+                    }else if(r==rBegin){
+                        ypred[j] = avgWeight * locPred[j];
+                    }else{
+                        ypred[j] += avgWeight * locPred[j];
                     }
                 }
-
-                jointLogLL += logLL;
-                sumMahaDist += mahaDist;
-                
             }
-            // RSSI of unknown beacons are assumed to be minRssi.
-            else if(mFillsUnknownBeaconRssi){
-                double ypred = BeaconConfig::minRssi();
-                double stdev = mStdevRssiForUnknownBeacon;
-                
-                //double logLL = MathUtils::logProbaNormal(rssi, ypred, stdev);
-                double logLL = normFunc(rssi, ypred, stdev);
-                double mahaDist = MathUtils::mahalanobisDistance(rssi, ypred, stdev);
+        }
+        
+        // Evaluate log-density
+        double lowestLogLL = normFunc(0, 0, mStdevRssiForUnknownBeacon * mCoeffDiffFloorStdev);
+        values.resize(n);
+        for(size_t i=0; i<n; i++){
+            const Location& state = buf.locations[buf.offsets[i]];
+            double rssiBias = buf.rssiBiases[i];
+            const double* ypred = &buf.ypreds[i*m];
+            
+            double jointLogLL = 0;
+            double sumMahaDist = 0;
+            for(size_t k=0; k<nObs; k++){
+                double rssi = buf.rssis[k] - rssiBias;
+                int j = buf.localIndices[k];
                 
-                jointLogLL += logLL;
-                sumMahaDist += mahaDist;
+                // RSSI of known beacons are predicted by a model.
+                if(0<=j){
+                    const BLEBeacon& bleBeacon = *buf.bleBeacons[j];
+                    double stdev = buf.stdevs[j];
+                    if(mCoeffDiffFloorStdev!=1.0 && Location::checkDifferentFloor(state, bleBeacon)){
+                        stdev = stdev*mCoeffDiffFloorStdev ;
+                    }
+                    double logLL = normFunc(rssi, ypred[j], stdev);
+                    double mahaDist = MathUtils::mahalanobisDistance(rssi, ypred[j], stdev);
+                    
+                    if(applyLowestLogLikelihood){
+                        if(bleBeacon.floor()!=state.floor()){
+                            logLL = lowestLogLL < logLL? logLL : lowestLogLL;
+                        }
+                    }
+                    
+                    jointLogLL += logLL;
+                    sumMahaDist += mahaDist;
+                }
+                // RSSI of unknown beacons are assumed to be minRssi.
+                else if(mFillsUnknownBeaconRssi){
+                    double ypredUnknown = BeaconConfig::minRssi();
+                    double stdev = mStdevRssiForUnknownBeacon;
+                    
+                    double logLL = normFunc(rssi, ypredUnknown, stdev);
+                    double mahaDist = MathUtils::mahalanobisDistance(rssi, ypredUnknown, stdev);
+                    
+                    jointLogLL += logLL;
+                    sumMahaDist += mahaDist;
+                }
             }
+            
+            std::vector<double>& returnValues = values[i]; // logLikelihood, mahalanobisDistance, #knownBeacons, #unknownBeacons
+            returnValues.resize(4);
+            returnValues[0] = jointLogLL;
+            returnValues[1] = sumMahaDist;
+            returnValues[2] = m;
+            returnValues[3] = countUnknown;
         }
-        returnValues[0] = jointLogLL;
-        returnValues[1] = sumMahaDist;
-        returnValues[2] = countKnown;
-        returnValues[3] = countUnknown;
-        
-        return returnValues;
     }
     
     template<class Tstate, class Tinput>
     std::vector<double> GaussianProcessLDPLMultiModel<Tstate, Tinput>::computeLogLikelihood(const std::vector<Tstate> & states, const Tinput & input) {
         int n = (int) states.size();
+        std::vector<std::vector<double>> values(n);
+        this->computeLogLikelihoodRelatedValues(states.data(), n, input, values);
         std::vector<double> logLLs(n);
         for(int i=0; i<n; i++){
-            logLLs[i] = this->computeLogLikelihood(states.at(i), input);
+            logLLs[i] = values[i][0];
         }
         return logLLs;
     }
@@ -702,12 +887,8 @@ namespace loc{
     template<class Tstate, class Tinput>
     std::vector<std::vector<double>> GaussianProcessLDPLMultiModel<Tstate, Tinput>::computeLogLikelihoodRelatedValues(const std::vector<Tstate> & states, const Tinput & input) {
         int n = (int) states.size();
-        std::vector<double> logLLs(n);
-        
         std::vector<std::vector<double>> values(n);
-        for(int i=0; i<n; i++){
-            values[i] = this->computeLogLikelihoodRelatedValues(states.at(i), input);
-        }
+        this->computeLogLikelihoodRelatedValues(states.data(), n, input, values);
         return values;
     }
     
@@ -742,10 +923,122 @@ namespace loc{
     template<class Tstate, class Tinput>
     GaussianProcessLDPLMultiModel<Tstate, Tinput>& GaussianProcessLDPLMultiModel<Tstate, Tinput>::tDelay(int T){
         mTDelay = T;
-        State::history_capacity = T;
         return *this;
     }
     
+    template<class Tstate, class Tinput>
+    int GaussianProcessLDPLMultiModel<Tstate, Tinput>::tDelay() const{
+        return mTDelay;
+    }
+    
+    template<class Tstate, class Tinput>
+    GaussianProcessLDPLMultiModel<Tstate, Tinput>& GaussianProcessLDPLMultiModel<Tstate, Tinput>::buildPredictionGrid(const Building& building, const RssiPredictionGridParameters& params){
+        static const int ndim = ITUModelFunction::ndim_;
+        size_t nBeacons = mBLEBeacons.size();
+        if(nBeacons==0 || !mGP){
+            BOOST_THROW_EXCEPTION(LocException("The model has not been trained or loaded."));
+        }
+        if(params.cellSize<=0){
+            BOOST_THROW_EXCEPTION(LocException("cellSize must be positive."));
+        }
+        
+        std::vector<int> floors;
+        for(int f=building.minFloor(); f<=building.maxFloor(); f++){
+            if(building.hasFloor(f)){
+                floors.push_back(f);
+            }
+        }
+        
+        // Enlarge cell size until the grid fits in the memory budget
+        double cellSize = params.cellSize;
+        auto latticeSize = [&](const FloorMap& floorMap, double cs, int& nx, int& ny){
+            Location minLoc = floorMap.minLocation();
+            Location maxLoc = floorMap.maxLocation();
+            nx = static_cast<int>(std::ceil((maxLoc.x() - minLoc.x())/cs)) + 1;
+            ny = static_cast<int>(std::ceil((maxLoc.y() - minLoc.y())/cs)) + 1;
+            nx = std::max(nx, 2);
+            ny = std::max(ny, 2);
+        };
+        while(true){
+            double nPoints = 0;
+            bool isMinimum = true;
+            for(int f: floors){
+                int nx, ny;
+                latticeSize(building.getFloorAt(f), cellSize, nx, ny);
+                nPoints += (double) nx*ny;
+                isMinimum = isMinimum && nx==2 && ny==2;
+            }
+            // Computed in double to avoid overflow on large inputs
+            double bytes = nPoints*nBeacons*sizeof(float);
+            if(bytes <= params.maxMemoryBytes){
+                std::cout << "prediction grid: cellSize=" << cellSize << ", #points=" << (size_t) nPoints << ", bytes=" << (size_t) bytes << std::endl;
+                break;
+            }
+            if(isMinimum){
+                std::stringstream ss;
+                ss << "The prediction grid does not fit in maxMemoryBytes=" << params.maxMemoryBytes << " (minimum " << (size_t) bytes << " bytes).";
+                BOOST_THROW_EXCEPTION(LocException(ss.str()));
+            }
+            cellSize *= 2;
+        }
+        
+        auto grid = std::make_shared<RssiPredictionGrid>(nBeacons, cellSize, params.z);
+        std::vector<int> indices(nBeacons);
+        for(size_t j=0; j<nBeacons; j++){
+            indices[j] = (int) j;
+        }
+        double feats[ndim];
+        for(int f: floors){
+            RssiPredictionGrid::FloorLattice lattice;
+            latticeSize(building.getFloorAt(f), cellSize, lattice.nx, lattice.ny);
+            Location minLoc = building.getFloorAt(f).minLocation();
+            lattice.xmin = minLoc.x();
+            lattice.ymin = minLoc.y();
+            size_t nPoints = (size_t) lattice.nx*lattice.ny;
+            lattice.values.resize(nPoints*nBeacons);
+            
+            // Evaluate each row of lattice at once
+            std::vector<double> xs(lattice.nx*ndim);
+            std::vector<double> dypreds(lattice.nx*nBeacons);
+            for(int iy=0; iy<lattice.ny; iy++){
+                for(int ix=0; ix<lattice.nx; ix++){
+                    double* x = &xs[ix*ndim];
+                    x[0] = lattice.xmin + ix*cellSize; x[1] = lattice.ymin + iy*cellSize; x[2] = params.z; x[3] = f;
+                }
+                mGP->predict(xs.data(), lattice.nx, indices, dypreds.data());
+                for(int ix=0; ix<lattice.nx; ix++){
+                    const double* x = &xs[ix*ndim];
+                    Location loc(x[0], x[1], x[2], x[3]);
+                    float* values = &lattice.values[((size_t)iy*lattice.nx + ix)*nBeacons];
+                    for(size_t j=0; j<nBeacons; j++){
+                        const BLEBeacon& bleBeacon = mBLEBeacons[j];
+                        const auto& ituModel = mITUModels[j];
+                        ituModel.transformFeature(loc, bleBeacon, feats);
+                        double mean = ituModel.predict(mITUParameters.col(j).data(), feats);
+                        values[j] = static_cast<float>(mean + dypreds[ix*nBeacons + j]);
+                    }
+                }
+            }
+            grid->floorLattice(f, std::move(lattice));
+        }
+        mPredictionGrid = grid;
+        return *this;
+    }
+    
+    template<class Tstate, class Tinput>
+    GaussianProcessLDPLMultiModel<Tstate, Tinput>& GaussianProcessLDPLMultiModel<Tstate, Tinput>::predictionGrid(RssiPredictionGrid::Ptr grid){
+        if(grid && grid->nBeacons()!=mBLEBeacons.size()){
+            BOOST_THROW_EXCEPTION(LocException("The number of beacons in the prediction grid does not match the model."));
+        }
+        mPredictionGrid = grid;
+        return *this;
+    }
+    
+    template<class Tstate, class Tinput>
+    RssiPredictionGrid::Ptr GaussianProcessLDPLMultiModel<Tstate, Tinput>::predictionGrid() const{
+        return mPredictionGrid;
+    }
+    
     // CEREAL function
     template<class Tstate, class Tinput>
     template<class Archive>
@@ -755,7 +1048,8 @@ namespace loc{
         
         ar(CEREAL_NVP(mBLEBeacons));
         ar(CEREAL_NVP(mITUModelMap));
-        ar(CEREAL_NVP(mITUParameters));
+        std::vector<std::vector<double>> ituParams = ituParameters();
+        ar(cereal::make_nvp("mITUParameters", ituParams));
 
         if(version<=1){
             ar(cereal::make_nvp("mGP",*mGP));
@@ -809,7 +1103,9 @@ namespace loc{
             BOOST_THROW_EXCEPTION(LocException("unsupported version (version=" + std::to_string(version) +")"));
         }
             
-        ar(CEREAL_NVP(mITUParameters));
+        std::vector<std::vector<double>> ituParams;
+        ar(cereal::make_nvp("mITUParameters", ituParams));
+        ituParameters(ituParams);
         
         // deserialize gp
         if(version<=1){
@@ -831,6 +1127,8 @@ namespace loc{
         }
         ar(CEREAL_NVP(mRssiStandardDeviations));
         mBeaconIdIndexMap = BLEBeacon::constructBeaconIdToIndexMap(mBLEBeacons);
+        updateBeaconIndices();
+        mPredictionGrid.reset();
         mStdevRssiForUnknownBeacon = computeNormalStandardDeviation(mRssiStandardDeviations);
         
         try{
@@ -871,6 +1169,77 @@ namespace loc{
         iarchive(*this);
     }
     
+    template<class Tstate, class Tinput>
+    void GaussianProcessLDPLMultiModel<Tstate, Tinput>::saveBinary(ModelBundleWriter& writer) const{
+        if(!mGP){
+            BOOST_THROW_EXCEPTION(LocException("the observation model has not been trained or loaded"));
+        }
+        writer.matrix(ModelBundle::ITU_PARAMETERS, mITUParameters);
+        
+        std::ostringstream os;
+        {
+            cereal::PortableBinaryOutputArchive oarchive(os);
+            oarchive(version);
+            oarchive(mBLEBeacons, mITUModelMap);
+            auto lgp = std::dynamic_pointer_cast<GaussianProcessLight>(mGP);
+            bool isLight = lgp ? true : false;
+            oarchive(isLight);
+            if(isLight){
+                oarchive(*lgp);
+            }else{
+                oarchive(mGP->sigmaN(), mGP->gaussianKernel());
+                writer.matrix(ModelBundle::GP_X, mGP->X());
+                writer.matrix(ModelBundle::GP_WEIGHTS, mGP->weights());
+            }
+            oarchive(mRssiStandardDeviations, mTDelay);
+        }
+        writer.observationModel(os.str());
+    }
+    
+    template<class Tstate, class Tinput>
+    void GaussianProcessLDPLMultiModel<Tstate, Tinput>::loadBinary(const ModelBundle& bundle){
+        const ModelBundle::Section& section = bundle.section(ModelBundle::OBSERVATION_MODEL);
+        ModelBundle::SectionStreamBuffer buffer(bundle.data(section), section.size);
+        std::istream is(&buffer);
+        cereal::PortableBinaryInputArchive iarchive(is);
+        int versionBinary = 0;
+        iarchive(versionBinary);
+        if(versionBinary != version){
+            BOOST_THROW_EXCEPTION(LocException("unsupported version of binary model (version=" + std::to_string(versionBinary) +")"));
+        }
+        iarchive(mBLEBeacons, mITUModelMap);
+        bool isLight = false;
+        iarchive(isLight);
+        if(isLight){
+            auto lgp = std::make_shared<GaussianProcessLight>();
+            iarchive(*lgp);
+            mGP = lgp;
+        }else{
+            double sigmaN = 0;
+            GaussianKernel kernel;
+            iarchive(sigmaN, kernel);
+            auto gp = std::make_shared<GaussianProcess>();
+            gp->sigmaN(sigmaN);
+            gp->gaussianKernel(kernel);
+            // Viewed in the mapped sections without parsing.
+            gp->trained(bundle.matrix(ModelBundle::GP_X), bundle.matrix(ModelBundle::GP_WEIGHTS), bundle.shared_from_this());
+            mGP = gp;
+        }
+        iarchive(mRssiStandardDeviations, mTDelay);
+        
+        auto ituParameterMatrix = bundle.matrix(ModelBundle::ITU_PARAMETERS);
+        if(static_cast<size_t>(ituParameterMatrix.cols())!=mBLEBeacons.size()){
+            BOOST_THROW_EXCEPTION(LocException("the number of ITU parameters does not match the number of beacons"));
+        }
+        ituParameters(ituParameterMatrix, bundle.shared_from_this());
+        
+        mBeaconIdIndexMap = BLEBeacon::constructBeaconIdToIndexMap(mBLEBeacons);
+        updateBeaconIndices();
+        mPredictionGrid.reset();
+        mStdevRssiForUnknownBeacon = computeNormalStandardDeviation(mRssiStandardDeviations);
+        this->tDelay(mTDelay);
+    }
+    
     
     /**
      Implementation of GaussianProcessLDPLMultiModelTrainer
@@ -892,6 +1261,7 @@ namespace loc{
         GaussianProcessLDPLMultiModel<Tstate, Tinput>* obsModel = new GaussianProcessLDPLMultiModel<Tstate, Tinput>();
         
         obsModel->gpType = gpType;
+        obsModel->nThreadsTraining = nThreads;
         
         obsModel->bleBeacons(bleBeacons);
         obsModel->train(samplesFiltered);
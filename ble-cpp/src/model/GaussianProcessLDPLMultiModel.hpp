@@ -33,9 +33,15 @@
 #include "GaussianProcess.hpp"
 #include "ObservationModel.hpp"
 #include "ObservationModelTrainer.hpp"
+#include "RssiPredictionGrid.hpp"
+#include "BeaconRegistry.hpp"
+#include "Building.hpp"
 
 namespace loc{
     
+    class ModelBundle;
+    class ModelBundleWriter;
+    
     /**
      ITUModelFunction
      **/
@@ -56,7 +62,7 @@ namespace loc{
         int ndim(){return ndim_;}
         
         ITUModelFunction& distanceOffset(double distanceOffset);
-        //void transformFeature(const Location& stateReceiver, const Location& stateTransmitter, double features[]) const;
+        void transformFeature(const Location& stateReceiver, const Location& stateTransmitter, double features[]) const;
         std::vector<double> transformFeature(const Location& stateReceiver, const Location& stateTransmitter) const;
         double predict(const double parameters[], const double features[]) const;
         double predict(const std::vector<double>& parameters, const std::vector<double>& features) const;
@@ -96,11 +102,16 @@ namespace loc{
         //ITUModelFunction mITUModel;
         std::map<BeaconId, ITUModelFunction> mITUModelMap;
         
-        std::vector<std::vector<double>> mITUParameters;
+        // Column i holds the ITU parameters of mBLEBeacons[i]. mITUParameterStorage owns the values
+        // or keeps the mapped bundle alive.
+        std::shared_ptr<const void> mITUParameterStorage;
+        Eigen::Map<const Eigen::MatrixXd> mITUParameters{nullptr, 0, 0};
         
         //GaussianProcess mGP;
         std::shared_ptr<GaussianProcess> mGP;
         std::map<BeaconId, int> mBeaconIdIndexMap;
+        BeaconRegistry mBeaconRegistry; // indices of mBLEBeacons
+        std::vector<ITUModelFunction> mITUModels; // aligned with mBLEBeacons
         //boost::bimaps::bimap<long, int> mBeaconIdIndexBimap;
         std::vector<double> mRssiStandardDeviations;
         bool mFillsUnknownBeaconRssi = false;
@@ -108,17 +119,28 @@ namespace loc{
         double computeNormalStandardDeviation(std::vector<double> standardDeviations);
         double mCoeffDiffFloorStdev = 5.0;
         
+        // Optional precomputed RSSI means
+        RssiPredictionGrid::Ptr mPredictionGrid;
+        
         // Private function to train the model
         //GaussianProcessLDPLMultiModel& kernelFunction(std::shared_ptr<KernelFunction> kernel);
         GaussianProcessLDPLMultiModel& bleBeacons(BLEBeacons bleBeacons);
         GaussianProcessLDPLMultiModel& train(Samples samples);
         std::vector<std::vector<double>> fitITUModel(Samples samples);
+        void ituParameters(const std::vector<std::vector<double>>& ituParameters);
+        void ituParameters(const Eigen::Map<const Eigen::MatrixXd>& ituParameters, std::shared_ptr<const void> storage);
+        std::vector<std::vector<double>> ituParameters() const;
         std::vector<double> computeRssiStandardDeviations(Samples samples);
+        void updateBeaconIndices();
+        int findBeaconIndex(const Beacon& beacon) const;
         std::vector<int> extractKnownBeaconIndices(const Tinput& beacons) const;
+        void computeLogLikelihoodRelatedValues(const Tstate states[], size_t n, const Tinput& input, std::vector<std::vector<double>>& values);
+        void evaluateCollectedLocations(size_t n, const Tinput& input, std::vector<std::vector<double>>& values);
         
         friend class GaussianProcessLDPLMultiModelTrainer<Tstate, Tinput>;
         int version = 3;
         GPType gpType = GPNORMAL;
+        int nThreadsTraining = 1; // the number of threads for hyperparameter search (0: hardware concurrency)
         
         //parameters for delayed prediction
         int mTDelay = 1;
@@ -146,6 +168,7 @@ namespace loc{
         
         std::vector<double> computeLogLikelihoodRelatedValues(const Tstate& state, const Tinput& input);
         std::vector<std::vector<double>> computeLogLikelihoodRelatedValues(const std::vector<Tstate> & states, const Tinput& input) override;
+        void computeLogLikelihoodRelatedValues(const Particles& particles, const Tinput& input, std::vector<std::vector<double>>& values) override;
         
         GaussianProcessLDPLMultiModel& fillsUnknownBeaconRssi(bool fills);
         bool fillsUnknownBeaconRssi() const;
@@ -155,6 +178,11 @@ namespace loc{
         
         GaussianProcessLDPLMultiModel& coeffDiffFloorStdev(double);
         GaussianProcessLDPLMultiModel& tDelay(int);
+        int tDelay() const;
+        
+        GaussianProcessLDPLMultiModel& buildPredictionGrid(const Building& building, const RssiPredictionGridParameters& params);
+        GaussianProcessLDPLMultiModel& predictionGrid(RssiPredictionGrid::Ptr grid);
+        RssiPredictionGrid::Ptr predictionGrid() const;
         
         template<class Archive>
         void save(Archive& ar) const;
@@ -166,6 +194,12 @@ namespace loc{
         void load(std::ifstream& ifs);
         void load(std::istringstream& iss);
         
+        // Binary form used in model bundles. Only the current version is supported.
+        // GP inputs and weights (except for GaussianProcessLight) and ITU parameters are raw matrix sections;
+        // the rest is a small PortableBinary record in the observation model section.
+        void saveBinary(ModelBundleWriter& writer) const;
+        void loadBinary(const ModelBundle& bundle);
+        
         bool applyLowestLogLikelihood = false;
     };
     
@@ -196,9 +230,14 @@ namespace loc{
             gpType = gt;
         }
         
+        void setNumThreads(int n){
+            nThreads = n;
+        }
+        
     private:
         std::shared_ptr<DataStore> mDataStore;
         GPType gpType = GPNORMAL;
+        int nThreads = 1;
     };
     
 }
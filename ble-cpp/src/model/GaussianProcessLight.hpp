@@ -189,6 +189,17 @@ namespace loc{
             std::vector<double> ypreds(y_hat.data(), y_hat.data() + indices.size());
             return ypreds;
         }
+        
+        void predict(const double xs[], size_t n, const std::vector<int>& indices, double ypreds[]) const
+        {
+            const size_t m = indices.size();
+            double x[N_FEATURES];
+            for (size_t i=0; i < n; ++i) {
+                std::copy(&xs[i*N_FEATURES], &xs[(i+1)*N_FEATURES], x);
+                std::vector<double> tmp = predict(x, indices);
+                std::copy(tmp.begin(), tmp.end(), &ypreds[i*m]);
+            }
+        }
 
         /**
          * Estimate parameters as preparation
@@ -198,6 +209,7 @@ namespace loc{
             GaussianProcess gp;
             gp.sigmaN(sigmaN_);
             gp.gaussianKernel(gaussianKernel_);
+            gp.numThreads(numThreads());
             
             // estimate parameters using GaussianProcess::fitCV
             gp.fitCV(X, Y, Actives);
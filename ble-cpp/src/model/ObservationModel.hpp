@@ -29,6 +29,7 @@
 #include <vector>
 
 #include "Location.hpp"
+#include "Particles.hpp"
 
 namespace loc{
 
@@ -43,6 +44,12 @@ public:
     virtual std::vector<double> computeLogLikelihood(const std::vector<Tstate> & states, const Tinput & input) = 0;
     
     virtual std::vector<std::vector<double>> computeLogLikelihoodRelatedValues(const std::vector<Tstate> & states, const Tinput& input) = 0;
+    
+    // Computes the values for a particle set stored as arrays. The default implementation converts particles to states.
+    virtual void computeLogLikelihoodRelatedValues(const Particles& particles, const Tinput& input, std::vector<std::vector<double>>& values){
+        States states = particles.toStates();
+        values = computeLogLikelihoodRelatedValues(std::vector<Tstate>(states.begin(), states.end()), input);
+    }
 
 };
 
@@ -49,12 +49,16 @@ namespace loc{
     }
     
     State PoseRandomWalker::predict(State state, SystemModelInput input){
+        return predict(state, input, motionControl(), randomGenerator);
+    }
+    
+    State PoseRandomWalker::predict(State state, SystemModelInput input, const SystemModelMotionControl& control, RandomGenerator& randomGenerator){
         
         //long timestamp = input.timestamp;
         //long previousTimestamp = input.previousTimestamp;
         double dTime = (input.timestamp()-input.previousTimestamp())/(1000.0); //[s] Difference in time
         
-        double movLevel = movingLevel();
+        double movLevel = movingLevel(control);
         double nSteps = mProperty->pedometer()->getNSteps();
         double yaw = mProperty->orientationMeter()->getYaw();
         
@@ -94,10 +98,10 @@ namespace loc{
         
         // Update velocity at the moment
         if(nSteps > 0){
-            v = nV * velocityRate() * turningVelocityRate;
+            v = nV * control.velocityRate * turningVelocityRate;
         }
-        if(relativeVelocity()>0){
-            v += randomGenerator.nextTruncatedGaussian(relativeVelocity(),
+        if(control.relativeVelocity>0){
+            v += randomGenerator.nextTruncatedGaussian(control.relativeVelocity,
                                                  poseProperty->diffusionVelocity()*dTime,
                                                  poseProperty->minVelocity(),
                                                  poseProperty->maxVelocity());
@@ -116,9 +120,26 @@ namespace loc{
     }
 
     
+    bool PoseRandomWalker::supportsConcurrentPredictions() const{
+        return true;
+    }
+    
+    SystemModelMotionControl PoseRandomWalker::motionControl() const{
+        SystemModelMotionControl control;
+        control.velocityRate = velocityRate();
+        control.relativeVelocity = relativeVelocity();
+        control.isUnderControl = isUnderControll;
+        control.movement = mMovement;
+        return control;
+    }
+    
     double PoseRandomWalker::movingLevel(){
-        if(isUnderControll){
-            return mMovement;
+        return movingLevel(motionControl());
+    }
+    
+    double PoseRandomWalker::movingLevel(const SystemModelMotionControl& control) const{
+        if(control.isUnderControl){
+            return control.movement;
         }else{
             return mProperty->pedometer()->getNSteps();
         }
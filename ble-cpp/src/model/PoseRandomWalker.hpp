@@ -93,8 +93,14 @@ namespace loc{
         
         virtual std::vector<State> predict(std::vector<State> poses, SystemModelInput input) override;
         virtual State predict(State state, SystemModelInput input) override;
+        virtual State predict(State state, SystemModelInput input, const SystemModelMotionControl& control, RandomGenerator& randomGenerator) override;
+        virtual bool supportsConcurrentPredictions() const override;
         
         virtual double movingLevel();
+        
+    protected:
+        SystemModelMotionControl motionControl() const;
+        double movingLevel(const SystemModelMotionControl& control) const;
     };
     
 }
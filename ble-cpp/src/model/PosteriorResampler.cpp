@@ -25,6 +25,12 @@
 
 namespace loc{
     
+    template<class Tstate>
+    void PosteriorResampler<Tstate>::resample(Particles& particles){
+        States states = particles.toStates();
+        particles.assign(resample(states));
+    }
+    
     template<class Tstate>
     void OrientationPosteriorResampler<Tstate>::probabilityParametric(double probParam){
         probParametric = probParam;
@@ -52,17 +58,7 @@ namespace loc{
         
         for(size_t i=0; i<n; i++){
             State sNew(states.at(i));
-            double theta;
-            double r = mRand->nextDouble();
-            if(isinf(sigma)){
-                theta = 2.0*M_PI*mRand->nextDouble();
-            }else if(r < probParametric){
-                theta = mu + sigma*mRand->nextGaussian();
-                theta = std::fmod(theta, 2.0*M_PI);
-            }else{
-                theta = 2.0*M_PI*mRand->nextDouble();
-            }
-            theta = theta<M_PI ? theta : theta-2.0*M_PI; // [-pi, pi]
+            double theta = sampleOrientation(mu, sigma);
             sNew.orientation(theta);
             sNew.orientationBias(theta);
             statesNew.at(i) = sNew;
@@ -71,5 +67,40 @@ namespace loc{
         return statesNew;
     }
     
+    template<class Tstate>
+    void OrientationPosteriorResampler<Tstate>::resample(Particles& particles){
+        size_t n = particles.size();
+        double* orientations = particles.orientation();
+        double* orientationBiases = particles.orientationBias();
+        mOrientations.assign(orientations, orientations + n);
+        
+        auto wrappedNormStats = MathUtils::computeWrappedNormalParameters(mOrientations);
+        double mu = wrappedNormStats.mean();
+        double sigma = wrappedNormStats.stdev();
+        
+        for(size_t i=0; i<n; i++){
+            double theta = sampleOrientation(mu, sigma);
+            orientations[i] = theta;
+            orientationBiases[i] = theta;
+        }
+    }
+    
+    template<class Tstate>
+    double OrientationPosteriorResampler<Tstate>::sampleOrientation(double mu, double sigma){
+        double theta;
+        double r = mRand->nextDouble();
+        if(isinf(sigma)){
+            theta = 2.0*M_PI*mRand->nextDouble();
+        }else if(r < probParametric){
+            theta = mu + sigma*mRand->nextGaussian();
+            theta = std::fmod(theta, 2.0*M_PI);
+        }else{
+            theta = 2.0*M_PI*mRand->nextDouble();
+        }
+        theta = theta<M_PI ? theta : theta-2.0*M_PI; // [-pi, pi]
+        return theta;
+    }
+    
+    template class PosteriorResampler<State>;
     template class OrientationPosteriorResampler<State>;
 }
@@ -27,6 +27,7 @@
 #include <memory>
 #include "RandomGenerator.hpp"
 #include "State.hpp"
+#include "Particles.hpp"
 
 namespace loc {
     
@@ -37,6 +38,8 @@ namespace loc {
         
         virtual ~PosteriorResampler() = default;
         virtual std::vector<Tstate> resample(const std::vector<Tstate>& states) = 0;
+        // Resamples particles in place. The default implementation goes through resample(states).
+        virtual void resample(Particles& particles);
     };
     
     template<class Tstate>
@@ -45,6 +48,9 @@ namespace loc {
     private:
         std::shared_ptr<RandomGenerator> mRand;
         double probParametric = 0.8;
+        std::vector<double> mOrientations;
+        
+        double sampleOrientation(double mu, double sigma);
         
     public:
         using Ptr = std::shared_ptr<OrientationPosteriorResampler<Tstate>>;
@@ -52,7 +58,8 @@ namespace loc {
         OrientationPosteriorResampler(): mRand(new RandomGenerator){}
         ~OrientationPosteriorResampler() = default;
         
-        std::vector<Tstate> resample(const std::vector<Tstate>&);
+        std::vector<Tstate> resample(const std::vector<Tstate>&) override;
+        void resample(Particles& particles) override;
         void probabilityParametric(double);
         double probabilityParametric() const;
     };
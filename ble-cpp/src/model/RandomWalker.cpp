@@ -40,13 +40,18 @@ namespace loc{
     
     template<class Ts, class Tin>
     Ts RandomWalker<Ts, Tin>::predict(Ts loc, Tin input){
+        return predict(loc, input, SystemModelMotionControl(), *mRandGen);
+    }
+    
+    template<class Ts, class Tin>
+    Ts RandomWalker<Ts, Tin>::predict(Ts loc, Tin input, const SystemModelMotionControl& control, RandomGenerator& randGen){
         double x = loc.x();
         double y = loc.y();
         double z = loc.z();
         double floor = loc.floor();
         
-        x += mRWProperty->sigma * mRandGen->nextGaussian();
-        y += mRWProperty->sigma * mRandGen->nextGaussian();
+        x += mRWProperty->sigma * randGen.nextGaussian();
+        y += mRWProperty->sigma * randGen.nextGaussian();
         
         State locNew;
         locNew.x(x).y(y).z(z).floor(floor);
@@ -65,6 +70,11 @@ namespace loc{
         return locsNew;
     }
     
+    template<class Ts, class Tin>
+    bool RandomWalker<Ts, Tin>::supportsConcurrentPredictions() const{
+        return true;
+    }
+    
     // Explicit instantiation
     template class RandomWalker<State, RandomWalkerInput>;
 }
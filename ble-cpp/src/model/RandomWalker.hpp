@@ -59,6 +59,8 @@ namespace loc{
         virtual RandomWalker<Ts, Tin>& setProperty(RandomWalkerProperty::Ptr property);
         virtual Ts predict(Ts state, Tin input) override;
         virtual std::vector<Ts> predict(std::vector<Ts> states, Tin input) override;
+        virtual Ts predict(Ts state, Tin input, const SystemModelMotionControl& control, RandomGenerator& randGen) override;
+        virtual bool supportsConcurrentPredictions() const override;
         
     protected:
         RandomWalkerProperty::Ptr mRWProperty;
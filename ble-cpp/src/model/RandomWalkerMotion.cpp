@@ -19,7 +19,6 @@
  * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
  * THE SOFTWARE.
  *******************************************************************************/
-
 #include "RandomWalkerMotion.hpp"
 #include "PoseRandomWalker.hpp"
 
@@ -27,7 +26,12 @@ namespace loc{
     
     template<class Ts, class Tin>
     Ts RandomWalkerMotion<Ts, Tin>::predict(Ts state, Tin input){
-        auto& mRandGen = RandomWalker<Ts, Tin>::mRandGen;
+        updateTurningVelocityRate(input);
+        return predict(state, input, motionControl(), *RandomWalker<Ts, Tin>::mRandGen);
+    }
+    
+    template<class Ts, class Tin>
+    Ts RandomWalkerMotion<Ts, Tin>::predict(Ts state, Tin input, const SystemModelMotionControl& control, RandomGenerator& randGen){
         const auto& mPedometer = mRWMotionProperty->pedometer();
         const auto& mOrientationMeter = mRWMotionProperty->orientationMeter();
         
@@ -41,7 +45,7 @@ namespace loc{
         }
         
         if(mPedometer && mOrientationMeter){
-            double movLevel = movingLevel();
+            double movLevel = movingLevel(control);
             double x = state.x();
             double y = state.y();
             double z = state.z();
@@ -51,27 +55,6 @@ namespace loc{
                 throw std::runtime_error("Time increment is too small in RandomWalkerMotion.");
             }
             
-            // Compute velocity rate to reduce velocity when turning
-            if(mRWMotionProperty->usesAngularVelocityLimit()){
-                double yaw =  Pose::normalizeOrientaion(mOrientationMeter->getYaw());
-                if(!wasYawUpdated){
-                    currentTimestamp = t_cur;
-                    currentYaw = yaw;
-                    wasYawUpdated = true;
-                }
-                if(currentTimestamp!=t_cur){
-                    currentTimestamp = t_cur;
-                    double previousYaw = Pose::normalizeOrientaion(currentYaw);
-                    currentYaw = Pose::normalizeOrientaion(yaw);
-                    double oriDiff = Pose::computeOrientationDifference(previousYaw, currentYaw);
-                    double angularVelocity = oriDiff/dt;
-                    double angularVelocityLimit = mRWMotionProperty->angularVelocityLimit();
-                    turningVelocityRate = std::sqrt(1.0 - std::min(1.0, std::pow(angularVelocity/angularVelocityLimit,2)));
-                }
-            }else{
-                turningVelocityRate = 1.0;
-            }
-            
             double sigma;
             if(movLevel > 0){
                 sigma = mRWMotionProperty->sigmaMove;
@@ -83,13 +66,13 @@ namespace loc{
             sigma = sigma * std::sqrt(1.0/dt);
             
             // Multiply sigma by velocity rate
-            sigma = sigma * velocityRate();
+            sigma = sigma * control.velocityRate;
             
             // Multyply sigma by turning velocity rate
             sigma = sigma * turningVelocityRate;
             
-            double nx = mRandGen->nextGaussian();
-            double ny = mRandGen->nextGaussian();
+            double nx = randGen.nextGaussian();
+            double ny = randGen.nextGaussian();
             double theta = std::atan2(ny, nx);
             
             double vx = sigma * nx;
@@ -114,16 +97,71 @@ namespace loc{
         }
     }
     
+    template<class Ts, class Tin>
+    void RandomWalkerMotion<Ts, Tin>::startPredictions(const std::vector<Ts>& states, const Tin& input){
+        updateTurningVelocityRate(input);
+    }
+    
+    template<class Ts, class Tin>
+    void RandomWalkerMotion<Ts, Tin>::updateTurningVelocityRate(const Tin& input){
+        const auto& mOrientationMeter = mRWMotionProperty->orientationMeter();
+        
+        long t_pre = input.previousTimestamp();
+        long t_cur = input.timestamp();
+        double dt = (t_cur-t_pre)*input.timeUnit();
+        
+        // Invalid inputs are reported by predict.
+        if(!mRWMotionProperty->pedometer() || !mOrientationMeter || dt<input.timeUnit()){
+            return;
+        }
+        
+        // Compute velocity rate to reduce velocity when turning
+        if(mRWMotionProperty->usesAngularVelocityLimit()){
+            double yaw =  Pose::normalizeOrientaion(mOrientationMeter->getYaw());
+            if(!wasYawUpdated){
+                currentTimestamp = t_cur;
+                currentYaw = yaw;
+                wasYawUpdated = true;
+            }
+            if(currentTimestamp!=t_cur){
+                currentTimestamp = t_cur;
+                double previousYaw = Pose::normalizeOrientaion(currentYaw);
+                currentYaw = Pose::normalizeOrientaion(yaw);
+                double oriDiff = Pose::computeOrientationDifference(previousYaw, currentYaw);
+                double angularVelocity = oriDiff/dt;
+                double angularVelocityLimit = mRWMotionProperty->angularVelocityLimit();
+                turningVelocityRate = std::sqrt(1.0 - std::min(1.0, std::pow(angularVelocity/angularVelocityLimit,2)));
+            }
+        }else{
+            turningVelocityRate = 1.0;
+        }
+    }
+    
     template<class Ts, class Tin>
     RandomWalkerMotion<Ts, Tin>& RandomWalkerMotion<Ts, Tin>::setProperty(RandomWalkerMotionProperty::Ptr property){
         mRWMotionProperty = property;
         return *this;
     }
     
+    template<class Ts, class Tin>
+    SystemModelMotionControl RandomWalkerMotion<Ts, Tin>::motionControl() const{
+        SystemModelMotionControl control;
+        control.velocityRate = velocityRate();
+        control.relativeVelocity = relativeVelocity();
+        control.isUnderControl = isUnderControll;
+        control.movement = mMovement;
+        return control;
+    }
+    
     template<class Ts, class Tin>
     double RandomWalkerMotion<Ts, Tin>::movingLevel(){
-        if(isUnderControll){
-            return mMovement;
+        return movingLevel(motionControl());
+    }
+    
+    template<class Ts, class Tin>
+    double RandomWalkerMotion<Ts, Tin>::movingLevel(const SystemModelMotionControl& control) const{
+        if(control.isUnderControl){
+            return control.movement;
         }else{
             return mRWMotionProperty->pedometer()->getNSteps();
         }
@@ -84,7 +84,10 @@ namespace loc{
         
         using Ptr = std::shared_ptr<RandomWalkerMotion>;
         
+        using RandomWalker<Ts, Tin>::predict;
         virtual Ts predict(Ts state, Tin input) override;
+        virtual Ts predict(Ts state, Tin input, const SystemModelMotionControl& control, RandomGenerator& randGen) override;
+        virtual void startPredictions(const std::vector<Ts>& states, const Tin& input) override;
         virtual RandomWalkerMotion& setProperty(RandomWalkerMotionProperty::Ptr);
 
     protected:
@@ -94,7 +97,11 @@ namespace loc{
         double currentYaw;
         bool wasYawUpdated = false;
         
+        // Updates turningVelocityRate once per timestamp. Shared by all particles predicted at the timestamp.
+        virtual void updateTurningVelocityRate(const Tin& input);
         virtual double movingLevel();
+        double movingLevel(const SystemModelMotionControl& control) const;
+        SystemModelMotionControl motionControl() const;
     };
 }
 
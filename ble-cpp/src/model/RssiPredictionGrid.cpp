@@ -0,0 +1,120 @@
+/*******************************************************************************
+ * Copyright (c) 2014, 2016  IBM Corporation and others
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *******************************************************************************/
+
+#include "RssiPredictionGrid.hpp"
+#include <cmath>
+#include <cassert>
+
+namespace loc{
+    
+    RssiPredictionGrid::RssiPredictionGrid(size_t nBeacons, double cellSize, double z){
+        nBeacons_ = nBeacons;
+        cellSize_ = cellSize;
+        z_ = z;
+    }
+    
+    size_t RssiPredictionGrid::nBeacons() const{
+        return nBeacons_;
+    }
+    
+    double RssiPredictionGrid::cellSize() const{
+        return cellSize_;
+    }
+    
+    double RssiPredictionGrid::z() const{
+        return z_;
+    }
+    
+    size_t RssiPredictionGrid::memoryUsage() const{
+        size_t size = 0;
+        for(const auto& pair: lattices_){
+            size += pair.second.values.size()*sizeof(float);
+        }
+        return size;
+    }
+    
+    RssiPredictionGrid& RssiPredictionGrid::floorLattice(int floor, FloorLattice lattice){
+        assert(lattice.values.size() == (size_t) lattice.nx*lattice.ny*nBeacons_);
+        lattices_[floor] = std::move(lattice);
+        return *this;
+    }
+    
+    const std::map<int, RssiPredictionGrid::FloorLattice>& RssiPredictionGrid::floorLattices() const{
+        return lattices_;
+    }
+    
+    namespace{
+        // Find lattice and cell containing location
+        const RssiPredictionGrid::FloorLattice* findCell(const std::map<int, RssiPredictionGrid::FloorLattice>& lattices, double cellSize, double z,
+                                                        const Location& location, int& ix, int& iy, double& tx, double& ty){
+            double floor = location.floor();
+            int floor_int = static_cast<int>(std::round(floor));
+            if(floor != floor_int || 1.0e-6 < std::abs(location.z() - z)){
+                return nullptr;
+            }
+            auto iter = lattices.find(floor_int);
+            if(iter==lattices.end()){
+                return nullptr;
+            }
+            const auto& lattice = iter->second;
+            double fx = (location.x() - lattice.xmin)/cellSize;
+            double fy = (location.y() - lattice.ymin)/cellSize;
+            if( !(0<=fx && fx<=lattice.nx-1 && 0<=fy && fy<=lattice.ny-1) ){
+                return nullptr;
+            }
+            ix = std::min(static_cast<int>(fx), lattice.nx-2);
+            iy = std::min(static_cast<int>(fy), lattice.ny-2);
+            tx = fx - ix;
+            ty = fy - iy;
+            return &lattice;
+        }
+    }
+    
+    bool RssiPredictionGrid::covers(const Location& location) const{
+        int ix, iy;
+        double tx, ty;
+        return findCell(lattices_, cellSize_, z_, location, ix, iy, tx, ty) != nullptr;
+    }
+    
+    bool RssiPredictionGrid::interpolate(const Location& location, const int indices[], size_t m, double ypreds[]) const{
+        int ix, iy;
+        double tx, ty;
+        const FloorLattice* lattice = findCell(lattices_, cellSize_, z_, location, ix, iy, tx, ty);
+        if(lattice==nullptr){
+            return false;
+        }
+        size_t nb = nBeacons_;
+        const float* v00 = &lattice->values[((size_t)iy*lattice->nx + ix)*nb];
+        const float* v10 = v00 + nb;
+        const float* v01 = v00 + (size_t)lattice->nx*nb;
+        const float* v11 = v01 + nb;
+        double w00 = (1-tx)*(1-ty);
+        double w10 = tx*(1-ty);
+        double w01 = (1-tx)*ty;
+        double w11 = tx*ty;
+        for(size_t j=0; j<m; j++){
+            int b = indices[j];
+            ypreds[j] = w00*v00[b] + w10*v10[b] + w01*v01[b] + w11*v11[b];
+        }
+        return true;
+    }
+}
@@ -0,0 +1,82 @@
+/*******************************************************************************
+ * Copyright (c) 2014, 2016  IBM Corporation and others
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *******************************************************************************/
+
+#ifndef RssiPredictionGrid_hpp
+#define RssiPredictionGrid_hpp
+
+#include <stdio.h>
+#include <map>
+#include <vector>
+#include <memory>
+
+#include "Location.hpp"
+
+namespace loc{
+    
+    struct RssiPredictionGridParameters{
+        double cellSize = 1.0; // [m]
+        double z = 0.0; // height of lattice points
+        size_t maxMemoryBytes = 64*1024*1024; // cellSize is enlarged until the grid fits in this size
+    };
+    
+    /**
+     Lattice of predicted RSSI means for all beacons on each floor.
+     Values of a lattice point are stored contiguously (point-major, beacon-minor).
+     **/
+    class RssiPredictionGrid{
+    public:
+        using Ptr = std::shared_ptr<RssiPredictionGrid>;
+        
+        struct FloorLattice{
+            double xmin = 0;
+            double ymin = 0;
+            int nx = 0;
+            int ny = 0;
+            std::vector<float> values;
+        };
+        
+    private:
+        size_t nBeacons_ = 0;
+        double cellSize_ = 1.0;
+        double z_ = 0.0;
+        std::map<int, FloorLattice> lattices_;
+        
+    public:
+        RssiPredictionGrid() = default;
+        ~RssiPredictionGrid() = default;
+        RssiPredictionGrid(size_t nBeacons, double cellSize, double z);
+        
+        size_t nBeacons() const;
+        double cellSize() const;
+        double z() const;
+        size_t memoryUsage() const;
+        
+        RssiPredictionGrid& floorLattice(int floor, FloorLattice lattice);
+        const std::map<int, FloorLattice>& floorLattices() const;
+        
+        // Bilinear interpolation of predicted means for beacon indices. Returns false if location is not covered.
+        bool interpolate(const Location& location, const int indices[], size_t m, double ypreds[]) const;
+        bool covers(const Location& location) const;
+    };
+}
+
+#endif /* RssiPredictionGrid_hpp */
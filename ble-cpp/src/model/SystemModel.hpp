@@ -28,6 +28,8 @@
 #include <memory>
 
 #include "Location.hpp"
+#include "Particles.hpp"
+#include "RandomGenerator.hpp"
 
 namespace loc{
     
@@ -56,6 +58,14 @@ public:
     }
 };
     
+    // Motion adjustments of a single prediction given by the caller instead of being set to a model.
+    struct SystemModelMotionControl{
+        double velocityRate = 1.0;
+        double relativeVelocity = 0.0;
+        bool isUnderControl = false;
+        double movement = 0.0;
+    };
+    
     template<class Ts, class Tin> class SystemModel{
     public:
         
@@ -66,8 +76,33 @@ public:
         //virtual SystemModel<Ts, Tin, Tproperty>* setProperty(Tproperty property) = 0;
         virtual Ts predict(Ts state, Tin input) = 0;
         virtual std::vector<Ts> predict(std::vector<Ts> states, Tin input)  = 0;
+        
+        // Predicts a particle set in place. The default implementation predicts each particle through its state
+        // and writes it to the field arrays of a buffer, which is swapped in after all predictions succeeded.
+        // Particles are left unchanged when prediction of any particle fails.
+        virtual void predict(Particles& particles, Tin input){
+            size_t n = particles.size();
+            Particles predicted(n);
+            this->startPredictions(std::vector<Ts>(), input);
+            for(size_t i=0; i<n; i++){
+                predicted.state(i, predict(particles.state(i), input));
+            }
+            this->endPredictions(std::vector<Ts>(), input);
+            particles.swapFields(predicted);
+        }
         //virtual std::vector<Ts>* predict(std::vector<Ts> states) = 0;
         
+        // Predicts a state with the given motion control and random generator.
+        // When supportsConcurrentPredictions() is true, this function can be called from multiple threads between
+        // startPredictions and endPredictions; it must not modify the model and must draw random numbers only from randomGenerator.
+        // The default implementation ignores the arguments and is not thread-safe.
+        virtual Ts predict(Ts state, Tin input, const SystemModelMotionControl& control, RandomGenerator& randomGenerator){
+            return predict(state, input);
+        }
+        virtual bool supportsConcurrentPredictions() const{
+            return false;
+        }
+        
         virtual void startPredictions(const std::vector<Ts>& states, const Tin& input){
             // Do nothing in a default method
         }
@@ -227,7 +227,51 @@ namespace loc{
     }
     
     template<class Tstate, class Tinput>
-    Tstate SystemModelInBuilding<Tstate, Tinput>::moveOnElevator(const Tstate& state, Tinput input){
+    SystemModelInBuilding<Tstate, Tinput>& SystemModelInBuilding<Tstate, Tinput>::numThreads(int nThreads){
+        if(nThreads<0){
+            BOOST_THROW_EXCEPTION(LocException("nThreads must not be negative."));
+        }
+        if(mNumThreads!=nThreads){
+            mThreadPool.reset();
+        }
+        mNumThreads = nThreads;
+        return *this;
+    }
+    
+    template<class Tstate, class Tinput>
+    int SystemModelInBuilding<Tstate, Tinput>::numThreads() const{
+        return mNumThreads;
+    }
+    
+    template<class Tstate, class Tinput>
+    SystemModelInBuilding<Tstate, Tinput>& SystemModelInBuilding<Tstate, Tinput>::partitionSize(size_t partitionSize){
+        if(partitionSize==0){
+            BOOST_THROW_EXCEPTION(LocException("partitionSize must be positive."));
+        }
+        mPartitionSize = partitionSize;
+        return *this;
+    }
+    
+    template<class Tstate, class Tinput>
+    size_t SystemModelInBuilding<Tstate, Tinput>::partitionSize() const{
+        return mPartitionSize;
+    }
+    
+    template<class Tstate, class Tinput>
+    SystemModelInBuilding<Tstate, Tinput>& SystemModelInBuilding<Tstate, Tinput>::threadPool(ThreadPool::Ptr threadPool){
+        mThreadPool = threadPool;
+        mNumThreads = threadPool ? threadPool->numThreads() : 1;
+        return *this;
+    }
+    
+    template<class Tstate, class Tinput>
+    SystemModelInBuilding<Tstate, Tinput>& SystemModelInBuilding<Tstate, Tinput>::metrics(PipelineMetrics::Ptr metrics){
+        mMetrics = metrics;
+        return *this;
+    }
+    
+    template<class Tstate, class Tinput>
+    Tstate SystemModelInBuilding<Tstate, Tinput>::moveOnElevator(const Tstate& state, Tinput input, RandomGenerator& randGen){
         int f_min = mBuilding->minFloor();
         int f_max = mBuilding->maxFloor();
         int f_current = std::round(state.floor());
@@ -240,14 +284,14 @@ namespace loc{
             return stateNew;
         }
         while(true){
-            double p = mRandomGenerator.nextDouble();
+            double p = randGen.nextDouble();
             if(p<=pStay){
                 stateNew.floor(f_current);
                 break;
             }else{
                 int f_new = f_current;
                 while(true){
-                    f_new = f_min + mRandomGenerator.nextInt(f_max - f_min);
+                    f_new = f_min + randGen.nextInt(f_max - f_min);
                     if(f_new != f_current){
                         break;
                     }
@@ -268,7 +312,7 @@ namespace loc{
     }
     
     template<class Tstate, class Tinput>
-    Tstate SystemModelInBuilding<Tstate, Tinput>::moveOnEscalator(const Tstate& state, Tinput input){
+    Tstate SystemModelInBuilding<Tstate, Tinput>::moveOnEscalator(const Tstate& state, Tinput input, RandomGenerator& randGen){
         // TODO: many duplications with moveOnStair
         int f_min = mBuilding->minFloor();
         int f_max = mBuilding->maxFloor();
@@ -291,7 +335,7 @@ namespace loc{
         
         Tstate stateNew(state);
         while(true){
-            double p = mRandomGenerator.nextDouble();
+            double p = randGen.nextDouble();
             if(p < pUp){
                 f_new = f+1;
             }else if( p - pUp < pDown){
@@ -312,7 +356,7 @@ namespace loc{
     
     
     template<class Tstate, class Tinput>
-    Tstate SystemModelInBuilding<Tstate, Tinput>::moveOnStair(const Tstate& state, Tinput input){
+    Tstate SystemModelInBuilding<Tstate, Tinput>::moveOnStair(const Tstate& state, Tinput input, RandomGenerator& randGen){
         int f_min = mBuilding->minFloor();
         int f_max = mBuilding->maxFloor();
         int f = state.floor();
@@ -334,7 +378,7 @@ namespace loc{
         
         Tstate stateNew(state);
         while(true){
-            double p = mRandomGenerator.nextDouble();
+            double p = randGen.nextDouble();
             if(p < pUp){
                 f_new = f+1;
             }else if( p - pUp < pDown){
@@ -369,53 +413,46 @@ namespace loc{
     }
 
     template<class Tstate, class Tinput>
-    Tstate SystemModelInBuilding<Tstate, Tinput>::moveOnFloor(const Tstate& state, Tinput input){
+    Tstate SystemModelInBuilding<Tstate, Tinput>::moveOnFloor(const Tstate& state, Tinput input, RandomGenerator& randGen){
         if(! mBuilding->isMovable(state)){
             BOOST_THROW_EXCEPTION(LocException("building->isMovable(state) is false"));
         }
         Tstate stateNew(state);
         
-        auto sysVelAdj = std::dynamic_pointer_cast<SystemModelVelocityAdjustable>(mSysModel);
-        auto sysCtrl = std::dynamic_pointer_cast<SystemModelMovementControllable>(mSysModel);
-        if(sysVelAdj!=NULL){
-             // Change field velocity
-             if(mBuilding->isElevator(state)){
-                 sysVelAdj->velocityRate(mProperty->velocityRateElevator());
-             }else if(mBuilding->isStair(state)){
-                 sysVelAdj->velocityRate(mProperty->velocityRateStair());
-             }else if(mBuilding->isEscalatorGroup(state)){
-                 sysVelAdj->velocityRate(mProperty->velocityRateEscalator());
-                 sysVelAdj->relativeVelocity(mProperty->relativeVelocityEscalator());
-             }else{
-                 sysVelAdj->velocityRate(mProperty->velocityRateFloor());
-             }
+        // Field velocity and movement control are passed to the system model for each particle.
+        SystemModelMotionControl control;
+        if(mBuilding->isElevator(state)){
+            control.velocityRate = mProperty->velocityRateElevator();
+        }else if(mBuilding->isStair(state)){
+            control.velocityRate = mProperty->velocityRateStair();
+        }else if(mBuilding->isEscalatorGroup(state)){
+            control.velocityRate = mProperty->velocityRateEscalator();
+            control.relativeVelocity = mProperty->relativeVelocityEscalator();
+        }else{
+            control.velocityRate = mProperty->velocityRateFloor();
         }
-        if(sysCtrl!=NULL){
-            if(mBuilding->isEscalatorGroup(state)){
-                sysCtrl->forceMove();
-            }
+        if(mBuilding->isEscalatorGroup(state)){
+            control.isUnderControl = true;
+            control.movement = 1.0;
         }
         // Update state
         for(int i=0; i<mProperty->maxTrial() ; i++){
-            stateNew = mSysModel->predict(state, input);
+            stateNew = mSysModel->predict(state, input, control, randGen);
             if(mBuilding->checkMovableRoute(state, stateNew)){
                 break;
             }else if(i==mProperty->maxTrial()-1){
-                stateNew = moveOnFloorRetry(state, stateNew, input);
+                if(mMetrics){
+                    mMetrics->increment(PipelineMetrics::REJECTION_FALLBACKS);
+                }
+                stateNew = moveOnFloorRetry(state, stateNew, input, randGen);
                 if(!mBuilding->checkMovableRoute(state, stateNew)){
                     BOOST_THROW_EXCEPTION(LocException("A route from location (" + static_cast<Location>(state).toString()
                                                         + ") to new location (" + static_cast<Location>(stateNew).toString() + ") is invalid."));
                 }
+            }else if(mMetrics){
+                mMetrics->increment(PipelineMetrics::REJECTION_RETRIES);
             }
         }
-        if(sysVelAdj!=NULL){
-            // Revert field velocity
-            sysVelAdj->velocityRate(mProperty->velocityRateFloor());
-            sysVelAdj->relativeVelocity(0.0);
-        }
-        if(sysCtrl!=NULL){
-            sysCtrl->releaseControl();
-        }
         if(! mBuilding->isMovable(stateNew)){
             if (stateNew.weight() != 0){
                 BOOST_THROW_EXCEPTION(LocException("stateNew.weight is not 0 even though stateNew is not movable."));
@@ -425,9 +462,9 @@ namespace loc{
     }
     
     template<class Tstate, class Tinput>
-    Tstate SystemModelInBuilding<Tstate, Tinput>::moveOnFloorRetry(const Tstate& state, const Tstate& stateNew, Tinput input){
+    Tstate SystemModelInBuilding<Tstate, Tinput>::moveOnFloorRetry(const Tstate& state, const Tstate& stateNew, Tinput input, RandomGenerator& randGen){
         Tstate stateTmp(stateNew);
-        if( mRandomGenerator.nextDouble() < mProperty->wallCrossingAliveRate()){
+        if( randGen.nextDouble() < mProperty->wallCrossingAliveRate()){
             double orientation = atan2(stateNew.y() - state.y(), stateNew.x() - state.x());
             double angle = mBuilding->estimateWallAngle(state, stateNew);
             double orientationDiff = Pose::computeOrientationDifference(orientation, angle);
@@ -451,12 +488,12 @@ namespace loc{
     }
     
     template<class Tstate, class Tinput>
-    Tstate SystemModelInBuilding<Tstate, Tinput>::moveFloorJump(const Tstate& state, Tinput input){
+    Tstate SystemModelInBuilding<Tstate, Tinput>::moveFloorJump(const Tstate& state, Tinput input, RandomGenerator& randGen){
         int f_min = mBuilding->minFloor();
         int f_max = mBuilding->maxFloor();
         Tstate stateNew(state);
         while(true){
-            int f_new = f_min + mRandomGenerator.nextInt(f_max - f_min);
+            int f_new = f_min + randGen.nextInt(f_max - f_min);
             if(mBuilding->isValidFloor(f_new)){
                 stateNew = Tstate(state);
                 stateNew.floor(f_new);
@@ -470,31 +507,46 @@ namespace loc{
     
     template<class Tstate, class Tinput>
     Tstate SystemModelInBuilding<Tstate, Tinput>::predict(Tstate state, Tinput input){
+        return predictInBuilding(state, input, mRandomGenerator);
+    }
+    
+    template<class Tstate, class Tinput>
+    void SystemModelInBuilding<Tstate, Tinput>::startPredictions(const std::vector<Tstate>& states, const Tinput& input){
+        mSysModel->startPredictions(states, input);
+    }
+    
+    template<class Tstate, class Tinput>
+    void SystemModelInBuilding<Tstate, Tinput>::endPredictions(const std::vector<Tstate>& states, const Tinput& input){
+        mSysModel->endPredictions(states, input);
+    }
+    
+    template<class Tstate, class Tinput>
+    Tstate SystemModelInBuilding<Tstate, Tinput>::predictInBuilding(const Tstate& state, Tinput input, RandomGenerator& randGen){
         if(! mBuilding->isMovable(state)){
             BOOST_THROW_EXCEPTION(LocException("building->isMovable(state) == false"));
         }
         try{
             // Jumping move
-            if(mRandomGenerator.nextDouble() < mProperty->probabilityFloorJump()){
-                Tstate stateTmp = moveFloorJump(state, input);
-                return moveOnFloor(stateTmp, input);
+            if(randGen.nextDouble() < mProperty->probabilityFloorJump()){
+                Tstate stateTmp = moveFloorJump(state, input, randGen);
+                return moveOnFloor(stateTmp, input, randGen);
             }
             // Standard move
             if(mBuilding->isElevator(state)){
-                Tstate stateTmp = moveOnElevator(state, input);
+                Tstate stateTmp = moveOnElevator(state, input, randGen);
                 if(Location::floorDifference(state, stateTmp)==0){
-                    return moveOnFloor(stateTmp, input);
+                    return moveOnFloor(stateTmp, input, randGen);
                 }else{
                     return stateTmp;
                 }
             }else if(mBuilding->isEscalator(state)){ // escalator move is not allowed on escalator end
-                State stateTmp = moveOnEscalator(state, input);
-                return moveOnFloor(stateTmp, input);
+                State stateTmp = moveOnEscalator(state, input, randGen);
+                return moveOnFloor(stateTmp, input, randGen);
             }else if(mBuilding->isStair(state)){
-                State stateTmp = moveOnStair(state, input);
-                return moveOnFloor(stateTmp, input);
+                State stateTmp = moveOnStair(state, input, randGen);
+                return moveOnFloor(stateTmp, input, randGen);
             }else{
-                return moveOnFloor(state, input);
+                return moveOnFloor(state, input, randGen);
             }
         }catch(LocException& ex){
             ex << boost::error_info<struct err_info, std::string>("Failed prediction at a given location (" + static_cast<Location>(state).toString() + ")");
@@ -503,15 +555,85 @@ namespace loc{
     }
 
     template<class Tstate, class Tinput>
-    std::vector<Tstate> SystemModelInBuilding<Tstate, Tinput>::predict(std::vector<Tstate> states, Tinput input){
-        std::vector<Tstate> statesPredicted(states.size());
+    template<class Tgetter, class Tsetter>
+    void SystemModelInBuilding<Tstate, Tinput>::predictPartitions(const std::vector<Tstate>& states, size_t n, Tgetter stateAt, Tsetter storeAt, Tinput input){
         mSysModel->startPredictions(states, input);
-        for(int i=0; i<states.size(); i++){
-            Tstate& st = states.at(i);
-            statesPredicted[i] = predict(st, input);
+        size_t nPartitions = (n + mPartitionSize - 1)/mPartitionSize;
+        if(mPartitionRandomGenerators.size() < nPartitions){
+            mPartitionRandomGenerators.resize(nPartitions);
+        }
+        std::uint32_t seed = mRandomGenerator.nextSeed();
+        auto predictPartition = [&](size_t p){
+            RandomGenerator& randGen = mPartitionRandomGenerators[p];
+            randGen.seed(seed, static_cast<std::uint32_t>(p));
+            size_t end = std::min(n, (p+1)*mPartitionSize);
+            for(size_t i=p*mPartitionSize; i<end; i++){
+                storeAt(i, predictInBuilding(stateAt(i), input, randGen));
+            }
+        };
+        if(mNumThreads!=1 && 1<nPartitions && mSysModel->supportsConcurrentPredictions()){
+            if(!mThreadPool){
+                mThreadPool = std::make_shared<ThreadPool>(mNumThreads);
+            }
+            mThreadPool->parallelFor(nPartitions, predictPartition);
+        }else{
+            for(size_t p=0; p<nPartitions; p++){
+                predictPartition(p);
+            }
         }
         mSysModel->endPredictions(states, input);
-        return statesPredicted;
+    }
+    
+    template<class Tstate, class Tinput>
+    std::vector<Tstate> SystemModelInBuilding<Tstate, Tinput>::predict(std::vector<Tstate> states, Tinput input){
+        mStatesPredicted.resize(states.size());
+        predictPartitions(states, states.size(),
+                          [&](size_t i) -> const Tstate& {return states[i];},
+                          [&](size_t i, const Tstate& s){mStatesPredicted[i] = s;},
+                          input);
+        return mStatesPredicted;
+    }
+    
+    template<class Tstate, class Tinput>
+    void SystemModelInBuilding<Tstate, Tinput>::predict(Particles& particles, Tinput input){
+        size_t n = particles.size();
+        // Each partition loads its particles from the field arrays into one reused state, which the system model takes,
+        // and stores the predictions into the field arrays of the buffer.
+        mParticlesPredicted.resize(n);
+        size_t nPartitions = (n + mPartitionSize - 1)/mPartitionSize;
+        if(mPartitionStates.size() < nPartitions){
+            mPartitionStates.resize(nPartitions);
+        }
+        const double *x = particles.x(), *y = particles.y(), *z = particles.z(), *floor = particles.floor();
+        const double *orientation = particles.orientation(), *velocity = particles.velocity(), *normalVelocity = particles.normalVelocity();
+        const double *orientationBias = particles.orientationBias(), *orientationAlignment = particles.orientationAlignment(), *rssiBias = particles.rssiBias();
+        const double *weight = particles.weight(), *negativeLogLikelihood = particles.negativeLogLikelihood(), *mahalanobisDistance = particles.mahalanobisDistance();
+        const long *timestamp = particles.timestamp();
+        double *xNew = mParticlesPredicted.x(), *yNew = mParticlesPredicted.y(), *zNew = mParticlesPredicted.z(), *floorNew = mParticlesPredicted.floor();
+        double *orientationNew = mParticlesPredicted.orientation(), *velocityNew = mParticlesPredicted.velocity(), *normalVelocityNew = mParticlesPredicted.normalVelocity();
+        double *orientationBiasNew = mParticlesPredicted.orientationBias(), *orientationAlignmentNew = mParticlesPredicted.orientationAlignment(), *rssiBiasNew = mParticlesPredicted.rssiBias();
+        double *weightNew = mParticlesPredicted.weight(), *negativeLogLikelihoodNew = mParticlesPredicted.negativeLogLikelihood(), *mahalanobisDistanceNew = mParticlesPredicted.mahalanobisDistance();
+        long *timestampNew = mParticlesPredicted.timestamp();
+        predictPartitions(std::vector<Tstate>(), n,
+                          [&](size_t i) -> const Tstate& {
+                              Tstate& s = mPartitionStates[i/mPartitionSize];
+                              s.x(x[i]).y(y[i]).z(z[i]).floor(floor[i]);
+                              s.orientation(orientation[i]).velocity(velocity[i]).normalVelocity(normalVelocity[i]);
+                              s.orientationBias(orientationBias[i]).orientationAlignment(orientationAlignment[i]).rssiBias(rssiBias[i]);
+                              s.weight(weight[i]).negativeLogLikelihood(negativeLogLikelihood[i]).mahalanobisDistance(mahalanobisDistance[i]);
+                              s.timestamp = timestamp[i];
+                              return s;
+                          },
+                          [&](size_t i, const Tstate& s){
+                              xNew[i] = s.x(); yNew[i] = s.y(); zNew[i] = s.z(); floorNew[i] = s.floor();
+                              orientationNew[i] = s.orientation(); velocityNew[i] = s.velocity(); normalVelocityNew[i] = s.normalVelocity();
+                              orientationBiasNew[i] = s.orientationBias(); orientationAlignmentNew[i] = s.orientationAlignment(); rssiBiasNew[i] = s.rssiBias();
+                              weightNew[i] = s.weight(); negativeLogLikelihoodNew[i] = s.negativeLogLikelihood(); mahalanobisDistanceNew[i] = s.mahalanobisDistance();
+                              timestampNew[i] = s.timestamp;
+                          },
+                          input);
+        // Particles are swapped in after all predictions succeeded.
+        particles.swapFields(mParticlesPredicted);
     }
     
     template<class Tstate, class Tinput>
@@ -29,6 +29,8 @@
 #include "Building.hpp"
 #include "AltitudeManager.hpp"
 #include "SerializeUtils.hpp"
+#include "ThreadPool.hpp"
+#include "PipelineMetrics.hpp"
 
 namespace loc{
     
@@ -159,13 +161,28 @@ namespace loc{
         Building::Ptr mBuilding;
         SystemModelInBuildingProperty::Ptr mProperty;
         AltitudeManager::Ptr mAltManager;
-        
-        Tstate moveOnElevator(const Tstate& state, Tinput input);
-        Tstate moveOnStair(const Tstate& state, Tinput input);
-        Tstate moveOnEscalator(const Tstate& state, Tinput input);
-        Tstate moveOnFloor(const Tstate& state, Tinput input);
-        Tstate moveOnFloorRetry(const Tstate& state, const Tstate& stateNew,  Tinput input);
-        Tstate moveFloorJump(const Tstate& state, Tinput input);
+        std::vector<Tstate> mStatesPredicted; // buffer for prediction of states
+        Particles mParticlesPredicted; // buffer for in-place prediction of particles
+        
+        // Particles are predicted in fixed-size partitions. Each partition draws from its own random generator
+        // seeded from mRandomGenerator, so results do not depend on the number of threads.
+        int mNumThreads = 1; // 0: hardware concurrency
+        size_t mPartitionSize = 256;
+        ThreadPool::Ptr mThreadPool;
+        std::vector<RandomGenerator> mPartitionRandomGenerators;
+        std::vector<Tstate> mPartitionStates; // state of the particle being predicted in each partition
+        PipelineMetrics::Ptr mMetrics;
+        
+        Tstate moveOnElevator(const Tstate& state, Tinput input, RandomGenerator& randGen);
+        Tstate moveOnStair(const Tstate& state, Tinput input, RandomGenerator& randGen);
+        Tstate moveOnEscalator(const Tstate& state, Tinput input, RandomGenerator& randGen);
+        Tstate moveOnFloor(const Tstate& state, Tinput input, RandomGenerator& randGen);
+        Tstate moveOnFloorRetry(const Tstate& state, const Tstate& stateNew,  Tinput input, RandomGenerator& randGen);
+        Tstate moveFloorJump(const Tstate& state, Tinput input, RandomGenerator& randGen);
+        Tstate predictInBuilding(const Tstate& state, Tinput input, RandomGenerator& randGen);
+        // Predicts a batch of n states between startPredictions and endPredictions of the system model.
+        template<class Tgetter, class Tsetter>
+        void predictPartitions(const std::vector<Tstate>& states, size_t n, Tgetter stateAt, Tsetter storeAt, Tinput input);
         
     public:
         
@@ -179,8 +196,24 @@ namespace loc{
         SystemModelInBuilding& property(SystemModelInBuildingProperty::Ptr property);
         SystemModelInBuilding& altitudeManager(AltitudeManager::Ptr altManager);
         
+        // Number of threads used for prediction of particles (0: hardware concurrency).
+        // Threads are used only when the underlying system model supports concurrent predictions.
+        SystemModelInBuilding& numThreads(int nThreads);
+        int numThreads() const;
+        SystemModelInBuilding& partitionSize(size_t partitionSize);
+        size_t partitionSize() const;
+        // Shares a thread pool with other models instead of creating one.
+        SystemModelInBuilding& threadPool(ThreadPool::Ptr threadPool);
+        // Counts predictions rejected by the building.
+        SystemModelInBuilding& metrics(PipelineMetrics::Ptr metrics);
+        
+        // A single state is predicted without startPredictions and endPredictions; callers predicting states one by one call them per batch.
         Tstate predict(Tstate state, Tinput input) override;
         std::vector<Tstate> predict(std::vector<Tstate> states, Tinput input) override;
+        void predict(Particles& particles, Tinput input) override;
+        
+        void startPredictions(const std::vector<Tstate>& states, const Tinput& input) override;
+        void endPredictions(const std::vector<Tstate>& states, const Tinput& input) override;
         
         virtual void notifyObservationUpdated() override;
         
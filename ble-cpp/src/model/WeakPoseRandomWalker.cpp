@@ -25,8 +25,7 @@
 namespace loc{
     
     template<class Ts, class Tin>
-    Ts WeakPoseRandomWalker<Ts, Tin>::predict(Ts state, Tin input){
-        auto& mRandGen = RandomWalker<Ts, Tin>::mRandGen;
+    Ts WeakPoseRandomWalker<Ts, Tin>::predict(Ts state, Tin input, const SystemModelMotionControl& control, RandomGenerator& randGen){
         auto& mRWMotionProperty = RandomWalkerMotion<Ts,Tin>::mRWMotionProperty;
         const auto& mPedometer = mRWMotionProperty->pedometer();
         const auto& mOrientationMeter = mRWMotionProperty->orientationMeter();
@@ -43,42 +42,17 @@ namespace loc{
         
         if(mPedometer && mOrientationMeter){
             double nSteps = mPedometer->getNSteps();
-            double movLevel = RandomWalkerMotion<Ts,Tin>::movingLevel();
+            double movLevel = RandomWalkerMotion<Ts,Tin>::movingLevel(control);
             double yaw = mOrientationMeter->getYaw();
             
             if(dt<input.timeUnit()){
                 throw std::runtime_error("Time increment is too small in WeakPoseRandomWalker.");
             }
-            // Compute velocity rate to reduce velocity when turning
-            if(mRWMotionProperty->usesAngularVelocityLimit()){
-                if(!wasYawUpdated){ // for the initial loop
-                    currentTimestamp = t_cur;
-                    currentYaw = yaw;
-                    wasYawUpdated = true;
-                }
-                if(currentTimestamp!=t_cur){
-                    currentTimestamp = t_cur;
-                    double previousYaw = currentYaw;
-                    currentYaw = yaw;
-                    if(previousYaw<-M_PI || M_PI<previousYaw){
-                        BOOST_THROW_EXCEPTION(LocException("previous yaw is out of range."));
-                    }
-                    if(currentYaw<-M_PI || M_PI<currentYaw){
-                        BOOST_THROW_EXCEPTION(LocException("current yaw is out of range."));
-                    }
-                    double oriDiff = Pose::computeOrientationDifference(previousYaw, currentYaw);
-                    double angularVelocity = oriDiff/dt;
-                    double angularVelocityLimit = mRWMotionProperty->angularVelocityLimit();
-                    turningVelocityRate = std::sqrt(1.0 - std::min(1.0, std::pow(angularVelocity/angularVelocityLimit,2)));
-                }
-            }else{
-                turningVelocityRate = 1.0;
-            }
             
             // Compute sigma for RandomWalkerMotion
             double sigma = movLevel>0 ? mRWMotionProperty->sigmaMove : mRWMotionProperty->sigmaStop;
             // Multiply sigma by velocity rate and turning velocity rate
-            sigma = sigma * velocityRate() * turningVelocityRate;
+            sigma = sigma * control.velocityRate * turningVelocityRate;
             
             // Add noise to (actually) static parameters just after resampling
             if(wasFiltered){
@@ -95,18 +69,18 @@ namespace loc{
                     double sqdt_long = std::sqrt(dt_long);
                     // Perturb variables in State (orientationBias, rssiBias)
                     double oriTmp;
-                    if( mRandGen->nextDouble() < wPRWProperty->probabilityOrientationBiasJump()){
-                        oriTmp = Pose::normalizeOrientaion( 2.0 * M_PI * (mRandGen->nextDouble()-0.5));
+                    if( randGen.nextDouble() < wPRWProperty->probabilityOrientationBiasJump()){
+                        oriTmp = Pose::normalizeOrientaion( 2.0 * M_PI * (randGen.nextDouble()-0.5));
                     }else{
-                        oriTmp = mRandGen->nextWrappedNormal(state.orientationBias(),
+                        oriTmp = randGen.nextWrappedNormal(state.orientationBias(),
                                                              mStateProperty->diffusionOrientationBias() * sqdt_long );
                     }
                     state.orientationBias(oriTmp);
-                    state.rssiBias(mRandGen->nextTruncatedGaussian(state.rssiBias(), mStateProperty->diffusionRssiBias() * sqdt_long , mStateProperty->minRssiBias(), mStateProperty->maxRssiBias()));
+                    state.rssiBias(randGen.nextTruncatedGaussian(state.rssiBias(), mStateProperty->diffusionRssiBias() * sqdt_long , mStateProperty->minRssiBias(), mStateProperty->maxRssiBias()));
                     
                     // Perturb variables in Pose (normal velocity)
                     double nV = state.normalVelocity();
-                    nV = mRandGen->nextTruncatedGaussian(state.normalVelocity(),
+                    nV = randGen.nextTruncatedGaussian(state.normalVelocity(),
                                                          mPoseProperty->diffusionVelocity() * sqdt_long,
                                                          mPoseProperty->minVelocity(),
                                                          mPoseProperty->maxVelocity());
@@ -114,7 +88,7 @@ namespace loc{
                     
                     // Assign orientationAlignment
                     state.orientationAlignment(0.0);
-                    if( mRandGen->nextDouble() < wPRWProperty->probabilityBackwardMove()){
+                    if( randGen.nextDouble() < wPRWProperty->probabilityBackwardMove()){
                         double oriBW = M_PI;
                         state.orientationAlignment(oriBW);
                     }
@@ -125,9 +99,9 @@ namespace loc{
             double orientationActual = yaw - state.orientationBias();
             if(movLevel>0 ){
                 // Add noise to orientation
-                orientationActual = mRandGen->nextWrappedNormal(orientationActual, mPoseProperty->stdOrientation() * sqdt);
-                if( mRandGen->nextDouble() < wPRWProperty->probabilityOrientationJump() ){
-                    orientationActual = Pose::normalizeOrientaion( 2.0 * M_PI * (mRandGen->nextDouble() - 0.5));
+                orientationActual = randGen.nextWrappedNormal(orientationActual, mPoseProperty->stdOrientation() * sqdt);
+                if( randGen.nextDouble() < wPRWProperty->probabilityOrientationJump() ){
+                    orientationActual = Pose::normalizeOrientaion( 2.0 * M_PI * (randGen.nextDouble() - 0.5));
                 }
             }
             state.orientation(orientationActual);
@@ -136,10 +110,10 @@ namespace loc{
             double v = 0.0;
             if(nSteps > 0){
                 double nV = state.normalVelocity();
-                v = nV * velocityRate() * turningVelocityRate;
+                v = nV * control.velocityRate * turningVelocityRate;
             }
-            if(relativeVelocity() > 0){
-                v += mRandGen->nextTruncatedGaussian(relativeVelocity(),
+            if(control.relativeVelocity > 0){
+                v += randGen.nextTruncatedGaussian(control.relativeVelocity,
                                                      mPoseProperty->diffusionVelocity()*sqdt,
                                                      mPoseProperty->minVelocity(),
                                                      mPoseProperty->maxVelocity());
@@ -153,8 +127,8 @@ namespace loc{
             double dx_v = state.velocity()*std::cos(oriActAl) * dt;
             double dy_v = state.velocity()*std::sin(oriActAl) * dt;
             
-            double dx_noise = sigma * mRandGen->nextGaussian() * sqdt;
-            double dy_noise = sigma * mRandGen->nextGaussian() * sqdt;
+            double dx_noise = sigma * randGen.nextGaussian() * sqdt;
+            double dy_noise = sigma * randGen.nextGaussian() * sqdt;
             
             double poseRwr = wPRWProperty->poseRandomWalkRate();
             double rwr = wPRWProperty->randomWalkRate();
@@ -176,8 +150,51 @@ namespace loc{
         }
     }
     
+    template<class Ts, class Tin>
+    void WeakPoseRandomWalker<Ts, Tin>::updateTurningVelocityRate(const Tin& input){
+        auto& mRWMotionProperty = RandomWalkerMotion<Ts,Tin>::mRWMotionProperty;
+        const auto& mOrientationMeter = mRWMotionProperty->orientationMeter();
+        
+        long t_pre = input.previousTimestamp();
+        long t_cur = input.timestamp();
+        double dt = (t_cur-t_pre) * input.timeUnit();
+        
+        // Invalid inputs are reported by predict.
+        if(!mRWMotionProperty->pedometer() || !mOrientationMeter || dt<input.timeUnit()){
+            return;
+        }
+        
+        double yaw = mOrientationMeter->getYaw();
+        // Compute velocity rate to reduce velocity when turning
+        if(mRWMotionProperty->usesAngularVelocityLimit()){
+            if(!wasYawUpdated){ // for the initial loop
+                currentTimestamp = t_cur;
+                currentYaw = yaw;
+                wasYawUpdated = true;
+            }
+            if(currentTimestamp!=t_cur){
+                currentTimestamp = t_cur;
+                double previousYaw = currentYaw;
+                currentYaw = yaw;
+                if(previousYaw<-M_PI || M_PI<previousYaw){
+                    BOOST_THROW_EXCEPTION(LocException("previous yaw is out of range."));
+                }
+                if(currentYaw<-M_PI || M_PI<currentYaw){
+                    BOOST_THROW_EXCEPTION(LocException("current yaw is out of range."));
+                }
+                double oriDiff = Pose::computeOrientationDifference(previousYaw, currentYaw);
+                double angularVelocity = oriDiff/dt;
+                double angularVelocityLimit = mRWMotionProperty->angularVelocityLimit();
+                turningVelocityRate = std::sqrt(1.0 - std::min(1.0, std::pow(angularVelocity/angularVelocityLimit,2)));
+            }
+        }else{
+            turningVelocityRate = 1.0;
+        }
+    }
+    
     template<class Ts, class Tin>
     void WeakPoseRandomWalker<Ts, Tin>::startPredictions(const std::vector<Ts>& states, const Tin& input){
+        RandomWalkerMotion<Ts, Tin>::startPredictions(states, input);
         enabledPredictions = true;
         if(previousTimestampResample==0){
             previousTimestampResample = input.timestamp();
@@ -110,6 +110,8 @@ namespace loc {
         bool wasFiltered = false;
         long previousTimestampResample = 0;
         
+        virtual void updateTurningVelocityRate(const Tin& input) override;
+        
     public:
         using Ptr = std::shared_ptr<WeakPoseRandomWalker<Ts, Tin>>;
         using RandomWalker<Ts, Tin>::predict;
@@ -123,7 +125,7 @@ namespace loc {
         }
         
         virtual ~WeakPoseRandomWalker() = default;
-        virtual Ts predict(Ts state, Tin input) override;
+        virtual Ts predict(Ts state, Tin input, const SystemModelMotionControl& control, RandomGenerator& randGen) override;
         virtual void startPredictions(const std::vector<Ts>& states, const Tin&) override;
         virtual void endPredictions(const std::vector<Ts>& states, const Tin&) override;
         virtual void notifyObservationUpdated() override;
@@ -21,6 +21,7 @@
  *******************************************************************************/
 
 #include <boost/math/distributions/chi_squared.hpp>
+#include <boost/math/distributions/normal.hpp>
 #include "MathUtils.hpp"
 #include "LocException.hpp"
 
@@ -30,6 +31,11 @@ double MathUtils::quantileChiSquaredDistribution(int degreeOfFreedom, double cum
     return x;
 }
 
+double MathUtils::quantileNormalDistribution(double cumulativeDensity){
+    boost::math::normal norm;
+    return boost::math::quantile(norm, cumulativeDensity);
+}
+
 DirectionalStatistics MathUtils::computeDirectionalStatistics(std::vector<double> orientations){
     size_t n = orientations.size();
     if(n==0){
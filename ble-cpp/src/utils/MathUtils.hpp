@@ -85,6 +85,7 @@ public:
     }
     
     static double quantileChiSquaredDistribution(int degreeOfFreedom, double cumulativeDensity);
+    static double quantileNormalDistribution(double cumulativeDensity);
     
     static double normalizeOrientaion(double orientation){
         double x = std::cos(orientation);
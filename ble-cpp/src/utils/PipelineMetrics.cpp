@@ -0,0 +1,169 @@
+/*******************************************************************************
+ * Copyright (c) 2014, 2016  IBM Corporation and others
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *******************************************************************************/
+
+#include "PipelineMetrics.hpp"
+#include <algorithm>
+#include <cmath>
+
+namespace loc{
+    
+    double PipelineMetrics::StageSnapshot::meanMicros() const{
+        return count==0 ? 0 : totalMicros/count;
+    }
+    
+    double PipelineMetrics::StageSnapshot::percentileMicros(double p) const{
+        if(count==0){
+            return 0;
+        }
+        std::uint64_t rank = std::max<std::uint64_t>(static_cast<std::uint64_t>(std::ceil(p*count)), 1);
+        std::uint64_t cumulative = 0;
+        for(int b=0; b<NUM_BUCKETS-1; b++){
+            cumulative += buckets[b];
+            if(rank<=cumulative){
+                return std::min(std::ldexp(1.0, b), maxMicros);
+            }
+        }
+        return maxMicros;
+    }
+    
+    std::ostream& operator<<(std::ostream& os, const PipelineMetrics::Snapshot& snapshot){
+        os << "stage,count,total_us,mean_us,p50_us,p95_us,p99_us,max_us" << std::endl;
+        for(int s=0; s<PipelineMetrics::NUM_STAGES; s++){
+            const auto& st = snapshot.stages[s];
+            os << PipelineMetrics::stageToString(static_cast<PipelineMetrics::Stage>(s)) << "," << st.count << "," << st.totalMicros
+            << "," << st.meanMicros() << "," << st.percentileMicros(0.5) << "," << st.percentileMicros(0.95)
+            << "," << st.percentileMicros(0.99) << "," << st.maxMicros << std::endl;
+        }
+        for(int c=0; c<PipelineMetrics::NUM_COUNTERS; c++){
+            os << PipelineMetrics::counterToString(static_cast<PipelineMetrics::Counter>(c)) << "," << snapshot.counters[c] << std::endl;
+        }
+        os << "lastEffectiveSampleSize," << snapshot.lastEffectiveSampleSize << std::endl;
+        return os;
+    }
+    
+    PipelineMetrics::ScopedTimer::ScopedTimer(PipelineMetrics* metrics, Stage stage) : mMetrics(metrics), mStage(stage), mSpan(stageToString(stage), "filter"){
+        if(mMetrics){
+            mStart = std::chrono::steady_clock::now();
+        }
+    }
+    
+    PipelineMetrics::ScopedTimer::~ScopedTimer(){
+        stop();
+    }
+    
+    void PipelineMetrics::ScopedTimer::stop(){
+        mSpan.end();
+        if(mMetrics){
+            mMetrics->record(mStage, std::chrono::steady_clock::now() - mStart);
+            mMetrics = nullptr;
+        }
+    }
+    
+    PipelineMetrics::PipelineMetrics(){
+        reset();
+    }
+    
+    void PipelineMetrics::record(Stage stage, std::chrono::nanoseconds elapsed){
+        std::uint64_t nanos = std::max<std::int64_t>(elapsed.count(), 0);
+        StageData& data = mStages[stage];
+        // Stages are recorded by the filtering thread, so relaxed ordering is enough.
+        data.count.fetch_add(1, std::memory_order_relaxed);
+        data.totalNanos.fetch_add(nanos, std::memory_order_relaxed);
+        if(data.maxNanos.load(std::memory_order_relaxed) < nanos){
+            data.maxNanos.store(nanos, std::memory_order_relaxed);
+        }
+        int b = 0;
+        for(std::uint64_t micros = nanos/1000; 0<micros && b<NUM_BUCKETS-1; micros >>= 1){
+            b++;
+        }
+        data.buckets[b].fetch_add(1, std::memory_order_relaxed);
+    }
+    
+    void PipelineMetrics::increment(Counter counter, std::uint64_t n){
+        mCounters[counter].fetch_add(n, std::memory_order_relaxed);
+    }
+    
+    void PipelineMetrics::effectiveSampleSize(double ess){
+        mLastESS.store(ess, std::memory_order_relaxed);
+    }
+    
+    PipelineMetrics::Snapshot PipelineMetrics::snapshot() const{
+        Snapshot snapshot;
+        for(int s=0; s<NUM_STAGES; s++){
+            const StageData& data = mStages[s];
+            StageSnapshot& st = snapshot.stages[s];
+            st.count = data.count.load(std::memory_order_relaxed);
+            st.totalMicros = data.totalNanos.load(std::memory_order_relaxed)/1000.0;
+            st.maxMicros = data.maxNanos.load(std::memory_order_relaxed)/1000.0;
+            for(int b=0; b<NUM_BUCKETS; b++){
+                st.buckets[b] = data.buckets[b].load(std::memory_order_relaxed);
+            }
+        }
+        for(int c=0; c<NUM_COUNTERS; c++){
+            snapshot.counters[c] = mCounters[c].load(std::memory_order_relaxed);
+        }
+        snapshot.lastEffectiveSampleSize = mLastESS.load(std::memory_order_relaxed);
+        return snapshot;
+    }
+    
+    void PipelineMetrics::reset(){
+        for(auto& data: mStages){
+            data.count.store(0);
+            data.totalNanos.store(0);
+            data.maxNanos.store(0);
+            for(auto& bucket: data.buckets){
+                bucket.store(0);
+            }
+        }
+        for(auto& counter: mCounters){
+            counter.store(0);
+        }
+        mLastESS.store(0);
+    }
+    
+    const char* PipelineMetrics::stageToString(Stage stage){
+        switch(stage){
+            case BEACON_FILTERING: return "beaconFiltering";
+            case FLOOR_UPDATE: return "floorUpdate";
+            case MIXING: return "mixing";
+            case MOTION_PREDICTION: return "motionPrediction";
+            case LIKELIHOOD: return "likelihood";
+            case WEAKENING: return "weakening";
+            case RESAMPLING: return "resampling";
+            case POST_RESAMPLING: return "postResampling";
+            case STATUS_PUBLICATION: return "statusPublication";
+            default: return "unknown";
+        }
+    }
+    
+    const char* PipelineMetrics::counterToString(Counter counter){
+        switch(counter){
+            case BEACON_UPDATES: return "beaconUpdates";
+            case MOTION_UPDATES: return "motionUpdates";
+            case RESAMPLINGS: return "resamplings";
+            case PARTICLES_RESAMPLED: return "particlesResampled";
+            case REJECTION_RETRIES: return "rejectionRetries";
+            case REJECTION_FALLBACKS: return "rejectionFallbacks";
+            default: return "unknown";
+        }
+    }
+}
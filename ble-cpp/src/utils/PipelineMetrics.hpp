@@ -0,0 +1,136 @@
+/*******************************************************************************
+ * Copyright (c) 2014, 2016  IBM Corporation and others
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *******************************************************************************/
+
+#ifndef PipelineMetrics_hpp
+#define PipelineMetrics_hpp
+
+#include <stdio.h>
+#include <iostream>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include "SpanTracer.hpp"
+
+namespace loc{
+    
+    // Cumulative latencies and counters of the stages of a particle filter update.
+    // Recording is lock-free and a snapshot can be taken from any thread at any time.
+    class PipelineMetrics{
+    public:
+        using Ptr = std::shared_ptr<PipelineMetrics>;
+        
+        enum Stage{
+            BEACON_FILTERING = 0,
+            FLOOR_UPDATE,
+            MIXING,
+            MOTION_PREDICTION,
+            LIKELIHOOD,
+            WEAKENING,
+            RESAMPLING,
+            POST_RESAMPLING,
+            STATUS_PUBLICATION,
+            NUM_STAGES
+        };
+        
+        enum Counter{
+            BEACON_UPDATES = 0,
+            MOTION_UPDATES,
+            RESAMPLINGS,
+            PARTICLES_RESAMPLED,
+            REJECTION_RETRIES, // predictions rejected by the building and drawn again
+            REJECTION_FALLBACKS, // predictions that exhausted the trials
+            NUM_COUNTERS
+        };
+        
+        // Bucket b counts latencies in [2^(b-1), 2^b) microseconds. The last bucket is unbounded.
+        static const int NUM_BUCKETS = 24;
+        
+        struct StageSnapshot{
+            std::uint64_t count = 0;
+            double totalMicros = 0;
+            double maxMicros = 0;
+            std::array<std::uint64_t, NUM_BUCKETS> buckets{};
+            
+            double meanMicros() const;
+            // Upper bound of the bucket containing the p-th quantile
+            double percentileMicros(double p) const;
+        };
+        
+        struct Snapshot{
+            std::array<StageSnapshot, NUM_STAGES> stages;
+            std::array<std::uint64_t, NUM_COUNTERS> counters{};
+            double lastEffectiveSampleSize = 0;
+            
+            const StageSnapshot& stage(Stage s) const{
+                return stages[s];
+            }
+            std::uint64_t counter(Counter c) const{
+                return counters[c];
+            }
+            friend std::ostream& operator<<(std::ostream& os, const Snapshot& snapshot);
+        };
+        
+        // Records the time between construction and destruction. Nothing is measured if metrics is null.
+        // A span of the stage is also recorded when SpanTracer is enabled.
+        class ScopedTimer{
+        public:
+            ScopedTimer(PipelineMetrics* metrics, Stage stage);
+            ~ScopedTimer();
+            // Records the time until now. Later calls and the destructor do nothing.
+            void stop();
+            ScopedTimer(const ScopedTimer&) = delete;
+            ScopedTimer& operator=(const ScopedTimer&) = delete;
+        private:
+            PipelineMetrics* mMetrics;
+            Stage mStage;
+            std::chrono::steady_clock::time_point mStart;
+            SpanTracer::Span mSpan;
+        };
+        
+        PipelineMetrics();
+        
+        void record(Stage stage, std::chrono::nanoseconds elapsed);
+        void increment(Counter counter, std::uint64_t n = 1);
+        void effectiveSampleSize(double ess);
+        
+        Snapshot snapshot() const;
+        void reset();
+        
+        static const char* stageToString(Stage stage);
+        static const char* counterToString(Counter counter);
+        
+    private:
+        struct StageData{
+            std::atomic<std::uint64_t> count;
+            std::atomic<std::uint64_t> totalNanos;
+            std::atomic<std::uint64_t> maxNanos;
+            std::array<std::atomic<std::uint64_t>, NUM_BUCKETS> buckets;
+        };
+        std::array<StageData, NUM_STAGES> mStages;
+        std::array<std::atomic<std::uint64_t>, NUM_COUNTERS> mCounters;
+        std::atomic<double> mLastESS;
+    };
+}
+
+#endif /* PipelineMetrics_hpp */
@@ -28,6 +28,27 @@
 
 namespace loc{
     
+    RandomGenerator::RandomGenerator(std::uint32_t seed){
+        this->seed(seed);
+    }
+    
+    void RandomGenerator::seed(std::uint32_t seed){
+        engine.seed(seed);
+        uniformDistribution.reset();
+        normalDistribution.reset();
+    }
+    
+    void RandomGenerator::seed(std::uint32_t seed, std::uint32_t stream){
+        std::seed_seq seq{seed, stream};
+        engine.seed(seq);
+        uniformDistribution.reset();
+        normalDistribution.reset();
+    }
+    
+    std::uint32_t RandomGenerator::nextSeed(){
+        return static_cast<std::uint32_t>(engine());
+    }
+    
     int RandomGenerator::nextInt(int n){
         std::uniform_int_distribution<> uniIntDist(0,n);
         return uniIntDist(engine);
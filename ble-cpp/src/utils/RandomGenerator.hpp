@@ -27,6 +27,7 @@
 #include <random>
 #include <algorithm>
 #include <memory>
+#include <cstdint>
 
 namespace loc{
     class RandomGenerator{
@@ -41,8 +42,14 @@ namespace loc{
         using Ptr = std::shared_ptr<RandomGenerator>;
         
         RandomGenerator() = default;
+        RandomGenerator(std::uint32_t seed);
         ~RandomGenerator() = default;
         
+        // Reseeds the engine. Different streams of the same seed give independent sequences.
+        void seed(std::uint32_t seed);
+        void seed(std::uint32_t seed, std::uint32_t stream);
+        std::uint32_t nextSeed();
+        
         int nextInt(int n);
         double nextDouble();
         double nextGaussian();
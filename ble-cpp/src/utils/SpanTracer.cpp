@@ -0,0 +1,146 @@
+/*******************************************************************************
+ * Copyright (c) 2014, 2016  IBM Corporation and others
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *******************************************************************************/
+
+#include "SpanTracer.hpp"
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <mutex>
+
+namespace loc{
+    
+    namespace{
+        struct ThreadBuffer{
+            std::vector<SpanTracer::Event> events;
+            std::atomic<size_t> size{0}; // published with release order after an event is written
+            std::atomic<std::uint64_t> dropped{0};
+            int tid = 0;
+            long session = 0;
+        };
+        
+        std::mutex sMutex; // guards the registry. Not used on the recording path.
+        std::vector<std::shared_ptr<ThreadBuffer>> sBuffers;
+        std::string sPath;
+        size_t sEventsPerThread = 0;
+        std::atomic<long> sSession{0};
+        std::atomic<std::int64_t> sOrigin{0};
+        thread_local std::shared_ptr<ThreadBuffer> tBuffer;
+    }
+    
+    std::atomic<bool> SpanTracer::sEnabled{false};
+    
+    std::int64_t SpanTracer::now(){
+        return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+    }
+    
+    SpanTracer::Span::Span(const char* name, const char* category) : mName(name), mCategory(category){
+        if(enabled()){
+            mStart = now();
+        }
+    }
+    
+    SpanTracer::Span::~Span(){
+        end();
+    }
+    
+    void SpanTracer::Span::end(){
+        if(0<=mStart && enabled()){
+            append(Event{mName, mCategory, mStart, now() - mStart});
+        }
+        mStart = -1;
+    }
+    
+    void SpanTracer::append(const Event& event){
+        long session = sSession.load(std::memory_order_acquire);
+        if(!tBuffer || tBuffer->session!=session){
+            // Registered once per thread and tracing session
+            std::lock_guard<std::mutex> lock(sMutex);
+            auto buffer = std::make_shared<ThreadBuffer>();
+            buffer->events.resize(sEventsPerThread);
+            buffer->tid = static_cast<int>(sBuffers.size()) + 1;
+            buffer->session = session;
+            sBuffers.push_back(buffer);
+            tBuffer = buffer;
+        }
+        ThreadBuffer& buffer = *tBuffer;
+        size_t i = buffer.size.load(std::memory_order_relaxed);
+        if(i < buffer.events.size()){
+            buffer.events[i] = event;
+            buffer.size.store(i+1, std::memory_order_release);
+        }else{
+            buffer.dropped.fetch_add(1, std::memory_order_relaxed);
+        }
+    }
+    
+    void SpanTracer::start(const std::string& path, size_t eventsPerThread){
+        std::lock_guard<std::mutex> lock(sMutex);
+        sBuffers.clear();
+        sPath = path;
+        sEventsPerThread = eventsPerThread;
+        sOrigin.store(now());
+        sSession.fetch_add(1, std::memory_order_release);
+        sEnabled.store(true);
+    }
+    
+    std::uint64_t SpanTracer::droppedEvents(){
+        std::lock_guard<std::mutex> lock(sMutex);
+        std::uint64_t dropped = 0;
+        for(const auto& buffer: sBuffers){
+            dropped += buffer->dropped.load(std::memory_order_relaxed);
+        }
+        return dropped;
+    }
+    
+    void SpanTracer::stop(){
+        if(!sEnabled.exchange(false)){
+            return;
+        }
+        std::lock_guard<std::mutex> lock(sMutex);
+        std::ofstream ofs(sPath);
+        if(!ofs.is_open()){
+            std::cerr << "SpanTracer: " << sPath << " cannot be opened." << std::endl;
+            return;
+        }
+        // Timestamps of the Chrome trace format are in microseconds.
+        std::int64_t origin = sOrigin.load();
+        ofs << std::fixed << std::setprecision(3);
+        ofs << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[";
+        bool first = true;
+        std::uint64_t dropped = 0;
+        for(const auto& buffer: sBuffers){
+            size_t n = buffer->size.load(std::memory_order_acquire);
+            for(size_t i=0; i<n; i++){
+                const Event& e = buffer->events[i];
+                ofs << (first ? "" : ",") << std::endl
+                << "{\"name\":\"" << e.name << "\",\"cat\":\"" << e.category << "\",\"ph\":\"X\",\"pid\":1,\"tid\":" << buffer->tid
+                << ",\"ts\":" << (e.startNanos - origin)/1000.0 << ",\"dur\":" << e.durationNanos/1000.0 << "}";
+                first = false;
+            }
+            dropped += buffer->dropped.load(std::memory_order_relaxed);
+        }
+        ofs << std::endl << "]}" << std::endl;
+        if(0<dropped){
+            std::cerr << "SpanTracer: " << dropped << " events were dropped." << std::endl;
+        }
+        sBuffers.clear();
+    }
+}
@@ -0,0 +1,80 @@
+/*******************************************************************************
+ * Copyright (c) 2014, 2016  IBM Corporation and others
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *******************************************************************************/
+
+#ifndef SpanTracer_hpp
+#define SpanTracer_hpp
+
+#include <stdio.h>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace loc{
+    
+    // Collects timed spans of all threads and writes them as a Chrome trace JSON file,
+    // which can be opened by chrome://tracing and Perfetto.
+    // Each thread appends to its own fixed-size buffer without locks. Spans cost one atomic load when tracing is disabled.
+    class SpanTracer{
+    public:
+        struct Event{
+            const char* name; // must be a string literal
+            const char* category;
+            std::int64_t startNanos;
+            std::int64_t durationNanos;
+        };
+        
+        // Records the time between construction and destruction.
+        class Span{
+        public:
+            Span(const char* name, const char* category = "loc");
+            ~Span();
+            // Records the span until now. Later calls and the destructor do nothing.
+            void end();
+            Span(const Span&) = delete;
+            Span& operator=(const Span&) = delete;
+        private:
+            const char* mName;
+            const char* mCategory;
+            std::int64_t mStart = -1;
+        };
+        
+        // Starts tracing. Events beyond eventsPerThread in a thread are dropped.
+        static void start(const std::string& path, size_t eventsPerThread = 1<<16);
+        // Stops tracing and writes the collected spans to the path given to start.
+        static void stop();
+        static bool enabled(){
+            return sEnabled.load(std::memory_order_relaxed);
+        }
+        static std::uint64_t droppedEvents();
+        
+    private:
+        static std::atomic<bool> sEnabled;
+        
+        static std::int64_t now();
+        static void append(const Event& event);
+    };
+}
+
+#endif /* SpanTracer_hpp */
@@ -0,0 +1,137 @@
+/*******************************************************************************
+ * Copyright (c) 2014, 2016  IBM Corporation and others
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *******************************************************************************/
+
+#include "ThreadPool.hpp"
+
+namespace loc{
+    
+    namespace{
+        // Pool whose tasks the current thread is running (nullptr: none).
+        thread_local const ThreadPool* tlsRunningPool = nullptr;
+        
+        struct RunningPoolScope{
+            const ThreadPool* previous;
+            RunningPoolScope(const ThreadPool* pool) : previous(tlsRunningPool){ tlsRunningPool = pool; }
+            ~RunningPoolScope(){ tlsRunningPool = previous; }
+        };
+    }
+    
+    ThreadPool::ThreadPool(int nThreads){
+        if(nThreads<=0){
+            nThreads = std::max(1, static_cast<int>(std::thread::hardware_concurrency()));
+        }
+        for(int i=1; i<nThreads; i++){
+            mWorkers.emplace_back(&ThreadPool::workerLoop, this);
+        }
+    }
+    
+    ThreadPool::~ThreadPool(){
+        {
+            std::lock_guard<std::mutex> lock(mMutex);
+            mStop = true;
+        }
+        mCondStart.notify_all();
+        for(auto& worker: mWorkers){
+            worker.join();
+        }
+    }
+    
+    int ThreadPool::numThreads() const{
+        return static_cast<int>(mWorkers.size()) + 1;
+    }
+    
+    void ThreadPool::parallelFor(size_t n, const std::function<void(size_t)>& task){
+        if(n==0){
+            return;
+        }
+        // A nested call would wait for the loop it is called from.
+        if(mWorkers.empty() || n==1 || tlsRunningPool==this){
+            for(size_t i=0; i<n; i++){
+                task(i);
+            }
+            return;
+        }
+        std::lock_guard<std::mutex> runLock(mRunMutex);
+        {
+            std::lock_guard<std::mutex> lock(mMutex);
+            mTask = &task;
+            mSize = n;
+            mNext = 0;
+            mException = nullptr;
+            mNumActive = mWorkers.size();
+            mGeneration++;
+        }
+        mCondStart.notify_all();
+        runTasks();
+        std::exception_ptr exception;
+        {
+            std::unique_lock<std::mutex> lock(mMutex);
+            mCondDone.wait(lock, [this]{return mNumActive==0;});
+            mTask = nullptr;
+            exception = mException;
+            mException = nullptr;
+        }
+        if(exception){
+            std::rethrow_exception(exception);
+        }
+    }
+    
+    void ThreadPool::workerLoop(){
+        long generation = 0;
+        while(true){
+            {
+                std::unique_lock<std::mutex> lock(mMutex);
+                mCondStart.wait(lock, [&]{return mStop || mGeneration!=generation;});
+                if(mStop){
+                    return;
+                }
+                generation = mGeneration;
+            }
+            runTasks();
+            {
+                std::lock_guard<std::mutex> lock(mMutex);
+                mNumActive--;
+                if(mNumActive==0){
+                    mCondDone.notify_all();
+                }
+            }
+        }
+    }
+    
+    void ThreadPool::runTasks(){
+        RunningPoolScope scope(this);
+        while(true){
+            size_t i = mNext.fetch_add(1);
+            if(mSize<=i){
+                break;
+            }
+            try{
+                (*mTask)(i);
+            }catch(...){
+                std::lock_guard<std::mutex> lock(mMutex);
+                if(!mException){
+                    mException = std::current_exception();
+                }
+            }
+        }
+    }
+}
@@ -0,0 +1,77 @@
+/*******************************************************************************
+ * Copyright (c) 2014, 2016  IBM Corporation and others
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *******************************************************************************/
+
+#ifndef ThreadPool_hpp
+#define ThreadPool_hpp
+
+#include <stdio.h>
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <functional>
+#include <exception>
+#include <memory>
+
+namespace loc{
+    
+    // Fixed set of worker threads reused across parallel loops.
+    class ThreadPool{
+    public:
+        using Ptr = std::shared_ptr<ThreadPool>;
+        
+        // nThreads includes the calling thread (0: hardware concurrency).
+        ThreadPool(int nThreads = 0);
+        ~ThreadPool();
+        
+        ThreadPool(const ThreadPool&) = delete;
+        ThreadPool& operator=(const ThreadPool&) = delete;
+        
+        int numThreads() const;
+        
+        // Calls task(i) for i in [0, n) on the workers and the calling thread, and blocks until all calls finish.
+        // An exception thrown by a task is rethrown after the remaining tasks finished.
+        // A call from a task of this pool runs the loop on the calling thread. Calls from other threads wait for the running loop.
+        void parallelFor(size_t n, const std::function<void(size_t)>& task);
+        
+    private:
+        std::vector<std::thread> mWorkers;
+        std::mutex mRunMutex;
+        std::mutex mMutex;
+        std::condition_variable mCondStart;
+        std::condition_variable mCondDone;
+        
+        const std::function<void(size_t)>* mTask = nullptr;
+        size_t mSize = 0;
+        std::atomic<size_t> mNext{0};
+        size_t mNumActive = 0;
+        long mGeneration = 0;
+        bool mStop = false;
+        std::exception_ptr mException;
+        
+        void workerLoop();
+        void runTasks();
+    };
+}
+
+#endif /* ThreadPool_hpp */
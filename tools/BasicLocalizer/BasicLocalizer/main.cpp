@@ -22,9 +22,17 @@
 
 #include <iostream>
 #include "BasicLocalizer.hpp"
+#include "LocalizationEngine.hpp"
 #include "MathUtils.hpp"
 #include "DataUtils.hpp"
 #include "LogUtil.hpp"
+#include "DataLogger.hpp"
+#include "TraceReader.hpp"
+#include "SpanTracer.hpp"
+#include "ThreadPool.hpp"
+#include <chrono>
+#include <mutex>
+#include <numeric>
 #include <getopt.h>
 #include <boost/program_options.hpp>
 
@@ -41,6 +49,7 @@ typedef struct {
     NormalFunction normFunc = NORMAL;
     double tDistNu = 3;
     int nSmooth = 10;
+    int smoothingLag = 0;
     int nStates = 1000;
     SmoothType smoothType = SMOOTH_LOCATION;
     bool findRssiBias = false;
@@ -50,6 +59,13 @@ typedef struct {
     bool usesRestart = false;
     bool forceTraining = false;
     bool finalizeMapdata = false;
+    std::string bundlePath = "";
+    std::string traceDirectory = "";
+    std::string convertTracePath = "";
+    std::string spanTracePath = "";
+    std::string batchListPath = "";
+    std::string sweepPath = "";
+    int batchThreads = 0;
     std::string restartLogPath = "";
     bool longLog = false;
     
@@ -75,6 +91,9 @@ void printHelp() {
     std::cout << " --meanRssiBias      set mean of rssi bias at initialization" << std::endl;
     std::cout << " --nSmooth           set nSmooth" << std::endl;
     std::cout << " -r                  set beacon rssi smooth (default location smooth)" << std::endl;
+    std::cout << " --smoothLag <int>   write locations smoothed with the lag [beacon input] to -o.smoothed.csv (or stdout) in tracking" << std::endl;
+    std::cout << "                     (fixed-lag smoothing on the particle ancestry, not offline smoothing of the whole log;" << std::endl;
+    std::cout << "                      keep it short as estimates far back rest on few surviving ancestors)" << std::endl;
     std::cout << " -s <double>         use student's t distribution and set nu value" << std::endl;
     std::cout << " -f                  find rssiBias" << std::endl;
     std::cout << " --lm <string>       set localization mode [ONESHOT,RANDOM_WALK_ACC,RANDOM_WALK_ACC_ATT,WEAK_POSE_RANDOM_WALKER]" << std::endl;
@@ -87,6 +106,16 @@ void printHelp() {
     std::cout << " -v                  set verbosity" << std::endl;
     std::cout << " --finalize          finalize map data file" << std::endl;
     std::cout << " --skip              set skip count of initial beacon inputs" << std::endl;
+    std::cout << " --grid <double>     use precomputed RSSI prediction grid with the cell size [m]" << std::endl;
+    std::cout << " --trainThreads <int>  set the number of threads for GP hyperparameter search (default: 1, 0: all cores)" << std::endl;
+    std::cout << " --predictThreads <int>  set the number of threads for particle prediction (0: all cores)" << std::endl;
+    std::cout << " --bundle <path>     write a binary model bundle which can be passed to -m instead of map data" << std::endl;
+    std::cout << " --trace <dir>       write a binary trace of particles, inputs and statuses to dir/trace.bin" << std::endl;
+    std::cout << " --convertTrace <path>  convert a binary trace to csv files in the directory set by -o (default: .)" << std::endl;
+    std::cout << " --spans <path>      write spans of localization stages as a Chrome trace json (chrome://tracing, Perfetto)" << std::endl;
+    std::cout << " --batch <listfile>  replay the logs listed in listfile in parallel and write error metrics to -o (and -o.summary.csv)" << std::endl;
+    std::cout << " --sweep <jsonfile>  evaluate every combination of {\"parameter\": [values], ...} in batch mode" << std::endl;
+    std::cout << " --batchThreads <int>  set the number of threads for batch mode (0: all cores)" << std::endl;
 }
 
 Option parseArguments(int argc, char *argv[]){
@@ -99,6 +128,7 @@ Option parseArguments(int argc, char *argv[]){
         {"maxRssiBias",     required_argument, NULL,  0 },
         {"meanRssiBias",    required_argument, NULL,  0 },
         {"nSmooth",    required_argument, NULL,  0 },
+        {"smoothLag",  required_argument, NULL,  0 },
         {"lm",         required_argument, NULL,  0 },
         {"wc",         no_argument, NULL, 0},
         {"reset",      no_argument, NULL, 0},
@@ -112,6 +142,16 @@ Option parseArguments(int argc, char *argv[]){
         {"finalize",   required_argument , NULL, 0},
         {"skip",         required_argument , NULL, 0},
         {"vl",         required_argument , NULL, 0},
+        {"grid",       required_argument , NULL, 0},
+        {"trainThreads", required_argument , NULL, 0},
+        {"predictThreads", required_argument , NULL, 0},
+        {"bundle",     required_argument , NULL, 0},
+        {"trace",      required_argument , NULL, 0},
+        {"convertTrace", required_argument , NULL, 0},
+        {"spans",      required_argument , NULL, 0},
+        {"batch",      required_argument , NULL, 0},
+        {"sweep",      required_argument , NULL, 0},
+        {"batchThreads", required_argument , NULL, 0},
         {0,         0,                 0,  0 }
     };
 
@@ -134,6 +174,9 @@ Option parseArguments(int argc, char *argv[]){
             if (strcmp(long_options[option_index].name, "nSmooth") == 0){
                 opt.nSmooth = atoi(optarg);
             }
+            if (strcmp(long_options[option_index].name, "smoothLag") == 0){
+                opt.smoothingLag = atoi(optarg);
+            }
             if (strcmp(long_options[option_index].name, "lm") == 0){
                 if(strcmp(optarg, "ONESHOT") == 0){
                     opt.localizeMode = ONESHOT;
@@ -194,6 +237,37 @@ Option parseArguments(int argc, char *argv[]){
             if (strcmp(long_options[option_index].name, "vl") == 0){
                 opt.longLog = true;
             }
+            if (strcmp(long_options[option_index].name, "grid") == 0){
+                opt.basicLocalizerOptions.usesPredictionGrid = true;
+                opt.basicLocalizerOptions.predictionGridParameters.cellSize = atof(optarg);
+            }
+            if (strcmp(long_options[option_index].name, "trainThreads") == 0){
+                opt.basicLocalizerOptions.nThreadsTraining = atoi(optarg);
+            }
+            if (strcmp(long_options[option_index].name, "predictThreads") == 0){
+                opt.basicLocalizerOptions.nThreadsPrediction = atoi(optarg);
+            }
+            if (strcmp(long_options[option_index].name, "bundle") == 0){
+                opt.bundlePath.assign(optarg);
+            }
+            if (strcmp(long_options[option_index].name, "trace") == 0){
+                opt.traceDirectory.assign(optarg);
+            }
+            if (strcmp(long_options[option_index].name, "convertTrace") == 0){
+                opt.convertTracePath.assign(optarg);
+            }
+            if (strcmp(long_options[option_index].name, "spans") == 0){
+                opt.spanTracePath.assign(optarg);
+            }
+            if (strcmp(long_options[option_index].name, "batch") == 0){
+                opt.batchListPath.assign(optarg);
+            }
+            if (strcmp(long_options[option_index].name, "sweep") == 0){
+                opt.sweepPath.assign(optarg);
+            }
+            if (strcmp(long_options[option_index].name, "batchThreads") == 0){
+                opt.batchThreads = atoi(optarg);
+            }
             break;
         case 'h':
             printHelp();
@@ -238,8 +312,25 @@ typedef struct {
     std::function<void(Status&)> func;
     int writeCount = 0;
     Beacons recentBeacons;
+    std::ostream *smoothedOut = NULL;
 } MyData;
 
+// Writes the estimates of the fixed-lag smoother. flush smooths the remaining steps at the end of a log or before restart.
+void writeSmoothedLocations(BasicLocalizer& localizer, MyData& ud, bool flush){
+    auto smoother = localizer.smoother();
+    if(!smoother || ud.smoothedOut==NULL){
+        return;
+    }
+    if(flush){
+        smoother->flush();
+    }
+    FixedLagSmoother::Estimate estimate;
+    while(smoother->next(estimate)){
+        auto global = ud.latLngConverter->localToGlobal(estimate.mean);
+        *ud.smoothedOut << estimate << "," << std::setprecision(10) << global.lat() << "," << global.lng() << std::endl;
+    }
+}
+
 void functionCalledWhenUpdated(void *userData, loc::Status *pStatus){
     MyData *ud = (MyData*)userData;
     if (ud->opt->findRssiBias) {
@@ -307,6 +398,428 @@ void functionCalledWhenUpdated(void *userData, loc::Status *pStatus){
     }
 }
 
+// Replay of sensor inputs shared by the sequential log replay and the batch evaluation.
+
+typedef struct {
+    bool printsLog = true;
+    int beaconReceiveCount = 0;
+    std::function<void(const Beacons&)> beaconsWillBePut; // called before beacons are put (e.g. to be seen by the update handler)
+    std::function<void(const Beacons&)> beaconsWerePut;
+} LogReplayState;
+
+// Puts a sensor input, DisableAcceleration or Reset line of a log to the localizer.
+// Returns false for the other lines (Marker, Restart, Note, ...), which are handled by the caller.
+bool replayLogLine(BasicLocalizer& localizer, const std::string& logString, const Option& opt, LatLngConverter::Ptr latLngConverter, LogReplayState& state){
+    // Parameter for reset log play
+    const double dx_reset = 1.0;
+    const double dy_reset = 1.0;
+    const double std_ori_reset = 10;
+    
+    // Parsing beacons values
+    if (logString.compare(0, 7, "Beacon,") == 0) {
+        Beacons beacons = LogUtil::toBeacons(logString);
+        for(auto& b: beacons){
+            b.rssi( b.rssi() < 0 ? b.rssi() : -100);
+        }
+        state.beaconReceiveCount++;
+        if(opt.skipBeacon<state.beaconReceiveCount){
+            if(state.beaconsWillBePut){
+                state.beaconsWillBePut(beacons);
+            }
+            localizer.putBeacons(beacons);
+            if(state.beaconsWerePut){
+                state.beaconsWerePut(beacons);
+            }
+        }else if(state.printsLog){
+            std::cout << "First "<< state.beaconReceiveCount << " beacon input was skipped." << std::endl;
+        }
+        return true;
+    }
+    // Parsing acceleration values
+    if (logString.compare(0, 4, "Acc,") == 0) {
+        Acceleration acc = LogUtil::toAcceleration(logString);
+        localizer.putAcceleration(acc);
+        return true;
+    }
+    // Parsing motion values
+    if (logString.compare(0, 7, "Motion,") == 0) {
+        Attitude att = LogUtil::toAttitude(logString);
+        localizer.putAttitude(att);
+        return true;
+    }
+    if (logString.compare(0, 10,"Altimeter,") == 0){
+        Altimeter alt = LogUtil::toAltimeter(logString);
+        localizer.putAltimeter(alt);
+        return true;
+    }
+    if (logString.compare(0, 8,"Heading,") == 0){
+        Heading heading = LogUtil::toHeading(logString);
+        
+        // do not update the trueHeading value in this block because heading.trueHeading() < 0 is checked later.
+        if(heading.trueHeading() < 0){ // (trueHeading==-1 is invalid.)
+            Anchor anchor = latLngConverter->anchor();
+            if(std::isnan(anchor.magneticDeclination)){
+                if(!std::isnan(opt.magneticDeclination)){
+                    // overwrite declination to the anchor if it is set as an argument value.
+                    anchor.magneticDeclination = opt.magneticDeclination;
+                    latLngConverter->anchor(anchor);
+                }else{
+                    // if declination is not set in the anchor and the argument value.
+                    std::stringstream ss;
+                    ss << "True heading (trueHeading=" << heading.trueHeading() << ") is invalid. Input declination argument";
+                    BOOST_THROW_EXCEPTION(LocException(ss.str())); // a valid declination value is required in the command line tool.
+                }
+            }
+        }
+        localizer.putHeading(heading);
+        return true;
+    }
+    if (logString.compare(0, 20, "DisableAcceleration,") == 0){
+        std::vector<std::string> values;
+        boost::split(values, logString, boost::is_any_of(","));
+        int da = stoi(values.at(1));
+        long timestamp = stol(values.back());
+        localizer.disableAcceleration(da==1, timestamp);
+        if(state.printsLog){
+            std::cout << "LogReplay:" << logString << std::endl;
+        }
+        return true;
+    }
+    if (opt.usesReset && logString.compare(0, 6, "Reset,") == 0) {
+        // "Reset",lat,lng,floor,heading,timestamp
+        std::vector<std::string> values;
+        boost::split(values, logString, boost::is_any_of(","));
+        long timestamp = stol(values.at(5));
+        double lat = stod(values.at(1));
+        double lng = stod(values.at(2));
+        double floor = stod(values.at(3));
+        double heading = stod(values.at(4));
+        if(state.printsLog){
+            std::cout << "LogReplay:" << timestamp << ",Reset,";
+            std::cout << std::setprecision(10) << lat <<"," <<lng;
+            std::cout <<"," <<floor <<"," << heading << std::endl;
+        }
+        
+        Location loc;
+        GlobalState<Location> global(loc);
+        global.lat(lat);
+        global.lng(lng);
+        loc = latLngConverter->globalToLocal(global);
+        loc.floor(floor);
+        
+        auto anchor = latLngConverter->anchor();
+        double localHeading = ( heading - anchor.rotate )/180*M_PI;
+        double xH = sin(localHeading);
+        double yH = cos(localHeading);
+        double orientation = atan2(yH,xH);
+        
+        loc::Pose newPose(loc);
+        newPose.orientation(orientation);
+        
+        loc::Pose stdevPose;
+        stdevPose.x(dx_reset).y(dy_reset).orientation(std_ori_reset/180*M_PI);
+        
+        localizer.resetStatus(newPose, stdevPose);
+        return true;
+    }
+    return false;
+}
+
+// Batch evaluation: replays many logs with a grid of parameters on a worker pool.
+
+typedef struct {
+    size_t configIndex = 0;
+    std::string logPath;
+    std::vector<double> errors; // 2D errors at markers [m]
+    int nFloorErrors = 0;
+    double elapsedTime = 0; // [s]
+    std::string errorMessage;
+} BatchRun;
+
+typedef struct {
+    std::shared_ptr<Pose> recentPose;
+} BatchUserData;
+
+void functionCalledWhenUpdatedInBatch(void *userData, loc::Status *pStatus){
+    BatchUserData *ud = (BatchUserData*)userData;
+    if(pStatus->step()!=Status::OTHER && pStatus->meanPose()){
+        ud->recentPose = std::make_shared<Pose>(*pStatus->meanPose());
+    }
+}
+
+std::vector<std::string> readLines(const std::string& path){
+    std::ifstream ifs(path);
+    if(ifs.fail()){
+        BOOST_THROW_EXCEPTION(LocException("file is unable to read: " + path));
+    }
+    std::vector<std::string> lines;
+    std::string str;
+    while(getline(ifs, str)){
+        boost::trim(str);
+        if(!str.empty() && str[0]!='#'){
+            lines.push_back(str);
+        }
+    }
+    return lines;
+}
+
+// Expands a parameter grid {"key": [v0, v1, ...], ...} into the cartesian product of overrides of base.
+// Keys are the names in the localizer config json; nested values are addressed by dots (e.g. "*poseProperty.meanVelocity").
+std::vector<BasicLocalizerParameters> expandParameterGrid(const BasicLocalizerParameters& base, const std::string& gridPath, std::vector<std::string>& labels){
+    std::stringstream ssBase;
+    {
+        cereal::JSONOutputArchive oarchive(ssBase);
+        oarchive(base);
+    }
+    picojson::value baseJSON;
+    std::string err = picojson::parse(baseJSON, ssBase.str());
+    if(!err.empty()){
+        BOOST_THROW_EXCEPTION(LocException(err));
+    }
+    
+    std::vector<std::pair<std::string, picojson::array>> axes;
+    if(!gridPath.empty()){
+        std::ifstream ifs(gridPath);
+        if(ifs.fail()){
+            BOOST_THROW_EXCEPTION(LocException("parameter grid file is unable to read: " + gridPath));
+        }
+        picojson::value grid;
+        err = picojson::parse(grid, std::string(std::istreambuf_iterator<char>(ifs), std::istreambuf_iterator<char>()));
+        if(!err.empty()){
+            BOOST_THROW_EXCEPTION(LocException(err));
+        }
+        if(!grid.is<picojson::object>()){
+            BOOST_THROW_EXCEPTION(LocException("parameter grid must be a json object: " + gridPath));
+        }
+        for(const auto& pair: grid.get<picojson::object>()){
+            if(pair.second.is<picojson::array>()){
+                axes.push_back(std::make_pair(pair.first, pair.second.get<picojson::array>()));
+            }else{
+                axes.push_back(std::make_pair(pair.first, picojson::array{pair.second}));
+            }
+        }
+    }
+    
+    std::vector<BasicLocalizerParameters> configs;
+    std::vector<size_t> counter(axes.size(), 0);
+    while(true){
+        picojson::value json = baseJSON;
+        std::stringstream ssLabel;
+        for(size_t a=0; a<axes.size(); a++){
+            const auto& key = axes[a].first;
+            const auto& value = axes[a].second.at(counter[a]);
+            std::vector<std::string> path;
+            boost::split(path, key, boost::is_any_of("."));
+            // cereal wraps the parameters in "value0"
+            picojson::value* node = &json.get<picojson::object>()["value0"];
+            for(const auto& name: path){
+                if(!node->is<picojson::object>()){
+                    BOOST_THROW_EXCEPTION(LocException("parameter " + key + " is not found"));
+                }
+                node = &node->get<picojson::object>()[name];
+            }
+            *node = value;
+            ssLabel << (a==0 ? "" : ";") << key << "=" << value.serialize();
+        }
+        std::stringstream ssConfig(json.serialize());
+        BasicLocalizerParameters params;
+        {
+            cereal::JSONInputArchive iarchive(ssConfig);
+            iarchive(params);
+        }
+        configs.push_back(params);
+        labels.push_back(ssLabel.str());
+        
+        size_t a = 0;
+        for(; a<axes.size(); a++){
+            if(++counter[a] < axes[a].second.size()){
+                break;
+            }
+            counter[a] = 0;
+        }
+        if(a==axes.size()){
+            break;
+        }
+    }
+    return configs;
+}
+
+// Replays sensor inputs of a log and records errors at markers.
+void replayLogForEvaluation(BasicLocalizer& localizer, const Option& opt, BatchUserData& ud, BatchRun& run){
+    std::ifstream ifs(run.logPath);
+    if(ifs.fail()){
+        BOOST_THROW_EXCEPTION(LocException("test file is unable to read: " + run.logPath));
+    }
+    auto latLngConverter = localizer.latLngConverter();
+    LogReplayState state;
+    state.printsLog = false;
+    std::string str;
+    while(getline(ifs, str)){
+        std::vector<std::string> v;
+        boost::split(v, str, boost::is_any_of(" "));
+        if(v.size() <= 3){
+            continue;
+        }
+        const std::string& logString = v.at(3);
+        try{
+            if(replayLogLine(localizer, logString, opt, latLngConverter, state)){
+                continue;
+            }
+            if (logString.compare(0, 7, "Marker,") == 0){
+                // "Marker",lat,lng,floor,timestamp
+                std::vector<std::string> values;
+                boost::split(values, logString, boost::is_any_of(","));
+                Location markerLoc;
+                GlobalState<Location> global(markerLoc);
+                global.lat(stod(values.at(1)));
+                global.lng(stod(values.at(2)));
+                global.floor(stod(values.at(3)));
+                markerLoc = latLngConverter->globalToLocal(global);
+                if(ud.recentPose){
+                    run.errors.push_back(Location::distance2D(markerLoc, *ud.recentPose));
+                    if(Location::floorDifference(markerLoc, *ud.recentPose) >= 1.0){
+                        run.nFloorErrors++;
+                    }
+                }
+            }
+        }catch (std::invalid_argument& e){
+            std::cerr << run.logPath << ": error in parse log file (" << e.what() << ")" << std::endl;
+        }
+    }
+}
+
+double percentile(std::vector<double> values, double p){
+    if(values.empty()){
+        return NAN;
+    }
+    std::sort(values.begin(), values.end());
+    size_t rank = static_cast<size_t>(std::ceil(p*values.size()));
+    return values.at(std::min(std::max(rank, (size_t)1), values.size()) - 1);
+}
+
+void writeErrorStatistics(std::ostream& os, const std::vector<double>& errors, int nFloorErrors){
+    double mean = errors.empty() ? NAN : std::accumulate(errors.begin(), errors.end(), 0.0)/errors.size();
+    os << errors.size() << "," << mean << "," << percentile(errors, 0.5) << "," << percentile(errors, 0.95)
+    << "," << (errors.empty() ? NAN : (double) nFloorErrors/errors.size());
+}
+
+int runBatch(Option& opt){
+    std::vector<std::string> logPaths = readLines(opt.batchListPath);
+    
+    // Base parameters from --lj or from the command line options
+    BasicLocalizerParameters baseParams;
+    std::ifstream ifs(opt.localizerJSONPath);
+    if(!opt.localizerJSONPath.empty() && ifs.is_open()){
+        cereal::JSONInputArchive iarchive(ifs);
+        iarchive(baseParams);
+    }else{
+        BasicLocalizer localizer;
+        localizer.localizeMode = opt.localizeMode;
+        localizer.nSmooth = opt.nSmooth;
+        localizer.smoothType = opt.smoothType;
+        localizer.nStates = opt.nStates;
+        localizer.walkDetectSigmaThreshold = opt.walkDetectSigmaThreshold;
+        localizer.meanRssiBias(opt.meanRssiBias);
+        localizer.minRssiBias(opt.minRssiBias);
+        localizer.maxRssiBias(opt.maxRssiBias);
+        localizer.headingConfidenceForOrientationInit(0.5);
+        baseParams = BasicLocalizerParameters(localizer);
+    }
+    std::vector<std::string> labels;
+    std::vector<BasicLocalizerParameters> configs = expandParameterGrid(baseParams, opt.sweepPath, labels);
+    
+    // The model is loaded once and shared by all runs.
+    LocalizationModelOptions modelOptions;
+    modelOptions.forceTraining = opt.forceTraining;
+    modelOptions.finalizeMapdata = opt.finalizeMapdata;
+    modelOptions.gpType = opt.basicLocalizerOptions.gpType;
+    modelOptions.nThreadsTraining = opt.basicLocalizerOptions.nThreadsTraining;
+    modelOptions.usesPredictionGrid = opt.basicLocalizerOptions.usesPredictionGrid;
+    modelOptions.predictionGridParameters = opt.basicLocalizerOptions.predictionGridParameters;
+    LocalizationModel::Ptr model = LocalizationModel::load(opt.mapPath, "./", modelOptions);
+    
+    std::vector<BatchRun> runs(configs.size()*logPaths.size());
+    for(size_t c=0; c<configs.size(); c++){
+        for(size_t l=0; l<logPaths.size(); l++){
+            BatchRun& run = runs[c*logPaths.size() + l];
+            run.configIndex = c;
+            run.logPath = logPaths[l];
+        }
+    }
+    std::cerr << "batch: " << configs.size() << " configs x " << logPaths.size() << " logs" << std::endl;
+    
+    std::mutex mutexProgress;
+    size_t nFinished = 0;
+    auto start = std::chrono::steady_clock::now();
+    ThreadPool pool(opt.batchThreads);
+    pool.parallelFor(runs.size(), [&](size_t i){
+        BatchRun& run = runs[i];
+        auto s = std::chrono::steady_clock::now();
+        try{
+            BatchUserData ud;
+            BasicLocalizer localizer(LocalizationEngine::copyParameters(configs[run.configIndex]));
+            localizer.isVerboseLocalizer = opt.verbose;
+            localizer.basicLocalizerOptions = opt.basicLocalizerOptions;
+            localizer.updateHandler(functionCalledWhenUpdatedInBatch, &ud);
+            localizer.setModel(model);
+            localizer.normalFunction(opt.normFunc, opt.tDistNu); // set after calling setModel
+            replayLogForEvaluation(localizer, opt, ud, run);
+        }catch(LocException& e){
+            run.errorMessage = e.what();
+        }catch(std::exception& e){
+            run.errorMessage = e.what();
+        }catch(...){
+            run.errorMessage = "unknown exception";
+        }
+        run.elapsedTime = std::chrono::duration<double>(std::chrono::steady_clock::now() - s).count();
+        
+        std::lock_guard<std::mutex> lock(mutexProgress);
+        nFinished++;
+        std::cerr << "batch: [" << nFinished << "/" << runs.size() << "] config=" << run.configIndex << ", log=" << run.logPath
+        << ", nMarkers=" << run.errors.size() << ", time=" << run.elapsedTime << "s"
+        << (run.errorMessage.empty() ? "" : ", error=" + run.errorMessage) << std::endl;
+    });
+    double wallTime = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    
+    std::unique_ptr<std::ofstream> ofsRuns, ofsSummary;
+    std::ostream* outRuns = &std::cout;
+    std::ostream* outSummary = &std::cout;
+    if(!opt.outputPath.empty()){
+        ofsRuns.reset(new std::ofstream(opt.outputPath));
+        ofsSummary.reset(new std::ofstream(opt.outputPath + ".summary.csv"));
+        outRuns = ofsRuns.get();
+        outSummary = ofsSummary.get();
+    }
+    
+    *outRuns << "config,log,nMarkers,meanError,medianError,p95Error,floorErrorRate,time,error" << std::endl;
+    for(const auto& run: runs){
+        *outRuns << run.configIndex << "," << run.logPath << ",";
+        writeErrorStatistics(*outRuns, run.errors, run.nFloorErrors);
+        *outRuns << "," << run.elapsedTime << "," << run.errorMessage << std::endl;
+    }
+    
+    *outSummary << "config,parameters,nMarkers,meanError,medianError,p95Error,floorErrorRate,time,nFailedRuns" << std::endl;
+    for(size_t c=0; c<configs.size(); c++){
+        std::vector<double> errors;
+        int nFloorErrors = 0, nFailed = 0;
+        double time = 0;
+        for(const auto& run: runs){
+            if(run.configIndex!=c){
+                continue;
+            }
+            errors.insert(errors.end(), run.errors.begin(), run.errors.end());
+            nFloorErrors += run.nFloorErrors;
+            nFailed += run.errorMessage.empty() ? 0 : 1;
+            time += run.elapsedTime;
+        }
+        *outSummary << c << ",\"" << labels[c] << "\",";
+        writeErrorStatistics(*outSummary, errors, nFloorErrors);
+        *outSummary << "," << time << "," << nFailed << std::endl;
+    }
+    std::cerr << "batch: finished " << runs.size() << " runs in " << wallTime << "s with " << pool.numThreads() << " threads" << std::endl;
+    return 0;
+}
+
 int main(int argc, char * argv[]) {
     if (argc <= 1) {
         printHelp();
@@ -315,6 +828,29 @@ int main(int argc, char * argv[]) {
     
     Option opt = parseArguments(argc, argv);
     
+    if (opt.convertTracePath.length() > 0) {
+        TraceReader::convertToCSV(opt.convertTracePath, opt.outputPath.length() > 0 ? opt.outputPath : ".");
+        return 0;
+    }
+    // Spans are written when main returns.
+    struct SpanTracerStopper{
+        ~SpanTracerStopper(){ SpanTracer::stop(); }
+    } spanTracerStopper;
+    if (opt.spanTracePath.length() > 0) {
+        SpanTracer::start(opt.spanTracePath);
+    }
+    if (opt.batchListPath.length() > 0) {
+        try{
+            return runBatch(opt);
+        }catch(LocException& e){
+            std::cerr << boost::diagnostic_information(e) << std::endl;
+            return -1;
+        }
+    }
+    if (opt.traceDirectory.length() > 0) {
+        DataLogger::createInstance(opt.traceDirectory, true);
+    }
+    
     MyData ud;
     ud.opt = &opt;
     if (opt.outputPath.length() > 0) {
@@ -326,6 +862,14 @@ int main(int argc, char * argv[]) {
     } else {
         ud.out = &std::cout;
     }
+    if (0 < opt.smoothingLag) {
+        if (opt.outputPath.length() > 0) {
+            ud.smoothedOut = new std::ofstream(opt.outputPath + ".smoothed.csv");
+        } else {
+            ud.smoothedOut = &std::cout;
+        }
+        *ud.smoothedOut << FixedLagSmoother::Estimate::header() << ",lat,lng" << std::endl;
+    }
 
     auto resetBasicLocalizer = [](Option& opt, MyData& ud){
         BasicLocalizer localizer;
@@ -354,6 +898,9 @@ int main(int argc, char * argv[]) {
             
             localizer.headingConfidenceForOrientationInit(0.5);
         }
+        if(0<opt.smoothingLag){
+            localizer.smoothingLag = opt.smoothingLag;
+        }
         
         localizer.isVerboseLocalizer = opt.verbose;
         localizer.updateHandler(functionCalledWhenUpdated, &ud);
@@ -364,6 +911,11 @@ int main(int argc, char * argv[]) {
         localizer.normalFunction(opt.normFunc, opt.tDistNu); // set after calling setModel
         ud.latLngConverter = localizer.latLngConverter();
         
+        if(opt.bundlePath!=""){
+            localizer.writeModelBundle(opt.bundlePath);
+            std::cout << "model bundle was written to " << opt.bundlePath << std::endl;
+        }
+        
         if(opt.outputLocalizerJSONPath!=""){
             std::string strPath = opt.outputLocalizerJSONPath;
             std::ofstream ofs(strPath);
@@ -387,11 +939,6 @@ int main(int argc, char * argv[]) {
         std::cerr << ch << std::endl;
         return -1;
     }
-    // Parameter for reset log play
-    double dx_reset = 1.0;
-    double dy_reset = 1.0;
-    double std_ori_reset = 10;
-    
     if (opt.findRssiBias) {
         double step = (opt.maxRssiBias - opt.minRssiBias)/20;
         for(double rssiBias = opt.minRssiBias; rssiBias < opt.maxRssiBias; rssiBias += step) {
@@ -483,7 +1030,14 @@ int main(int argc, char * argv[]) {
             Beacons beaconsRecent;
             std::vector<double> errorsAtMarkers;
             
-            int beaconReceiveCount = 0;
+            LogReplayState replayState;
+            replayState.beaconsWillBePut = [&](const Beacons& beacons){
+                ud.recentBeacons = beacons;
+            };
+            replayState.beaconsWerePut = [&](const Beacons& beacons){
+                beaconsRecent = beacons;
+                writeSmoothedLocations(localizer, ud, false);
+            };
             while (getline(ifs, str))
             {
                 try {
@@ -491,121 +1045,14 @@ int main(int argc, char * argv[]) {
                     boost::split(v, str, boost::is_any_of(" "));
                     if(v.size() > 3){
                         std::string logString = v.at(3);
-                        // Parsing beacons values
-                        if (logString.compare(0, 7, "Beacon,") == 0) {
-                            Beacons beacons = LogUtil::toBeacons(logString);
-                            //std::cout << "LogReplay:" << beacons.timestamp() << ",Beacon," << beacons.size() << std::endl;
-                            for(auto& b: beacons){
-                                b.rssi( b.rssi() < 0 ? b.rssi() : -100);
-                            }
-                            
-                            beaconReceiveCount++;
-                            if(opt.skipBeacon<beaconReceiveCount){
-                                ud.recentBeacons = beacons;
-                                localizer.putBeacons(beacons);
-                                beaconsRecent = beacons;
-                            }else{
-                                std::cout << "First "<< beaconReceiveCount << " beacon input was skipped." << std::endl;
-                            }
-                            // Compute likelihood at recent pose
-                            //{
-                            //    auto recentPose = ud.recentPose;
-                            //    auto obsModel = localizer.observationModel();
-                            //    State sTmp(recentPose);
-                            //    auto logLikelihood = obsModel->computeLogLikelihood(sTmp, beaconsRecent);
-                            //}
-                        }
-                        // Parsing acceleration values
-                        if (logString.compare(0, 4, "Acc,") == 0) {
-                            Acceleration acc = LogUtil::toAcceleration(logString);
-                            localizer.putAcceleration(acc);
-                        }
-                        // Parsing motion values
-                        if (logString.compare(0, 7, "Motion,") == 0) {
-                            Attitude att = LogUtil::toAttitude(logString);
-                            localizer.putAttitude(att);
-                        }
-                        
-                        if (logString.compare(0, 10,"Altimeter,") == 0){
-                            Altimeter alt = LogUtil::toAltimeter(logString);
-                            localizer.putAltimeter(alt);
-                            //std::cout << "LogReplay:" << alt.timestamp() << ", Altimeter, " << alt.relativeAltitude() << "," << alt.pressure() << std::endl;
-                        }
-                        if (logString.compare(0, 8,"Heading,") == 0){
-                            Heading heading = LogUtil::toHeading(logString);
-                            
-                            // do not update the trueHeading value in this block because heading.trueHeading() < 0 is checked later.
-                            if(heading.trueHeading() < 0){ // (trueHeading==-1 is invalid.)
-                                Anchor anchor = ud.latLngConverter->anchor();
-                                if(std::isnan(anchor.magneticDeclination)){
-                                    if(!isnan(opt.magneticDeclination)){
-                                        // overwrite declination to the anchor if it is set as an argument value.
-                                        anchor.magneticDeclination = opt.magneticDeclination;
-                                        ud.latLngConverter->anchor(anchor);
-                                    }else{
-                                        // if declination is not set in the anchor and the argument value.
-                                        std::stringstream ss;
-                                        ss << "True heading (trueHeading=" << heading.trueHeading() << ") is invalid. Input declination argument";
-                                        BOOST_THROW_EXCEPTION(LocException(ss.str())); // a valid declination value is required in the command line tool.
-                                    }
-                                }
-                            }
-                            localizer.putHeading(heading);
-                            //LocalHeading localHeading = ud.latLngConverter->headingGlobalToLocal(heading);
-                            //std::cout << "LogReplay:" << heading.timestamp() << ", Heading, " << heading.magneticHeading() << "," << heading.trueHeading() << "," << heading.headingAccuracy() << "(localHeading=" << localHeading.orientation() << ")" << std::endl;
-                        }
-                        if (logString.compare(0, 20, "DisableAcceleration,") == 0){
-                            std::vector<std::string> values;
-                            boost::split(values, logString, boost::is_any_of(","));
-                            int da = stoi(values.at(1));
-                            long timestamp = stol(values.back());
-                            if(da==1){
-                                localizer.disableAcceleration(true,timestamp);
-                            }else{
-                                localizer.disableAcceleration(false,timestamp);
-                            }
-                            std::cout << "LogReplay:" << logString << std::endl;
-                        }
-                        if (opt.usesReset && logString.compare(0, 6, "Reset,") == 0) {
-                            // "Reset",lat,lng,floor,heading,timestamp
-                            std::vector<std::string> values;
-                            boost::split(values, logString, boost::is_any_of(","));
-                            long timestamp = stol(values.at(5));
-                            double lat = stod(values.at(1));
-                            double lng = stod(values.at(2));
-                            double floor = stod(values.at(3));
-                            double heading = stod(values.at(4));
-                            std::cout << "LogReplay:" << timestamp << ",Reset,";
-                            std::cout << std::setprecision(10) << lat <<"," <<lng;
-                            std::cout <<"," <<floor <<"," << heading << std::endl;
-                            
-                            Location loc;
-                            GlobalState<Location> global(loc);
-                            global.lat(lat);
-                            global.lng(lng);
-                            loc = ud.latLngConverter->globalToLocal(global);
-                            loc.floor(floor);
-                            
-                            auto anchor = ud.latLngConverter->anchor();
-                            double localHeading = ( heading - anchor.rotate )/180*M_PI;
-                            double xH = sin(localHeading);
-                            double yH = cos(localHeading);
-                            double orientation = atan2(yH,xH);
-                            
-                            loc::Pose newPose(loc);
-                            newPose.orientation(orientation);
-                            
-                            loc::Pose stdevPose;
-                            stdevPose.x(dx_reset).y(dy_reset).orientation(std_ori_reset/180*M_PI);
-                            
-                            localizer.resetStatus(newPose, stdevPose);
-                        }
+                        replayLogLine(localizer, logString, opt, ud.latLngConverter, replayState);
                         if (opt.usesRestart && logString.compare(0, 8, "Restart,") == 0){
                             // "Restart",timestamp
                             std::vector<std::string> values;
                             boost::split(values, logString, boost::is_any_of(","));
                             long timestamp = stol(values.at(1));
                             std::cout << "LogReplay: " << timestamp << ",Restart," << std::endl;
+                            writeSmoothedLocations(localizer, ud, true);
                             localizer = resetBasicLocalizer(opt, ud);
                             restarter.reset();
                             restarter.counter=1;
@@ -744,6 +1191,7 @@ int main(int argc, char * argv[]) {
                     std::cerr << "error in parse log file" << std::endl;
                 }
             }
+            writeSmoothedLocations(localizer, ud, true);
         }else{
             std::cout << "test file is not specified" << std::endl;
         }
@@ -0,0 +1,188 @@
+/*******************************************************************************
+ * Copyright (c) 2014, 2016  IBM Corporation and others
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *******************************************************************************/
+
+
+#import <XCTest/XCTest.h>
+#import <algorithm>
+#import <atomic>
+#import <chrono>
+#import <thread>
+#import <vector>
+#import "AsyncStreamLocalizer.hpp"
+#import "Status.hpp"
+
+using namespace loc;
+using namespace std;
+
+namespace{
+    // Records the timestamps of accelerations. The first input blocks until released,
+    // so that later inputs are queued.
+    class RecordingLocalizer: public StreamLocalizer{
+    public:
+        std::vector<long> timestamps;
+        std::atomic<bool> started{false};
+        std::atomic<bool> released{false};
+        Status status;
+        
+        RecordingLocalizer& updateHandler(void (*)(Status*)) override { return *this; }
+        RecordingLocalizer& updateHandler(void (*)(void*, Status*), void*) override { return *this; }
+        RecordingLocalizer& putAcceleration(const Acceleration acceleration) override {
+            if(!started.exchange(true)){
+                while(!released.load()){
+                    std::this_thread::yield();
+                }
+            }
+            timestamps.push_back(acceleration.timestamp());
+            status.timestamp(acceleration.timestamp());
+            return *this;
+        }
+        RecordingLocalizer& putAttitude(const Attitude) override { return *this; }
+        RecordingLocalizer& putBeacons(const Beacons) override { return *this; }
+        RecordingLocalizer& putLocalHeading(const LocalHeading) override { return *this; }
+        RecordingLocalizer& putAltimeter(const Altimeter) override { return *this; }
+        Status* getStatus() override { return &status; }
+        bool resetStatus() override { return true; }
+        bool resetStatus(Pose) override { return true; }
+        bool resetStatus(Pose, Pose) override { return true; }
+        bool resetStatus(Pose, Pose, double) override { return true; }
+        bool resetStatus(const Beacons&) override { return true; }
+        bool resetStatus(const Location&, const Beacons&) override { return true; }
+    };
+    
+    // Pushes the first input, waits until the worker holds it and then pushes the rest in shuffled order.
+    void pushBlocked(AsyncStreamLocalizer& async, RecordingLocalizer& recorder, const std::vector<long>& rest){
+        async.putAcceleration(Acceleration(0, 0, 0, 1));
+        while(!recorder.started.load()){
+            std::this_thread::yield();
+        }
+        for(long t: rest){
+            async.putAcceleration(Acceleration(t, 0, 0, 1));
+        }
+        recorder.released.store(true);
+    }
+    
+    std::vector<long> shuffledTimestamps(size_t n){
+        std::vector<long> ts;
+        for(size_t i=1; i<=n; i++){
+            ts.push_back((long)((i*37)%n + 1));
+        }
+        return ts;
+    }
+}
+
+@interface AsyncStreamLocalizerTest : XCTestCase
+
+@end
+
+@implementation AsyncStreamLocalizerTest
+
+- (void)testEventsAreProcessedInTimestampOrder {
+    auto recorder = std::make_shared<RecordingLocalizer>();
+    AsyncStreamLocalizer async(recorder);
+    auto rest = shuffledTimestamps(100);
+    pushBlocked(async, *recorder, rest);
+    async.flush();
+    
+    XCTAssertEqual(recorder->timestamps.size(), rest.size() + 1);
+    XCTAssertTrue(std::is_sorted(recorder->timestamps.begin(), recorder->timestamps.end()));
+    auto stats = async.statistics();
+    XCTAssertEqual(stats.pushed, (uint64_t)101);
+    XCTAssertEqual(stats.processed, (uint64_t)101);
+}
+
+- (void)testEventsInSeparateBatchesAreReorderedWithinWindow {
+    AsyncStreamLocalizerParameters params;
+    params.reorderWindow = 1000;
+    auto recorder = std::make_shared<RecordingLocalizer>();
+    recorder->released.store(true);
+    AsyncStreamLocalizer async(recorder, params);
+    // Each event is pushed after the worker has taken the previous one.
+    for(long t: {100L, 80L, 120L, 90L, 1500L, 1100L}){
+        async.putAcceleration(Acceleration(t, 0, 0, 1));
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+    async.flush();
+    
+    std::vector<long> expected{80, 90, 100, 120, 1100, 1500};
+    XCTAssertTrue(recorder->timestamps == expected);
+}
+
+- (void)testHeldEventsAreReleasedWithoutNewerEvents {
+    AsyncStreamLocalizerParameters params;
+    params.reorderWindow = 20;
+    auto recorder = std::make_shared<RecordingLocalizer>();
+    recorder->released.store(true);
+    AsyncStreamLocalizer async(recorder, params);
+    async.putAcceleration(Acceleration(100, 0, 0, 1));
+    for(int i=0; i<100 && async.statistics().processed==0; i++){
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+    XCTAssertEqual(async.statistics().processed, (uint64_t)1);
+}
+
+- (void)testFlushWaitsForAllEventsWhenDropping {
+    AsyncStreamLocalizerParameters params;
+    params.queueCapacity = 4;
+    params.policy = DROP_OLDEST;
+    auto recorder = std::make_shared<RecordingLocalizer>();
+    AsyncStreamLocalizer async(recorder, params);
+    pushBlocked(async, *recorder, shuffledTimestamps(50));
+    async.flush();
+    
+    auto stats = async.statistics();
+    XCTAssertEqual(stats.pushed, (uint64_t)51);
+    XCTAssertTrue(0 < stats.dropped);
+    XCTAssertEqual(stats.processed + stats.dropped, stats.pushed);
+    XCTAssertEqual(recorder->timestamps.size(), stats.processed);
+}
+
+- (void)testFlushWaitsForAllEventsWhenCoalescing {
+    AsyncStreamLocalizerParameters params;
+    params.queueCapacity = 4;
+    params.policy = COALESCE;
+    auto recorder = std::make_shared<RecordingLocalizer>();
+    AsyncStreamLocalizer async(recorder, params);
+    pushBlocked(async, *recorder, shuffledTimestamps(50));
+    async.flush();
+    
+    auto stats = async.statistics();
+    XCTAssertTrue(0 < stats.coalesced);
+    XCTAssertEqual(stats.processed + stats.coalesced, stats.pushed);
+    XCTAssertEqual(recorder->timestamps.size(), stats.processed);
+}
+
+- (void)testGetStatusReturnsSnapshot {
+    auto recorder = std::make_shared<RecordingLocalizer>();
+    recorder->released.store(true);
+    AsyncStreamLocalizer async(recorder);
+    async.putAcceleration(Acceleration(10, 0, 0, 1));
+    Status* status = async.getStatus();
+    XCTAssertTrue(status != recorder->getStatus());
+    XCTAssertEqual(status->timestamp(), 10L);
+    
+    async.putAcceleration(Acceleration(20, 0, 0, 1));
+    async.flush();
+    XCTAssertEqual(status->timestamp(), 10L);
+    XCTAssertEqual(async.getStatus()->timestamp(), 20L);
+}
+
+@end
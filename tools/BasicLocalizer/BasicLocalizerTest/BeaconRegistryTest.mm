@@ -0,0 +1,105 @@
+/*******************************************************************************
+ * Copyright (c) 2014, 2016  IBM Corporation and others
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *******************************************************************************/
+
+
+#import <XCTest/XCTest.h>
+#import <vector>
+#import "BeaconRegistry.hpp"
+#import "RegisteredBeaconFilter.hpp"
+
+using namespace loc;
+using namespace std;
+
+namespace{
+    const string uuidA = "00000000-0000-0000-0000-0000000003AA";
+    const string uuidB = "00000000-0000-0000-0000-0000000003BB";
+
+    // Finds the first id equal to id by BeaconId::operator==
+    uint32_t findLinear(const vector<BeaconId>& ids, const BeaconId& id){
+        for(uint32_t i=0; i<ids.size(); i++){
+            if(ids[i]==id){
+                return i;
+            }
+        }
+        return BeaconRegistry::noIndex;
+    }
+}
+
+@interface BeaconRegistryTest : XCTestCase
+
+@end
+
+@implementation BeaconRegistryTest
+
+- (void)testIndicesFollowRegistrationOrder {
+    vector<BeaconId> ids{BeaconId(uuidA, 3, 1), BeaconId(uuidA, 3, 2), BeaconId(uuidB, 3, 1)};
+    BeaconRegistry registry(ids);
+    XCTAssertEqual(registry.size(), ids.size());
+    for(uint32_t i=0; i<ids.size(); i++){
+        XCTAssertEqual(registry.find(ids[i]), i);
+        XCTAssertTrue(registry.id(i)==ids[i]);
+    }
+    XCTAssertEqual(registry.find(BeaconId(uuidA, 3, 3)), BeaconRegistry::noIndex);
+    XCTAssertEqual(registry.find(BeaconId(uuidB, 3, 2)), BeaconRegistry::noIndex);
+    XCTAssertEqual(BeaconRegistry().find(ids[0]), BeaconRegistry::noIndex);
+}
+
+- (void)testMixedNilAndFullIdsMatchBeaconIdEquality {
+    // Model beacons with and without uuid
+    vector<BeaconId> ids{BeaconId(uuidA, 3, 1), BeaconId("", 3, 2), BeaconId(uuidB, 3, 2), BeaconId(uuidB, 4, 1), BeaconId("", 5, 5)};
+    BeaconRegistry registry(ids);
+
+    vector<BeaconId> queries;
+    for(const string& uuid: {string(""), uuidA, uuidB}){
+        for(int major: {3, 4, 5, 6}){
+            for(int minor: {1, 2, 5}){
+                queries.push_back(BeaconId(uuid, major, minor));
+            }
+        }
+    }
+    for(const auto& query: queries){
+        XCTAssertEqual(registry.find(query), findLinear(ids, query), @"%s", query.toString().c_str());
+    }
+    // Scans without uuid resolve to the model beacons regardless of the order ids were registered
+    XCTAssertEqual(registry.find(BeaconId("", 3, 1)), 0u);
+    XCTAssertEqual(registry.find(BeaconId("", 4, 1)), 3u);
+    XCTAssertEqual(registry.find(BeaconId(uuidA, 5, 5)), 4u);
+}
+
+- (void)testFilterKeepsScansWithoutUuid {
+    BLEBeacons bleBeacons;
+    bleBeacons.push_back(BLEBeacon(uuidA, 3, 1, 0.0, 0.0, 0, 0));
+    bleBeacons.push_back(BLEBeacon(uuidA, 3, 2, 10.0, 0.0, 0, 0));
+    RegisteredBeaconFilter filter(bleBeacons);
+
+    Beacons beacons;
+    beacons.push_back(Beacon(3, 2, -70));
+    beacons.push_back(Beacon(uuidB, 3, 1, -75));
+    beacons.push_back(Beacon(uuidA, 3, 1, -80));
+    beacons.push_back(Beacon(7, 7, -60));
+    Beacons filtered = filter.filter(beacons);
+    XCTAssertEqual(filtered.size(), 2);
+    XCTAssertEqual(filtered.at(0).minor(), 2);
+    XCTAssertEqual(filtered.at(1).rssi(), -80);
+}
+
+@end
@@ -0,0 +1,150 @@
+/*******************************************************************************
+ * Copyright (c) 2014, 2016  IBM Corporation and others
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *******************************************************************************/
+
+
+
+#import <XCTest/XCTest.h>
+#import "Particles.hpp"
+#import "ParticleHistory.hpp"
+#import "FixedLagSmoother.hpp"
+
+using namespace loc;
+using namespace std;
+
+@interface FixedLagSmootherTest : XCTestCase
+
+@end
+
+@implementation FixedLagSmootherTest
+
+// Moves the particles to xs with equal weights at timestamp and stores them as a new step.
+static void step(ParticleHistory& history, Particles& particles, const std::vector<double>& xs, long timestamp){
+    size_t n = particles.size();
+    for(size_t i=0; i<n; i++){
+        particles.x()[i] = xs[i];
+        particles.weight()[i] = 1.0/n;
+        particles.timestamp()[i] = timestamp;
+    }
+    history.push(particles);
+}
+
+- (void)testCursorFollowsResampledAncestors {
+    auto history = std::make_shared<ParticleHistory>(3);
+    Particles particles(3);
+    step(*history, particles, {0, 10, 20}, 100);
+    particles.select({2, 2, 0});
+    step(*history, particles, {21, 22, 1}, 200);
+    
+    XCTAssertEqual(history->step(particles), 1L);
+    XCTAssertEqual(history->parentStep(1), 0L);
+    
+    std::vector<double> expectedParents{20, 20, 0};
+    for(size_t i=0; i<particles.size(); i++){
+        ParticleHistory::Cursor c = history->cursor(particles, i);
+        XCTAssertTrue(c.valid());
+        XCTAssertEqual(c.step(), 1L);
+        XCTAssertEqual(c.location().x(), particles.x()[i]);
+        c.toParent();
+        XCTAssertTrue(c.valid());
+        XCTAssertEqual(c.step(), 0L);
+        XCTAssertEqual(c.timestamp(), 100L);
+        XCTAssertEqual(c.location().x(), expectedParents[i]);
+        c.toParent();
+        XCTAssertFalse(c.valid());
+    }
+}
+
+- (void)testOverwrittenStepEndsLineage {
+    auto history = std::make_shared<ParticleHistory>(2);
+    Particles particles(2);
+    step(*history, particles, {0, 1}, 100);
+    step(*history, particles, {2, 3}, 200);
+    step(*history, particles, {4, 5}, 300);
+    
+    ParticleHistory::Cursor c = history->cursor(particles, 1);
+    XCTAssertEqual(c.location().x(), 5.0);
+    c.toParent();
+    XCTAssertTrue(c.valid());
+    XCTAssertEqual(c.location().x(), 3.0);
+    c.toParent();
+    XCTAssertFalse(c.valid());
+    XCTAssertFalse(history->cursor(0, 0).valid());
+}
+
+- (void)testSmoothedEstimateUsesSurvivingAncestors {
+    FixedLagSmoother smoother(1);
+    auto history = std::make_shared<ParticleHistory>(smoother.lag()+1);
+    Particles particles(2);
+    FixedLagSmoother::Estimate estimate;
+    
+    step(*history, particles, {0, 10}, 100);
+    smoother.update(particles);
+    XCTAssertFalse(smoother.next(estimate));
+    
+    // The particle at x=0 dies out at resampling, so the smoothed location at t=100 is that of the survivor.
+    particles.select({1, 1});
+    step(*history, particles, {11, 13}, 200);
+    smoother.update(particles);
+    XCTAssertTrue(smoother.next(estimate));
+    XCTAssertEqual(estimate.timestamp, 100L);
+    XCTAssertEqual(estimate.lag, (size_t)1);
+    XCTAssertEqual(estimate.mean.x(), 10.0);
+    XCTAssertEqual(estimate.stdev.x(), 0.0);
+    XCTAssertFalse(smoother.next(estimate));
+    
+    smoother.flush();
+    XCTAssertTrue(smoother.next(estimate));
+    XCTAssertEqual(estimate.timestamp, 200L);
+    XCTAssertEqual(estimate.lag, (size_t)0);
+    XCTAssertEqual(estimate.mean.x(), 12.0);
+    XCTAssertEqual(estimate.stdev.x(), 1.0);
+    XCTAssertFalse(smoother.next(estimate));
+}
+
+- (void)testFlushSmoothsWholeTrajectory {
+    FixedLagSmoother smoother(10);
+    auto history = std::make_shared<ParticleHistory>(smoother.lag()+1);
+    Particles particles(2);
+    
+    step(*history, particles, {0, 10}, 100);
+    smoother.update(particles);
+    particles.select({0, 0});
+    step(*history, particles, {1, 2}, 200);
+    smoother.update(particles);
+    particles.select({1, 1});
+    step(*history, particles, {3, 3}, 300);
+    smoother.update(particles);
+    XCTAssertEqual(smoother.size(), (size_t)0);
+    
+    smoother.flush();
+    std::vector<long> timestamps;
+    std::vector<double> means;
+    FixedLagSmoother::Estimate estimate;
+    while(smoother.next(estimate)){
+        timestamps.push_back(estimate.timestamp);
+        means.push_back(estimate.mean.x());
+    }
+    XCTAssertTrue((timestamps==std::vector<long>{100, 200, 300}));
+    XCTAssertTrue((means==std::vector<double>{0, 2, 3}));
+}
+
+@end
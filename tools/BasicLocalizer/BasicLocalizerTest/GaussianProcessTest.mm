@@ -0,0 +1,130 @@
+/*******************************************************************************
+ * Copyright (c) 2014, 2016  IBM Corporation and others
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *******************************************************************************/
+
+
+
+#import <XCTest/XCTest.h>
+#import <random>
+#import "GaussianProcess.hpp"
+
+using namespace loc;
+using namespace std;
+
+@interface GaussianProcessTest : XCTestCase
+
+@end
+
+@implementation GaussianProcessTest
+
+// Samples on two floors with three outputs
+static void makeSamples(size_t n, Eigen::MatrixXd& X, Eigen::MatrixXd& Y){
+    std::mt19937 engine(1234);
+    std::uniform_real_distribution<double> uniform(0.0, 20.0);
+    std::normal_distribution<double> noise(0.0, 1.0);
+    X.resize(n, 4);
+    Y.resize(n, 3);
+    for(size_t i=0; i<n; i++){
+        X(i,0) = uniform(engine);
+        X(i,1) = uniform(engine);
+        X(i,2) = 0;
+        X(i,3) = i%2;
+        for(int j=0; j<3; j++){
+            Y(i,j) = 5.0*std::sin(0.3*X(i,0) + j) + 3.0*std::cos(0.2*X(i,1)) + noise(engine);
+        }
+    }
+}
+
+static GaussianProcess makeGP(const Eigen::MatrixXd& X, const Eigen::MatrixXd& Y){
+    GaussianKernel::Parameters params;
+    params.sigma_f = 3.0;
+    params.lengthes[0] = params.lengthes[1] = params.lengthes[2] = 4.0;
+    params.lengthes[3] = 0.01;
+    GaussianProcess gp;
+    gp.gaussianKernel(GaussianKernel(params));
+    gp.sigmaN(1.0);
+    gp.fit(X, Y);
+    return gp;
+}
+
+- (void)testBatchPredictionEqualsSinglePrediction {
+    Eigen::MatrixXd X, Y;
+    makeSamples(60, X, Y);
+    GaussianProcess gp = makeGP(X, Y);
+    
+    // More points than one block of the batch product
+    size_t n = 300;
+    std::vector<int> indices{2, 0};
+    std::vector<double> xs(n*4);
+    for(size_t i=0; i<n; i++){
+        xs[i*4+0] = 0.07*i;
+        xs[i*4+1] = 20.0 - 0.05*i;
+        xs[i*4+2] = 0;
+        xs[i*4+3] = i%2;
+    }
+    std::vector<double> ypreds(n*indices.size());
+    gp.predict(xs.data(), n, indices, ypreds.data());
+    for(size_t i=0; i<n; i++){
+        std::vector<double> single = gp.predict(&xs[i*4], indices);
+        for(size_t k=0; k<indices.size(); k++){
+            XCTAssertEqualWithAccuracy(ypreds[i*indices.size()+k], single[k], 1.0e-9);
+        }
+    }
+}
+
+- (void)testWeightsEqualInverseSolution {
+    Eigen::MatrixXd X, Y;
+    makeSamples(50, X, Y);
+    GaussianProcess gp = makeGP(X, Y);
+    
+    Eigen::MatrixXd Ky = gp.computeKernelMatrix(X);
+    Ky.diagonal().array() += gp.sigmaN()*gp.sigmaN();
+    Eigen::MatrixXd weights = Ky.inverse()*Y;
+    XCTAssertLessThan((gp.weights() - weights).cwiseAbs().maxCoeff(), 1.0e-8);
+}
+
+- (void)testLeaveOneOutMSEEqualsRefitting {
+    Eigen::MatrixXd X, Y;
+    size_t n = 30;
+    makeSamples(n, X, Y);
+    GaussianProcess gp = makeGP(X, Y);
+    
+    // Fit without sample i and predict it
+    double sumSquareError = 0;
+    for(size_t i=0; i<n; i++){
+        Eigen::MatrixXd Xi(n-1, X.cols()), Yi(n-1, Y.cols());
+        for(size_t r=0, k=0; r<n; r++){
+            if(r!=i){
+                Xi.row(k) = X.row(r);
+                Yi.row(k) = Y.row(r);
+                k++;
+            }
+        }
+        GaussianProcess gpi = makeGP(Xi, Yi);
+        double xi[4] = {X(i,0), X(i,1), X(i,2), X(i,3)};
+        Eigen::VectorXd ypred = gpi.predict(xi);
+        sumSquareError += (Y.row(i).transpose() - ypred).squaredNorm();
+    }
+    double mse = sumSquareError/(n*Y.cols());
+    XCTAssertEqualWithAccuracy(gp.leaveOneOutMSE(), mse, 1.0e-8*mse);
+}
+
+@end
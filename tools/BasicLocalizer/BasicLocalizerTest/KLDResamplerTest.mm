@@ -0,0 +1,119 @@
+/*******************************************************************************
+ * Copyright (c) 2014, 2016  IBM Corporation and others
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *******************************************************************************/
+
+
+#import <XCTest/XCTest.h>
+#import <memory>
+#import <vector>
+#import "KLDResampler.hpp"
+#import "Particles.hpp"
+
+using namespace loc;
+using namespace std;
+
+namespace{
+    // n particles with equal weights spread over a nx x nx grid of 1 m cells on floor 0
+    Particles spreadParticles(size_t n, int nx){
+        Particles particles(n);
+        for(size_t i=0; i<n; i++){
+            particles.x()[i] = (i % nx) + 0.5;
+            particles.y()[i] = ((i / nx) % nx) + 0.5;
+            particles.floor()[i] = 0;
+            particles.weight()[i] = 1.0/n;
+        }
+        return particles;
+    }
+}
+
+@interface KLDResamplerTest : XCTestCase
+
+@end
+
+@implementation KLDResamplerTest
+
+- (void)testBoundNumberOfStates {
+    KLDResamplerParameters params;
+    params.minStates = 10;
+    params.epsilon = 0.05;
+    params.delta = 0.01;
+    KLDResampler<State> resampler(params);
+    
+    XCTAssertEqual(resampler.boundNumberOfStates(1), 10);
+    XCTAssertEqual(resampler.boundNumberOfStates(2), 66);
+    int previous = 0;
+    for(int k=2; k<200; k++){
+        int n = resampler.boundNumberOfStates(k);
+        XCTAssertTrue(previous < n);
+        previous = n;
+    }
+}
+
+- (void)testSingleBinGivesMinStates {
+    KLDResamplerParameters params;
+    params.minStates = 50;
+    params.maxStates = 1000;
+    KLDResampler<State> resampler(params);
+    
+    Particles particles = spreadParticles(500, 1);
+    std::vector<int> ancestors;
+    resampler.resample(particles, particles.weight(), particles.sumWeights(), ancestors);
+    XCTAssertEqual(ancestors.size(), (size_t)50);
+    
+    States states = particles.toStates();
+    std::unique_ptr<States> resampled(resampler.resample(states, particles.weight()));
+    XCTAssertEqual(resampled->size(), (size_t)50);
+}
+
+- (void)testSampleCountGrowsWithOccupiedBins {
+    KLDResamplerParameters params;
+    params.minStates = 50;
+    params.maxStates = 100000;
+    KLDResampler<State> resampler(params);
+    
+    size_t previous = 0;
+    for(int nx: {2, 5, 10}){
+        Particles particles = spreadParticles(nx*nx*20, nx);
+        std::vector<int> ancestors;
+        resampler.resample(particles, particles.weight(), particles.sumWeights(), ancestors);
+        // At most nx*nx bins can be occupied, and every draw is counted before the bound is reached.
+        XCTAssertTrue(ancestors.size() <= (size_t)resampler.boundNumberOfStates(nx*nx));
+        XCTAssertTrue(previous < ancestors.size());
+        previous = ancestors.size();
+        for(int a: ancestors){
+            XCTAssertTrue(0 <= a && a < (int)particles.size());
+        }
+    }
+}
+
+- (void)testSampleCountIsBoundedByMaxStates {
+    KLDResamplerParameters params;
+    params.minStates = 50;
+    params.maxStates = 300;
+    KLDResampler<State> resampler(params);
+    
+    Particles particles = spreadParticles(10000, 100);
+    std::vector<int> ancestors;
+    resampler.resample(particles, particles.weight(), particles.sumWeights(), ancestors);
+    XCTAssertEqual(ancestors.size(), (size_t)300);
+}
+
+@end
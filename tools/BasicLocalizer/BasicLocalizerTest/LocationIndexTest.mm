@@ -0,0 +1,156 @@
+/*******************************************************************************
+ * Copyright (c) 2014, 2016  IBM Corporation and others
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *******************************************************************************/
+
+
+#import <XCTest/XCTest.h>
+#import <algorithm>
+#import <random>
+#import "LocationIndex.hpp"
+#import "DataStoreImpl.hpp"
+#import "StatusInitializerImpl.hpp"
+
+using namespace loc;
+using namespace std;
+
+namespace{
+    const string uuid = "00000000-0000-0000-0000-0000000016AB";
+    
+    Locations makeLocations(size_t n){
+        std::mt19937 engine(16);
+        std::uniform_real_distribution<double> uniform(-30.0, 50.0);
+        Locations locations;
+        for(size_t i=0; i<n; i++){
+            locations.push_back(Location(uniform(engine), uniform(engine), 0, i%3==0 ? 1 : 0));
+        }
+        return locations;
+    }
+    
+    BLEBeacons makeBLEBeacons(){
+        BLEBeacons bleBeacons;
+        bleBeacons.push_back(BLEBeacon(uuid, 16, 1, 0.0, 0.0, 0, 0));
+        bleBeacons.push_back(BLEBeacon(uuid, 16, 2, 20.0, 10.0, 0, 0));
+        bleBeacons.push_back(BLEBeacon(uuid, 16, 3, 5.0, 40.0, 0, 1));
+        return bleBeacons;
+    }
+}
+
+@interface LocationIndexTest : XCTestCase
+
+@end
+
+@implementation LocationIndexTest
+
+- (void)testBeaconIndex {
+    LocationIndex index(makeLocations(10), makeBLEBeacons());
+    XCTAssertEqual(index.beaconIndex(Beacon(uuid, 16, 2, -70)), 1);
+    XCTAssertEqual(index.beaconIndex(BeaconId(uuid, 16, 3)), 2);
+    // Beacons without uuid match by major and minor
+    XCTAssertEqual(index.beaconIndex(Beacon(16, 1, -70)), 0);
+    XCTAssertEqual(index.beaconIndex(Beacon(uuid, 16, 4, -70)), -1);
+    XCTAssertEqual(index.beaconIndex(BeaconId(uuid, 17, 1)), -1);
+}
+
+- (void)testScansWithoutUuidFindLocationsCloseToBeacons {
+    Locations locations = makeLocations(500);
+    LocationIndex index(locations, makeBLEBeacons());
+    vector<int> withUuid, withoutUuid;
+    index.findLocationIndicesCloseToBeacons({Beacon(uuid, 16, 1, -70), Beacon(uuid, 16, 3, -80)}, 12.0, withUuid);
+    index.findLocationIndicesCloseToBeacons({Beacon(16, 1, -70), Beacon(16, 3, -80)}, 12.0, withoutUuid);
+    XCTAssertFalse(withUuid.empty());
+    XCTAssertTrue(withoutUuid==withUuid);
+}
+
+- (void)testStatusInitializerBuildsIndexWithDataStore {
+    auto dataStore = std::make_shared<DataStoreImpl>();
+    dataStore->bleBeacons(makeBLEBeacons());
+    dataStore->locations(makeLocations(300));
+    
+    StatusInitializerImpl initializer;
+    initializer.dataStore(dataStore);
+    Locations selected = initializer.extractLocationsCloseToBeacons({Beacon(16, 2, -70)}, 12.0);
+    XCTAssertFalse(selected.empty());
+    for(const auto& loc: selected){
+        XCTAssertTrue(Location::distance2D(loc, makeBLEBeacons().at(1)) <= 12.0);
+    }
+    // A shared index must cover the locations of the data store
+    auto otherIndex = std::make_shared<LocationIndex>(makeLocations(10), makeBLEBeacons());
+    XCTAssertThrows(initializer.dataStore(dataStore, otherIndex));
+}
+
+- (void)testDuplicatedBeaconsThrow {
+    BLEBeacons bleBeacons = makeBLEBeacons();
+    bleBeacons.push_back(bleBeacons.front());
+    XCTAssertThrows(LocationIndex(makeLocations(10), bleBeacons));
+}
+
+- (void)testLocationsWithinRadiusEqualExhaustiveSearch {
+    Locations locations = makeLocations(2000);
+    LocationIndex index(locations, makeBLEBeacons(), 5.0);
+    XCTAssertEqual(index.nLocations(), locations.size());
+    
+    std::mt19937 engine(7);
+    std::uniform_real_distribution<double> uniform(-40.0, 60.0);
+    for(int trial=0; trial<50; trial++){
+        Location center(uniform(engine), uniform(engine), 0, trial%2);
+        for(double radius: {0.0, 1.5, 7.0, 30.0, 200.0}){
+            vector<int> expected;
+            for(int i=0; i<locations.size(); i++){
+                if(locations[i].floor()==center.floor() && Location::distance2D(locations[i], center) <= radius){
+                    expected.push_back(i);
+                }
+            }
+            vector<int> found;
+            index.findLocationIndices(center, radius, found);
+            std::sort(found.begin(), found.end());
+            XCTAssertTrue(found==expected);
+        }
+    }
+    // Floors without locations
+    vector<int> found;
+    index.findLocationIndices(Location(0, 0, 0, 5), 100.0, found);
+    XCTAssertTrue(found.empty());
+}
+
+- (void)testLocationsCloseToBeaconsEqualExhaustiveSearch {
+    Locations locations = makeLocations(500);
+    BLEBeacons bleBeacons = makeBLEBeacons();
+    LocationIndex index(locations, bleBeacons);
+    
+    vector<Beacon> beacons{Beacon(uuid, 16, 3, -80), Beacon(uuid, 16, 1, -60), Beacon(uuid, 99, 9, -60), Beacon(uuid, 16, 2, -75)};
+    double radius = 12.0;
+    vector<int> expected;
+    for(int i=0; i<locations.size(); i++){
+        for(const auto& b: beacons){
+            for(const auto& ble: bleBeacons){
+                if(ble.id()==b.id() && ble.floor()==locations[i].floor() && Location::distance2D(ble, locations[i]) <= radius){
+                    expected.push_back(i);
+                }
+            }
+        }
+    }
+    vector<int> found{-1}; // entries before the call are kept
+    index.findLocationIndicesCloseToBeacons(beacons, radius, found);
+    XCTAssertEqual(found.front(), -1);
+    XCTAssertTrue(vector<int>(found.begin()+1, found.end())==expected);
+}
+
+@end
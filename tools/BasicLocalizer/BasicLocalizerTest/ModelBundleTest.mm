@@ -0,0 +1,166 @@
+/*******************************************************************************
+ * Copyright (c) 2014, 2016  IBM Corporation and others
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *******************************************************************************/
+
+
+#import <XCTest/XCTest.h>
+#import <cmath>
+#import <random>
+#import <sstream>
+#import <cstdio>
+#import "ModelBundle.hpp"
+#import "DataStoreImpl.hpp"
+#import "GaussianProcessLDPLMultiModel.hpp"
+
+using namespace loc;
+using namespace std;
+
+namespace{
+    using Model = GaussianProcessLDPLMultiModel<State, Beacons>;
+
+    const string uuid = "00000000-0000-0000-0000-0000000010AB";
+
+    BLEBeacons makeBLEBeacons(){
+        BLEBeacons bleBeacons;
+        bleBeacons.push_back(BLEBeacon(uuid, 10, 1, 0.0, 0.0, 0, 0));
+        bleBeacons.push_back(BLEBeacon(uuid, 10, 2, 30.0, 5.0, 0, 0));
+        bleBeacons.push_back(BLEBeacon(uuid, 10, 3, 10.0, 25.0, 0, 0));
+        return bleBeacons;
+    }
+
+    // Log-distance RSSI with noise on a grid of locations
+    Samples makeSamples(const BLEBeacons& bleBeacons){
+        std::mt19937 engine(10);
+        std::normal_distribution<double> noise(0.0, 2.0);
+        Samples samples;
+        long timestamp = 0;
+        for(double x=0; x<=30; x+=3){
+            for(double y=0; y<=25; y+=5){
+                Beacons beacons;
+                for(const auto& ble: bleBeacons){
+                    double d = std::sqrt((x-ble.x())*(x-ble.x()) + (y-ble.y())*(y-ble.y()));
+                    beacons.push_back(Beacon(ble.uuid(), ble.major(), ble.minor(), -60 - 20*std::log10(d+1) + noise(engine)));
+                }
+                beacons.timestamp(timestamp);
+                Sample sample;
+                sample.timestamp(timestamp)->location(Location(x, y, 0, 0))->beacons(beacons);
+                samples.push_back(sample);
+                timestamp += 1000;
+            }
+        }
+        return samples;
+    }
+
+    std::shared_ptr<Model> trainModel(){
+        BLEBeacons bleBeacons = makeBLEBeacons();
+        auto dataStore = std::make_shared<DataStoreImpl>();
+        dataStore->bleBeacons(bleBeacons).samples(makeSamples(bleBeacons));
+        GaussianProcessLDPLMultiModelTrainer<State, Beacons> trainer;
+        trainer.dataStore(dataStore);
+        return std::shared_ptr<Model>(trainer.train());
+    }
+
+    std::string bundlePath(const std::string& name){
+        return std::string([NSTemporaryDirectory() UTF8String]) + "/" + name;
+    }
+}
+
+@interface ModelBundleTest : XCTestCase
+
+@end
+
+@implementation ModelBundleTest
+
+- (void)testGaussianProcessViewsBundleMatrices {
+    GaussianKernel::Parameters params;
+    params.sigma_f = 3.0;
+    params.lengthes[0] = params.lengthes[1] = params.lengthes[2] = 4.0;
+    GaussianProcess gp;
+    gp.gaussianKernel(GaussianKernel(params));
+    gp.fit(Eigen::MatrixXd::Random(20, 4)*10, Eigen::MatrixXd::Random(20, 3));
+
+    std::string path = bundlePath("gp.bundle");
+    ModelBundleWriter writer;
+    writer.matrix(ModelBundle::GP_X, gp.X()).matrix(ModelBundle::GP_WEIGHTS, gp.weights());
+    writer.write(path);
+
+    std::shared_ptr<GaussianProcess> copied;
+    {
+        GaussianProcess viewed;
+        viewed.gaussianKernel(gp.gaussianKernel());
+        auto bundle = ModelBundle::open(path);
+        viewed.trained(bundle->matrix(ModelBundle::GP_X), bundle->matrix(ModelBundle::GP_WEIGHTS), bundle);
+        XCTAssertEqual(viewed.weights().data(), bundle->matrix(ModelBundle::GP_WEIGHTS).data());
+        copied = std::make_shared<GaussianProcess>(viewed);
+    }
+    // The mapping is kept alive by the copy of the GP.
+    std::remove(path.c_str());
+    double x[] = {1.0, 2.0, 0.0, 0.0};
+    XCTAssertTrue(copied->predict(x).isApprox(gp.predict(x)));
+}
+
+- (void)testBundlePredictionsEqualTextLoadedModel {
+    auto trained = trainModel();
+    std::ostringstream oss;
+    trained->save(oss);
+    Model textModel;
+    std::istringstream iss(oss.str());
+    textModel.load(iss);
+
+    std::string path = bundlePath("model.bundle");
+    ModelBundleWriter writer;
+    textModel.saveBinary(writer);
+    writer.write(path);
+
+    Model bundleModel;
+    bundleModel.loadBinary(*ModelBundle::open(path));
+    std::remove(path.c_str());
+
+    Beacons beacons;
+    beacons.push_back(Beacon(uuid, 10, 1, -75));
+    beacons.push_back(Beacon(uuid, 10, 3, -82));
+    beacons.push_back(Beacon(uuid, 10, 9, -90));
+    beacons.timestamp(0);
+    std::vector<State> states;
+    for(double x=-2; x<=32; x+=4.5){
+        for(double y=-1; y<=26; y+=3.5){
+            State state;
+            state.x(x).y(y).z(0).floor(0);
+            states.push_back(state);
+        }
+    }
+    std::vector<double> textLogLLs = textModel.computeLogLikelihood(states, beacons);
+    std::vector<double> bundleLogLLs = bundleModel.computeLogLikelihood(states, beacons);
+    XCTAssertEqual(textLogLLs.size(), states.size());
+    XCTAssertEqual(bundleLogLLs.size(), states.size());
+    for(size_t i=0; i<states.size(); i++){
+        XCTAssertEqualWithAccuracy(bundleLogLLs[i], textLogLLs[i], 1.0e-9);
+        auto textPreds = textModel.predict(states[i], beacons);
+        auto bundlePreds = bundleModel.predict(states[i], beacons);
+        XCTAssertEqual(bundlePreds.size(), textPreds.size());
+        for(const auto& pred: textPreds){
+            XCTAssertEqualWithAccuracy(bundlePreds.at(pred.first).mean(), pred.second.mean(), 1.0e-9);
+            XCTAssertEqualWithAccuracy(bundlePreds.at(pred.first).stdev(), pred.second.stdev(), 1.0e-9);
+        }
+    }
+}
+
+@end
@@ -0,0 +1,111 @@
+/*******************************************************************************
+ * Copyright (c) 2014, 2016  IBM Corporation and others
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *******************************************************************************/
+
+
+
+#import <XCTest/XCTest.h>
+#import <random>
+#import "NearestPointField.hpp"
+
+using namespace loc;
+using namespace std;
+
+@interface NearestPointFieldTest : XCTestCase
+
+@end
+
+@implementation NearestPointFieldTest
+
+static long squaredDistance(int x1, int y1, int x2, int y2){
+    long dx = x1 - x2;
+    long dy = y1 - y2;
+    return dx*dx + dy*dy;
+}
+
+// Checks every pixel against an exhaustive search. Ties may resolve to any of the closest seeds.
+static bool equalsBruteForce(int rows, int cols, const vector<int>& xs, const vector<int>& ys){
+    NearestPointField field(rows, cols, xs, ys);
+    for(int y=0; y<rows; y++){
+        for(int x=0; x<cols; x++){
+            long minDist = -1;
+            for(size_t i=0; i<xs.size(); i++){
+                if(xs[i]<0 || cols<=xs[i] || ys[i]<0 || rows<=ys[i]){
+                    continue;
+                }
+                long d = squaredDistance(x, y, xs[i], ys[i]);
+                if(minDist<0 || d<minDist){
+                    minDist = d;
+                }
+            }
+            int32_t nearest = field.nearest(y, x);
+            if(minDist<0){
+                if(nearest!=-1){
+                    return false;
+                }
+                continue;
+            }
+            if(nearest<0 || squaredDistance(x, y, nearest%cols, nearest/cols)!=minDist){
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+- (void)testRandomSeedsEqualBruteForce {
+    std::mt19937 engine(42);
+    int sizes[][2] = {{1, 1}, {1, 17}, {23, 1}, {31, 47}, {64, 40}};
+    for(auto& size: sizes){
+        int rows = size[0];
+        int cols = size[1];
+        for(int nSeeds: {1, 2, 5, 40}){
+            std::uniform_int_distribution<int> rx(0, cols-1), ry(0, rows-1);
+            vector<int> xs, ys;
+            for(int i=0; i<nSeeds; i++){
+                xs.push_back(rx(engine));
+                ys.push_back(ry(engine));
+            }
+            XCTAssertTrue(equalsBruteForce(rows, cols, xs, ys));
+        }
+    }
+}
+
+- (void)testSeedsOnALine {
+    // Many equidistant seeds produce ties in both passes.
+    vector<int> xs, ys;
+    for(int x=0; x<50; x+=3){
+        xs.push_back(x);
+        ys.push_back(10);
+    }
+    XCTAssertTrue(equalsBruteForce(21, 50, xs, ys));
+    XCTAssertTrue(equalsBruteForce(21, 50, ys, xs));
+}
+
+- (void)testSeedsOutsideImageAreIgnored {
+    NearestPointField empty(10, 10, {-1, 10, 3}, {2, 2, 10});
+    XCTAssertFalse(empty.hasSeeds());
+    XCTAssertEqual(empty.nearest(5, 5), -1);
+    
+    XCTAssertTrue(equalsBruteForce(12, 9, {-3, 4, 20}, {1, 11, 5}));
+}
+
+@end
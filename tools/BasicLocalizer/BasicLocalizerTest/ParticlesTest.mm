@@ -0,0 +1,128 @@
+/*******************************************************************************
+ * Copyright (c) 2014, 2016  IBM Corporation and others
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *******************************************************************************/
+
+
+#import <XCTest/XCTest.h>
+#import "Particles.hpp"
+#import "Status.hpp"
+
+using namespace loc;
+using namespace std;
+
+@interface ParticlesTest : XCTestCase
+
+@end
+
+@implementation ParticlesTest
+
+static States makeStates(size_t n){
+    States states(n);
+    for(size_t i=0; i<n; i++){
+        State& s = states[i];
+        s.x(1.0+i).y(2.0+i).z(0.5*i).floor(i%3);
+        s.orientation(0.1*i).velocity(1.0+0.01*i).normalVelocity(0.9);
+        s.orientationBias(0.2*i).orientationAlignment(0.3*i).rssiBias(-1.0*i);
+        s.weight(1.0/n).negativeLogLikelihood(10.0+i).mahalanobisDistance(3.0+i);
+        s.timestamp = 1000+i;
+    }
+    return states;
+}
+
+static bool isSame(const State& a, const State& b){
+    return a.x()==b.x() && a.y()==b.y() && a.z()==b.z() && a.floor()==b.floor()
+    && a.orientation()==b.orientation() && a.velocity()==b.velocity() && a.normalVelocity()==b.normalVelocity()
+    && a.orientationBias()==b.orientationBias() && a.orientationAlignment()==b.orientationAlignment()
+    && a.rssiBias()==b.rssiBias() && a.weight()==b.weight()
+    && a.negativeLogLikelihood()==b.negativeLogLikelihood() && a.mahalanobisDistance()==b.mahalanobisDistance()
+    && a.timestamp==b.timestamp;
+}
+
+- (void)testStatesRoundTrip {
+    States states = makeStates(17);
+    Particles particles(states);
+    XCTAssertEqual(particles.size(), states.size());
+    States converted = particles.toStates();
+    for(size_t i=0; i<states.size(); i++){
+        XCTAssertTrue(isSame(states[i], particles.state(i)));
+        XCTAssertTrue(isSame(states[i], converted[i]));
+    }
+    
+    Particles assigned;
+    assigned.assign(converted);
+    for(size_t i=0; i<states.size(); i++){
+        XCTAssertTrue(isSame(states[i], assigned.state(i)));
+    }
+}
+
+- (void)testSwapFields {
+    Particles particles(makeStates(5));
+    Particles predicted(5);
+    predicted.x()[2] = 42.0;
+    particles.swapFields(predicted);
+    XCTAssertEqual(particles.size(), (size_t)5);
+    XCTAssertEqual(particles.x()[2], 42.0);
+    XCTAssertEqual(predicted.x()[2], 3.0);
+}
+
+- (void)testAppendAndFindClosest {
+    States states = makeStates(6);
+    Particles particles(States(states.begin(), states.begin()+2));
+    particles.append(Particles(States(states.begin()+2, states.end())));
+    XCTAssertEqual(particles.size(), states.size());
+    for(size_t i=0; i<states.size(); i++){
+        XCTAssertTrue(isSame(states[i], particles.state(i)));
+    }
+    XCTAssertEqual(particles.findClosestLocationIndex(states[4]), (size_t)4);
+    XCTAssertEqual(particles.compute2DVariance(), Location::compute2DVariance(states));
+}
+
+- (void)testStatusStatesFollowParticleEdits {
+    Status status;
+    auto particles = std::make_shared<Particles>(makeStates(4));
+    status.particles(particles);
+    XCTAssertEqual(status.states()->at(0).x(), 1.0);
+    
+    // In-place edits through particles() are visible to the next states() call.
+    status.particles()->x()[0] = 5.0;
+    status.particles()->timestamp()[1] = 2000;
+    XCTAssertEqual(status.states()->at(0).x(), 5.0);
+    XCTAssertEqual(status.states()->at(1).timestamp, 2000L);
+    
+    // Copies do not share particles.
+    Status copied(status);
+    copied.particles()->x()[0] = 6.0;
+    XCTAssertEqual(status.states()->at(0).x(), 5.0);
+    XCTAssertEqual(copied.states()->at(0).x(), 6.0);
+}
+
+- (void)testStatusParticlesAdoptStates {
+    Status status;
+    status.states(std::make_shared<States>(makeStates(3)));
+    const Status& constStatus = status;
+    XCTAssertEqual(constStatus.particles()->size(), (size_t)3);
+    
+    status.particles()->x()[2] = 7.0;
+    XCTAssertEqual(status.states()->at(2).x(), 7.0);
+    XCTAssertEqual(constStatus.particles()->x()[2], 7.0);
+}
+
+@end
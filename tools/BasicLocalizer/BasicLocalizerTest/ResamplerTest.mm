@@ -0,0 +1,147 @@
+/*******************************************************************************
+ * Copyright (c) 2014, 2016  IBM Corporation and others
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *******************************************************************************/
+
+
+#import <XCTest/XCTest.h>
+#import <algorithm>
+#import <cmath>
+#import <vector>
+#import "GridResampler.hpp"
+#import "ResidualResampler.hpp"
+#import "Particles.hpp"
+
+using namespace loc;
+using namespace std;
+
+namespace{
+    // Unnormalized weights including zeros
+    vector<double> makeWeights(){
+        return {0.0, 3.0, 0.5, 0.0, 7.25, 1.0, 0.1, 12.0, 0.0, 2.15};
+    }
+    
+    vector<int> countAncestors(const vector<int>& ancestors, size_t n){
+        vector<int> counts(n, 0);
+        for(int a: ancestors){
+            counts.at(a)++;
+        }
+        return counts;
+    }
+}
+
+@interface ResamplerTest : XCTestCase
+
+@end
+
+@implementation ResamplerTest
+
+- (void)testSystematicCountsAreRoundedExpectations {
+    GridResampler<State> resampler(GridResampler<State>::SYSTEMATIC);
+    vector<double> weights = makeWeights();
+    size_t n = weights.size();
+    double sumWeights = 0;
+    for(double w: weights){
+        sumWeights += w;
+    }
+    for(int trial=0; trial<100; trial++){
+        size_t m = 37;
+        vector<int> ancestors;
+        resampler.sampleIndices(weights.data(), n, sumWeights, m, ancestors);
+        XCTAssertEqual(ancestors.size(), m);
+        XCTAssertTrue(std::is_sorted(ancestors.begin(), ancestors.end()));
+        vector<int> counts = countAncestors(ancestors, n);
+        for(size_t i=0; i<n; i++){
+            double expected = m*weights[i]/sumWeights;
+            XCTAssertTrue(std::floor(expected - 1e-9) <= counts[i] && counts[i] <= std::ceil(expected + 1e-9));
+        }
+    }
+}
+
+- (void)testStratifiedNeverSelectsZeroWeights {
+    GridResampler<State> resampler(GridResampler<State>::STRATIFIED);
+    vector<double> weights = makeWeights();
+    size_t n = weights.size();
+    double sumWeights = 0;
+    for(double w: weights){
+        sumWeights += w;
+    }
+    for(int trial=0; trial<100; trial++){
+        vector<int> ancestors;
+        resampler.sampleIndices(weights.data(), n, sumWeights, 50, ancestors);
+        XCTAssertEqual(ancestors.size(), (size_t)50);
+        XCTAssertTrue(std::is_sorted(ancestors.begin(), ancestors.end()));
+        vector<int> counts = countAncestors(ancestors, n);
+        for(size_t i=0; i<n; i++){
+            if(weights[i]==0){
+                XCTAssertEqual(counts[i], 0);
+            }
+            // Each particle spans at most ceil(m*w)+1 strata.
+            XCTAssertTrue(counts[i] <= std::ceil(50*weights[i]/sumWeights) + 1);
+        }
+    }
+}
+
+- (void)testResidualCopiesIntegerParts {
+    ResidualResampler<State> resampler;
+    vector<double> weights = makeWeights();
+    size_t n = weights.size();
+    double sumWeights = 0;
+    for(double w: weights){
+        sumWeights += w;
+    }
+    for(int trial=0; trial<100; trial++){
+        size_t m = 23;
+        vector<int> ancestors;
+        resampler.sampleIndices(weights.data(), n, sumWeights, m, ancestors);
+        XCTAssertEqual(ancestors.size(), m);
+        vector<int> counts = countAncestors(ancestors, n);
+        for(size_t i=0; i<n; i++){
+            double expected = m*weights[i]/sumWeights;
+            // floor(expected) copies plus at most one draw from the residual weight
+            XCTAssertTrue(std::floor(expected) <= counts[i] && counts[i] <= std::floor(expected) + 1);
+        }
+    }
+}
+
+- (void)testSelectAppliesAncestors {
+    vector<double> weights = makeWeights();
+    size_t n = weights.size();
+    Particles particles(n);
+    for(size_t i=0; i<n; i++){
+        particles.x()[i] = i;
+        particles.timestamp()[i] = 100 + i;
+        particles.weight()[i] = weights[i];
+    }
+    GridResampler<State> resampler;
+    vector<int> ancestors;
+    resampler.resample(particles, particles.weight(), particles.sumWeights(), ancestors);
+    XCTAssertEqual(ancestors.size(), n);
+    
+    particles.select(ancestors);
+    XCTAssertEqual(particles.size(), n);
+    for(size_t k=0; k<n; k++){
+        XCTAssertEqual(particles.x()[k], (double)ancestors[k]);
+        XCTAssertEqual(particles.timestamp()[k], 100L + ancestors[k]);
+        XCTAssertTrue(0 < weights[ancestors[k]]);
+    }
+}
+
+@end
@@ -0,0 +1,184 @@
+/*******************************************************************************
+ * Copyright (c) 2014, 2016  IBM Corporation and others
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *******************************************************************************/
+
+
+#import <XCTest/XCTest.h>
+#import <algorithm>
+#import <vector>
+#import "SegmentedBatchLocalizer.hpp"
+#import "Status.hpp"
+
+using namespace loc;
+using namespace std;
+
+namespace{
+    // Reports a prediction at every acceleration with x set to the timestamp in seconds.
+    class EchoLocalizer: public StreamLocalizer{
+    public:
+        Status status;
+        void (*handler)(void*, Status*) = nullptr;
+        void* userData = nullptr;
+        
+        EchoLocalizer& updateHandler(void (*)(Status*)) override { return *this; }
+        EchoLocalizer& updateHandler(void (*functionCalledAfterUpdate)(void*, Status*), void* inUserData) override {
+            handler = functionCalledAfterUpdate;
+            userData = inUserData;
+            return *this;
+        }
+        EchoLocalizer& putAcceleration(const Acceleration acceleration) override {
+            auto states = std::make_shared<States>(1);
+            states->at(0).weight(1.0);
+            states->at(0).x(acceleration.timestamp()/1000.0);
+            status.states(states, Status::PREDICTION);
+            status.timestamp(acceleration.timestamp());
+            if(handler){
+                handler(userData, &status);
+            }
+            return *this;
+        }
+        EchoLocalizer& putAttitude(const Attitude) override { return *this; }
+        EchoLocalizer& putBeacons(const Beacons) override { return *this; }
+        EchoLocalizer& putLocalHeading(const LocalHeading) override { return *this; }
+        EchoLocalizer& putAltimeter(const Altimeter) override { return *this; }
+        Status* getStatus() override { return &status; }
+        bool resetStatus() override { return true; }
+        bool resetStatus(Pose) override { return true; }
+        bool resetStatus(Pose, Pose) override { return true; }
+        bool resetStatus(Pose, Pose, double) override { return true; }
+        bool resetStatus(const Beacons&) override { return true; }
+        bool resetStatus(const Location&, const Beacons&) override { return true; }
+    };
+    
+    SegmentedBatchLocalizer::Factory echoFactory(){
+        return [](){ return std::make_shared<EchoLocalizer>(); };
+    }
+    
+    // Accelerations every 100 ms, still in [stillStart, stillEnd) and walking otherwise,
+    // and beacons every second except in [gapStart, gapEnd).
+    vector<SensorEvent> makeLog(long end, long stillStart, long stillEnd, long gapStart, long gapEnd){
+        vector<SensorEvent> events;
+        for(long t=0; t<end; t+=100){
+            bool still = stillStart <= t && t < stillEnd;
+            events.push_back(SensorEvent(Acceleration(t, 0, 0, still ? 1.0 : 1.0 + 0.1*((t/100)%2))));
+            if(t%1000==0 && (t < gapStart || gapEnd <= t)){
+                Beacons beacons;
+                beacons.push_back(Beacon(1, 1, -70));
+                beacons.timestamp(t);
+                events.push_back(SensorEvent(beacons));
+            }
+        }
+        return events;
+    }
+    
+    void assertContiguous(const vector<SegmentedBatchLocalizer::Segment>& segments, const vector<SensorEvent>& events){
+        XCTAssertFalse(segments.empty());
+        XCTAssertEqual(segments.front().start, events.front().timestamp);
+        XCTAssertEqual(segments.back().end, events.back().timestamp + 1);
+        for(size_t i=0; i<segments.size(); i++){
+            XCTAssertLessThanOrEqual(segments[i].warmUpStart, segments[i].start);
+            XCTAssertLessThan(segments[i].start, segments[i].end);
+            if(0<i){
+                XCTAssertEqual(segments[i-1].end, segments[i].start);
+            }
+        }
+    }
+}
+
+@interface SegmentedBatchLocalizerTest : XCTestCase
+
+@end
+
+@implementation SegmentedBatchLocalizerTest
+
+- (void)testSplitAtBeaconGap {
+    auto events = makeLog(250000, -1, -1, 100001, 130000);
+    SegmentedBatchLocalizer localizer(echoFactory());
+    auto segments = localizer.split(events);
+    XCTAssertEqual(segments.size(), (size_t)2);
+    assertContiguous(segments, events);
+    XCTAssertTrue(segments[0].reason=="begin");
+    XCTAssertTrue(segments[1].reason=="beacon_gap");
+    XCTAssertEqual(segments[1].start, 130000L);
+    // Warm-up is taken before the gap, not inside it
+    XCTAssertEqual(segments[1].warmUpStart, 100000L - 15000L);
+}
+
+- (void)testSplitAtStationaryPeriod {
+    auto events = makeLog(250000, 100000, 120000, -1, -1);
+    SegmentedBatchLocalizer localizer(echoFactory());
+    auto segments = localizer.split(events);
+    XCTAssertEqual(segments.size(), (size_t)2);
+    assertContiguous(segments, events);
+    XCTAssertTrue(segments[1].reason=="stationary");
+    XCTAssertEqual(segments[1].start, 110000L);
+    XCTAssertEqual(segments[1].warmUpStart, 110000L - 15000L);
+}
+
+- (void)testShortSegmentsAreNotSplit {
+    // Both split points are closer than minSegmentDuration to an end of the log
+    auto events = makeLog(250000, 10000, 30000, 200001, 230000);
+    SegmentedBatchLocalizer localizer(echoFactory());
+    auto segments = localizer.split(events);
+    XCTAssertEqual(segments.size(), (size_t)1);
+    assertContiguous(segments, events);
+    
+    SegmentedBatchLocalizerParameters params;
+    params.maxBeaconGap = 0;
+    params.minStationaryDuration = 0;
+    SegmentedBatchLocalizer disabled(echoFactory(), params);
+    XCTAssertEqual(disabled.split(makeLog(250000, 100000, 120000, 100001, 130000)).size(), (size_t)1);
+    XCTAssertTrue(disabled.split(vector<SensorEvent>()).empty());
+}
+
+- (void)testLocalizeStitchesSegmentsWithoutOverlap {
+    auto events = makeLog(300000, 180000, 200000, 60001, 90000);
+    SegmentedBatchLocalizerParameters params;
+    params.nThreads = 3;
+    SegmentedBatchLocalizer localizer(echoFactory(), params);
+    // Shuffled input is sorted by localize
+    std::reverse(events.begin(), events.end());
+    auto trajectory = localizer.localize(events);
+    const auto& segments = localizer.segments();
+    XCTAssertEqual(segments.size(), (size_t)3);
+    
+    // Every acceleration is reported exactly once, by the segment covering its timestamp
+    XCTAssertEqual(trajectory.size(), (size_t)3000);
+    for(size_t i=0; i<trajectory.size(); i++){
+        const auto& p = trajectory[i];
+        XCTAssertEqual(p.timestamp, (long)i*100);
+        XCTAssertEqual(p.pose.x(), p.timestamp/1000.0);
+        const auto& s = segments[p.segment];
+        XCTAssertTrue(s.start <= p.timestamp && p.timestamp < s.end);
+    }
+    // Later segments are fed their warm-up inputs too
+    for(size_t i=1; i<segments.size(); i++){
+        XCTAssertLessThan(segments[i].warmUpStart, segments[i].start);
+        XCTAssertEqual(segments[i].nFailedEvents, (size_t)0);
+        size_t nInputs = 0;
+        for(const auto& e: events){
+            nInputs += segments[i].warmUpStart <= e.timestamp && e.timestamp < segments[i].end;
+        }
+        XCTAssertEqual(segments[i].nEvents, nInputs);
+    }
+}
+
+@end
@@ -0,0 +1,150 @@
+/*******************************************************************************
+ * Copyright (c) 2014, 2016  IBM Corporation and others
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *******************************************************************************/
+
+
+#import <XCTest/XCTest.h>
+#import <random>
+#import "SystemModelInBuilding.hpp"
+#import "RandomWalker.hpp"
+
+using namespace loc;
+using namespace std;
+
+namespace{
+    using Model = SystemModelInBuilding<State, SystemModelInput>;
+    
+    // Counts the batches of predictions
+    class CountingRandomWalker : public RandomWalker<State, SystemModelInput>{
+    public:
+        int nStarts = 0;
+        int nEnds = 0;
+        void startPredictions(const std::vector<State>& states, const SystemModelInput& input) override{
+            nStarts++;
+        }
+        void endPredictions(const std::vector<State>& states, const SystemModelInput& input) override{
+            nEnds++;
+        }
+    };
+    
+    // A floor of 100 x 100 [m] surrounded by walls. The origin is at the center.
+    Building::Ptr makeBuilding(){
+        const int size = 200;
+        auto labels = std::make_shared<std::vector<uint8_t>>(size*size, ImageHolder::labelOf(color::white));
+        for(int i=0; i<size; i++){
+            uint8_t wall = ImageHolder::labelOf(color::black);
+            (*labels)[i] = (*labels)[(size-1)*size + i] = wall;
+            (*labels)[i*size] = (*labels)[i*size + size-1] = wall;
+        }
+        ImageHolder image(size, size, labels->data(), labels, "0");
+        BuildingBuilder builder;
+        builder.addFloorCoordinateSystemParametersAndImage(0, CoordinateSystemParameters(2, 2, 1, 100, 100, 0), image);
+        return std::make_shared<Building>(builder.build());
+    }
+    
+    Model::Ptr makeModel(SystemModel<State, SystemModelInput>::Ptr walker, int nThreads){
+        auto model = std::make_shared<Model>(walker, makeBuilding(), std::make_shared<SystemModelInBuildingProperty>());
+        model->numThreads(nThreads).partitionSize(64);
+        return model;
+    }
+    
+    SystemModel<State, SystemModelInput>::Ptr makeWalker(){
+        auto walker = std::make_shared<RandomWalker<State, SystemModelInput>>();
+        RandomWalkerProperty property;
+        property.sigma = 1.0;
+        walker->setProperty(property);
+        return walker;
+    }
+    
+    Particles makeParticles(size_t n){
+        std::mt19937 engine(7);
+        std::uniform_real_distribution<double> uniform(-40.0, 40.0);
+        Particles particles(n);
+        for(size_t i=0; i<n; i++){
+            State state;
+            state.x(uniform(engine)).y(uniform(engine)).z(0).floor(0);
+            state.weight(1.0/n);
+            particles.state(i, state);
+        }
+        return particles;
+    }
+    
+    SystemModelInput makeInput(long timestamp){
+        SystemModelInput input;
+        input.previousTimestamp(timestamp-1000);
+        input.timestamp(timestamp);
+        return input;
+    }
+}
+
+@interface SystemModelInBuildingTest : XCTestCase
+
+@end
+
+@implementation SystemModelInBuildingTest
+
+- (void)testPredictionsDoNotDependOnTheNumberOfThreads {
+    auto serial = makeModel(makeWalker(), 1);
+    auto parallel = makeModel(makeWalker(), 4);
+    Particles particlesSerial = makeParticles(1000);
+    Particles particlesParallel = makeParticles(1000);
+    for(long t=1000; t<=5000; t+=1000){
+        serial->predict(particlesSerial, makeInput(t));
+        parallel->predict(particlesParallel, makeInput(t));
+    }
+    for(size_t i=0; i<particlesSerial.size(); i++){
+        XCTAssertEqual(particlesSerial.x()[i], particlesParallel.x()[i]);
+        XCTAssertEqual(particlesSerial.y()[i], particlesParallel.y()[i]);
+        XCTAssertEqual(particlesSerial.weight()[i], particlesParallel.weight()[i]);
+    }
+    
+    std::vector<State> states;
+    for(size_t i=0; i<300; i++){
+        states.push_back(particlesSerial.state(i));
+    }
+    std::vector<State> statesSerial = serial->predict(states, makeInput(6000));
+    std::vector<State> statesParallel = parallel->predict(states, makeInput(6000));
+    XCTAssertEqual(statesSerial.size(), states.size());
+    for(size_t i=0; i<states.size(); i++){
+        XCTAssertEqual(statesSerial[i].x(), statesParallel[i].x());
+        XCTAssertEqual(statesSerial[i].y(), statesParallel[i].y());
+    }
+}
+
+- (void)testBatchesStartAndEndPredictions {
+    for(int nThreads: {1, 4}){
+        auto walker = std::make_shared<CountingRandomWalker>();
+        auto model = makeModel(walker, nThreads);
+        Particles particles = makeParticles(500);
+        model->predict(particles, makeInput(1000));
+        XCTAssertEqual(walker->nStarts, 1);
+        XCTAssertEqual(walker->nEnds, 1);
+        model->predict(std::vector<State>{particles.state(0), particles.state(1)}, makeInput(2000));
+        XCTAssertEqual(walker->nStarts, 2);
+        XCTAssertEqual(walker->nEnds, 2);
+        // A single prediction does not start a batch which is never ended.
+        model->predict(particles.state(0), makeInput(3000));
+        XCTAssertEqual(walker->nStarts, 2);
+        XCTAssertEqual(walker->nEnds, 2);
+    }
+}
+
+@end
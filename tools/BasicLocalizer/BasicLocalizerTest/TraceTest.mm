@@ -0,0 +1,224 @@
+/*******************************************************************************
+ * Copyright (c) 2014, 2016  IBM Corporation and others
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *******************************************************************************/
+
+
+
+#import <XCTest/XCTest.h>
+#import <cstring>
+#import <fstream>
+#import "TraceWriter.hpp"
+#import "TraceReader.hpp"
+#import "LocException.hpp"
+
+using namespace loc;
+using namespace std;
+
+@interface TraceTest : XCTestCase
+
+@end
+
+@implementation TraceTest
+
+static std::string tracePath(const std::string& name){
+    return std::string([NSTemporaryDirectory() UTF8String]) + "/" + name;
+}
+
+static Particles makeParticles(size_t n){
+    Particles particles(n);
+    for(size_t i=0; i<n; i++){
+        particles.x()[i] = 1.0+i;
+        particles.y()[i] = 2.0+i;
+        particles.floor()[i] = i%2;
+        particles.orientation()[i] = 0.1*i;
+        particles.rssiBias()[i] = -0.5*i;
+        particles.weight()[i] = 1.0/n;
+        particles.mahalanobisDistance()[i] = 3.0+i;
+        particles.timestamp()[i] = 1000+i;
+    }
+    return particles;
+}
+
+// Writes the magic and one record with the given payload.
+static void writeRecord(const std::string& path, uint32_t type, const std::vector<char>& payload){
+    std::ofstream ofs(path, std::ios::binary);
+    ofs.write(TraceWriter::magic, sizeof(TraceWriter::magic));
+    uint32_t header[2] = {type, static_cast<uint32_t>(payload.size())};
+    ofs.write(reinterpret_cast<const char*>(header), sizeof(header));
+    ofs.write(payload.data(), payload.size());
+}
+
+template<class T>
+static void append(std::vector<char>& payload, T value){
+    const char* p = reinterpret_cast<const char*>(&value);
+    payload.insert(payload.end(), p, p+sizeof(T));
+}
+
+- (void)testRoundTrip {
+    std::string path = tracePath("TraceTest_roundTrip.bin");
+    Particles particles = makeParticles(7);
+    
+    SensorEvent event;
+    event.type = SensorEvent::BEACONS;
+    event.timestamp = 2000;
+    event.values[0] = 0.25;
+    event.beacons.push_back(Beacon("00000000-0000-0000-0000-000000000001", 1, 2, -70.5));
+    event.beacons.push_back(Beacon("00000000-0000-0000-0000-000000000002", 3, 4, -85.0));
+    
+    Status status;
+    auto statusParticles = std::make_shared<Particles>(1);
+    statusParticles->x()[0] = 10;
+    statusParticles->y()[0] = 20;
+    statusParticles->floor()[0] = 1;
+    statusParticles->velocity()[0] = 1.2;
+    statusParticles->weight()[0] = 1.0;
+    status.particles(statusParticles, Status::FILTERING_WITH_RESAMPLING);
+    status.timestamp(3000).locationStatus(Status::STABLE);
+    auto meanPose = status.meanPose();
+    {
+        TraceWriterParameters params;
+        params.blocksWhenFull = true;
+        TraceWriter writer(path, params);
+        writer.writeParticles(TraceWriter::AFTER_LIKELIHOOD, 1500, particles);
+        writer.writeInput(event);
+        writer.writeStatus(status);
+        writer.flush();
+        XCTAssertEqual(writer.droppedRecords(), (size_t)0);
+    }
+    
+    TraceReader reader(path);
+    TraceReader::Record record;
+    
+    XCTAssertTrue(reader.next(record));
+    XCTAssertEqual(record.type, TraceWriter::PARTICLES);
+    XCTAssertEqual(record.stage, TraceWriter::AFTER_LIKELIHOOD);
+    XCTAssertEqual(record.timestamp, 1500L);
+    XCTAssertEqual(record.particles.size(), particles.size());
+    for(size_t i=0; i<particles.size(); i++){
+        State expected = particles.state(i);
+        State actual = record.particles.state(i);
+        XCTAssertEqual(actual.x(), expected.x());
+        XCTAssertEqual(actual.y(), expected.y());
+        XCTAssertEqual(actual.floor(), expected.floor());
+        XCTAssertEqual(actual.orientation(), expected.orientation());
+        XCTAssertEqual(actual.rssiBias(), expected.rssiBias());
+        XCTAssertEqual(actual.weight(), expected.weight());
+        XCTAssertEqual(actual.mahalanobisDistance(), expected.mahalanobisDistance());
+        XCTAssertEqual(actual.timestamp, expected.timestamp);
+    }
+    
+    XCTAssertTrue(reader.next(record));
+    XCTAssertEqual(record.type, TraceWriter::INPUT);
+    XCTAssertEqual(record.input.type, SensorEvent::BEACONS);
+    XCTAssertEqual(record.input.timestamp, 2000L);
+    XCTAssertEqual(record.input.values[0], 0.25);
+    XCTAssertEqual(record.input.beacons.size(), (size_t)2);
+    for(size_t i=0; i<event.beacons.size(); i++){
+        XCTAssertTrue(record.input.beacons[i].uuid()==event.beacons[i].uuid());
+        XCTAssertEqual(record.input.beacons[i].major(), event.beacons[i].major());
+        XCTAssertEqual(record.input.beacons[i].minor(), event.beacons[i].minor());
+        XCTAssertEqual(record.input.beacons[i].rssi(), event.beacons[i].rssi());
+    }
+    
+    XCTAssertTrue(reader.next(record));
+    XCTAssertEqual(record.type, TraceWriter::STATUS);
+    XCTAssertEqual(record.timestamp, 3000L);
+    XCTAssertEqual(record.step, Status::FILTERING_WITH_RESAMPLING);
+    XCTAssertEqual(record.locationStatus, Status::STABLE);
+    XCTAssertEqual(record.meanPose.x(), meanPose->x());
+    XCTAssertEqual(record.meanPose.y(), meanPose->y());
+    XCTAssertEqual(record.meanPose.floor(), meanPose->floor());
+    XCTAssertEqual(record.meanPose.velocity(), meanPose->velocity());
+    
+    XCTAssertFalse(reader.next(record));
+}
+
+- (void)testTruncatedRecordEndsTrace {
+    std::string path = tracePath("TraceTest_truncated.bin");
+    {
+        TraceWriter writer(path);
+        writer.writeParticles(TraceWriter::RESAMPLED, 100, makeParticles(3));
+        writer.flush();
+    }
+    // Drop the last byte of the record.
+    std::ifstream ifs(path, std::ios::binary);
+    std::vector<char> bytes((std::istreambuf_iterator<char>(ifs)), std::istreambuf_iterator<char>());
+    ifs.close();
+    std::ofstream ofs(path, std::ios::binary);
+    ofs.write(bytes.data(), bytes.size()-1);
+    ofs.close();
+    
+    TraceReader reader(path);
+    TraceReader::Record record;
+    XCTAssertFalse(reader.next(record));
+}
+
+- (void)testParticleCountBeyondPayloadThrows {
+    std::string path = tracePath("TraceTest_particles.bin");
+    std::vector<char> payload;
+    append<int64_t>(payload, 100);
+    append<uint32_t>(payload, TraceWriter::RESAMPLED);
+    append<uint32_t>(payload, 1000000);
+    append<double>(payload, 1.0);
+    writeRecord(path, TraceWriter::PARTICLES, payload);
+    
+    TraceReader reader(path);
+    TraceReader::Record record;
+    XCTAssertThrows(reader.next(record));
+}
+
+- (void)testBeaconCountBeyondPayloadThrows {
+    std::string path = tracePath("TraceTest_beacons.bin");
+    std::vector<char> payload;
+    append<uint32_t>(payload, SensorEvent::BEACONS);
+    append<int64_t>(payload, 100);
+    for(int i=0; i<3; i++){
+        append<double>(payload, 0.0);
+    }
+    append<uint32_t>(payload, 1000);
+    writeRecord(path, TraceWriter::INPUT, payload);
+    
+    TraceReader reader(path);
+    TraceReader::Record record;
+    XCTAssertThrows(reader.next(record));
+}
+
+- (void)testUuidLengthBeyondPayloadThrows {
+    std::string path = tracePath("TraceTest_uuid.bin");
+    std::vector<char> payload;
+    append<uint32_t>(payload, SensorEvent::BEACONS);
+    append<int64_t>(payload, 100);
+    for(int i=0; i<3; i++){
+        append<double>(payload, 0.0);
+    }
+    append<uint32_t>(payload, 1);
+    append<uint32_t>(payload, 0xFFFFFF00);
+    append<int32_t>(payload, 1);
+    append<int32_t>(payload, 2);
+    append<double>(payload, -70.0);
+    writeRecord(path, TraceWriter::INPUT, payload);
+    
+    TraceReader reader(path);
+    TraceReader::Record record;
+    XCTAssertThrows(reader.next(record));
+}
+
+@end
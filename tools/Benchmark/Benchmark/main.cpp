@@ -0,0 +1,518 @@
+/*******************************************************************************
+ * Copyright (c) 2014, 2016  IBM Corporation and others
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *******************************************************************************/
+
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+#include <numeric>
+#include <algorithm>
+#include <functional>
+#include <map>
+#include <random>
+#include <getopt.h>
+
+#include "bleloc.h"
+#include "Building.hpp"
+#include "DataStoreImpl.hpp"
+#include "DataUtils.hpp"
+#include "GaussianProcess.hpp"
+#include "GaussianProcessLDPLMultiModel.hpp"
+#include "GridResampler.hpp"
+#include "MetropolisSampler.hpp"
+#include "Particles.hpp"
+#include "RandomWalker.hpp"
+#include "StatusInitializerImpl.hpp"
+#include "SystemModelInBuilding.hpp"
+
+using namespace loc;
+
+// Micro-benchmarks of the localization hot paths on a synthetic venue.
+// Results are written as csv (or json with --json), one row per benchmark and parameter set.
+
+typedef struct {
+    std::vector<int> particles{100, 1000, 10000};
+    std::vector<int> beacons{20, 100};
+    std::vector<int> samples{100, 400};
+    double minTime = 0.5; // [s] per measurement
+    int minIterations = 3;
+    int maxIterations = 10000;
+    std::string filter = "";
+    std::string outputPath = "";
+    bool json = false;
+    unsigned seed = 1;
+} Option;
+
+void printHelp() {
+    std::cout << "Options for Benchmark" << std::endl;
+    std::cout << " -h                  show this help" << std::endl;
+    std::cout << " --particles <list>  set particle counts (default 100,1000,10000)" << std::endl;
+    std::cout << " --beacons <list>    set beacon counts (default 20,100)" << std::endl;
+    std::cout << " --samples <list>    set training set sizes (default 100,400)" << std::endl;
+    std::cout << " --minTime <double>  set minimum time [s] of each measurement (default 0.5)" << std::endl;
+    std::cout << " --minIterations <int>  set minimum iterations of each measurement (default 3)" << std::endl;
+    std::cout << " --filter <string>   run only benchmarks whose name contains the string" << std::endl;
+    std::cout << " --json              write json instead of csv" << std::endl;
+    std::cout << " --seed <int>        set random seed of the synthetic venue" << std::endl;
+    std::cout << " -o output           set output file (default stdout)" << std::endl;
+}
+
+std::vector<int> parseList(const std::string& str){
+    std::vector<int> values;
+    std::stringstream ss(str);
+    std::string item;
+    while(getline(ss, item, ',')){
+        values.push_back(std::stoi(item));
+    }
+    return values;
+}
+
+Option parseArguments(int argc, char *argv[]){
+    Option opt;
+    int c = 0;
+    int option_index = 0;
+    struct option long_options[] = {
+        {"particles",     required_argument, NULL,  0 },
+        {"beacons",       required_argument, NULL,  0 },
+        {"samples",       required_argument, NULL,  0 },
+        {"minTime",       required_argument, NULL,  0 },
+        {"minIterations", required_argument, NULL,  0 },
+        {"filter",        required_argument, NULL,  0 },
+        {"json",          no_argument,       NULL,  0 },
+        {"seed",          required_argument, NULL,  0 },
+        {0,         0,                 0,  0 }
+    };
+    while ((c = getopt_long(argc, argv, "ho:", long_options, &option_index )) != -1){
+        switch(c){
+            case 0:
+                if (strcmp(long_options[option_index].name, "particles") == 0){
+                    opt.particles = parseList(optarg);
+                }
+                if (strcmp(long_options[option_index].name, "beacons") == 0){
+                    opt.beacons = parseList(optarg);
+                }
+                if (strcmp(long_options[option_index].name, "samples") == 0){
+                    opt.samples = parseList(optarg);
+                }
+                if (strcmp(long_options[option_index].name, "minTime") == 0){
+                    opt.minTime = atof(optarg);
+                }
+                if (strcmp(long_options[option_index].name, "minIterations") == 0){
+                    opt.minIterations = atoi(optarg);
+                }
+                if (strcmp(long_options[option_index].name, "filter") == 0){
+                    opt.filter.assign(optarg);
+                }
+                if (strcmp(long_options[option_index].name, "json") == 0){
+                    opt.json = true;
+                }
+                if (strcmp(long_options[option_index].name, "seed") == 0){
+                    opt.seed = atoi(optarg);
+                }
+                break;
+            case 'h':
+                printHelp();
+                exit(0);
+            case 'o':
+                opt.outputPath.assign(optarg);
+                break;
+            default:
+                printHelp();
+                exit(1);
+        }
+    }
+    return opt;
+}
+
+// Two floors of 200m x 100m with corridors, rooms, stairs and an elevator (1 pixel = 1 m).
+class SyntheticVenue{
+public:
+    static const int width = 200;
+    static const int height = 100;
+    static const int nFloors = 2;
+    
+    Building::Ptr building;
+    BLEBeacons bleBeacons;
+    Samples samples;
+    std::shared_ptr<DataStoreImpl> dataStore;
+    std::shared_ptr<GaussianProcessLDPLMultiModel<State, Beacons>> model;
+    
+    SyntheticVenue(int nBeacons, int nSamples, unsigned seed) : engine(seed){
+        buildBuilding();
+        for(int i=0; i<nBeacons; i++){
+            Location loc = randomMovableLocation(i%nFloors);
+            bleBeacons.push_back(BLEBeacon(uuid, 1, i, loc.x(), loc.y(), 0, loc.floor()));
+        }
+        for(int i=0; i<nSamples; i++){
+            Sample sample;
+            sample.location(randomMovableLocation(i%nFloors))->timestamp(i*1000);
+            sample.beacons(observe(sample.location(), i*1000));
+            samples.push_back(sample);
+        }
+        dataStore = std::make_shared<DataStoreImpl>();
+        dataStore->samples(samples).bleBeacons(bleBeacons).building(*building);
+    }
+    
+    GaussianProcessLDPLMultiModel<State, Beacons>& trainModel(){
+        if(!model){
+            GaussianProcessLDPLMultiModelTrainer<State, Beacons> trainer;
+            trainer.dataStore(dataStore);
+            model.reset(trainer.train());
+        }
+        return *model;
+    }
+    
+    Location randomMovableLocation(int floor){
+        std::uniform_real_distribution<double> ux(0, width), uy(0, height);
+        while(true){
+            Location loc(ux(engine), uy(engine), 0, floor);
+            if(building->isMovable(loc)){
+                return loc;
+            }
+        }
+    }
+    
+    States randomStates(int n){
+        States states;
+        states.reserve(n);
+        for(int i=0; i<n; i++){
+            State s(randomMovableLocation(i%nFloors));
+            s.orientation(std::uniform_real_distribution<double>(-M_PI, M_PI)(engine));
+            s.velocity(1.0);
+            s.weight(1.0/n);
+            states.push_back(s);
+        }
+        return states;
+    }
+    
+    // Log-distance path loss with noise. Beacons on other floors and weak signals are not observed.
+    Beacons observe(const Location& loc, long timestamp){
+        std::normal_distribution<double> noise(0, 4.0);
+        Beacons beacons;
+        beacons.timestamp(timestamp);
+        for(const auto& b: bleBeacons){
+            if(b.floor()!=loc.floor()){
+                continue;
+            }
+            double d = std::max(Location::distance2D(loc, b), 1.0);
+            double rssi = -50 - 20*std::log10(d) + noise(engine);
+            if(-95 < rssi){
+                beacons.push_back(Beacon(b.id(), std::min(rssi, -1.0)));
+            }
+        }
+        return beacons;
+    }
+    
+    std::mt19937& randomEngine(){
+        return engine;
+    }
+    
+private:
+    const std::string uuid = "00000000-0000-0000-0000-000000000000";
+    std::mt19937 engine;
+    std::vector<std::shared_ptr<std::vector<uint8_t>>> rasters;
+    
+    void buildBuilding(){
+        const uint8_t floorLabel = ImageHolder::labelOf(color::white);
+        const uint8_t wallLabel = ImageHolder::labelOf(color::black);
+        const uint8_t stairsLabel = ImageHolder::labelOf(color::blue);
+        const uint8_t elevatorLabel = ImageHolder::labelOf(color::yellow);
+        BuildingBuilder builder;
+        for(int f=0; f<nFloors; f++){
+            auto raster = std::make_shared<std::vector<uint8_t>>(width*height, floorLabel);
+            auto set = [&](int x, int y, uint8_t label){ (*raster)[y*width + x] = label; };
+            for(int x=0; x<width; x++){
+                for(int y=0; y<height; y++){
+                    bool border = x==0 || y==0 || x==width-1 || y==height-1;
+                    // Rooms of 20m x 40m along a corridor at 45m <= y < 55m, with doors
+                    bool roomWall = (y==45 || y==55 || (x%20==0 && (y<45 || 55<y))) && !(x%20==10 && (y==45 || y==55));
+                    if(border || roomWall){
+                        set(x, y, wallLabel);
+                    }
+                }
+            }
+            for(int x=5; x<10; x++){
+                for(int y=47; y<53; y++){
+                    set(x, y, stairsLabel);
+                    set(x+185, y, elevatorLabel);
+                }
+            }
+            rasters.push_back(raster);
+            ImageHolder image(height, width, raster->data(), raster, "floor" + std::to_string(f));
+            builder.addFloorCoordinateSystemParametersAndImage(f, CoordinateSystemParameters(1, 1, 1, 0, 0, 0), image);
+        }
+        building = std::make_shared<Building>(builder.build());
+    }
+};
+
+class Measurement{
+public:
+    std::string name;
+    int particles = 0;
+    int beacons = 0;
+    int samples = 0;
+    size_t items = 0; // items processed per iteration
+    std::vector<double> times; // [s]
+    
+    double percentile(double p) const{
+        std::vector<double> sorted(times);
+        std::sort(sorted.begin(), sorted.end());
+        size_t rank = std::max(static_cast<size_t>(std::ceil(p*sorted.size())), (size_t)1);
+        return sorted.at(std::min(rank, sorted.size()) - 1);
+    }
+    
+    double mean() const{
+        return std::accumulate(times.begin(), times.end(), 0.0)/times.size();
+    }
+};
+
+class BenchmarkRunner{
+public:
+    BenchmarkRunner(const Option& opt) : mOpt(opt){}
+    
+    bool enabled(const std::string& name) const{
+        return mOpt.filter.empty() || name.find(mOpt.filter)!=std::string::npos;
+    }
+    
+    // Calls setup once and then iteration repeatedly. Only iteration is timed.
+    void run(const std::string& name, int particles, int beacons, int samples, size_t items, const std::function<void()>& iteration){
+        Measurement m;
+        m.name = name;
+        m.particles = particles;
+        m.beacons = beacons;
+        m.samples = samples;
+        m.items = items;
+        iteration(); // warm up
+        double total = 0;
+        while((total < mOpt.minTime || (int) m.times.size() < mOpt.minIterations) && (int) m.times.size() < mOpt.maxIterations){
+            auto s = std::chrono::steady_clock::now();
+            iteration();
+            double t = std::chrono::duration<double>(std::chrono::steady_clock::now() - s).count();
+            m.times.push_back(t);
+            total += t;
+        }
+        std::cerr << name << " particles=" << particles << " beacons=" << beacons << " samples=" << samples
+        << " median=" << m.percentile(0.5)*1e6 << "us" << std::endl;
+        mMeasurements.push_back(m);
+    }
+    
+    void write(std::ostream& os) const{
+        if(mOpt.json){
+            os << "[" << std::endl;
+            for(size_t i=0; i<mMeasurements.size(); i++){
+                const auto& m = mMeasurements[i];
+                os << "  {\"name\":\"" << m.name << "\",\"particles\":" << m.particles << ",\"beacons\":" << m.beacons
+                << ",\"samples\":" << m.samples << ",\"iterations\":" << m.times.size()
+                << ",\"mean_us\":" << m.mean()*1e6 << ",\"median_us\":" << m.percentile(0.5)*1e6
+                << ",\"p95_us\":" << m.percentile(0.95)*1e6 << ",\"min_us\":" << m.percentile(0)*1e6
+                << ",\"items_per_sec\":" << m.items/m.percentile(0.5) << "}" << (i+1<mMeasurements.size() ? "," : "") << std::endl;
+            }
+            os << "]" << std::endl;
+        }else{
+            os << "name,particles,beacons,samples,iterations,mean_us,median_us,p95_us,min_us,items_per_sec" << std::endl;
+            for(const auto& m: mMeasurements){
+                os << m.name << "," << m.particles << "," << m.beacons << "," << m.samples << "," << m.times.size()
+                << "," << m.mean()*1e6 << "," << m.percentile(0.5)*1e6 << "," << m.percentile(0.95)*1e6
+                << "," << m.percentile(0)*1e6 << "," << m.items/m.percentile(0.5) << std::endl;
+            }
+        }
+    }
+    
+private:
+    const Option& mOpt;
+    std::vector<Measurement> mMeasurements;
+};
+
+int main(int argc, char * argv[]) {
+    Option opt = parseArguments(argc, argv);
+    BenchmarkRunner runner(opt);
+    
+    // Venues are shared by benchmarks with the same beacon count and training set size.
+    std::map<std::pair<int, int>, std::shared_ptr<SyntheticVenue>> venues;
+    auto venueOf = [&](int nBeacons, int nSamples){
+        auto key = std::make_pair(nBeacons, nSamples);
+        if(venues.count(key)==0){
+            venues[key] = std::make_shared<SyntheticVenue>(nBeacons, nSamples, opt.seed);
+        }
+        return venues[key];
+    };
+    const int nBeacons0 = opt.beacons.front();
+    const int nSamples0 = opt.samples.front();
+    
+    for(int nSamples: opt.samples){
+        for(int nBeacons: opt.beacons){
+            auto venue = venueOf(nBeacons, nSamples);
+            for(int n: opt.particles){
+                // Observation model likelihood
+                if(runner.enabled("likelihood")){
+                    auto& model = venue->trainModel();
+                    Particles particles(venue->randomStates(n));
+                    Beacons beacons = venue->observe(particles.location(0), 0);
+                    std::vector<std::vector<double>> values;
+                    runner.run("likelihood", n, nBeacons, nSamples, n, [&](){
+                        model.computeLogLikelihoodRelatedValues(particles, beacons, values);
+                    });
+                }
+                // Gaussian process prediction of all beacons at particle locations
+                if(runner.enabled("gp_predict")){
+                    Eigen::MatrixXd X(nSamples, 4), Y(nSamples, nBeacons);
+                    std::normal_distribution<double> noise(0, 3.0);
+                    for(int i=0; i<nSamples; i++){
+                        Location loc = venue->samples.at(i).location();
+                        X.row(i) << loc.x(), loc.y(), loc.z(), loc.floor();
+                        for(int j=0; j<nBeacons; j++){
+                            Y(i, j) = noise(venue->randomEngine());
+                        }
+                    }
+                    GaussianProcess gp;
+                    gp.fit(X, Y);
+                    States states = venue->randomStates(n);
+                    std::vector<double> xs;
+                    for(const auto& s: states){
+                        xs.insert(xs.end(), {s.x(), s.y(), s.z(), s.floor()});
+                    }
+                    std::vector<int> indices(nBeacons);
+                    std::iota(indices.begin(), indices.end(), 0);
+                    std::vector<double> ypreds(n*nBeacons);
+                    runner.run("gp_predict", n, nBeacons, nSamples, n, [&](){
+                        gp.predict(xs.data(), n, indices, ypreds.data());
+                    });
+                }
+                // Metropolis sampling of n states
+                if(runner.enabled("metropolis_sampling")){
+                    venue->trainModel();
+                    auto initializer = std::make_shared<StatusInitializerImpl>();
+                    initializer->dataStore(venue->dataStore);
+                    MetropolisSampler<State, Beacons> sampler;
+                    MetropolisSampler<State, Beacons>::Parameters params;
+                    params.burnIn = n;
+                    sampler.parameters(params);
+                    sampler.observationModel(venue->model);
+                    sampler.statusInitializer(initializer);
+                    Beacons beacons = venue->observe(venue->randomMovableLocation(0), 0);
+                    runner.run("metropolis_sampling", n, nBeacons, nSamples, n, [&](){
+                        sampler.input(beacons);
+                        sampler.startBurnIn();
+                        sampler.sampling(n);
+                    });
+                }
+            }
+        }
+    }
+    
+    // Benchmarks independent of beacons and training samples
+    auto venue = venueOf(nBeacons0, nSamples0);
+    for(int n: opt.particles){
+        if(runner.enabled("system_model_in_building")){
+            RandomWalkerProperty::Ptr rwProperty(new RandomWalkerProperty);
+            rwProperty->sigma = 0.25;
+            std::shared_ptr<RandomWalker<State, SystemModelInput>> randomWalker(new RandomWalker<State, SystemModelInput>());
+            randomWalker->setProperty(rwProperty);
+            SystemModelInBuildingProperty::Ptr property(new SystemModelInBuildingProperty);
+            SystemModelInBuilding<State, SystemModelInput> sysModel(randomWalker, venue->building, property);
+            Particles particles(venue->randomStates(n));
+            long timestamp = 0;
+            runner.run("system_model_in_building", n, 0, 0, n, [&](){
+                SystemModelInput input;
+                input.previousTimestamp(timestamp);
+                timestamp += 1000;
+                input.timestamp(timestamp);
+                sysModel.predict(particles, input);
+            });
+        }
+        if(runner.enabled("grid_resampler")){
+            Particles particles(venue->randomStates(n));
+            std::vector<double> weights(n);
+            std::exponential_distribution<double> expo(1.0);
+            for(auto& w: weights){
+                w = expo(venue->randomEngine());
+            }
+            double sumWeights = std::accumulate(weights.begin(), weights.end(), 0.0);
+            GridResampler<State> resampler;
+            std::vector<int> ancestors;
+            runner.run("grid_resampler", n, 0, 0, n, [&](){
+                resampler.resample(particles, weights.data(), sumWeights, ancestors);
+            });
+        }
+        if(runner.enabled("wall_crossing_ratio")){
+            const FloorMap& floorMap = venue->building->getFloorAt(0);
+            std::vector<std::pair<Location, Location>> segments;
+            std::normal_distribution<double> step(0, 2.0);
+            for(int i=0; i<n; i++){
+                Location start = venue->randomMovableLocation(0);
+                Location end(start.x() + step(venue->randomEngine()), start.y() + step(venue->randomEngine()), 0, 0);
+                segments.push_back(std::make_pair(start, end));
+            }
+            double sum = 0;
+            runner.run("wall_crossing_ratio", n, 0, 0, n, [&](){
+                for(const auto& seg: segments){
+                    sum += floorMap.wallCrossingRatio(seg.first, seg.second);
+                }
+            });
+        }
+        if(runner.enabled("find_closest_points")){
+            ImageHolder image = venue->building->getFloorAt(0).image();
+            image.setUpIndexForColor(color::blue);
+            std::uniform_int_distribution<int> ux(0, SyntheticVenue::width-1), uy(0, SyntheticVenue::height-1);
+            ImageHolder::Points points;
+            for(int i=0; i<n; i++){
+                points.push_back(ImageHolder::Point(ux(venue->randomEngine()), uy(venue->randomEngine())));
+            }
+            runner.run("find_closest_points", n, 0, 0, n, [&](){
+                for(const auto& p: points){
+                    image.findClosestPoints(color::blue, p);
+                }
+            });
+        }
+    }
+    // Parsing of sample csv lines
+    if(runner.enabled("parse_sample_csv")){
+        for(int nBeacons: opt.beacons){
+            auto venue = venueOf(nBeacons, nSamples0);
+            std::vector<std::string> lines;
+            for(const auto& sample: venue->samples){
+                Location loc = sample.location();
+                std::stringstream ss;
+                ss << sample.timestamp() << ",Beacon," << loc.x() << "," << loc.y() << "," << loc.z() << "," << loc.floor() << "," << sample.beacons().size();
+                for(const auto& b: sample.beacons()){
+                    ss << "," << b.major() << "," << b.minor() << "," << b.rssi();
+                }
+                lines.push_back(ss.str());
+            }
+            runner.run("parse_sample_csv", 0, nBeacons, nSamples0, lines.size(), [&](){
+                for(const auto& line: lines){
+                    DataUtils::parseSampleCSV(line);
+                }
+            });
+        }
+    }
+    
+    if(opt.outputPath.length() > 0){
+        std::ofstream ofs(opt.outputPath);
+        runner.write(ofs);
+    }else{
+        runner.write(std::cout);
+    }
+    return 0;
+}
@@ -0,0 +1,9 @@
+#!/bin/sh
+# Builds the benchmark with g++ against the ble-cpp sources (the log player tool in src/log is excluded).
+# Set CEREAL_INCLUDE and PICOJSON_INCLUDE when the headers are not installed in the system include path.
+SRC=../../ble-cpp/src
+INCLUDES=$(find $SRC -type d | sed 's/^/-I/')
+SOURCES=$(find $SRC -name '*.cpp' ! -path "$SRC/log/*")
+g++ -std=c++14 -O2 -DNDEBUG ${CEREAL_INCLUDE:+-I$CEREAL_INCLUDE} ${PICOJSON_INCLUDE:+-I$PICOJSON_INCLUDE} $INCLUDES \
+    $(pkg-config --cflags eigen3 opencv4) Benchmark/main.cpp $SOURCES \
+    $(pkg-config --libs opencv4) -lboost_system -lpthread -o Benchmark/benchmark
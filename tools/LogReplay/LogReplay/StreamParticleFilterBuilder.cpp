@@ -75,7 +75,7 @@ namespace loc{
         dataStore->bleBeacons(bleBeacons);
         
         // Building
-        ImageHolder::setMode(ImageHolderMode(light));
+        ImageHolder::setMode(ImageHolderMode(dense));
         BuildingBuilder buildingBuilder;
         
         if (mMapDataPath.find(",") != std::string::npos) {
@@ -120,8 +120,43 @@ namespace loc{
     }
     
     
+    void StreamParticleFilterBuilder::buildModel(){
+        if(mDataStore && mObsModel){
+            return;
+        }
+        
+        // Create data store
+        std::shared_ptr<DataStore> dataStore = buildDataStore();
+        mDataStore = dataStore;
+        mLocationIndex = std::make_shared<LocationIndex>(dataStore->getLocations(), dataStore->getBLEBeacons());
+        
+        std::shared_ptr<GaussianProcessLDPLMultiModel<State, Beacons>> obsModel(new GaussianProcessLDPLMultiModel<State, Beacons>());
+        std::ifstream ifs(trainedModelPath);
+        if (ifs.is_open()) {
+            std::cout << "De-serializing observationModel" <<std::endl;
+            obsModel->load(ifs);
+            this->mObsModel = obsModel;
+        } else {
+            // Train observation model
+            std::shared_ptr<GaussianProcessLDPLMultiModelTrainer<State, Beacons>>obsModelTrainer( new GaussianProcessLDPLMultiModelTrainer<State, Beacons>());
+            obsModelTrainer->dataStore(dataStore);
+            
+            obsModel.reset(obsModelTrainer->train());
+            
+            this->mObsModel = obsModel;
+            saveTrainedModel(trainedModelPath);
+        }
+        if (tDistribution >= 1) {
+            this->mObsModel->normFunc = MathUtils::logProbatDistFunc(tDistribution);
+        } else {
+            this->mObsModel->normFunc = MathUtils::logProbaNormal;
+        }
+    }
+    
     std::shared_ptr<StreamLocalizer> StreamParticleFilterBuilder::build(){
         
+        buildModel();
+        
         std::shared_ptr<StreamParticleFilter> localizer(new StreamParticleFilter());
         
         int nStates = 1000;
@@ -132,9 +167,7 @@ namespace loc{
         Location locLB(0.0,0.0,0,0);
         localizer->locationStandardDeviationLowerBound(locLB);
         
-        // Create data store
-        std::shared_ptr<DataStore> dataStore = buildDataStore();
-        mDataStore = dataStore;
+        std::shared_ptr<DataStore> dataStore = mDataStore;
         
         // Instantiate sensor data processors
         // Pedometer
@@ -227,44 +260,20 @@ namespace loc{
         // Set status initializer
         
         std::shared_ptr<StatusInitializerImpl> statusInitializer(new StatusInitializerImpl());
-        statusInitializer->dataStore(dataStore)
+        statusInitializer->dataStore(dataStore, mLocationIndex)
         .poseProperty(poseProperty).stateProperty(stateProperty);
         localizer->statusInitializer(statusInitializer);
         
-        
-        std::shared_ptr<GaussianProcessLDPLMultiModel<State, Beacons>> obsModel(new GaussianProcessLDPLMultiModel<State, Beacons>());
-        {
-            std::ifstream ifs(trainedModelPath);
-            if (ifs.is_open()) {
-                std::cout << "De-serializing observationModel" <<std::endl;
-                obsModel->load(ifs);
-                this->mObsModel = obsModel;
-                localizer->observationModel(obsModel);
-            } else {
-                // Train observation model
-                std::shared_ptr<GaussianProcessLDPLMultiModelTrainer<State, Beacons>>obsModelTrainer( new GaussianProcessLDPLMultiModelTrainer<State, Beacons>());
-                obsModelTrainer->dataStore(dataStore);
-                
-                obsModel.reset(obsModelTrainer->train());
-                
-                this->mObsModel = obsModel;
-                saveTrainedModel(trainedModelPath);
-                
-                // Set localizer
-                localizer->observationModel(obsModel);                
-            }
-        }
-        if (tDistribution >= 1) {
-            this->mObsModel->normFunc = MathUtils::logProbatDistFunc(tDistribution);
-        } else {
-            this->mObsModel->normFunc = MathUtils::logProbaNormal;
-        }
+        // The copy shares the trained GP with the other localizers built by this builder.
+        std::shared_ptr<GaussianProcessLDPLMultiModel<State, Beacons>> obsModel(new GaussianProcessLDPLMultiModel<State, Beacons>(*mObsModel));
+        localizer->observationModel(obsModel);
+        localizer->stateHistoryCapacity(obsModel->tDelay());
 
         if (considerBias) {
             // ObservationDependentInitializer
             std::shared_ptr<MetropolisSampler<State, Beacons>> obsDepInitializer(new MetropolisSampler<State, Beacons>());
             MetropolisSampler<State, Beacons>::Parameters msParams;
-            obsDepInitializer->observationModel(mObsModel);
+            obsDepInitializer->observationModel(obsModel);
             obsDepInitializer->statusInitializer(statusInitializer);
             msParams.burnIn = 1000;
             msParams.radius2D = 10; // 10[m]
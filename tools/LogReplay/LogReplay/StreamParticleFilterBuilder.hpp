@@ -65,6 +65,7 @@ namespace loc {
         std::string mMapDataPath;
         
         std::shared_ptr<DataStore> mDataStore;
+        LocationIndex::Ptr mLocationIndex;
         std::shared_ptr<GaussianProcessLDPLMultiModel<State, Beacons>> mObsModel;
         
     public:
@@ -112,6 +113,9 @@ namespace loc {
         }
         
         std::shared_ptr<DataStore> buildDataStore();
+        // Loads the data store and loads or trains the observation model on the first call.
+        void buildModel();
+        // Builds a localizer over the model of buildModel. Localizers share the data store and the trained model.
         std::shared_ptr<StreamLocalizer> build();
         
         const std::shared_ptr<DataStore>& dataStore(){
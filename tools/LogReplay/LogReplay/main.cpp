@@ -24,6 +24,8 @@
 #include <string>
 #include <sstream>
 #include <fstream>
+#include <chrono>
+#include <algorithm>
 
 
 #include "bleloc.h"
@@ -33,6 +35,7 @@
 #include "DataLogger.hpp"
 #include "ExtendedDataUtils.hpp"
 #include "StreamParticleFilterBuilder.hpp"
+#include "SegmentedBatchLocalizer.hpp"
 
 struct Option{
     std::string trainFilePath = "";
@@ -61,6 +64,9 @@ struct Option{
     double stdX = 1.0;
     double stdY = 1.0;
     double tDistribution = 0;
+    int smoothingLag = 0;
+    bool segmented = false;
+    int nThreads = 0;
     
     void print(){
         std::cout << "------------------------------------" << std::endl;
@@ -88,6 +94,8 @@ struct Option{
         std::cout << " tDistribution  =" << tDistribution << std::endl;
         std::cout << " stdX    =" << stdX << std::endl;
         std::cout << " stdY    =" << stdY << std::endl;
+        std::cout << " smoothingLag   =" << smoothingLag << std::endl;
+        std::cout << " segmented      =" << (segmented?"true":"false") << " (threads=" << nThreads << ")" << std::endl;
         std::cout << "------------------------------------" << std::endl;
     }
 };
@@ -125,6 +133,11 @@ void printHelp(std::string command){
     std::cout << " --stdX <float>       set standard deviation of x used in initialization and mcmc sampling" << std::endl;
     std::cout << " --stdY <float>       set standard deviation of y used in initialization and mcmc sampling" << std::endl;
     std::cout << " --students-t <float> set beacon rssi distribution as student's t distribution" << std::endl;
+    std::cout << " --smoothLag <int>    write locations smoothed with the lag [beacon input] to <outputFile>.smoothed.csv" << std::endl;
+    std::cout << "                      (fixed-lag smoothing on the particle ancestry, not offline smoothing of the whole log;" << std::endl;
+    std::cout << "                       keep it short as estimates far back rest on few surviving ancestors)" << std::endl;
+    std::cout << " --segments           split the log at beacon gaps and stationary periods and localize the segments in parallel" << std::endl;
+    std::cout << " --threads <int>      set the number of threads for --segments (0: all cores)" << std::endl;
     std::cout << std::endl;
     std::cout << "Example" << std::endl;
     std::cout << "$ " << command << " -t train.txt -b beacon.csv -m map.png -l navcog.log -o out.txt" << std::endl;
@@ -145,6 +158,9 @@ Option parseArguments(int argc,char *argv[]){
         {"stdX",            required_argument, NULL,  0 },
         {"stdY",            required_argument, NULL,  0 },
         {"tDistribution",   required_argument, NULL,  0 },
+        {"smoothLag",       required_argument, NULL,  0 },
+        {"segments",        no_argument,       NULL,  0 },
+        {"threads",         required_argument, NULL,  0 },
         {0,         0,                 0,  0 }
     };
 //while ((c = getopt (argc, argv, "shft:b:l:o:m:1:a:rp:njcd:g:")) != -1)
@@ -176,6 +192,15 @@ Option parseArguments(int argc,char *argv[]){
             if (strcmp(long_options[option_index].name, "tDistribution") == 0) {
                 opt.tDistribution = atof(optarg);
             }
+            if (strcmp(long_options[option_index].name, "smoothLag") == 0) {
+                opt.smoothingLag = atoi(optarg);
+            }
+            if (strcmp(long_options[option_index].name, "segments") == 0) {
+                opt.segmented = true;
+            }
+            if (strcmp(long_options[option_index].name, "threads") == 0) {
+                opt.nThreads = atoi(optarg);
+            }
             break;
         case 'h':
             printHelp(lastComponent(argv[0]));
@@ -309,6 +334,81 @@ std::vector<loc::Location> convertSamplesToGridLocations(const loc::Samples& sam
     return locs;
 }
 
+// Localizes the segments of the log in parallel and writes the stitched trajectory in the same format as the sequential replay.
+int runSegmented(const Option& opt, loc::StreamParticleFilterBuilder& builder){
+    using namespace loc;
+    if (opt.oneDPDR || opt.oneshot) {
+        std::cerr << "--segments does not support 1D-PDR and oneshot modes" << std::endl;
+        return -1;
+    }
+    std::vector<SensorEvent> events;
+    std::vector<std::pair<long, std::string>> truths; // ground truths appended to the results after their timestamps
+    loc::NavCogLogPlayer logPlayer;
+    logPlayer.filePath(opt.logFilePath);
+    logPlayer.functionCalledWhenBeaconsUpdated([&](Beacons beacons){
+        events.push_back(SensorEvent(beacons));
+    });
+    logPlayer.functionCalledWhenAccelerationUpdated([&](Acceleration acc){
+        events.push_back(SensorEvent(acc));
+    });
+    logPlayer.functionCalledWhenAttitudeUpdated([&](Attitude att){
+        events.push_back(SensorEvent(att));
+    });
+    logPlayer.functionCalledWhenReset([&](Pose poseReset){
+        // Reset lines are not applied, as in the sequential replay.
+    });
+    logPlayer.functionCalledWhenReached([&](long time_stamp, double pos){
+        std::stringstream ss;
+        ss << "," << pos*3*0.3048;
+        truths.push_back(std::make_pair(time_stamp, ss.str()));
+    });
+    logPlayer.functionCalledWhenGroundTruth([&](long time_stamp, double x, double y, double z, double floor) {
+        std::stringstream ss;
+        ss << "," << x << "," << y << "," << z << "," << (int)floor;
+        truths.push_back(std::make_pair(time_stamp, ss.str()));
+    });
+    logPlayer.run();
+    
+    SegmentedBatchLocalizerParameters params;
+    params.nThreads = opt.nThreads;
+    // The builder holds the data store and the observation model built in main; segments only build localizers over them.
+    SegmentedBatchLocalizer batchLocalizer([&](){
+        return builder.build();
+    }, params);
+    auto start = std::chrono::steady_clock::now();
+    auto trajectory = batchLocalizer.localize(events);
+    double wallTime = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    
+    std::stable_sort(truths.begin(), truths.end(), [](const std::pair<long, std::string>& a, const std::pair<long, std::string>& b){
+        return a.first < b.first;
+    });
+    std::stringstream ss;
+    size_t iTruth = 0;
+    std::string truth;
+    for(const auto& point: trajectory){
+        for(; iTruth<truths.size() && truths[iTruth].first<=point.timestamp; iTruth++){
+            truth = truths[iTruth].second;
+        }
+        ss << point.timestamp << "," << point.pose << truth << std::endl;
+    }
+    std::cout << ss.str();
+    
+    const auto& segments = batchLocalizer.segments();
+    for(size_t i=0; i<segments.size(); i++){
+        const auto& s = segments[i];
+        std::cerr << "segment " << i << ": " << s.start << "-" << s.end << " (" << s.reason << "), warmUp=" << s.start - s.warmUpStart
+        << "ms, events=" << s.nEvents << ", failed=" << s.nFailedEvents << ", time=" << s.elapsedTime << "s" << std::endl;
+    }
+    std::cerr << "localized " << segments.size() << " segments in " << wallTime << "s" << std::endl;
+    
+    if(opt.outputFilePath!=""){
+        std::ofstream ofs(opt.outputFilePath);
+        ofs << "timestamp," << Pose::header() << std::endl;
+        ofs << ss.str();
+    }
+    return 0;
+}
+
 int main(int argc,char *argv[]){
     
     if (argc <= 1) {
@@ -344,10 +444,7 @@ int main(int argc,char *argv[]){
     builder.poseProperty_stdX = opt.stdX;
     builder.poseProperty_stdY = opt.stdY;
     builder.tDistribution = opt.tDistribution;
-    std::shared_ptr<loc::StreamLocalizer> localizer = builder.build();
-        
-    UserData userData;
-    localizer->updateHandler(functionCalledWhenUpdated, &userData);
+    builder.buildModel();
     
     if(opt.directoryLog!=""){
         DataLogger::createInstance(opt.directoryLog);
@@ -375,6 +472,29 @@ int main(int argc,char *argv[]){
         }
     }
     
+    if (opt.segmented) {
+        return runSegmented(opt, builder);
+    }
+    
+    std::shared_ptr<loc::StreamLocalizer> localizer = builder.build();
+    
+    UserData userData;
+    localizer->updateHandler(functionCalledWhenUpdated, &userData);
+    
+    // Fixed-lag smoothing of the tracked locations
+    std::shared_ptr<FixedLagSmoother> smoother;
+    std::stringstream ssSmoothed;
+    if(0<opt.smoothingLag){
+        smoother = std::make_shared<FixedLagSmoother>(opt.smoothingLag);
+        std::dynamic_pointer_cast<StreamParticleFilter>(localizer)->smoother(smoother);
+    }
+    auto writeSmoothedLocations = [&](){
+        FixedLagSmoother::Estimate estimate;
+        while(smoother && smoother->next(estimate)){
+            ssSmoothed << estimate << std::endl;
+        }
+    };
+    
     if (opt.oneDPDR) {
         loc::Pose pose;
         float orientation = atan2(opt.endy-opt.starty, 0);
@@ -395,6 +515,7 @@ int main(int argc,char *argv[]){
             functionCalledWhenUpdated((void*)&userData, localizer->getStatus());
         } else {
             localizer->putBeacons(beacons);
+            writeSmoothedLocations();
         }
         
         if(opt.directoryLog!=""){
@@ -448,6 +569,13 @@ int main(int argc,char *argv[]){
         ofs << "timestamp," << Pose::header() << std::endl;
         ofs << userData.ss.str();
     }
+    if(smoother){
+        smoother->flush();
+        writeSmoothedLocations();
+        std::ofstream ofs(opt.outputFilePath!="" ? opt.outputFilePath + ".smoothed.csv" : "smoothed.csv");
+        ofs << FixedLagSmoother::Estimate::header() << std::endl;
+        ofs << ssSmoothed.str();
+    }
     
     std::cout<<"Log play end"<<std::endl;
     return 0;
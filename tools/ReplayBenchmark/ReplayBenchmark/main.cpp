@@ -0,0 +1,409 @@
+/*******************************************************************************
+ * Copyright (c) 2014, 2016  IBM Corporation and others
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *******************************************************************************/
+
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+#include <numeric>
+#include <algorithm>
+#include <map>
+#include <getopt.h>
+#include <sys/resource.h>
+#include <boost/algorithm/string.hpp>
+
+#include "bleloc.h"
+#include "BasicLocalizer.hpp"
+#include "LogUtil.hpp"
+#include "NavCogLogPlayer.hpp"
+#include "StreamParticleFilterBuilder.hpp"
+
+using namespace loc;
+
+// End-to-end replay benchmark. A recorded session is fed to a localizer as fast as possible
+// and throughput, per-call latency, peak memory and localization error are reported.
+//
+// NavCog logs (navcog.log with train.txt, beacons.csv and map.png) are replayed with the localizer
+// built by LogReplay's StreamParticleFilterBuilder because these inputs do not contain a map json.
+// BasicLocalizer logs are replayed with BasicLocalizer when a map json is given by --model.
+
+typedef struct {
+    // NavCog log mode (same options as LogReplay)
+    std::string trainFilePath = "";
+    std::string beaconFilePath = "";
+    std::string mapFilePath = "";
+    std::string logFilePath = "";
+    bool shortCSV = false;
+    bool jsonSample = false;
+    float unit = 1.0;
+    bool oneDPDR = false;
+    float starty = 0;
+    float endy = 0;
+    // BasicLocalizer mode
+    std::string modelPath = "";
+    std::string localizerJSONPath = "";
+    int nStates = 1000;
+    // common
+    int repeat = 1;
+    std::string outputPath = "";
+} Option;
+
+void printHelp() {
+    std::cout << "Options for ReplayBenchmark" << std::endl;
+    std::cout << " -h                   show this help" << std::endl;
+    std::cout << " -t trainingDataFile  set training data file of NavCog log mode (long csv format)" << std::endl;
+    std::cout << " -s                   indicates <trainingDataFile> is in short csv format (3-feet unit)" << std::endl;
+    std::cout << " -j                   indicates <trainingDataFile> is in json sample format" << std::endl;
+    std::cout << " -b beaconDataFile    set beacon data file of NavCog log mode" << std::endl;
+    std::cout << " -f                   indicates <beaconDataFile> is in feet unit" << std::endl;
+    std::cout << " -m mapImage          set map image file of NavCog log mode" << std::endl;
+    std::cout << " -1 starty,endy       set 1D-PDR mode and the start/end point in feet" << std::endl;
+    std::cout << " -l logFile           set log file to replay" << std::endl;
+    std::cout << " --model <path>       set map json and replay <logFile> with BasicLocalizer" << std::endl;
+    std::cout << " --lj <path>          set BasicLocalizer parameter json" << std::endl;
+    std::cout << " -n <int>             set number of states of BasicLocalizer (default 1000)" << std::endl;
+    std::cout << " --repeat <int>       replay the log repeatedly (default 1)" << std::endl;
+    std::cout << " -o output            set output file (default stdout)" << std::endl;
+    std::cout << std::endl;
+    std::cout << "Example" << std::endl;
+    std::cout << "$ ReplayBenchmark -t train.txt -b beacons.csv -m map.png -l navcog.log -1 9,60" << std::endl;
+    std::cout << "$ ReplayBenchmark --model map.json -l 2017-01-01-00-00-00.log" << std::endl;
+}
+
+Option parseArguments(int argc, char *argv[]){
+    Option opt;
+    int c = 0;
+    int option_index = 0;
+    struct option long_options[] = {
+        {"model",     required_argument, NULL,  0 },
+        {"lj",        required_argument, NULL,  0 },
+        {"repeat",    required_argument, NULL,  0 },
+        {0,         0,                 0,  0 }
+    };
+    while ((c = getopt_long(argc, argv, "ht:sjb:fm:1:l:n:o:", long_options, &option_index )) != -1){
+        switch(c){
+            case 0:
+                if (strcmp(long_options[option_index].name, "model") == 0){
+                    opt.modelPath.assign(optarg);
+                }
+                if (strcmp(long_options[option_index].name, "lj") == 0){
+                    opt.localizerJSONPath.assign(optarg);
+                }
+                if (strcmp(long_options[option_index].name, "repeat") == 0){
+                    opt.repeat = std::max(atoi(optarg), 1);
+                }
+                break;
+            case 'h':
+                printHelp();
+                exit(0);
+            case 't':
+                opt.trainFilePath.assign(optarg);
+                break;
+            case 's':
+                opt.shortCSV = true;
+                break;
+            case 'j':
+                opt.jsonSample = true;
+                break;
+            case 'b':
+                opt.beaconFilePath.assign(optarg);
+                break;
+            case 'f':
+                opt.unit = 0.3048;
+                break;
+            case 'm':
+                opt.mapFilePath.assign(optarg);
+                break;
+            case '1':
+                opt.oneDPDR = true;
+                sscanf(optarg, "%f,%f", &(opt.starty), &(opt.endy));
+                break;
+            case 'l':
+                opt.logFilePath.assign(optarg);
+                break;
+            case 'n':
+                opt.nStates = atoi(optarg);
+                break;
+            case 'o':
+                opt.outputPath.assign(optarg);
+                break;
+            default:
+                printHelp();
+                exit(1);
+        }
+    }
+    return opt;
+}
+
+// Peak resident set size in bytes
+long peakRSS(){
+    struct rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+#ifdef __APPLE__
+    return usage.ru_maxrss;
+#else
+    return usage.ru_maxrss*1024L;
+#endif
+}
+
+class ReplayStatistics{
+public:
+    std::map<std::string, std::vector<double>> latencies; // [s] per input type
+    long nParticleUpdates = 0;
+    long nStatusUpdates = 0;
+    std::shared_ptr<Pose> recentPose;
+    std::vector<double> errors; // errors at reference points
+    double replayTime = 0; // [s] excluding localizer construction
+    
+    // Times a call of the localizer
+    template<class F>
+    void measure(const std::string& name, F&& func){
+        auto s = std::chrono::steady_clock::now();
+        func();
+        latencies[name].push_back(std::chrono::duration<double>(std::chrono::steady_clock::now() - s).count());
+    }
+    
+    static double percentile(std::vector<double> values, double p){
+        if(values.size()==0){
+            return NAN;
+        }
+        std::sort(values.begin(), values.end());
+        size_t rank = std::max(static_cast<size_t>(std::ceil(p*values.size())), (size_t)1);
+        return values.at(std::min(rank, values.size()) - 1);
+    }
+    
+    size_t nEvents() const{
+        size_t n = 0;
+        for(const auto& pair: latencies){
+            n += pair.second.size();
+        }
+        return n;
+    }
+    
+    double busyTime() const{
+        double t = 0;
+        for(const auto& pair: latencies){
+            t += std::accumulate(pair.second.begin(), pair.second.end(), 0.0);
+        }
+        return t;
+    }
+    
+    void write(std::ostream& os) const{
+        os << "metric,value" << std::endl;
+        os << "replay_time_s," << replayTime << std::endl;
+        os << "localizer_time_s," << busyTime() << std::endl;
+        os << "events," << nEvents() << std::endl;
+        os << "events_per_sec," << nEvents()/replayTime << std::endl;
+        os << "status_updates," << nStatusUpdates << std::endl;
+        os << "particle_updates," << nParticleUpdates << std::endl;
+        os << "particle_updates_per_sec," << nParticleUpdates/replayTime << std::endl;
+        for(const auto& pair: latencies){
+            const auto& v = pair.second;
+            os << pair.first << "_count," << v.size() << std::endl;
+            os << pair.first << "_mean_us," << std::accumulate(v.begin(), v.end(), 0.0)/v.size()*1e6 << std::endl;
+            os << pair.first << "_p50_us," << percentile(v, 0.50)*1e6 << std::endl;
+            os << pair.first << "_p95_us," << percentile(v, 0.95)*1e6 << std::endl;
+            os << pair.first << "_p99_us," << percentile(v, 0.99)*1e6 << std::endl;
+            os << pair.first << "_max_us," << percentile(v, 1.0)*1e6 << std::endl;
+        }
+        os << "peak_rss_bytes," << peakRSS() << std::endl;
+        os << "n_reference_points," << errors.size() << std::endl;
+        os << "mean_error," << (errors.size()>0 ? std::accumulate(errors.begin(), errors.end(), 0.0)/errors.size() : NAN) << std::endl;
+        os << "final_error," << (errors.size()>0 ? errors.back() : NAN) << std::endl;
+    }
+};
+
+void functionCalledWhenUpdated(void *userData, loc::Status *pStatus){
+    ReplayStatistics* stats = (ReplayStatistics*) userData;
+    stats->nStatusUpdates++;
+    if(auto particles = pStatus->particles()){
+        stats->nParticleUpdates += particles->size();
+    }
+    if(pStatus->meanPose()){
+        stats->recentPose = pStatus->meanPose();
+    }
+}
+
+// Replays a NavCog log. Errors are evaluated on y axis at "Reached" lines in 1D-PDR mode
+// and in 2D at "GroundTruth" lines.
+void replayNavCogLog(const Option& opt, ReplayStatistics& stats){
+    StreamParticleFilterBuilder builder;
+    builder.usesObservationDependentInitializer = false;
+    builder.mixProbability = 0.0;
+    builder.trainDataPath(opt.trainFilePath);
+    builder.shortCSV = opt.shortCSV;
+    builder.jsonSample = opt.jsonSample;
+    builder.unit = opt.unit;
+    builder.beaconDataPath(opt.beaconFilePath);
+    builder.mapDataPath(opt.mapFilePath);
+    std::shared_ptr<StreamLocalizer> localizer = builder.build();
+    localizer->updateHandler(functionCalledWhenUpdated, &stats);
+    
+    if(opt.oneDPDR){
+        Pose pose;
+        pose.x(0).y(opt.starty*0.3048).z(0).floor(0).orientation(atan2(opt.endy-opt.starty, 0));
+        Pose stdevPose;
+        stdevPose.x(0.25).y(0.25).orientation(1.0/180.0*M_PI);
+        localizer->resetStatus(pose, stdevPose);
+    }
+    
+    NavCogLogPlayer logPlayer;
+    logPlayer.filePath(opt.logFilePath);
+    logPlayer.functionCalledWhenBeaconsUpdated([&](Beacons beacons){
+        stats.measure("putBeacons", [&](){ localizer->putBeacons(beacons); });
+    });
+    logPlayer.functionCalledWhenAccelerationUpdated([&](Acceleration acc){
+        stats.measure("putAcceleration", [&](){ localizer->putAcceleration(acc); });
+    });
+    logPlayer.functionCalledWhenAttitudeUpdated([&](Attitude att){
+        if(opt.oneDPDR){
+            att = Attitude(att.timestamp(), 0, 0, 0);
+        }
+        stats.measure("putAttitude", [&](){ localizer->putAttitude(att); });
+    });
+    logPlayer.functionCalledWhenReset([](Pose){});
+    logPlayer.functionCalledWhenReached([&](long timestamp, double pos){
+        if(stats.recentPose){
+            stats.errors.push_back(std::abs(stats.recentPose->y() - pos*3*0.3048));
+        }
+    });
+    logPlayer.functionCalledWhenGroundTruth([&](long timestamp, double x, double y, double z, double floor){
+        if(stats.recentPose){
+            stats.errors.push_back(Location::distance2D(Location(x, y, z, floor), *stats.recentPose));
+        }
+    });
+    auto s = std::chrono::steady_clock::now();
+    logPlayer.run();
+    stats.replayTime = std::chrono::duration<double>(std::chrono::steady_clock::now() - s).count();
+}
+
+// Replays a BasicLocalizer log. Errors are evaluated at "Marker" lines.
+void replayBasicLocalizerLog(const Option& opt, ReplayStatistics& stats){
+    std::shared_ptr<BasicLocalizer> localizer;
+    std::ifstream ifsJSON(opt.localizerJSONPath);
+    if(!opt.localizerJSONPath.empty() && ifsJSON.is_open()){
+        cereal::JSONInputArchive iarchive(ifsJSON);
+        BasicLocalizerParameters params;
+        iarchive(params);
+        localizer = std::make_shared<BasicLocalizer>(params);
+    }else{
+        localizer = std::make_shared<BasicLocalizer>();
+        localizer->nStates = opt.nStates;
+    }
+    localizer->updateHandler(functionCalledWhenUpdated, &stats);
+    localizer->setModel(opt.modelPath, "./");
+    
+    std::ifstream ifs(opt.logFilePath);
+    if(ifs.fail()){
+        BOOST_THROW_EXCEPTION(LocException("log file is unable to read: " + opt.logFilePath));
+    }
+    auto latLngConverter = localizer->latLngConverter();
+    auto s = std::chrono::steady_clock::now();
+    std::string str;
+    while(getline(ifs, str)){
+        std::vector<std::string> v;
+        boost::split(v, str, boost::is_any_of(" "));
+        if(v.size() <= 3){
+            continue;
+        }
+        const std::string& logString = v.at(3);
+        try{
+            if (logString.compare(0, 7, "Beacon,") == 0) {
+                Beacons beacons = LogUtil::toBeacons(logString);
+                for(auto& b: beacons){
+                    b.rssi( b.rssi() < 0 ? b.rssi() : -100);
+                }
+                stats.measure("putBeacons", [&](){ localizer->putBeacons(beacons); });
+            }else if (logString.compare(0, 4, "Acc,") == 0) {
+                Acceleration acc = LogUtil::toAcceleration(logString);
+                stats.measure("putAcceleration", [&](){ localizer->putAcceleration(acc); });
+            }else if (logString.compare(0, 7, "Motion,") == 0) {
+                Attitude att = LogUtil::toAttitude(logString);
+                stats.measure("putAttitude", [&](){ localizer->putAttitude(att); });
+            }else if (logString.compare(0, 10,"Altimeter,") == 0){
+                Altimeter alt = LogUtil::toAltimeter(logString);
+                stats.measure("putAltimeter", [&](){ localizer->putAltimeter(alt); });
+            }else if (logString.compare(0, 8,"Heading,") == 0){
+                Heading heading = LogUtil::toHeading(logString);
+                if(heading.trueHeading() < 0 && std::isnan(latLngConverter->anchor().magneticDeclination)){
+                    continue; // true heading cannot be computed
+                }
+                stats.measure("putHeading", [&](){ localizer->putHeading(heading); });
+            }else if (logString.compare(0, 7, "Marker,") == 0){
+                // "Marker",lat,lng,floor,timestamp
+                std::vector<std::string> values;
+                boost::split(values, logString, boost::is_any_of(","));
+                Location markerLoc;
+                GlobalState<Location> global(markerLoc);
+                global.lat(stod(values.at(1)));
+                global.lng(stod(values.at(2)));
+                global.floor(stod(values.at(3)));
+                markerLoc = latLngConverter->globalToLocal(global);
+                if(stats.recentPose){
+                    stats.errors.push_back(Location::distance2D(markerLoc, *stats.recentPose));
+                }
+            }
+        }catch (std::invalid_argument& e){
+            std::cerr << opt.logFilePath << ": error in parse log file (" << e.what() << ")" << std::endl;
+        }
+    }
+    stats.replayTime = std::chrono::duration<double>(std::chrono::steady_clock::now() - s).count();
+    // Latencies of the filter stages
+    std::cerr << localizer->metrics()->snapshot();
+}
+
+int main(int argc, char * argv[]) {
+    Option opt = parseArguments(argc, argv);
+    if(opt.logFilePath.empty()){
+        printHelp();
+        return 1;
+    }
+    
+    ReplayStatistics stats;
+    for(int i=0; i<opt.repeat; i++){
+        ReplayStatistics run;
+        if(opt.modelPath.empty()){
+            replayNavCogLog(opt, run);
+        }else{
+            replayBasicLocalizerLog(opt, run);
+        }
+        std::cerr << "repeat " << i << ": " << run.nEvents() << " events in " << run.replayTime << "s (" << run.busyTime() << "s in localizer)" << std::endl;
+        stats.replayTime += run.replayTime;
+        for(const auto& pair: run.latencies){
+            auto& v = stats.latencies[pair.first];
+            v.insert(v.end(), pair.second.begin(), pair.second.end());
+        }
+        stats.nParticleUpdates += run.nParticleUpdates;
+        stats.nStatusUpdates += run.nStatusUpdates;
+        stats.errors = run.errors;
+    }
+    
+    if(opt.outputPath.length() > 0){
+        std::ofstream ofs(opt.outputPath);
+        stats.write(ofs);
+    }else{
+        stats.write(std::cout);
+    }
+    return 0;
+}
@@ -0,0 +1,10 @@
+#!/bin/sh
+# Builds the benchmark with g++ against the ble-cpp sources and the NavCog log player of LogReplay.
+# Set CEREAL_INCLUDE and PICOJSON_INCLUDE when the headers are not installed in the system include path.
+SRC=../../ble-cpp/src
+LOGREPLAY=../LogReplay/LogReplay
+INCLUDES="-I$LOGREPLAY $(find $SRC -type d ! -path "$SRC/log" | sed 's/^/-I/')"
+SOURCES="$(find $SRC -name '*.cpp' ! -path "$SRC/log/*") $LOGREPLAY/NavCogLogPlayer.cpp $LOGREPLAY/StreamParticleFilterBuilder.cpp"
+g++ -std=c++14 -O2 -DNDEBUG ${CEREAL_INCLUDE:+-I$CEREAL_INCLUDE} ${PICOJSON_INCLUDE:+-I$PICOJSON_INCLUDE} $INCLUDES \
+    $(pkg-config --cflags eigen3 opencv4) ReplayBenchmark/main.cpp $SOURCES \
+    $(pkg-config --libs opencv4) -lboost_system -lpthread -o ReplayBenchmark/replay_benchmark